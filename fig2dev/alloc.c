@@ -0,0 +1,119 @@
+/*
+ * TransFig: Facility for Translating Fig code
+ * Copyright (c) 1991 by Micah Beck
+ * Parts Copyright (c) 1985-1988 by Supoj Sutanthavibul
+ * Parts Copyright (c) 1989-2002 by Brian V. Smith
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish and/or distribute copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that this copyright
+ * notice remain intact.
+ *
+ */
+
+/*
+ * Arena for the objects of a figure.
+ *
+ * Everything read from a Fig file (objects, points, controls, arrows,
+ * comments and text strings) is carved out of large chunks with a bump
+ * pointer.  The points of one polyline therefore lie next to each other
+ * in memory, and the whole figure is released by free_arena() with one
+ * free() per chunk instead of one per point.
+ */
+
+#include "fig2dev.h"
+#include "alloc.h"
+
+/* chunks start small for small figures and double up to ARENA_MAX_CHUNK */
+#define	ARENA_MIN_CHUNK	16384
+#define	ARENA_MAX_CHUNK	1048576
+
+/* everything is aligned for the most demanding member of the object structs */
+typedef union {
+	double	 d;
+	long	 l;
+	char	*p;
+} Arena_align;
+
+#define	ARENA_ALIGN(n)	(((n) + sizeof(Arena_align)-1) & ~(sizeof(Arena_align)-1))
+
+typedef struct arena_chunk {
+	struct arena_chunk	*next;
+} Arena_chunk;
+
+#define	CHUNK_HDR	ARENA_ALIGN(sizeof(Arena_chunk))
+
+static Arena_chunk	*chunks = NULL;		/* newest chunk first */
+static char		*arena_next = NULL;	/* free space in the newest chunk */
+static char		*arena_limit = NULL;
+static size_t		 chunk_size = ARENA_MIN_CHUNK;
+
+char *
+fig_alloc(size)
+    size_t	 size;
+{
+	Arena_chunk	*c;
+	char		*p;
+
+	size = ARENA_ALIGN(size);
+	if (size > (size_t) (arena_limit - arena_next)) {
+	    if (size > chunk_size/4) {
+		/* a big request gets a chunk of its own, behind the current
+		   one so that the space left there isn't wasted */
+		if ((c = (Arena_chunk *) malloc(CHUNK_HDR + size)) == NULL)
+		    return NULL;
+		if (chunks) {
+		    c->next = chunks->next;
+		    chunks->next = c;
+		} else {
+		    c->next = NULL;
+		    chunks = c;
+		}
+		return (char *) c + CHUNK_HDR;
+	    }
+	    if ((c = (Arena_chunk *) malloc(CHUNK_HDR + chunk_size)) == NULL)
+		return NULL;
+	    c->next = chunks;
+	    chunks = c;
+	    arena_next = (char *) c + CHUNK_HDR;
+	    arena_limit = arena_next + chunk_size;
+	    if (chunk_size < ARENA_MAX_CHUNK)
+		chunk_size *= 2;
+	}
+	p = arena_next;
+	arena_next += size;
+	return p;
+}
+
+/* copy a string into the arena */
+
+char *
+fig_strdup(s)
+    char	*s;
+{
+	char	*p;
+
+	if ((p = fig_alloc(strlen(s)+1)) != NULL)
+	    strcpy(p, s);
+	return p;
+}
+
+/* release all objects of the figure at once */
+
+void
+free_arena()
+{
+	Arena_chunk	*c, *next;
+
+	for (c = chunks; c != NULL; c = next) {
+	    next = c->next;
+	    free((char *) c);
+	}
+	chunks = NULL;
+	arena_next = arena_limit = NULL;
+	chunk_size = ARENA_MIN_CHUNK;
+}
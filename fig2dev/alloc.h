@@ -13,15 +13,22 @@
  * notice remain intact.
  */
 
-#define		Line_malloc(z)		z = (F_line*)malloc(LINOBJ_SIZE)
-#define		Pic_malloc(z)		z = (F_pic*)malloc(PIC_SIZE)
-#define		Spline_malloc(z)	z = (F_spline*)malloc(SPLOBJ_SIZE)
-#define		Ellipse_malloc(z)	z = (F_ellipse*)malloc(ELLOBJ_SIZE)
-#define		Arc_malloc(z)		z = (F_arc*)malloc(ARCOBJ_SIZE)
-#define		Compound_malloc(z)	z = (F_compound*)malloc(COMOBJ_SIZE)
-#define		Text_malloc(z)		z = (F_text*)malloc(TEXOBJ_SIZE)
-#define		Point_malloc(z)		z = (F_point*)malloc(POINT_SIZE)
-#define		Control_malloc(z)	z = (F_control*)malloc(CONTROL_SIZE)
-#define		Arrow_malloc(z)		z = (F_arrow*)malloc(ARROW_SIZE)
+/* all objects of a figure are allocated from the arena in alloc.c */
+
+#define		Line_malloc(z)		z = (F_line*)fig_alloc(LINOBJ_SIZE)
+#define		Pic_malloc(z)		z = (F_pic*)fig_alloc(PIC_SIZE)
+#define		Spline_malloc(z)	z = (F_spline*)fig_alloc(SPLOBJ_SIZE)
+#define		Ellipse_malloc(z)	z = (F_ellipse*)fig_alloc(ELLOBJ_SIZE)
+#define		Arc_malloc(z)		z = (F_arc*)fig_alloc(ARCOBJ_SIZE)
+#define		Compound_malloc(z)	z = (F_compound*)fig_alloc(COMOBJ_SIZE)
+#define		Text_malloc(z)		z = (F_text*)fig_alloc(TEXOBJ_SIZE)
+#define		Point_malloc(z)		z = (F_point*)fig_alloc(POINT_SIZE)
+#define		Control_malloc(z)	z = (F_control*)fig_alloc(CONTROL_SIZE)
+#define		Arrow_malloc(z)		z = (F_arrow*)fig_alloc(ARROW_SIZE)
+#define		Comment_malloc(z)	z = (F_comment*)fig_alloc(COMMENT_SIZE)
+
+extern char	*fig_alloc();
+extern char	*fig_strdup();
+extern void	 free_arena();
 
 extern char	Err_mem[];
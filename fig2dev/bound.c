@@ -17,6 +17,7 @@
 #include "fig2dev.h"
 #include "object.h"
 #include "bound.h"
+#include "trans_spline.h"
 
 extern int adjust_boundingbox;
 
@@ -32,6 +33,7 @@ static double	compute_angle();
 static void	arrow_bound();
 static void	points_bound();
 static void	control_points_bound();
+static void	xspline_bound();
 
 /************** ARRAY FOR ARROW SHAPES **************/ 
 
@@ -419,10 +421,10 @@ line_bound(l, xmin, ymin, xmax, ymax)
 F_line	*l;
 int	*xmin, *ymin, *xmax, *ymax;
 {
-	points_bound(l->points, xmin, ymin, xmax, ymax);
+	points_bound(l->pts, l->npts, xmin, ymin, xmax, ymax);
 	/* now add in the arrow (if any) boundaries but
 	   only if the line has two or more points */
-	if (l->points->next)
+	if (l->npts > 1)
 	    arrow_bound(O_POLYLINE, l, xmin, ymin, xmax, ymax);
 }
 
@@ -523,11 +525,38 @@ int		*xmin, *ymin, *xmax, *ymax;
 	    }
 }
 
+/* bounds of the X-spline, flattened to BOUND_TOLERANCE, and its arrows */
+
+static void
+xspline_bound(s, xmin, ymin, xmax, ymax)
+F_spline	*s;
+int		*xmin, *ymin, *xmax, *ymax;
+{
+	F_line	 l;
+
+	if ((l.pts = xspline_points(s, BOUND_TOLERANCE, &l.npts)) == NULL) {
+	    /* out of memory; the control points will have to do */
+	    points_bound(s->pts, s->npts, xmin, ymin, xmax, ymax);
+	    return;
+	    }
+	points_bound(l.pts, l.npts, xmin, ymin, xmax, ymax);
+	if (l.npts > 1) {
+	    l.thickness = s->thickness;
+	    l.for_arrow = s->for_arrow;
+	    l.back_arrow = s->back_arrow;
+	    arrow_bound(O_POLYLINE, &l, xmin, ymin, xmax, ymax);
+	    }
+}
+
 void
 spline_bound(s, xmin, ymin, xmax, ymax)
 F_spline	*s;
 int		*xmin, *ymin, *xmax, *ymax;
 {
+	if (x_spline(s)) {
+	    xspline_bound(s, xmin, ymin, xmax, ymax);
+	    return;
+	    }
 	if (int_spline(s)) {
 	    int_spline_bound(s, xmin, ymin, xmax, ymax);
 	    }
@@ -649,17 +678,18 @@ text_bound(t, xmin, ymin, xmax, ymax, inc_text)
 }
 
 static void
-points_bound(points, xmin, ymin, xmax, ymax)
-    F_point	*points;
+points_bound(pts, npts, xmin, ymin, xmax, ymax)
+    F_pos	*pts;
+    int		 npts;
     int		*xmin, *ymin, *xmax, *ymax;
 {
 	int	bx, by, sx, sy;
-	F_point	*p;
+	int	i;
 
-	bx = sx = points->x; by = sy = points->y;
-	for (p = points->next; p != NULL; p = p->next) {
-	    sx = min(sx, p->x); sy = min(sy, p->y);
-	    bx = max(bx, p->x); by = max(by, p->y);
+	bx = sx = pts[0].x; by = sy = pts[0].y;
+	for (i = 1; i < npts; i++) {
+	    sx = min(sx, pts[i].x); sy = min(sy, pts[i].y);
+	    bx = max(bx, pts[i].x); by = max(by, pts[i].y);
 	    }
 	*xmin = sx; *ymin = sy;
 	*xmax = bx; *ymax = by;
@@ -697,7 +727,6 @@ arrow_bound(objtype, obj, xmin, ymin, xmax, ymax)
 {
     int		    fxmin, fymin, fxmax, fymax;
     int		    bxmin, bymin, bxmax, bymax;
-    F_point	   *p, *q;
     F_arc	   *a;
     int		    p1x, p1y, p2x, p2y;
     int		    dum;
@@ -715,13 +744,11 @@ arrow_bound(objtype, obj, xmin, ymin, xmax, ymax)
 	} else {
 	    /* this doesn't work very well for a spline with few points 
 		and lots of curvature */
-	    /* locate last point (forward tip) and next-to-last point */
-	    for (p = obj->points; p->next; p = p->next)
-		q = p;
-	    p1x = q->x;
-	    p1y = q->y;
-	    p2x = p->x;
-	    p2y = p->y;
+	    /* last point (forward tip) and next-to-last point */
+	    p1x = obj->pts[obj->npts-2].x;
+	    p1y = obj->pts[obj->npts-2].y;
+	    p2x = obj->pts[obj->npts-1].x;
+	    p2y = obj->pts[obj->npts-1].y;
 	}
 	calc_arrow(p1x, p1y, p2x, p2y, obj->thickness,
 			obj->for_arrow, arrowpts, &npts, arrowdumpts, &dum, arrowdumpts, &dum);
@@ -747,10 +774,10 @@ arrow_bound(objtype, obj, xmin, ymin, xmax, ymax)
 	    p2x = a->point[0].x;	/* backward tip */
 	    p2y = a->point[0].y;
 	} else {
-	    p1x = obj->points->next->x;	/* second point */
-	    p1y = obj->points->next->y;
-	    p2x = obj->points->x;	/* first point (forward tip) */
-	    p2y = obj->points->y;
+	    p1x = obj->pts[1].x;	/* second point */
+	    p1y = obj->pts[1].y;
+	    p2x = obj->pts[0].x;	/* first point (forward tip) */
+	    p2y = obj->pts[0].y;
 	}
 	calc_arrow(p1x, p1y, p2x, p2y, obj->thickness,
 			obj->back_arrow, arrowpts, &npts, arrowdumpts, &dum, arrowdumpts, &dum);
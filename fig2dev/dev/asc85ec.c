@@ -22,23 +22,28 @@
 
 typedef unsigned char byte;
 
-static unsigned char buf[4];
-static unsigned long power85[5] = { 1L, 85L, 85L*85, 85L*85*85, 85L*85*85*85};
+/*
+ * The encoders read the input a block at a time and build the output
+ * lines in obuf, which is written whenever it fills up.
+ */
+
+#define INBUFSIZE	4096
+#define OUTBUFSIZE	8192
+#define OUTSLACK	16		/* most that one group adds to obuf */
+
+static byte inbuf[INBUFSIZE];
+static byte obuf[OUTBUFSIZE];
+static int opos;			/* Number of characters in obuf */
 static int outbytes;		/* Number of characters in an output line */
 
-/* read 0-4 Bytes. result: number of bytes read */
-static int 
-ReadSomeBytes(FILE * in)
+static void 
+flushout(FILE * out)
 {
-  register int count, i;
-
-  for (count = 0; count < 4; count++) {
-    if ((i = getc(in)) == EOF)
-      break;
-    else
-      buf[count] = (byte) i;
+  if (opos > 0 && fwrite(obuf, 1, opos, out) != (size_t) opos) {
+    fprintf(stderr, "jpeg2ps: write error - exit!\n");
+    exit(1);
   }
-  return count;
+  opos = 0;
 }
 
 /* Two percent characters at the start of a line will cause trouble
@@ -51,84 +56,152 @@ ReadSomeBytes(FILE * in)
  */
 
 static void 
-outbyte(byte c, FILE * out)
+outbyte(byte c)
 {    /* output one byte */
 
-  if (fputc(c, out) == EOF) {
-    fprintf(stderr, "jpeg2ps: write error - exit!\n");
-    exit(1);
-  }
+  obuf[opos++] = c;
 
   if (++outbytes > 63 ||		/* line limit reached */
     (outbytes == 1 && c == '%') ) {	/* caution: percent character at start of line */
-    fputc('\n', out);			/* insert line feed */
+    obuf[opos++] = '\n';		/* insert line feed */
     outbytes = 0;
   }
 }
 
-int
-ASCII85Encode(FILE * in, FILE * out)
+/* the 5 ASCII85 digits of word, most significant first */
+static void 
+base85(unsigned long word, byte *d)
 {
-  register int i, count;
-  unsigned long word, v;
+  register int i;
+
+  for (i = 4; i >= 0; i--) {
+    d[i] = (byte) (word % 85 + '!');
+    word /= 85;
+  }
+}
+
+/*
+ * ASCII85 encoding of data that comes in pieces: ASCII85Begin(),
+ * ASCII85Write() for each piece, ASCII85End().  Up to 3 bytes of a
+ * group are kept over from one piece to the next.
+ */
 
+static FILE *a85out;
+static byte group[4];		/* bytes of an unfinished group */
+static int ngroup;
+
+void
+ASCII85Begin(FILE * out)
+{
+  a85out = out;
   outbytes = 0;
+  opos = 0;
+  ngroup = 0;
+}
 
-  /* 4 bytes read ==> output 5 bytes */
-  while ((count = ReadSomeBytes(in)) == 4) {
-    word = ((unsigned long)(((unsigned int)buf[0] << 8) + buf[1]) << 16) +
-                   (((unsigned int)buf[2] << 8) + buf[3]);
-    if (word == 0)
-      outbyte('z', out);       /* shortcut for 0 */
-    else
-      /* calculate 5 ASCII85 bytes and output them */
-      for (i = 4; i >= 0; i--) {
-	v = word / power85[i];
-	outbyte((byte) (v + '!'), out);
-	word -= v * power85[i];
-      }
+/* 4 bytes in ==> 5 bytes out */
+static void 
+put_group(byte *p)
+{
+  register int i;
+  unsigned long word;
+  byte d[5];
+
+  word = ((unsigned long)(((unsigned int)p[0] << 8) + p[1]) << 16) +
+                 (((unsigned int)p[2] << 8) + p[3]);
+  if (word == 0) {
+    outbyte('z');       /* shortcut for 0 */
+  } else if (outbytes > 0 && outbytes <= 58) {
+    /* the group fits on the line, no checks needed */
+    base85(word, &obuf[opos]);
+    opos += 5;
+    outbytes += 5;
+  } else {
+    /* calculate 5 ASCII85 bytes and output them */
+    base85(word, d);
+    for (i = 0; i < 5; i++)
+      outbyte(d[i]);
   }
+  if (opos > OUTBUFSIZE - OUTSLACK)
+    flushout(a85out);
+}
 
-  word = 0;
+void
+ASCII85Write(unsigned char *p, size_t n)
+{
+  /* finish the group left over from the last piece */
+  while (ngroup > 0 && n > 0) {
+    group[ngroup++] = *p++;
+    n--;
+    if (ngroup == 4) {
+      put_group(group);
+      ngroup = 0;
+    }
+  }
+  for ( ; n >= 4; p += 4, n -= 4)
+    put_group(p);
+  while (n-- > 0)
+    group[ngroup++] = *p++;
+}
 
-  if (count != 0) {   /* 1-3 bytes left */
-    for (i = count-1; i >= 0; i--)   /* accumulate bytes */
-      word += (unsigned long)buf[i] << 8 * (3-i);
+void
+ASCII85End(void)
+{
+  register int i;
+  unsigned long word;
+  byte d[5];
+
+  if (ngroup != 0) {   /* 1-3 bytes left */
+    word = 0;
+    for (i = ngroup-1; i >= 0; i--)   /* accumulate bytes */
+      word += (unsigned long)group[i] << 8 * (3-i);
     
-    /* encoding as above, but output only count+1 bytes */
-    for (i = 4; i >= 4-count; i--) {
-      v = word / power85[i];
-      outbyte((byte) (v + '!'), out);
-      word -= v * power85[i];
-    }
+    /* encoding as above, but output only ngroup+1 bytes */
+    base85(word, d);
+    for (i = 0; i <= ngroup; i++)
+      outbyte(d[i]);
   }
 
-  fputc('~', out);	/* EOD marker */
-  fputc('>', out);
+  obuf[opos++] = '~';	/* EOD marker */
+  obuf[opos++] = '>';
+  flushout(a85out);
+}
+
+int
+ASCII85Encode(FILE * in, FILE * out)
+{
+  size_t n;
+
+  ASCII85Begin(out);
+  while ((n = fread(inbuf, 1, INBUFSIZE, in)) != 0)
+    ASCII85Write(inbuf, n);
+  ASCII85End();
   return 0;
 }
 
 void 
 ASCIIHexEncode(FILE *in, FILE * out) {
-  static char buffer[512];
   static char BinToHex[] = "0123456789ABCDEF";
   int CharsPerLine;
   size_t i, n;
   unsigned char *p;
 
   CharsPerLine = 0;
-  fputc('\n', out);
+  opos = 0;
+  obuf[opos++] = '\n';
 
-  while ((n = fread(buffer, 1, sizeof(buffer), in)) != 0)
-    for (i = 0, p = (unsigned char *) buffer; i < n; i++, p++) {
-      fputc(BinToHex[*p>>4], out);           /* first nibble  */
-      fputc(BinToHex[*p & 0x0F], out);       /* second nibble */
+  while ((n = fread(inbuf, 1, sizeof(inbuf), in)) != 0)
+    for (i = 0, p = inbuf; i < n; i++, p++) {
+      obuf[opos++] = BinToHex[*p>>4];           /* first nibble  */
+      obuf[opos++] = BinToHex[*p & 0x0F];       /* second nibble */
       if ((CharsPerLine += 2) >= 64) {
-        fputc('\n', out);
+        obuf[opos++] = '\n';
         CharsPerLine = 0;
       }
+      if (opos > OUTBUFSIZE - OUTSLACK)
+	flushout(out);
     }
 
-  fputc('>', out);         /* EOD marker for PostScript hex strings */
+  obuf[opos++] = '>';         /* EOD marker for PostScript hex strings */
+  flushout(out);
 }
-
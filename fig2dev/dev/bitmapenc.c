@@ -0,0 +1,885 @@
+/*
+ * TransFig: Facility for Translating Fig code
+ * Parts Copyright (c) 1989-2002 by Brian V. Smith
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish and/or distribute copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that this copyright
+ * notice remain intact.
+ *
+ */
+
+/*
+ * Encoders for the bitmap formats that used to be made by the pbmplus
+ * filters (ppmquant, ppmtogif, ppmtoxpm, pgmtopbm, pbmtoxbm, ppmtopcx),
+ * and TIFF for the bitmap driver and the EPS previews.  They take the
+ * RGB pixels of the renderer or of ghostscript's ppm output, three bytes
+ * each, top row first, and write the file directly.
+ *
+ * A figure seldom has more than a few dozen colors, so the palette is
+ * first collected exactly.  Only when there are more than 256 (smoothed
+ * edges, imported photographs) are the colors reduced with an octree.
+ */
+
+#include "fig2dev.h"
+#include "bitmapenc.h"
+
+#define	CHASH_SIZE	1024		/* exact palette hash, a power of two */
+
+/*
+ * Collect the colors of the npix pixels into cmap (MAXCOLORS RGB triples)
+ * and the palette index of each pixel into index[].  Returns the number
+ * of colors, or -1 if there are more than MAXCOLORS.
+ */
+
+int
+exact_palette(pix, npix, cmap, index)
+    unsigned char	*pix;
+    long		 npix;
+    unsigned char	*cmap;
+    unsigned char	*index;
+{
+	long		 key[CHASH_SIZE];
+	unsigned char	 val[CHASH_SIZE];
+	long		 i, c, last;
+	int		 h, n, cur;
+
+	for (h = 0; h < CHASH_SIZE; h++)
+	    key[h] = -1;
+	n = cur = 0;
+	last = -1;
+	for (i = 0; i < npix; i++, pix += 3) {
+	    c = ((long) pix[0] << 16) | (pix[1] << 8) | pix[2];
+	    if (c != last) {
+		/* runs of one color are the rule, so only look up changes */
+		h = (int) ((c ^ (c >> 7) ^ (c >> 15)) & (CHASH_SIZE-1));
+		while (key[h] != -1 && key[h] != c)
+		    h = (h + 1) & (CHASH_SIZE-1);
+		if (key[h] == -1) {
+		    if (n == MAXCOLORS)
+			return -1;
+		    key[h] = c;
+		    val[h] = n;
+		    cmap[3*n] = pix[0];
+		    cmap[3*n+1] = pix[1];
+		    cmap[3*n+2] = pix[2];
+		    n++;
+		}
+		last = c;
+		cur = val[h];
+	    }
+	    index[i] = cur;
+	}
+	return n;
+}
+
+/*
+ * Octree color reduction (Gervautz and Purgathofer).  Each pixel is put
+ * into a tree of depth 8 whose branches are taken by the bits of r, g
+ * and b from the top.  Whenever there are more than MAXCOLORS leaves the
+ * deepest inner node is folded into a leaf, so the tree stays small; the
+ * leaves left at the end are the palette, and a pixel is mapped to its
+ * color by walking down the tree again.
+ */
+
+typedef struct _Onode {
+	unsigned long	 n;		/* pixels that ended in this leaf */
+	unsigned long	 r, g, b;	/* and the sums of their colors */
+	Boolean		 leaf;
+	int		 index;		/* palette entry of a leaf */
+	struct _Onode	*child[8];
+	struct _Onode	*next;		/* inner nodes of the same level */
+} Onode;
+
+static Onode	*reducible[8];		/* inner nodes, by level */
+static Onode	*free_nodes;
+static int	 nleaves;
+
+static Onode *
+new_node(level)
+    int		 level;
+{
+	Onode	*node;
+
+	if ((node = free_nodes) != NULL) {
+	    free_nodes = node->next;
+	    memset((char *) node, 0, sizeof(Onode));
+	} else if ((node = (Onode *) calloc(1, sizeof(Onode))) == NULL) {
+	    return NULL;
+	}
+	if (level == 8) {
+	    node->leaf = True;
+	    nleaves++;
+	} else {
+	    node->next = reducible[level];
+	    reducible[level] = node;
+	}
+	return node;
+}
+
+/* fold the children of the last inner node of the deepest level into it */
+
+static void
+reduce_tree()
+{
+	Onode	*node, *c;
+	int	 level, i;
+
+	for (level = 7; level > 0 && reducible[level] == NULL; level--)
+	    ;
+	node = reducible[level];
+	reducible[level] = node->next;
+	for (i = 0; i < 8; i++) {
+	    if ((c = node->child[i]) == NULL)
+		continue;
+	    node->n += c->n;
+	    node->r += c->r;
+	    node->g += c->g;
+	    node->b += c->b;
+	    c->next = free_nodes;
+	    free_nodes = c;
+	    node->child[i] = NULL;
+	    nleaves--;
+	}
+	node->leaf = True;
+	nleaves++;
+}
+
+/* the leaf that the color r, g, b ends in */
+
+static Onode *
+find_leaf(node, r, g, b)
+    Onode	*node;
+    int		 r, g, b;
+{
+	int	 bit;
+
+	for (bit = 7; !node->leaf; bit--)
+	    node = node->child[((r >> bit) & 1) << 2 |
+				((g >> bit) & 1) << 1 | ((b >> bit) & 1)];
+	return node;
+}
+
+static void
+palette_leaves(node, cmap, n)
+    Onode		*node;
+    unsigned char	*cmap;
+    int			*n;
+{
+	int	 i;
+
+	if (node->leaf) {
+	    node->index = *n;
+	    cmap[3 * *n] = (node->r + node->n/2) / node->n;
+	    cmap[3 * *n + 1] = (node->g + node->n/2) / node->n;
+	    cmap[3 * *n + 2] = (node->b + node->n/2) / node->n;
+	    (*n)++;
+	    return;
+	}
+	for (i = 0; i < 8; i++)
+	    if (node->child[i])
+		palette_leaves(node->child[i], cmap, n);
+}
+
+static void
+free_tree(node)
+    Onode	*node;
+{
+	int	 i;
+
+	for (i = 0; i < 8; i++)
+	    if (node->child[i])
+		free_tree(node->child[i]);
+	free((char *) node);
+}
+
+/*
+ * Like exact_palette(), but any number of colors is reduced to at most
+ * MAXCOLORS.  Returns -1 only if there is no memory for the tree.
+ */
+
+int
+quantize_pixels(pix, npix, cmap, index)
+    unsigned char	*pix;
+    long		 npix;
+    unsigned char	*cmap;
+    unsigned char	*index;
+{
+	Onode		*root, *leaf, *node;
+	unsigned char	*p;
+	long		 i, c, last;
+	int		 n, level;
+
+	if ((n = exact_palette(pix, npix, cmap, index)) >= 0)
+	    return n;
+
+	for (level = 0; level < 8; level++)
+	    reducible[level] = NULL;
+	free_nodes = NULL;
+	nleaves = 0;
+	n = -1;
+	if ((root = new_node(0)) == NULL)
+	    return -1;
+
+	leaf = NULL;
+	last = -1;
+	for (i = 0, p = pix; i < npix; i++, p += 3) {
+	    c = ((long) p[0] << 16) | (p[1] << 8) | p[2];
+	    if (c != last) {
+		/* make the path for this color */
+		node = root;
+		for (level = 0; !node->leaf; level++) {
+		    int	 bit = 7 - level;
+		    int	 k = ((p[0] >> bit) & 1) << 2 |
+				((p[1] >> bit) & 1) << 1 | ((p[2] >> bit) & 1);
+
+		    if (node->child[k] == NULL &&
+			    (node->child[k] = new_node(level + 1)) == NULL)
+			goto done;
+		    node = node->child[k];
+		}
+		leaf = node;
+		last = c;
+	    }
+	    leaf->n++;
+	    leaf->r += p[0];
+	    leaf->g += p[1];
+	    leaf->b += p[2];
+	    if (nleaves > MAXCOLORS) {
+		while (nleaves > MAXCOLORS)
+		    reduce_tree();
+		last = -1;		/* leaf may have been folded away */
+	    }
+	}
+
+	n = 0;
+	palette_leaves(root, cmap, &n);
+	last = -1;
+	for (i = 0, p = pix; i < npix; i++, p += 3) {
+	    c = ((long) p[0] << 16) | (p[1] << 8) | p[2];
+	    if (c != last) {
+		leaf = find_leaf(root, p[0], p[1], p[2]);
+		last = c;
+	    }
+	    index[i] = leaf->index;
+	}
+
+    done:
+	free_tree(root);
+	while ((node = free_nodes) != NULL) {
+	    free_nodes = node->next;
+	    free((char *) node);
+	}
+	return n;
+}
+
+/* the palette entry nearest to the color rgb (0xrrggbb) */
+
+static int
+nearest_color(cmap, ncolors, rgb)
+    unsigned char	*cmap;
+    int			 ncolors;
+    long		 rgb;
+{
+	long	 d, best;
+	int	 i, dr, dg, db, found;
+
+	best = 4 * 256L * 256L;
+	found = 0;
+	for (i = 0; i < ncolors; i++) {
+	    dr = cmap[3*i] - (int) ((rgb >> 16) & 0xff);
+	    dg = cmap[3*i+1] - (int) ((rgb >> 8) & 0xff);
+	    db = cmap[3*i+2] - (int) (rgb & 0xff);
+	    d = (long) dr*dr + (long) dg*dg + (long) db*db;
+	    if (d < best) {
+		best = d;
+		found = i;
+	    }
+	}
+	return found;
+}
+
+/*
+ * LZW compression for GIF and TIFF.  GIF packs the codes from the low bit
+ * up and cuts them into blocks of at most 255 bytes; TIFF packs them from
+ * the high bit down into memory and widens the codes one code earlier.
+ */
+
+#define	LZW_HSIZE	5003		/* prime, above 4096 by 20 percent */
+#define	LZW_HSHIFT	4		/* (255 << 4) ^ 4095 < LZW_HSIZE */
+
+static Boolean		 lzw_tiff;	/* TIFF, else GIF */
+static unsigned long	 lzw_acc;	/* bits not yet written */
+static int		 lzw_nacc;
+static FILE		*gif_file;
+static unsigned char	 gif_block[256];
+static int		 gif_nblock;
+static unsigned char	*tiff_out;	/* where the TIFF strip goes */
+
+static void
+gif_flush()
+{
+	if (gif_nblock > 0) {
+	    putc(gif_nblock, gif_file);
+	    (void) fwrite(gif_block, 1, gif_nblock, gif_file);
+	    gif_nblock = 0;
+	}
+}
+
+static void
+lzw_code(code, width)
+    int		 code, width;
+{
+	if (lzw_tiff) {
+	    lzw_acc = lzw_acc << width | code;
+	    lzw_nacc += width;
+	    while (lzw_nacc >= 8) {
+		lzw_nacc -= 8;
+		*tiff_out++ = (lzw_acc >> lzw_nacc) & 0xff;
+	    }
+	    lzw_acc &= (1UL << lzw_nacc) - 1;
+	    return;
+	}
+	lzw_acc |= (unsigned long) code << lzw_nacc;
+	lzw_nacc += width;
+	while (lzw_nacc >= 8) {
+	    gif_block[gif_nblock++] = lzw_acc & 0xff;
+	    if (gif_nblock == 255)
+		gif_flush();
+	    lzw_acc >>= 8;
+	    lzw_nacc -= 8;
+	}
+}
+
+/* compress the npix bytes of in, mincode bits each, with the codes of
+   lzw_tiff; the output goes to gif_file or tiff_out */
+
+static void
+lzw_encode(in, npix, mincode)
+    unsigned char	*in;
+    long		 npix;
+    int			 mincode;
+{
+	static long	 htab[LZW_HSIZE];	/* prefix and suffix of a code */
+	static short	 ctab[LZW_HSIZE];	/* and the code */
+	int		 clear, eoi, next, width, prefix, c, h, disp;
+	int		 early, maxcode;
+	long		 i, key;
+
+	lzw_acc = 0;
+	lzw_nacc = gif_nblock = 0;
+	clear = 1 << mincode;
+	eoi = clear + 1;
+	early = lzw_tiff ? 1 : 0;
+	maxcode = lzw_tiff ? 4094 : 4096;
+
+	for (h = 0; h < LZW_HSIZE; h++)
+	    htab[h] = -1;
+	width = mincode + 1;
+	next = eoi + 1;
+	lzw_code(clear, width);
+
+	prefix = in[0];
+	for (i = 1; i < npix; i++) {
+	    c = in[i];
+	    key = ((long) c << 12) | prefix;
+	    h = (c << LZW_HSHIFT) ^ prefix;
+	    disp = (h == 0) ? 1 : LZW_HSIZE - h;
+	    while (htab[h] != -1 && htab[h] != key)
+		if ((h -= disp) < 0)
+		    h += LZW_HSIZE;
+	    if (htab[h] == key) {
+		prefix = ctab[h];
+		continue;
+	    }
+	    lzw_code(prefix, width);
+	    prefix = c;
+	    if (next < maxcode) {
+		htab[h] = key;
+		ctab[h] = next++;
+		/* the decoder is one code behind, hence > and not >= */
+		if (next > (1 << width) - early)
+		    width++;
+	    } else {
+		/* table full, start over */
+		lzw_code(clear, width);
+		for (h = 0; h < LZW_HSIZE; h++)
+		    htab[h] = -1;
+		width = mincode + 1;
+		next = eoi + 1;
+	    }
+	}
+	lzw_code(prefix, width);
+	/* the decoder adds one more code after the last one */
+	if (next == (1 << width) - early && width < 12)
+	    width++;
+	lzw_code(eoi, width);
+	if (lzw_nacc > 0)
+	    lzw_code(0, 8 - lzw_nacc);
+	if (!lzw_tiff)
+	    gif_flush();
+}
+
+static void
+put_short(file, v)
+    FILE	*file;
+    int		 v;
+{
+	putc(v & 0xff, file);
+	putc((v >> 8) & 0xff, file);
+}
+
+/*
+ * Write a GIF file of the pixels.  If transp (0xrrggbb) is not -1, the
+ * palette entry nearest to it is made transparent, as ppmtogif does.
+ */
+
+int
+write_gif(file, pix, width, height, transp)
+    FILE		*file;
+    unsigned char	*pix;
+    int			 width, height;
+    long		 transp;
+{
+	unsigned char	 cmap[3*MAXCOLORS];
+	unsigned char	*index;
+	long		 npix = (long) width * height;
+	int		 ncolors, bits, i;
+
+	if ((index = (unsigned char *) malloc(npix > 0 ? npix : 1)) == NULL)
+	    return -1;
+	if ((ncolors = quantize_pixels(pix, npix, cmap, index)) < 0) {
+	    free((char *) index);
+	    return -1;
+	}
+	for (bits = 1; (1 << bits) < ncolors; bits++)
+	    ;
+
+	fputs(transp == -1 ? "GIF87a" : "GIF89a", file);
+	put_short(file, width);
+	put_short(file, height);
+	putc(0x80 | (bits-1) << 4 | (bits-1), file);	/* global color table */
+	putc(0, file);				/* background */
+	putc(0, file);				/* aspect ratio */
+	(void) fwrite(cmap, 3, ncolors, file);
+	for (i = ncolors; i < (1 << bits); i++) {
+	    putc(0, file);
+	    putc(0, file);
+	    putc(0, file);
+	}
+	if (transp != -1) {
+	    /* graphic control extension */
+	    putc(0x21, file);
+	    putc(0xf9, file);
+	    putc(4, file);
+	    putc(1, file);			/* transparent index given */
+	    put_short(file, 0);			/* no delay */
+	    putc(nearest_color(cmap, ncolors, transp), file);
+	    putc(0, file);
+	}
+	putc(0x2c, file);			/* image descriptor */
+	put_short(file, 0);
+	put_short(file, 0);
+	put_short(file, width);
+	put_short(file, height);
+	putc(0, file);				/* no local colors, not interlaced */
+	putc(bits < 2 ? 2 : bits, file);
+	if (npix > 0) {
+	    lzw_tiff = False;
+	    gif_file = file;
+	    lzw_encode(index, npix, bits < 2 ? 2 : bits);
+	}
+	putc(0, file);				/* end of the image data */
+	putc(0x3b, file);			/* trailer */
+
+	free((char *) index);
+	return ferror(file) ? -1 : 0;
+}
+
+/*
+ * XPM 3, one or two characters a pixel.  The characters are those of
+ * ppmtoxpm, without '"' and '\' that would need quoting in C.
+ */
+
+static char	xpm_chars[] =
+" .XoO+@#$%&*=-;:>,<1234567890qwertyuipasdfghjklzxcvbnmMNBVCZASDFGHJKLPIUYTREWQ!~^/()_`'][{}|";
+
+int
+write_xpm(file, pix, width, height)
+    FILE		*file;
+    unsigned char	*pix;
+    int			 width, height;
+{
+	unsigned char	 cmap[3*MAXCOLORS];
+	char		 code[MAXCOLORS][3];
+	unsigned char	*index, *ip;
+	char		*line, *p;
+	long		 npix = (long) width * height;
+	int		 ncolors, nchars, cpp, i, x, y;
+
+	if ((index = (unsigned char *) malloc(npix > 0 ? npix : 1)) == NULL)
+	    return -1;
+	if ((line = malloc(2 * width + 4)) == NULL) {
+	    free((char *) index);
+	    return -1;
+	}
+	if ((ncolors = quantize_pixels(pix, npix, cmap, index)) < 0) {
+	    free((char *) index);
+	    free(line);
+	    return -1;
+	}
+	nchars = strlen(xpm_chars);
+	cpp = ncolors <= nchars ? 1 : 2;
+	for (i = 0; i < ncolors; i++) {
+	    if (cpp == 1) {
+		code[i][0] = xpm_chars[i];
+	    } else {
+		code[i][0] = xpm_chars[i / nchars];
+		code[i][1] = xpm_chars[i % nchars];
+	    }
+	}
+
+	fprintf(file, "/* XPM */\nstatic char *noname[] = {\n");
+	fprintf(file, "/* width height ncolors chars_per_pixel */\n");
+	fprintf(file, "\"%d %d %d %d\",\n", width, height, ncolors, cpp);
+	fprintf(file, "/* colors */\n");
+	for (i = 0; i < ncolors; i++)
+	    fprintf(file, "\"%.*s c #%02X%02X%02X\",\n", cpp, code[i],
+			cmap[3*i], cmap[3*i+1], cmap[3*i+2]);
+	fprintf(file, "/* pixels */\n");
+	for (y = 0, ip = index; y < height; y++) {
+	    p = line;
+	    *p++ = '"';
+	    for (x = 0; x < width; x++, ip++) {
+		*p++ = code[*ip][0];
+		if (cpp == 2)
+		    *p++ = code[*ip][1];
+	    }
+	    *p++ = '"';
+	    if (y < height-1)
+		*p++ = ',';
+	    *p++ = '\n';
+	    (void) fwrite(line, 1, p - line, file);
+	}
+	fprintf(file, "};\n");
+
+	free((char *) index);
+	free(line);
+	return ferror(file) ? -1 : 0;
+}
+
+/*
+ * Black and white.  The pixels are made gray with the weights of ppmtopgm
+ * and then Floyd-Steinberg dithered, every other row from right to left,
+ * like pgmtopbm.  Pure black and white come through unchanged.  Returns
+ * a byte for each pixel, 1 for black, or NULL if out of memory.
+ */
+
+#define	FS_SCALE	1024		/* fixed point of the errors */
+
+unsigned char *
+dither_pixels(pix, width, height)
+    unsigned char	*pix;
+    int			 width, height;
+{
+	unsigned char	*black, *rp;
+	long		*err, *nerr, *t, v;
+	int		 x, y, dir, start, end;
+
+	err = (long *) calloc(width + 2, sizeof(long));
+	nerr = (long *) calloc(width + 2, sizeof(long));
+	black = (unsigned char *) malloc((long) width * height + 1);
+	if (err == NULL || nerr == NULL || black == NULL) {
+	    free((char *) err);
+	    free((char *) nerr);
+	    free((char *) black);
+	    return NULL;
+	}
+	dir = 1;
+	for (y = 0; y < height; y++) {
+	    memset((char *) nerr, 0, (width + 2) * sizeof(long));
+	    start = dir > 0 ? 0 : width - 1;
+	    end = dir > 0 ? width : -1;
+	    for (x = start; x != end; x += dir) {
+		rp = pix + 3 * ((long) y * width + x);
+		v = (299L * rp[0] + 587L * rp[1] + 114L * rp[2]) * FS_SCALE / 1000
+			+ err[x + 1];
+		if ((black[(long) y * width + x] = v < 128 * FS_SCALE) == 0)
+		    v -= 255 * FS_SCALE;
+		err[x + 1 + dir] += v * 7 / 16;
+		nerr[x + 1 - dir] += v * 3 / 16;
+		nerr[x + 1] += v * 5 / 16;
+		nerr[x + 1 + dir] += v / 16;
+	    }
+	    t = err;
+	    err = nerr;
+	    nerr = t;
+	    dir = -dir;
+	}
+	free((char *) err);
+	free((char *) nerr);
+	return black;
+}
+
+/* put the row of width pixels of black[] into bytes, the leftmost in the
+   low bit (XBM) or in the high bit (TIFF, EPSI) of the first byte */
+
+void
+pack_bits(black, width, row, lowfirst)
+    unsigned char	*black, *row;
+    int			 width;
+    Boolean		 lowfirst;
+{
+	int	 x;
+
+	memset((char *) row, 0, (width + 7) / 8);
+	for (x = 0; x < width; x++)
+	    if (black[x])
+		row[x >> 3] |= lowfirst ? 1 << (x & 7) : 0x80 >> (x & 7);
+}
+
+/* X11 bitmap, dithered as above */
+
+int
+write_xbm(file, pix, width, height)
+    FILE		*file;
+    unsigned char	*pix;
+    int			 width, height;
+{
+	unsigned char	*black, *row;
+	int		 rowbytes = (width + 7) / 8;
+	int		 y, i, nbytes;
+
+	if ((black = dither_pixels(pix, width, height)) == NULL)
+	    return -1;
+	if ((row = (unsigned char *) malloc(rowbytes + 1)) == NULL) {
+	    free((char *) black);
+	    return -1;
+	}
+
+	fprintf(file, "#define noname_width %d\n", width);
+	fprintf(file, "#define noname_height %d\n", height);
+	fprintf(file, "static char noname_bits[] = {\n");
+	nbytes = 0;
+	for (y = 0; y < height; y++) {
+	    pack_bits(black + (long) y * width, width, row, True);
+	    for (i = 0; i < rowbytes; i++) {
+		if (nbytes > 0)
+		    fputs(nbytes % 12 ? ", " : ",\n", file);
+		fprintf(file, "%s0x%02x", nbytes % 12 ? "" : "   ", row[i]);
+		nbytes++;
+	    }
+	}
+	fprintf(file, "};\n");
+
+	free((char *) black);
+	free((char *) row);
+	return ferror(file) ? -1 : 0;
+}
+
+/*
+ * PCX, run-length encoded.  Up to 256 colors make an 8-bit image with
+ * the palette at the end; more make three 8-bit planes, as in ppmtopcx,
+ * so nothing is lost.
+ */
+
+static void
+pcx_line(file, line, n)
+    FILE		*file;
+    unsigned char	*line;
+    int			 n;
+{
+	int	 i, run;
+
+	for (i = 0; i < n; i += run) {
+	    for (run = 1; run < 63 && i + run < n && line[i + run] == line[i];
+			run++)
+		;
+	    if (run > 1 || line[i] >= 0xc0)
+		putc(0xc0 | run, file);
+	    putc(line[i], file);
+	}
+}
+
+int
+write_pcx(file, pix, width, height)
+    FILE		*file;
+    unsigned char	*pix;
+    int			 width, height;
+{
+	unsigned char	 cmap[3*MAXCOLORS];
+	unsigned char	*index, *line, *p;
+	long		 npix = (long) width * height;
+	int		 ncolors, planes, linebytes, i, x, y;
+
+	if ((index = (unsigned char *) malloc(npix > 0 ? npix : 1)) == NULL)
+	    return -1;
+	ncolors = exact_palette(pix, npix, cmap, index);
+	planes = ncolors < 0 ? 3 : 1;
+	linebytes = (width + 1) & ~1;			/* must be even */
+	if ((line = (unsigned char *) calloc(linebytes + 1, 1)) == NULL) {
+	    free((char *) index);
+	    return -1;
+	}
+
+	putc(10, file);				/* ZSoft */
+	putc(5, file);				/* version 3.0 */
+	putc(1, file);				/* run-length encoded */
+	putc(8, file);				/* bits per pixel and plane */
+	for (i = 0; i < 4; i++)			/* xmin, ymin, xmax, ymax */
+	    put_short(file, i < 2 ? 0 : (i == 2 ? width : height) - 1);
+	put_short(file, 80);			/* 80 dpi, like gs -r80 */
+	put_short(file, 80);
+	for (i = 0; i < 48; i++)		/* no 16-color palette */
+	    putc(0, file);
+	putc(0, file);
+	putc(planes, file);
+	put_short(file, linebytes);
+	put_short(file, 1);			/* color palette */
+	for (i = 0; i < 58; i++)
+	    putc(0, file);
+
+	for (y = 0; y < height; y++) {
+	    if (planes == 1) {
+		(void) memcpy((char *) line, (char *) index + (long) y * width,
+				width);
+		pcx_line(file, line, linebytes);
+	    } else {
+		for (i = 0; i < 3; i++) {
+		    p = pix + 3L * y * width + i;
+		    for (x = 0; x < width; x++, p += 3)
+			line[x] = *p;
+		    pcx_line(file, line, linebytes);
+		}
+	    }
+	}
+	if (planes == 1) {
+	    putc(12, file);			/* 256-color palette follows */
+	    (void) fwrite(cmap, 3, ncolors, file);
+	    for (i = ncolors; i < MAXCOLORS; i++) {
+		putc(0, file);
+		putc(0, file);
+		putc(0, file);
+	    }
+	}
+
+	free((char *) index);
+	free((char *) line);
+	return ferror(file) ? -1 : 0;
+}
+
+/* little-endian longs and tags for the TIFF header */
+
+static void
+put_long(file, v)
+    FILE	*file;
+    long	 v;
+{
+	put_short(file, (int) (v & 0xffff));
+	put_short(file, (int) ((v >> 16) & 0xffff));
+}
+
+static void
+put_tag(file, tag, type, count, value)
+    FILE	*file;
+    int		 tag, type;
+    long	 count, value;
+{
+	put_short(file, tag);
+	put_short(file, type);
+	put_long(file, count);
+	if (type == 3 && count == 1) {
+	    put_short(file, (int) value);	/* a short sits in the first half */
+	    put_short(file, 0);
+	} else {
+	    put_long(file, value);
+	}
+}
+
+/*
+ * TIFF in one strip: uncompressed 24-bit RGB, the same as gs's tiff24nc
+ * device makes, or dithered black and white (1 is black) with LZW
+ * compression, like its tifflzw device.
+ */
+
+#define	TIFF_NTAGS	13
+#define	TIFF_EXTRA	(8 + 2 + TIFF_NTAGS*12 + 4)	/* header and directory */
+
+int
+write_tiff(file, pix, width, height, dpi, bilevel)
+    FILE		*file;
+    unsigned char	*pix;
+    int			 width, height, dpi;
+    Boolean		 bilevel;
+{
+	unsigned char	*black, *rows, *data;
+	long		 size, npix = (long) width * height;
+	int		 rowbytes = (width + 7) / 8;
+	int		 y;
+
+	data = rows = NULL;
+	if (bilevel) {
+	    if ((black = dither_pixels(pix, width, height)) == NULL)
+		return -1;
+	    size = (long) rowbytes * height;
+	    rows = (unsigned char *) malloc(size + 1);
+	    /* at most a code for each byte, and a clear code every 2000 */
+	    data = (unsigned char *) malloc(((size + size/2000 + 4) * 12 + 7) / 8);
+	    if (rows == NULL || data == NULL) {
+		free((char *) black);
+		free((char *) rows);
+		free((char *) data);
+		return -1;
+	    }
+	    for (y = 0; y < height; y++)
+		pack_bits(black + (long) y * width, width,
+				rows + (long) y * rowbytes, False);
+	    free((char *) black);
+	    lzw_tiff = True;
+	    tiff_out = data;
+	    if (size > 0)
+		lzw_encode(rows, size, 8);
+	    size = tiff_out - data;
+	} else {
+	    size = 3L * npix;
+	}
+
+	fputs("II*", file);
+	putc(0, file);
+	put_long(file, 8L);				/* the directory follows */
+	put_short(file, TIFF_NTAGS);
+	put_tag(file, 256, 4, 1L, (long) width);		/* ImageWidth */
+	put_tag(file, 257, 4, 1L, (long) height);		/* ImageLength */
+	if (bilevel)
+	    put_tag(file, 258, 3, 1L, 1L);			/* BitsPerSample */
+	else
+	    put_tag(file, 258, 3, 3L, (long) TIFF_EXTRA);
+	put_tag(file, 259, 3, 1L, bilevel ? 5L : 1L);		/* LZW or none */
+	put_tag(file, 262, 3, 1L, bilevel ? 0L : 2L);		/* WhiteIsZero, RGB */
+	put_tag(file, 273, 4, 1L, (long) TIFF_EXTRA+24);	/* StripOffsets */
+	put_tag(file, 277, 3, 1L, bilevel ? 1L : 3L);		/* SamplesPerPixel */
+	put_tag(file, 278, 4, 1L, (long) height);		/* RowsPerStrip */
+	put_tag(file, 279, 4, 1L, size);			/* StripByteCounts */
+	put_tag(file, 282, 5, 1L, (long) TIFF_EXTRA+8);	/* XResolution */
+	put_tag(file, 283, 5, 1L, (long) TIFF_EXTRA+16);	/* YResolution */
+	put_tag(file, 284, 3, 1L, 1L);			/* PlanarConfiguration */
+	put_tag(file, 296, 3, 1L, 2L);			/* ResolutionUnit: inch */
+	put_long(file, 0L);				/* no more directories */
+	put_short(file, 8);				/* 8 8 8 bits per sample */
+	put_short(file, 8);
+	put_short(file, 8);
+	put_short(file, 0);
+	put_long(file, (long) dpi);
+	put_long(file, 1L);
+	put_long(file, (long) dpi);
+	put_long(file, 1L);
+	(void) fwrite(bilevel ? data : pix, 1, size, file);
+
+	free((char *) rows);
+	free((char *) data);
+	return ferror(file) ? -1 : 0;
+}
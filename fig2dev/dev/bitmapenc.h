@@ -0,0 +1,31 @@
+/*
+ * TransFig: Facility for Translating Fig code
+ * Parts Copyright (c) 1989-2002 by Brian V. Smith
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish and/or distribute copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that this copyright
+ * notice remain intact.
+ *
+ */
+
+/*
+ *	bitmapenc.h: built-in GIF, XPM, XBM, PCX and TIFF encoders
+ *
+ */
+
+#define	MAXCOLORS	256		/* colors of an 8-bit palette */
+
+extern int	exact_palette();	/* (pix, npix, cmap, index) or -1 */
+extern int	quantize_pixels();	/* (pix, npix, cmap, index) or -1 */
+extern int	write_gif();		/* (file, pix, width, height, transp) */
+extern int	write_xpm();		/* (file, pix, width, height) */
+extern int	write_xbm();		/* (file, pix, width, height) */
+extern int	write_pcx();		/* (file, pix, width, height) */
+extern int	write_tiff();		/* (file, pix, width, height, dpi, bilevel) */
+extern unsigned char *dither_pixels();	/* (pix, width, height) 1 for black */
+extern void	pack_bits();		/* (black, width, row, lowfirst) */
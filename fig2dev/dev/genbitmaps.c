@@ -21,14 +21,26 @@
  *		Uses genps functions to generate PostScript output then
  *		calls ghostscript to convert it to the output language
  *		if ghostscript has a driver for that language, or to ppm
- *		if otherwise. If the latter, ppmtoxxx is then called to make
- *		the final XXX file.
+ *		if otherwise. If the latter, GIF, XPM and XBM are made by
+ *		the encoders in bitmapenc.c and the others by ppmtoxxx.
+ *		With -r the figure is drawn by the scanline renderer in
+ *		genraster.c instead; PPM, TIFF, PNG, GIF, XPM, XBM and PCX
+ *		are written directly and the other formats go through
+ *		ppmtoxxx as above.
  */
 
 #include "fig2dev.h"
 #include "genps.h"
 #include "object.h"
 #include "texfonts.h"
+#include "genraster.h"
+#include "bitmapenc.h"
+#ifdef USE_PNG
+#include <png.h>
+#endif
+
+extern	struct driver *dev;
+extern	struct driver dev_raster;
 
 static	char	 *gsdev,tmpname[PATH_MAX];
 static	Boolean	 direct;
@@ -39,7 +51,11 @@ static	int	 jpeg_quality=75;
 static	int	 border_margin = 0;
 static	int	 smooth = 0;
 
-void
+static	int	 convert_ppm();
+static	int	 convert_builtin();
+static	Boolean	 builtin_format();
+
+int
 genbitmaps_option(opt, optarg)
 char opt;
 char *optarg;
@@ -63,6 +79,10 @@ char *optarg;
 	    grayonly = 1;
 	    break;
 
+	case 'r':			/* render in-process, without ghostscript */
+	    dev = &dev_raster;
+	    break;
+
 	case 'q':			/* jpeg image quality */
 	    if (strcmp(lang,"jpeg") != 0)
 		fprintf(stderr,"-q option only allowed for jpeg quality; ignored\n");
@@ -82,7 +102,7 @@ char *optarg;
 		fprintf(stderr,
 			"fig2dev: bad value for -S option: %s, should be 0, 2 or 4\n",
 			optarg);
-		exit(1);
+		return 1;
 	    }
 	    break;
 
@@ -99,13 +119,14 @@ char *optarg;
 	    put_msg(Err_badarg, opt, lang);
 	    break;
     }
+    return 0;
 }
 
-void
-genbitmaps_start(objects)
-F_compound	*objects;
+/* add the border and work out the size of the bitmap */
+
+static void
+set_size()
 {
-    char extra_options[200];
     float bd;
 
     bd = border_margin * THICK_SCALE;
@@ -115,11 +136,23 @@ F_compound	*objects;
     urx += bd;
     ury += bd;
 
-    /* make command for ghostscript */
-
     width=round(mag*(urx-llx)/THICK_SCALE);
     height=round(mag*(ury-lly)/THICK_SCALE);
 
+    /* splines need no more points than the (smoothed) pixels */
+    curve_res = 80.0 * (smooth > 1 ? smooth : 1);
+}
+
+void
+genbitmaps_start(objects)
+F_compound	*objects;
+{
+    char extra_options[200];
+
+    set_size();
+
+    /* make command for ghostscript */
+
     /* Add conditionals here if gs has a driver built-in */
     /* gs has a driver for png, ppm, pcx, jpeg and tiff */
 
@@ -181,9 +214,6 @@ F_compound	*objects;
 int
 genbitmaps_end()
 {
-	char	 com[PATH_MAX+200],com1[200];
-	char	 errfname[PATH_MAX];
-	char	*tmpname1;
 	int	 status;
 
 	/* wrap up the postscript output */
@@ -203,91 +233,329 @@ genbitmaps_end()
 	/* all ok so far */
 	status = 0;
 
-	/* for the formats that are only 8-bits, reduce the colors to 256 */
-	/* and pipe through the ppm converter for that format */
-	if (!direct) {
-	    tmpname1 = tmpname;
-	    strcpy(com, "(");
-	    if (strcmp(lang, "gif")==0) {
-		if (gif_transparent[0]) {
-		    /* escape the first char of the transparent color (#) for the shell */
-		    sprintf(com1,"ppmquant 256 %s | ppmtogif -transparent \\%s",
-			tmpname1, gif_transparent);
-		} else {
-		    sprintf(com1,"ppmquant 256 %s | ppmtogif",tmpname1);
+	if (!direct)
+	    status = builtin_format() ? convert_builtin() : convert_ppm();
+
+	return status;
+}
+
+/* pipe the ppm file through the converter for the formats that */
+/* have no built-in encoder */
+
+static int
+convert_ppm()
+{
+	char	 com[PATH_MAX+200],com1[200];
+	char	 errfname[PATH_MAX];
+	char	*tmpname1;
+	int	 status;
+
+	tmpname1 = tmpname;
+	strcpy(com, "(");
+	if (strcmp(lang, "jpeg")==0) {
+	    sprintf(com1, "ppmtojpeg --quality=%d %s", jpeg_quality, tmpname1);
+	} else if (strcmp(lang, "sld")==0) {
+	    sprintf(com1,"ppmtoacad %s",tmpname1);
+	} else if (strcmp(lang, "ppm")==0) {
+	    com1[0] = '\0';				/* nothing to do for ppm */
+	} else if (strcmp(lang, "png")==0) {
+	    sprintf(com1, "pnmtopng %s", tmpname1);
+	} else if (strcmp(lang, "tiff")==0) {
+	    sprintf(com1, "pnmtotiff %s", tmpname1);
+	} else {
+	    fprintf(stderr, "fig2dev: unsupported image format: %s\n", lang);
+	    exit(1);
+	}
+	strcat(com, com1);
+
+	if (saveofile != stdout) {
+	    /* finally, route output from ppmtoxxx to final output file, if
+	       not going to stdout */
+	    strcat(com," > ");
+	    strcat(com,to);
+	}
+	/* close off parenthesized command stream */
+	strcat(com,")");
+
+	/* make a unique name for an error file */
+	sprintf(errfname,"%s/f2d%d.err",TMPDIR,getpid());
+
+	/* send all messages to error file */
+	strcat(com," 2> ");
+	strcat(com,errfname);
+
+	/* execute the ppm program */
+	if ((status=system(com)) != 0) {
+	    FILE *errfile;
+
+	    /* force to -1 */
+	    status = -1;
+
+	    /* seems to be a race condition where not all of the messages
+	       make it into the error file before we open it, so we'll wait a tad */
+	    sleep(1);
+	    errfile = fopen(errfname,"r");
+	    fprintf(stderr,"fig2dev: error while converting image.\n");
+	    fprintf(stderr,"Command used:\n  %s\n",com);
+	    fprintf(stderr,"Messages resulting:\n");
+	    if (errfile == 0)
+		fprintf(stderr,"can't open error file %s\n",errfname);
+	    else {
+		while (!feof(errfile)) {
+		    if (fgets(com, sizeof(com)-1, errfile) == NULL)
+			break;
+		    fprintf(stderr,"  %s",com);
 		}
-	    } else if (strcmp(lang, "jpeg")==0) {
-		sprintf(com1, "ppmtojpeg --quality=%d %s", jpeg_quality, tmpname1);
-	    } else if (strcmp(lang, "xbm")==0) {
-		sprintf(com1,"ppmtopgm %s | pgmtopbm | pbmtoxbm",tmpname1);
-	    } else if (strcmp(lang, "xpm")==0) {
-		sprintf(com1,"ppmquant 256 %s | ppmtoxpm",tmpname1);
-	    } else if (strcmp(lang, "sld")==0) {
-		sprintf(com1,"ppmtoacad %s",tmpname1);
-	    } else if (strcmp(lang, "pcx")==0) {
-		sprintf(com1, "ppmtopcx %s", tmpname1);
-	    } else if (strcmp(lang, "ppm")==0) {
-		com1[0] = '\0';				/* nothing to do for ppm */
-	    } else if (strcmp(lang, "png")==0) {
-		sprintf(com1, "pnmtopng %s", tmpname1);
-	    } else if (strcmp(lang, "tiff")==0) {
-		sprintf(com1, "pnmtotiff %s", tmpname1);
-	    } else {
-		fprintf(stderr, "fig2dev: unsupported image format: %s\n", lang);
-		exit(1);
+		fclose(errfile);
 	    }
-	    strcat(com, com1);
+	}
 
-	    if (saveofile != stdout) {
-		/* finally, route output from ppmtoxxx to final output file, if
-		   not going to stdout */
-		strcat(com," > ");
-		strcat(com,to);
-	    }
-	    /* close off parenthesized command stream */
-	    strcat(com,")");
-
-	    /* make a unique name for an error file */
-	    sprintf(errfname,"%s/f2d%d.err",TMPDIR,getpid());
-
-	    /* send all messages to error file */
-	    strcat(com," 2> ");
-	    strcat(com,errfname);
-
-	    /* execute the ppm program */
-	    if ((status=system(com)) != 0) {
-		FILE *errfile;
-
-		/* force to -1 */
-		status = -1;
-
-		/* seems to be a race condition where not all of the messages
-		   make it into the error file before we open it, so we'll wait a tad */
-		sleep(1);
-		errfile = fopen(errfname,"r");
-		fprintf(stderr,"fig2dev: error while converting image.\n");
-		fprintf(stderr,"Command used:\n  %s\n",com);
-		fprintf(stderr,"Messages resulting:\n");
-		if (errfile == 0)
-		    fprintf(stderr,"can't open error file %s\n",errfname);
-		else {
-		    while (!feof(errfile)) {
-			if (fgets(com, sizeof(com)-1, errfile) == NULL)
-			    break;
-			fprintf(stderr,"  %s",com);
-		    }
-		    fclose(errfile);
-		}
+	/* finally, remove the temporary file and the error file */
+	unlink(tmpname);
+	unlink(errfname);
+
+	return status;
+}
+
+/* formats that bitmapenc.c writes without outside programs */
+
+static Boolean
+builtin_format()
+{
+	return (strcmp(lang, "gif") == 0 || strcmp(lang, "xpm") == 0 ||
+		strcmp(lang, "xbm") == 0 || strcmp(lang, "pcx") == 0);
+}
+
+/* encode the RGB pixels in the output language */
+
+static int
+write_builtin(file, pix)
+FILE		*file;
+unsigned char	*pix;
+{
+	RGB	 rgb;
+	long	 transp;
+	int	 r, g, b, status;
+
+	if (strcmp(lang, "gif") == 0) {
+	    transp = -1;
+	    if (gif_transparent[0]) {
+		if (strlen(gif_transparent) == 7 &&
+			sscanf(gif_transparent, "#%2x%2x%2x", &r, &g, &b) == 3)
+		    transp = ((long) r << 16) | (g << 8) | b;
+		else if (lookup_X_color(gif_transparent, &rgb) >= 0)
+		    transp = ((long) (rgb.red >> 8) << 16) |
+				((rgb.green >> 8) << 8) | (rgb.blue >> 8);
+		else
+		    fprintf(stderr,
+			"fig2dev: can't parse transparent color '%s', ignored\n",
+			gif_transparent);
 	    }
+	    status = write_gif(file, pix, width, height, transp);
+	} else if (strcmp(lang, "xpm") == 0) {
+	    status = write_xpm(file, pix, width, height);
+	} else if (strcmp(lang, "xbm") == 0) {
+	    status = write_xbm(file, pix, width, height);
+	} else {
+	    status = write_pcx(file, pix, width, height);
+	}
+	if (status != 0)
+	    fprintf(stderr, "fig2dev: error writing %s file\n", lang);
+	return status;
+}
+
+/* read the binary ppm file that ghostscript made; sets width and height */
 
-	    /* finally, remove the temporary file and the error file */
-	    unlink(tmpname);
-	    unlink(errfname);
+static unsigned char *
+read_gs_ppm(file)
+FILE	*file;
+{
+	unsigned char *pix;
+	int	 c, i, v[3];
+
+	if (getc(file) != 'P' || getc(file) != '6')
+	    return NULL;
+	for (i = 0; i < 3; i++) {
+	    /* skip white space and comments */
+	    while ((c = getc(file)) == '#' || isspace(c))
+		if (c == '#')
+		    while ((c = getc(file)) != '\n' && c != EOF)
+			;
+	    for (v[i] = 0; isdigit(c); c = getc(file))
+		v[i] = 10*v[i] + c - '0';
 	}
+	/* c is the single white space before the pixels */
+	if (v[0] <= 0 || v[1] <= 0 || v[2] != 255 || !isspace(c))
+	    return NULL;
+	width = v[0];
+	height = v[1];
+	if ((pix = (unsigned char *) malloc(3L * width * height)) == NULL)
+	    return NULL;
+	if (fread(pix, 3, (size_t) width * height, file) !=
+			(size_t) width * height) {
+	    free((char *) pix);
+	    return NULL;
+	}
+	return pix;
+}
+
+/* make the output file from the temporary ppm file in-process */
 
+static int
+convert_builtin()
+{
+	unsigned char *pix;
+	FILE	*ppmfile, *outfile;
+	int	 status;
+
+	pix = NULL;
+	if ((ppmfile = fopen(tmpname, "rb")) != NULL) {
+	    pix = read_gs_ppm(ppmfile);
+	    fclose(ppmfile);
+	}
+	unlink(tmpname);
+	if (pix == NULL) {
+	    fprintf(stderr, "fig2dev: can't read ghostscript output %s\n", tmpname);
+	    return -1;
+	}
+	if (saveofile == stdout) {
+	    outfile = stdout;
+	} else if ((outfile = fopen(to, "wb")) == NULL) {
+	    fprintf(stderr, "fig2dev: can't open output file %s\n", to);
+	    free((char *) pix);
+	    return -1;
+	}
+	status = write_builtin(outfile, pix);
+	if (outfile != stdout && fclose(outfile) != 0)
+	    status = -1;
+	free((char *) pix);
 	return status;
 }
 
+/*
+ * In-process drawing (-r).  The renderer keeps the figure in memory;
+ * PPM, TIFF, PNG and the formats of bitmapenc.c are written straight to
+ * the output file and the others are made from a temporary ppm file as
+ * above.
+ */
+
+static void
+genraster_start(objects)
+F_compound	*objects;
+{
+    set_size();
+    raster_start(width, height, smooth);
+}
+
+static void
+write_ppm(file, pix)
+FILE		*file;
+unsigned char	*pix;
+{
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    fwrite(pix, 3, width*height, file);
+}
+
+#ifdef USE_PNG
+static int
+write_png(file, pix)
+FILE		*file;
+unsigned char	*pix;
+{
+    png_structp	png_ptr;
+    png_infop	info_ptr;
+    int		i;
+
+    if ((png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+				NULL, NULL, NULL)) == NULL)
+	return -1;
+    if ((info_ptr = png_create_info_struct(png_ptr)) == NULL) {
+	png_destroy_write_struct(&png_ptr, (png_infopp) NULL);
+	return -1;
+    }
+    if (setjmp(png_jmpbuf(png_ptr))) {
+	png_destroy_write_struct(&png_ptr, &info_ptr);
+	return -1;
+    }
+    png_init_io(png_ptr, file);
+    png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGB,
+		PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+		PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png_ptr, info_ptr);
+    for (i = 0; i < height; i++)
+	png_write_row(png_ptr, pix + 3*i*width);
+    png_write_end(png_ptr, info_ptr);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    return 0;
+}
+#endif /* USE_PNG */
+
+static int
+genraster_end()
+{
+    unsigned char *pix;
+    FILE	*ppmfile;
+    int		 status = 0;
+
+    pix = raster_end();
+    if (strcmp(lang, "ppm") == 0) {
+	write_ppm(tfp, pix);
+    } else if (strcmp(lang, "tiff") == 0) {
+	if ((status = write_tiff(tfp, pix, width, height, 80, False)) != 0)
+	    fprintf(stderr, "fig2dev: error writing TIFF file\n");
+#ifdef USE_PNG
+    } else if (strcmp(lang, "png") == 0) {
+	if ((status = write_png(tfp, pix)) != 0)
+	    fprintf(stderr, "fig2dev: error writing PNG file\n");
+#endif /* USE_PNG */
+    } else if (builtin_format()) {
+	status = write_builtin(tfp, pix);
+    } else {
+	/* write a temporary ppm file and convert it */
+	sprintf(tmpname, "%s/f2d%d.ppm", TMPDIR, getpid());
+	if ((ppmfile = fopen(tmpname, "wb")) == NULL) {
+	    fprintf(stderr, "fig2dev: can't open temporary file %s\n", tmpname);
+	    raster_free();
+	    return -1;
+	}
+	write_ppm(ppmfile, pix);
+	fclose(ppmfile);
+	/* the converter writes the output file itself */
+	saveofile = tfp;
+	if (tfp != stdout)
+	    fclose(tfp);
+	tfp = 0;
+	status = convert_ppm();
+    }
+    raster_free();
+    return status;
+}
+
+/* back to the defaults for the next figure of a batch */
+
+static void
+genbitmaps_reset()
+{
+    jpeg_quality = 75;
+    border_margin = 0;
+    smooth = 0;
+    genps_reset();
+}
+
+struct driver dev_raster = {
+  	genbitmaps_option,
+	genraster_start,
+	raster_grid,
+	raster_arc,
+	raster_ellipse,
+	raster_line,
+	raster_spline,
+	raster_text,
+	genraster_end,
+	INCLUDE_TEXT,
+	genbitmaps_reset
+};
+
 struct driver dev_bitmaps = {
   	genbitmaps_option,
 	genbitmaps_start,
@@ -298,7 +566,8 @@ struct driver dev_bitmaps = {
 	genps_spline,
 	genps_text,
 	genbitmaps_end,
-	INCLUDE_TEXT
+	INCLUDE_TEXT,
+	genbitmaps_reset
 };
 
 
@@ -22,7 +22,7 @@
 #include "fig2dev.h"
 #include "object.h"
 
-void genbox_option(opt, optarg)
+int genbox_option(opt, optarg)
 char opt, *optarg;
 {
   	switch (opt) {
@@ -35,8 +35,9 @@ char opt, *optarg;
 
  	default:
 		put_msg(Err_badarg, opt, "box");
-		exit(1);
+		return 1;
 	}
+	return 0;
 }
 
 void genbox_start(objects)
@@ -256,7 +256,7 @@ gencgm_end()
     return 0;
 }
 
-void
+int
 gencgm_option(opt, optarg)
    char		 opt;
    char		*optarg;
@@ -285,8 +285,9 @@ gencgm_option(opt, optarg)
 	     * background with corresponding change of foreground color, ... */
 
 	    put_msg(Err_badarg, opt, "cgm");
-	    exit(1);
+	    return 1;
     }
+    return 0;
 }
 
 /* Coordinates are translated such that the lower left corner has
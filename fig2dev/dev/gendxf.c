@@ -109,7 +109,7 @@ static        double        wide[]                 = {.6,.6,.6,.6,.6,.6,.6,.6,.6
 static        double        high[]                 = {.8,.8,.8,.8,.8,.8,.8,.8,.8,.8,.8,.8,.8,.8,
             .8,.8,.8,.8,.8,.8,.8,.8,.8,.8,.8,.8,.8,.8,.8,.8,.8,.8,.8,.8,.8,.8};
 
-static void gendxf_option(opt, optarg)
+static int gendxf_option(opt, optarg)
 char opt, *optarg;
 {
         FILE        *ffp;
@@ -202,8 +202,9 @@ char opt, *optarg;
 
             default:
                 put_msg(Err_badarg, opt, "dxf");
-                exit(1);
+                return 1;
         }
+        return 0;
 }
 
 static double                cpi;                        /*       cent/inch        */
@@ -690,8 +690,8 @@ static void textalign();
 static void moveto();
 #endif
 
-extern FILE *open_picfile();
 extern void close_picfile();
+extern FILE *sniff_picfile();
 #ifdef USE_PNG
 extern	int read_png();
 #endif
@@ -2146,6 +2146,7 @@ static void rotated_ellipse(e)
 {
     F_line l;
     F_point pnt[ELLIPSE_NPOINT];
+    F_pos pos[ELLIPSE_NPOINT];
     int i;
     const double delta = 2 * M_PI / (double)ELLIPSE_NPOINT;
     double th;
@@ -2159,6 +2160,8 @@ static void rotated_ellipse(e)
 	pnt[i].x = e->center.x + (int) (cosa * ex + sina * ey);
 	pnt[i].y = e->center.y + (int) (-sina * ex + cosa * ey);
 	pnt[i].next = &pnt[i + 1];
+	pos[i].x = pnt[i].x;
+	pos[i].y = pnt[i].y;
     }
     pnt[ELLIPSE_NPOINT - 1].next = NULL;
 
@@ -2179,6 +2182,8 @@ static void rotated_ellipse(e)
 
     /* setup other fields */
     l.points = pnt;
+    l.pts = pos;
+    l.npts = ELLIPSE_NPOINT;
     l.type = T_POLYGON;
 
     /* just in case... */
@@ -2380,7 +2385,7 @@ static void picbox(l)
     EMRSTRETCHDIBITS em_sd;
     BITMAPINFO bmi;
     char buf[512], realname[PATH_MAX];
-    int filtype;
+    int filtype, nhead;
     int dx, dy;
     FILE *picf;
     int pllx, plly;
@@ -2405,16 +2410,18 @@ static void picbox(l)
     else if (dy < 0 && dx >= 0)
        rotation = 90;
 
-    if ((picf = open_picfile(l->pic->file, &filtype, True, realname)) == NULL) {
+    /* the picture is opened once, for the header and for reading it */
+    nhead = 16;
+    if ((picf = sniff_picfile(l->pic->file, &filtype, realname, buf, &nhead))
+	    == NULL) {
 	fprintf(stderr, "fig2dev: %s: No such picture file\n", l->pic->file);
 	return;
     }
-    if (fread(buf, (size_t) 16, (size_t) 1, picf) != 1) {
+    if (nhead != 16) {
 	fprintf(stderr, "fig2dev: %s: short read\n", l->pic->file);
 	close_picfile(picf, filtype);
 	return;
     }
-    close_picfile(picf, filtype);
 
     memset(&em_sd, 0, sizeof(EMRSTRETCHDIBITS));
     em_sd.emr.iType = htofl(EMR_STRETCHDIBITS);
@@ -2425,18 +2432,14 @@ static void picbox(l)
 #ifdef USE_PNG
     if (strncmp(buf, "\211\120\116\107\015\012\032\012", (size_t) 8) == 0) {
 	/* png file */
-	if ((picf = open_picfile(l->pic->file, &filtype, True, realname)) == NULL) {
-	    perror(l->pic->file);
-	    return;
-	}
 	if (read_png(picf, filtype, l->pic, &pllx, &plly) == 0) {
 	    fprintf(stderr, "fig2dev: %s: illegal format\n", l->pic->file);
 	    close_picfile(picf, filtype);
 	    return;
 	}
-	close_picfile(picf, filtype);
     }
 #endif
+    close_picfile(picf, filtype);
     if (l->pic->subtype == P_GIF || l->pic->subtype == P_PCX ||
 	l->pic->subtype == P_JPEG || l->pic->subtype == P_PNG) {
 
@@ -2556,7 +2559,7 @@ static void picbox(l)
 static void polygon(l)
     F_line *l;
 {
-    F_point *p;
+    F_pos *p;
     int count;
     EMRPOLYGON em_pg;	/* Polygon in little endian format */
     POINTL *aptl;
@@ -2564,16 +2567,16 @@ static void polygon(l)
     int bbx_top, bbx_bottom, bbx_left, bbx_right;	/* Bounding box */
     unsigned  cpt;	/* Number of points in the array */
 
-    /* Calculate the number of points and the bounding box. */
-    if (!(p = l->points)) return;
+    /* Calculate the bounding box. */
+    if (!(cpt = l->npts)) return;
+    p = l->pts;
     bbx_left = p->x;
     bbx_top  = p->y;
     bbx_right  = p->x;
     bbx_bottom = p->y;
-    for (cpt = 0; p; p = p->next) {
-	UPDATE_BBX_X(p->x);
-	UPDATE_BBX_Y(p->y);
-	cpt++;
+    for (count = 0; count < cpt; count++) {
+	UPDATE_BBX_X(p[count].x);
+	UPDATE_BBX_Y(p[count].y);
     }
 
     /* Windows 95/98/Me: maximum points allowed is approx. 1360 */
@@ -2602,9 +2605,9 @@ static void polygon(l)
 	    perror("fig2dev: malloc");
 	    exit(1);
 	}
-	for (p=l->points, count=0; p; p=p->next, count++) {
-	    apts[count].x = htofs(p->x);
-	    apts[count].y = htofs(p->y);
+	for (count=0; count < cpt; count++) {
+	    apts[count].x = htofs(p[count].x);
+	    apts[count].y = htofs(p[count].y);
 	}
 
 	em_pg.emr.iType = htofl(EMR_POLYGON16);
@@ -2629,9 +2632,9 @@ static void polygon(l)
 	    perror("fig2dev: malloc");
 	    exit(1);
 	}
-	for (p=l->points, count=0; p; p=p->next, count++) {
-	    aptl[count].x = htofl(p->x);
-	    aptl[count].y = htofl(p->y);
+	for (count=0; count < cpt; count++) {
+	    aptl[count].x = htofl(p[count].x);
+	    aptl[count].y = htofl(p[count].y);
 	}
 
 	em_pg.emr.iType = htofl(EMR_POLYGON);
@@ -2667,7 +2670,8 @@ static int polyline_adjust(p, q, l)
 static void polyline(l)
     F_line *l;
 {
-    F_point *p, *q, p0, pn;
+    F_pos *pts;
+    F_point p, q, p0, pn;
     Dir dir;
     double d;
     EMRPOLYLINE em_pl;	/* Polyline in little endian format */
@@ -2677,21 +2681,25 @@ static void polyline(l)
 
     int bbx_top, bbx_bottom, bbx_left, bbx_right;	/* Bounding box */
     unsigned cpt;	/* Number of points in the array */
+    unsigned first;	/* Index of the first point drawn */
     unsigned u;
 
-    /* Calculate the number of points and the bounding box. */
-    if (!(p = l->points)) return;
-    bbx_left = p->x;
-    bbx_top  = p->y;
-    bbx_right  = p->x;
-    bbx_bottom = p->y;
-    for (cpt = 0, q = p; p; q = p, p = p->next) {
-	UPDATE_BBX_X(p->x);
-	UPDATE_BBX_Y(p->y);
-	cpt++;
-    }
-    p0 = *l->points;	/* first point */
-    pn = *q;		/* last point */
+    /* Calculate the bounding box. */
+    if (!(cpt = l->npts)) return;
+    pts = l->pts;
+    bbx_left = pts[0].x;
+    bbx_top  = pts[0].y;
+    bbx_right  = pts[0].x;
+    bbx_bottom = pts[0].y;
+    for (u = 0; u < cpt; u++) {
+	UPDATE_BBX_X(pts[u].x);
+	UPDATE_BBX_Y(pts[u].y);
+    }
+    first = 0;
+    p0.x = pts[0].x;		/* first point */
+    p0.y = pts[0].y;
+    pn.x = pts[cpt-1].x;	/* last point */
+    pn.y = pts[cpt-1].y;
 
     if (cpt == 1) {
 	/* Draw single point as a short line. */
@@ -2704,37 +2712,48 @@ static void polyline(l)
 	if (l->back_arrow) {		/* First point with arrow */
 	    alen = arrow_length(l->back_arrow);
 	    while (cpt > 1) {
-		q = p0.next;
-		seglen = distance((double)p0.x, (double)p0.y, (double)q->x, (double)q->y);
+		seglen = distance((double)p0.x, (double)p0.y,
+			(double)pts[first+1].x, (double)pts[first+1].y);
 		if (seglen > alen) {
 		    break;
 		} else {
 		    /* delete this segment */
 		    cpt--;
-		    p0 = *q;
+		    first++;
+		    p0.x = pts[first].x;
+		    p0.y = pts[first].y;
 		    alen -= seglen;
 		}
 	    }
-	    if (cpt > 1)
-		polyline_adjust(&p0, p0.next, alen); /* shorten line segment */
+	    if (cpt > 1) {
+		q.x = pts[first+1].x;
+		q.y = pts[first+1].y;
+		polyline_adjust(&p0, &q, alen); /* shorten line segment */
+	    }
 	}
 	if (l->for_arrow) {	/* Last point with arrow */
 	    alen = arrow_length(l->for_arrow);
 	    while (cpt > 1) {
-		for (p = &p0, u = cpt; --u > 0; q = p, p = p->next)
-		    ;
-		seglen = distance((double)p->x, (double)p->y, (double)q->x, (double)q->y);
+		/* q is the one but last point still drawn */
+		if (cpt == 2) {
+		    q = p0;
+		} else {
+		    q.x = pts[first+cpt-2].x;
+		    q.y = pts[first+cpt-2].y;
+		}
+		seglen = distance((double)pts[first+cpt-1].x,
+			(double)pts[first+cpt-1].y, (double)q.x, (double)q.y);
 		if (seglen > alen) {
 		    break;
 		} else {
 		    /* delete this segment */
 		    cpt--;
-		    pn = *q;
+		    pn = q;
 		    alen -= seglen;
 		}
 	    }
 	    if (cpt > 1)
-		polyline_adjust(&pn, q, alen);	/* shorten line segment */
+		polyline_adjust(&pn, &q, alen);	/* shorten line segment */
 	}
 	if (cpt <= 1)		/* if all line segments are removed, */
 	    goto draw_arrows;	/* skip drawing line segments */
@@ -2766,9 +2785,11 @@ static void polyline(l)
 	    perror("fig2dev: malloc");
 	    exit(1);
 	}
-	for (p = &p0, u = 0; u + 1 < cpt; p= p->next, u++) {
-	    apts[u].x = htofs(p->x);
-	    apts[u].y = htofs(p->y);
+	apts[0].x = htofs(p0.x);
+	apts[0].y = htofs(p0.y);
+	for (u = 1; u + 1 < cpt; u++) {
+	    apts[u].x = htofs(pts[first+u].x);
+	    apts[u].y = htofs(pts[first+u].y);
 	}
 	apts[u].x = htofs(pn.x);
 	apts[u].y = htofs(pn.y);
@@ -2795,9 +2816,11 @@ static void polyline(l)
 	    perror("fig2dev: malloc");
 	    exit(1);
 	}
-	for (p = &p0, u = 0; u + 1 < cpt; p= p->next, u++) {
-	    aptl[u].x = htofl(p->x);
-	    aptl[u].y = htofl(p->y);
+	aptl[0].x = htofl(p0.x);
+	aptl[0].y = htofl(p0.y);
+	for (u = 1; u + 1 < cpt; u++) {
+	    aptl[u].x = htofl(pts[first+u].x);
+	    aptl[u].y = htofl(pts[first+u].y);
 	}
 	aptl[u].x = htofl(pn.x);
 	aptl[u].y = htofl(pn.y);
@@ -2811,7 +2834,7 @@ static void polyline(l)
     }
 
 draw_arrows:
-    if (!l->points->next) {
+    if (l->npts < 2) {
 	if (l->for_arrow || l->back_arrow)
 	    fprintf(stderr, "Warning: Arrow at zero-length line segment omitted.\n");
 	return;
@@ -2819,18 +2842,22 @@ draw_arrows:
 
 
     if (l->back_arrow) {
-	p = l->points;
-	q = l->points->next;
-	if (direction(p, q, &dir, &d)) {
-	    arrow(p, l->back_arrow, l, &dir);
+	p.x = pts[0].x;
+	p.y = pts[0].y;
+	q.x = pts[1].x;
+	q.y = pts[1].y;
+	if (direction(&p, &q, &dir, &d)) {
+	    arrow(&p, l->back_arrow, l, &dir);
 	}
     }
 
     if (l->for_arrow) {
-	for (q=l->points, p=l->points->next; p->next; q=p, p=p->next) {}
-	/* q is the one but last point */
-	if (direction(p, q, &dir, &d)) {
-	    arrow(p, l->for_arrow, l, &dir);
+	p.x = pts[l->npts-1].x;
+	p.y = pts[l->npts-1].y;
+	q.x = pts[l->npts-2].x;	/* q is the one but last point */
+	q.y = pts[l->npts-2].y;
+	if (direction(&p, &q, &dir, &d)) {
+	    arrow(&p, l->for_arrow, l, &dir);
 	}
     }
 }/* end polyline */
@@ -3110,7 +3137,7 @@ static void moveto(x, y)
 
 
 /*~~~~~|><|~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
-void genemf_option(opt, optarg)
+int genemf_option(opt, optarg)
     char	 opt;
     char	*optarg;
 {
@@ -3140,8 +3167,9 @@ void genemf_option(opt, optarg)
 
     default:
 	put_msg(Err_badarg, opt, "emf");
-	exit(1);
+	return 1;
     }
+    return 0;
 }/* end genemf_option */
 
 
@@ -3354,7 +3382,7 @@ void genemf_line(l)
     case T_POLYLINE:
 	shape_interior(l, polygon);		/* draw interior */
 
-	if (l->points->next == NULL	/* single point line */
+	if (l->npts == 1		/* single point line */
 	    && l->cap_style == 0) {	/* butt style */
 	    /* draw as projecting style but in smaller size */
 	    edgeattr(1, l->style, (l->thickness + 1) / 2, l->pen_color,
@@ -227,7 +227,7 @@ double	ArrowScale=1.0;
 int	AllowRotatedText = 0;
 
 
-void
+int
 genepic_option(opt, optarg)
 char opt, *optarg;
 {
@@ -292,7 +292,7 @@ char opt, *optarg;
             loop = atoi(optarg);
             if (loop < 8 || loop > 12) {
             	put_msg("Scale must be between 8 and 12 inclusively\n");
-            	exit(1);
+            	return 1;
             }
             loop -= 8;
             mag = ScaleTbl[loop].mag;
@@ -324,8 +324,9 @@ char opt, *optarg;
 
 	  default:
 	    put_msg(Err_badarg, opt, "epic");
-	    exit(1);
+	    return 1;
         }
+	return 0;
 }
 
 static void
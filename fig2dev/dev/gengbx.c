@@ -35,9 +35,9 @@
 #include "object.h"
 #include "../../patchlevel.h"
 #include "alloc.h"
+#include "holdbuf.h"
 
 #define GBX_DRIVER_VERSION "0.1.1"
-#define MAX_APERTURES 989
 #define GBX_BUF_SIZE 1024
 
 /* Enumeration for units to use in output.  Inches are natural to FIG. */
@@ -57,6 +57,8 @@ int gbx_image_polarity = 1;
 float gbx_offset_a=0, gbx_offset_b=0;
 /* Should we include debug comments in GBX? */
 int gbx_debug_comments=1;
+/* Should the objects be ordered by aperture and position? */
+int gbx_order=0;
 
 /* Warning stack. */
 enum warnings { warn=0, warn_square_join, 
@@ -69,6 +71,7 @@ enum warnings { warn=0, warn_square_join,
 		warn_arrow_not_implemented,
 		warn_line_colour,
 		warn_line_zero_width,
+		warn_many_apertures,
 		warn_max };
 int warning_counts[warn_max];
 
@@ -126,6 +129,10 @@ long unsigned long int gbx_scale_factor;
 
 char outbuf[GBX_BUF_SIZE];
 
+/* The output file.  The drawing goes to a hold stream when ordering,
+   the aperture definitions always go here. */
+FILE *gbx_file;
+
 void write_end_block(void);
 void gengbx_line (F_line *l);
 
@@ -188,11 +195,11 @@ unsigned long int total_d_code_count=0;
 enum d_codes { d_exposure_on = 1, d_exposure_off = 2, 
 	       d_flash = 3, d_select_aperture = 10 };
 
-/** Define the maximum aperture index. */
+/** D codes above this are not understood by older photoplotters. */
 #define MAX_D_CODE 999
-#define MAX_APERTURE_INDEX (MAX_D_CODE - d_select_aperture)
-
 
+/** Size of the aperture hash table, a power of two. */
+#define APERTURE_HASH_SIZE 256
 
 /** Keeps count of the number of defined apertures. */
 unsigned long int count_apertures = 0;
@@ -202,79 +209,58 @@ unsigned long int count_circ_aperture = 0;
 unsigned long int count_square_aperture = 0;
 unsigned long int count_ellipse_aperture = 0;
 
-/** Simple structure to represent simple circular apertures. */
-struct ap_circ {
-  double dia;
-};
-
-/** Simple structure to represent elliptical apertures. */
-struct ap_ellipse {
-  double w,h;
-};
-
-/** Square apertures. */
-struct ap_square {
-  double width;
+/** An aperture, known by its shape letter from the %AD (C, R or O)
+    and its size as written there.  Two apertures are the same if
+    their definitions would print the same. */
+struct aperture {
+  char shape;
+  char size[80];
+  long int index;
+  struct aperture *next;
 };
 
-/** Define a buffer containing all the apertures to be defined. */
-struct ap_circ aperture_circ_list[MAX_APERTURE_INDEX];
-struct ap_square aperture_square_list[MAX_APERTURE_INDEX];
-struct ap_ellipse aperture_ellipse_list[MAX_APERTURE_INDEX];
-
+/** Hash table of all the apertures defined, chained in the buckets. */
+struct aperture *aperture_table[APERTURE_HASH_SIZE];
 
-/** 
-  Test two numbers for equality by comparing their string representation.
-*/
-int is_double_equal(double a, double b) {
-  char s_a[80], s_b[80];
-  sprintf(s_a,"%f",a);
-  sprintf(s_b,"%f",b);
-  return strcmp(s_a,s_b) == 0 ? 1 : 0;
+/** Bucket of the aperture with the given shape and size. */
+unsigned long int hash_aperture(char shape, char *size) {
+  unsigned long int h = shape;
+  for (; *size; ++size)
+    h = h * 31 + *size;
+  return h & (APERTURE_HASH_SIZE-1);
 }
 
 /** 
-    Returns the index of any simple circle if it already exists. 
+    Returns the index of the aperture with the given shape and size
+    if it already exists. 
 
     -1 if it does not exists.
 */
-int test_ap_circ(double outer_dia) {
-  long int n=0;
-  for (n=0; n<count_circ_aperture; ++n) {
-    //    fprintf(stderr, "%f, %f\n", aperture_circ_list[n].dia, outer_dia);
-    if ( is_double_equal(aperture_circ_list[n].dia,outer_dia) ) {
-      return n;
-    }
-  }
+long int find_aperture(char shape, char *size) {
+  struct aperture *ap;
+  for (ap = aperture_table[hash_aperture(shape, size)]; ap; ap = ap->next)
+    if ( ap->shape == shape && strcmp(ap->size, size) == 0 )
+      return ap->index;
   return -1;
 }
 
+/** Enters a new aperture and returns its index. */
+long int add_aperture(char shape, char *size) {
+  struct aperture *ap;
+  unsigned long int h = hash_aperture(shape, size);
 
-/** 
-    Returns the index of an elliptical aperture if it already exists. 
-
-    -1 if it does not exists.
-*/
-int test_ap_ellipse(double w, double h) {
-  long int n=0;
-  for (n=0; n<count_ellipse_aperture; ++n) {
-    if ( is_double_equal(aperture_ellipse_list[n].w,w) && 
-	 is_double_equal(aperture_ellipse_list[n].h,h) ) {
-      return n;
-    }
+  if ((ap = (struct aperture *) malloc(sizeof(struct aperture))) == NULL) {
+    put_msg(Err_mem);
+    exit(2);
   }
-  return -1;
-}
-
-int test_ap_square(double width) {
-  long int n=0;
-  for (n=0; n<count_square_aperture; ++n) {
-    // fprintf(stderr,"%f, %f\n",aperture_square_list[n].width, width);
-     if ( is_double_equal(aperture_square_list[n].width,width) ) {
-      return n;
-    }
-  }
-  return -1;
+  ap->shape = shape;
+  strcpy(ap->size, size);
+  ap->index = count_apertures++;
+  ap->next = aperture_table[h];
+  aperture_table[h] = ap;
+  if (d_select_aperture + ap->index > MAX_D_CODE)
+    warn_once(warn_many_apertures, "More than 990 apertures, D codes above 999 may not be understood by older photoplotters.");
+  return ap->index;
 }
 
 
@@ -348,6 +334,80 @@ int y_fig2gbx(long int f) {
   return newheight;
 }
 
+/*
+ * Ordering of the output (-O).  Each object's output is held as an
+ * item, remembering the aperture it selects first and last and where
+ * the pen starts and ends.  At the end the items are written in the
+ * order found by order_items().
+ */
+struct gbx_item {
+  long int start, length;	/* of its text in the hold stream */
+  long int sel_start, sel_end;	/* leading aperture selection, or -1 */
+  long int first_ap, last_ap;	/* apertures selected, or -1 for none */
+  long int x1, y1, x2, y2;	/* where the pen starts and ends */
+  int has_xy;
+};
+
+static struct gbx_item *items = NULL;
+static long int n_items = 0, max_items = 0;
+static struct gbx_item *item = NULL;	/* the object being held */
+static Hold_buf gbx_hold;
+
+/** Start holding the output of an object. */
+void begin_item() {
+  if (!gbx_order)
+    return;
+  if (n_items == max_items) {
+    max_items = max_items ? 2*max_items : 256;
+    if ((items = (struct gbx_item *) realloc(items, max_items*sizeof(struct gbx_item))) == NULL) {
+      put_msg(Err_mem);
+      exit(2);
+    }
+  }
+  item = &items[n_items];
+  item->start = ftell(tfp);
+  item->sel_start = item->sel_end = -1;
+  item->first_ap = item->last_ap = -1;
+  item->has_xy = 0;
+}
+
+/** Finish the object, objects that wrote nothing are dropped. */
+void end_item() {
+  if (!item)
+    return;
+  item->length = ftell(tfp) - item->start;
+  if (item->length > 0)
+    ++n_items;
+  item = NULL;
+}
+
+/** Note that the pen went to x, y. */
+void item_xy(long int x, long int y) {
+  if (!item)
+    return;
+  if (!item->has_xy) {
+    item->x1 = x; item->y1 = y;
+    item->has_xy = 1;
+  }
+  item->x2 = x; item->y2 = y;
+}
+
+/** Note an aperture selection written from offset at.  The first one
+    can be left out if nothing was drawn before it and the aperture is
+    already selected. */
+void item_aperture(long int aperture_index, long int at) {
+  if (!item)
+    return;
+  if (item->first_ap == -1) {
+    item->first_ap = aperture_index;
+    if (!item->has_xy) {
+      item->sel_start = at;
+      item->sel_end = ftell(tfp);
+    }
+  }
+  item->last_ap = aperture_index;
+}
+
 /** Print a D code padded with zeros to produce two characters.
 
     e.g. D03 - Flash aperture.
@@ -379,9 +439,11 @@ void exposure_on() {
   
 /** Select an aperture to use for drawing. */
 void use_aperture(long int aperture_index) {
+  long int at = item ? ftell(tfp) : 0;
   write_g_code(tool_prepare);
   write_d_code(d_select_aperture + aperture_index);
   write_end_block();
+  item_aperture(aperture_index, at);
 }
 
 
@@ -410,6 +472,7 @@ void draw_xy(long int x, long int y) {
   if (!is_exposure)
     exposure_on();
   write_end_block();
+  item_xy(x,y);
 }
 
 /** Go from current point to specified point with exposure off. */
@@ -417,20 +480,25 @@ void move_xy(long int x, long int y) {
   xy(x,y);
   exposure_off();
   write_end_block();
+  item_xy(x,y);
 }
 
 /** Move to a point specified by x,y and flash the given aperture at
     this point. */
 void flash_xy(long int x, long int y, int aperture_index ) {
+  long int at;
   if (is_exposure)
     exposure_off();
   write_end_block();
+  at = item ? ftell(tfp) : 0;
   write_g_code(tool_prepare);
   write_d_code(d_select_aperture + aperture_index);
   write_end_block();
+  item_aperture(aperture_index, at);
   xy(x,y);
   write_d_code(d_flash);
   write_end_block();
+  item_xy(x,y);
 }
   
 
@@ -439,12 +507,8 @@ void flash_xy(long int x, long int y, int aperture_index ) {
     Returns the corresponding aperture index. 
 */ 
 unsigned long int ad_aperture_define_circ(double outer_dia) {
-  /* Check to see if the aperture count is zero, if so initialise the array*/
-  long int index;
-  if (!count_circ_aperture)
-    for (index=0; index<MAX_APERTURE_INDEX; ++index)
-      aperture_circ_list[index].dia=-1.0;
-  
+  char size[80];
+
   /* Sanity check on aperture size */
   if (! (outer_dia > 0.0) ) {
     fprintf(stderr,"Error: Something tried to define a circular aperture of zero size.\n");
@@ -452,16 +516,15 @@ unsigned long int ad_aperture_define_circ(double outer_dia) {
   }
 
   /* First check to see if the aperture is defined. */
-  long int ap_index = test_ap_circ(outer_dia);
+  sprintf(size, "%f", outer_dia);
+  long int ap_index = find_aperture('C', size);
 
   /* If the aperture has not been defined, add it. */
   if (ap_index == -1) {
-    ap_index = count_apertures;
-    fprintf(tfp, "%%ADD%liC,%f%%*\n",d_select_aperture + ap_index, outer_dia );
-    aperture_circ_list[ap_index].dia=outer_dia;
+    ap_index = add_aperture('C', size);
+    fprintf(gbx_file, "%%ADD%liC,%f%%*\n",d_select_aperture + ap_index, outer_dia );
 
     count_circ_aperture++;
-    count_apertures++;
   }
 
   /* Return the index to this aperture. */ 
@@ -473,13 +536,7 @@ unsigned long int ad_aperture_define_circ(double outer_dia) {
     Returns the corresponding aperture index. 
 */ 
 unsigned long int ad_aperture_define_ellipse(double w, double h) {
-  /* Check to see if the aperture count is zero, if so initialise the array*/
-  long int index;
-  if (!count_ellipse_aperture)
-    for (index=0; index<MAX_APERTURE_INDEX; ++index) {
-      aperture_ellipse_list[index].w=-1.0;
-      aperture_ellipse_list[index].h=-1.0;
-    }
+  char size[80];
 
   /* Sanity check on aperture size */
   if (! ( w > 0.0 && h > 0.0 ) ) {
@@ -488,17 +545,15 @@ unsigned long int ad_aperture_define_ellipse(double w, double h) {
   }
 
   /* First check to see if the aperture is defined. */
-  long int ap_index = test_ap_ellipse(w,h);
+  sprintf(size, "%fX%f", w, h);
+  long int ap_index = find_aperture('O', size);
 
   /* If the aperture has not been defined, add it. */
   if (ap_index == -1) {
-    ap_index = count_apertures;
-    fprintf(tfp, "%%ADD%liO,%fX%f*%%\n",d_select_aperture + ap_index, w, h);
-    aperture_ellipse_list[ap_index].w=w;
-    aperture_ellipse_list[ap_index].h=h;
+    ap_index = add_aperture('O', size);
+    fprintf(gbx_file, "%%ADD%liO,%fX%f*%%\n",d_select_aperture + ap_index, w, h);
 
     count_ellipse_aperture++;
-    count_apertures++;
   }
 
   /* Return the index to this aperture. */ 
@@ -510,12 +565,7 @@ unsigned long int ad_aperture_define_ellipse(double w, double h) {
     Returns the corresponding aperture index.
 */
 unsigned long int ad_aperture_define_square(double width) {
-  /* Check to see if the aperture count is zero, if so initialise the array*/
-  long int index;
-  if (!count_square_aperture)
-    for (index=0; index<MAX_APERTURE_INDEX; ++index) {
-      aperture_square_list[index].width=-1.0;
-    }
+  char size[80];
 
   /* Sanity check on aperture size */
   if (! ( width > 0.0 ) ) {
@@ -524,16 +574,15 @@ unsigned long int ad_aperture_define_square(double width) {
   }
 
    /* First check to see if the aperture is defined. */
-  long int ap_index = test_ap_square(width);
+  sprintf(size, "%f", width);
+  long int ap_index = find_aperture('R', size);
   
   /* If the aperture has not been defined, add it. */
   if (ap_index == -1) {
-    ap_index = count_apertures; 
-    fprintf(tfp, "%%ADD%liR,%fX%f*%%\n",d_select_aperture + ap_index, width, width);
-    aperture_square_list[ap_index].width=width;
+    ap_index = add_aperture('R', size);
+    fprintf(gbx_file, "%%ADD%liR,%fX%f*%%\n",d_select_aperture + ap_index, width, width);
   
     count_square_aperture++;
-    count_apertures++;
   }
   return ap_index;
 }
@@ -618,7 +667,7 @@ unsigned long int max_block_horizontal_count=10;
 /*
   Process options for producing the Gerber file.
 */
-void gengbx_option(opt, optarg)
+int gengbx_option(opt, optarg)
      char opt;
      char *optarg;
 {
@@ -678,10 +727,15 @@ void gengbx_option(opt, optarg)
     else
       fprintf(stderr,"Error: Debug comments option should be 'on' or 'off'\n");
     break;
+  case 'O':
+    /* Order the objects by aperture and position. */
+    gbx_order = 1;
+    break;
   default:
     put_msg(Err_badarg, opt, "gbx");
-    exit(1);
+    return 1;
   }
+  return 0;
 }
 
 void
@@ -694,6 +748,7 @@ gengbx_start (objects)
   /*     long int     i; */
 
   gbx_scale_factor=pow(10,gbx_after);
+  gbx_file = tfp;
 
   write_comment("Gerber RS-274x file"); 
 
@@ -733,10 +788,176 @@ gengbx_start (objects)
 
   write_comment("The following is an aperture definition of width pi/10.  It should never be used.");
   ad_aperture_define_square(0.314159);
+
+  /* Hold the drawing until it can be ordered. */
+  if (gbx_order) {
+    tfp = hold_open(&gbx_hold, "the output for ordering");
+  }
+}
+
+/** Pen-up distance from the end of item a (or the origin) to the start of b. */
+double item_travel(struct gbx_item *a, struct gbx_item *b) {
+  if (a == NULL)
+    return length(0, 0, b->x1, b->y1);
+  return length(a->x2, a->y2, b->x1, b->y1);
+}
+
+/** Travel and aperture changes when writing the items in the given order. */
+double order_travel(struct gbx_item **order, long int n, long int *changes) {
+  struct gbx_item *last = NULL;
+  long int i, ap = -1;
+  double travel = 0;
+  *changes = 0;
+  for (i = 0; i < n; ++i) {
+    if (order[i]->first_ap != -1 && order[i]->first_ap != ap)
+      ++*changes;
+    if (order[i]->last_ap != -1)
+      ap = order[i]->last_ap;
+    if (order[i]->has_xy) {
+      travel += item_travel(last, order[i]);
+      last = order[i];
+    }
+  }
+  return travel;
+}
+
+/** Maximum distance of the two items whose links 2-opt exchanges. */
+#define TWO_OPT_SPAN 100
+
+/** Improve the path order[from..to-1], coming from prev (NULL for the
+    origin) and going on to next (NULL if nothing follows), by reversing
+    pieces of it while that shortens the pen-up travel. The items are
+    not reversible, so the links inside a reversed piece change too. */
+void two_opt(struct gbx_item **order, long int from, long int to,
+	     struct gbx_item *prev, struct gbx_item *next) {
+  struct gbx_item *t, *before;
+  long int i, j, k, passes;
+  double fwd, rev, delta;
+  int improved = 1;
+
+  for (passes = 0; improved && passes < 20; ++passes) {
+    improved = 0;
+    for (i = from; i < to; ++i) {
+      before = i > from ? order[i-1] : prev;
+      fwd = rev = 0;
+      for (j = i+1; j < to && j <= i+TWO_OPT_SPAN; ++j) {
+	fwd += item_travel(order[j-1], order[j]);
+	rev += item_travel(order[j], order[j-1]);
+	delta = item_travel(before, order[j]) + rev - item_travel(before, order[i]) - fwd;
+	if (j+1 < to || next)
+	  delta += item_travel(order[i], j+1 < to ? order[j+1] : next)
+	    - item_travel(order[j], j+1 < to ? order[j+1] : next);
+	if (delta < -1e-6) {
+	  for (k = 0; i+k < j-k; ++k) {
+	    t = order[i+k]; order[i+k] = order[j-k]; order[j-k] = t;
+	  }
+	  improved = 1;
+	  break;
+	}
+      }
+    }
+  }
+}
+
+/** Order the held items: items without coordinates first, then by
+    nearest neighbour, preferring the items that need no aperture
+    change so that each aperture is selected about once, then 2-opt
+    inside each run of items drawn with one aperture. */
+void order_items(struct gbx_item **order) {
+  struct gbx_item *last = NULL, *t;
+  long int i, j, n = 0, first, best, ap = -1, in, out, run;
+  int is_free, free_best;
+  double d, bestd;
+
+  for (i = 0; i < n_items; ++i)
+    if (!items[i].has_xy)
+      order[n++] = &items[i];
+  first = n;
+  for (i = 0; i < n_items; ++i)
+    if (items[i].has_xy)
+      order[n++] = &items[i];
+
+  /* Nearest neighbour. */
+  for (i = first; i < n_items; ++i) {
+    best = -1; bestd = 0; free_best = 0;
+    for (j = i; j < n_items; ++j) {
+      is_free = order[j]->first_ap == -1 || order[j]->first_ap == ap;
+      d = item_travel(last, order[j]);
+      if (best == -1 || (is_free && !free_best) || (is_free == free_best && d < bestd)) {
+	best = j; bestd = d; free_best = is_free;
+      }
+    }
+    t = order[i]; order[i] = order[best]; order[best] = t;
+    if (order[i]->last_ap != -1)
+      ap = order[i]->last_ap;
+    last = order[i];
+  }
+
+  /* 2-opt inside the runs.  An item selecting another aperture starts
+     a new run, one leaving another aperture selected than it started
+     with stays where it is. */
+  ap = -1;
+  for (run = i = first; i < n_items; ++i) {
+    in = order[i]->first_ap != -1 ? order[i]->first_ap : ap;
+    out = order[i]->last_ap != -1 ? order[i]->last_ap : in;
+    if (in != ap || out != in) {
+      two_opt(order, run, i, run > first ? order[run-1] : NULL, order[i]);
+      run = out != in ? i+1 : i;
+    }
+    ap = out;
+  }
+  two_opt(order, run, n_items, run > first ? order[run-1] : NULL, NULL);
+}
+
+/** Write the held items in order, leaving out aperture selections of
+    the aperture already selected, and report the travel saved. */
+void write_items() {
+  struct gbx_item **order;
+  char *buf;
+  long int i, ap = -1, changes_before, changes_after;
+  double before, after, scale = width_fig2gbx(1);
+  char *units = gbx_dimensions == units_mm ? "mm" : "in";
+
+  tfp = gbx_file;
+  buf = hold_data(&gbx_hold);
+
+  if ((order = (struct gbx_item **) malloc((n_items+1)*sizeof(struct gbx_item *))) == NULL) {
+    put_msg(Err_mem);
+    exit(2);
+  }
+  for (i = 0; i < n_items; ++i)
+    order[i] = &items[i];
+  before = order_travel(order, n_items, &changes_before) * scale;
+  order_items(order);
+  after = order_travel(order, n_items, &changes_after) * scale;
+
+  sprintf(outbuf, "## ORDER: pen-up travel %.3f %s in depth order, %.3f %s ordered", before, units, after, units);
+  write_trace(outbuf);
+  fprintf(stderr, "gbx: pen-up travel %.3f %s in depth order, %.3f %s ordered; %ld aperture changes, %ld ordered\n",
+	  before, units, after, units, changes_before, changes_after);
+
+  for (i = 0; i < n_items; ++i) {
+    if (order[i]->sel_start != -1 && order[i]->first_ap == ap) {
+      fwrite(buf + order[i]->start, 1, order[i]->sel_start - order[i]->start, tfp);
+      fwrite(buf + order[i]->sel_end, 1, order[i]->start + order[i]->length - order[i]->sel_end, tfp);
+    } else {
+      fwrite(buf + order[i]->start, 1, order[i]->length, tfp);
+    }
+    if (order[i]->last_ap != -1)
+      ap = order[i]->last_ap;
+  }
+
+  free(buf);
+  free(order);
+  free(items);
+  items = NULL;
+  n_items = max_items = 0;
 }
 
 /** Output end of file marker. */
 int gengbx_end () {
+  if (gbx_order)
+    write_items();
   write_m_code(end_of_program);
   return 0;
 }
@@ -1033,7 +1254,7 @@ void gengbx_line (F_line *l) {
     write_g_code(poly_area_fill_off); write_end_block();
     
     /* Finish with an explicit exposure off */
-    exposure_off(); 
+    exposure_off(); write_end_block();
     
     /* The line surrounding the polygon is not closed.  Can lead to
        misrepresentation errors. */
@@ -1097,6 +1318,7 @@ gengbx_arc (F_arc *a) {
      
   fprintf(tfp,"X%iY%iI%iJ%iD01*\n", x_fig2gbx(a->point[2].x), y_fig2gbx(a->point[2].y),
 	  x_fig2gbx(a->center.x-a->point[0].x), y_fig2gbx(a->center.y-a->point[0].y)); 
+  item_xy(a->point[2].x, a->point[2].y);
 
   if (a->fill_style != fill_style_none) { 
     write_g_code(poly_area_fill_off);
@@ -1104,7 +1326,7 @@ gengbx_arc (F_arc *a) {
   }
   write_g_code(circ_interp_disable); write_end_block();
   write_g_code(line_interp_1x); write_end_block();
-  exposure_off();
+  exposure_off(); write_end_block();
     
   /* If the line has thickness and is filled switch off fill, and call myself to draw the line arc. */
   if (a->thickness > 0  && a->fill_style != fill_style_none) {
@@ -1150,11 +1372,17 @@ gengbx_ellipse (F_ellipse *e) {
       put_msg(Err_mem);
       exit (2);
     }
+    /* The arena hands back whatever was there before, so clear every
+       field and then copy over the ones the circle shares with the arc. */
+    memset((char *) a, 0, sizeof(F_arc));
+    a->type = T_OPEN_ARC;
+    a->style = e->style;
     a->pen = e->pen;
     a->fill_style = e->fill_style;
-    a->for_arrow = NULL;
-    a->back_arrow = NULL;
-    a->next = NULL;
+    a->depth = e->depth;
+    a->pen_color = e->pen_color;
+    a->fill_color = e->fill_color;
+    a->style_val = e->style_val;
 
     /* FIXIT - Warning the /sqrt(2.0) incurrs potential rounding
        errors.  Find a better way to write a circle in Gerber. */
@@ -1163,7 +1391,7 @@ gengbx_ellipse (F_ellipse *e) {
     a->point[2].x = e->center.x + e->radiuses.x/sqrt(2.0);
     a->point[2].y = e->center.y + e->radiuses.y/sqrt(2.0);
     a->point[1].x = e->center.x - e->radiuses.x/sqrt(2.0);
-    a->point[1].x = e->center.y - e->radiuses.y/sqrt(2.0);
+    a->point[1].y = e->center.y - e->radiuses.y/sqrt(2.0);
     a->center.x = e->center.x;
     a->center.y = e->center.y;
     a->thickness = e->thickness;
@@ -1188,14 +1416,19 @@ void gengbx_text (F_text *t) {
   */
 }
 
+/* Driver entries, the output of each object is one item for ordering. */
+void gengbx_arc_item (F_arc *a) { begin_item(); gengbx_arc(a); end_item(); }
+void gengbx_ellipse_item (F_ellipse *e) { begin_item(); gengbx_ellipse(e); end_item(); }
+void gengbx_line_item (F_line *l) { begin_item(); gengbx_line(l); end_item(); }
+
 /* driver defs */
 struct driver dev_gbx = {
   gengbx_option,
   gengbx_start,
   gendev_null,
-  gengbx_arc,
-  gengbx_ellipse,
-  gengbx_line,
+  gengbx_arc_item,
+  gengbx_ellipse_item,
+  gengbx_line_item,
   gengbx_spline,
   gengbx_text,
   gengbx_end,
@@ -79,7 +79,7 @@ static int	GE_COLORS[] = {	 1, /* black	black		*/
 				19, /* gold	goldenrod	*/
 		};
 
-void
+int
 genge_option(opt, optarg)
 char opt;
 char *optarg;
@@ -92,8 +92,9 @@ char *optarg;
 	    break;
 	default:
 	    put_msg(Err_badarg, opt, "ge");
-	    exit(1);
+	    return 1;
     }
+    return 0;
 }
 
 void
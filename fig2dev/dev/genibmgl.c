@@ -49,6 +49,7 @@
 
 #include "fig2dev.h"
 #include "object.h"
+#include "holdbuf.h"
 
 static set_style();
 
@@ -74,6 +75,7 @@ static	int	ibmgec		 = False;
 #endif
 
 static	Boolean	pcljcl		 = False;  /* flag to precede IBMGL (HP/GL) output with PCL job control */
+static	Boolean	ordered		 = False;  /* order the objects for the plotter (-O) */
 static	Boolean	reflected	 = False;
 static	int	fonts		 = FONTS;
 static	int	colors		 = COLORS;
@@ -82,6 +84,10 @@ static	int	line_color	 = DEFAULT;
 static	int	line_style	 = SOLID_LINE;
 static	int	fill_pattern	 = DEFAULT;
 static	double	dash_length	 = DEFAULT;	/* in pixels		*/
+static	int	current_width	 = -1;
+static	int	current_pen	 = 0;		/* 1 <= pen <= 8	*/
+static	double	current_thickness = 0.3;	/* pen thickness in mm	*/
+static	Boolean	forget_text	 = False;	/* text settings unknown */
 #ifdef A4
 static	double	pageheight	 = ISO_A4_HEIGHT;
 static	double	pagewidth	 = ISO_A4_WIDTH;
@@ -176,7 +182,7 @@ static struct {
     /* "ZapfDingbats",			34 */ { 45, 0, 0 },
 };
 
-static void genibmgl_option(opt, optarg)
+static int genibmgl_option(opt, optarg)
 char opt, *optarg;
 {
 	FILE	*ffp;
@@ -263,6 +269,10 @@ char opt, *optarg;
 		}
 		break;
 
+	    case 'O':				/* order for the plotter */
+		ordered		 = True;
+		break;
+
 	    case 'P':				/* portrait mode	*/
 		landscape	 = False;
 		orientspec	 = True;	/* user-specified	*/
@@ -283,8 +293,9 @@ char opt, *optarg;
 
 	    default:
 		put_msg(Err_badarg, opt, "ibmgl");
-		exit(1);
+		return 1;
 	}
+	return 0;
 }
 
 static double		cpi;			/*       cent/inch	*/
@@ -292,6 +303,155 @@ static double		cpp;			/*       cent/pixel	*/
 static double		wcmpp;			/* centimeter/point	*/
 static double		hcmpp;			/* centimeter/point	*/
 
+/*
+ * Ordering of the output (-O).  Each object is held as an item: first
+ * its setup (line type, width, pen and text settings), all of it, as
+ * if nothing had been set before, then the drawing.  At the end the
+ * items are put in an order that saves pen changes and pen-up travel,
+ * and the setup of an item is left out when the item before has left
+ * the same setup in place.  The pen selection of a setup that is written
+ * is left out too when that pen is already in the holder.
+ */
+struct plot_item {
+	long	start, body, end;	/* setup and drawing in the hold stream */
+	long	rev, rev_end;		/* the drawing backwards, or -1 */
+	long	sp_start, sp_end;	/* the pen selection in the setup, or -1 */
+	int	key;			/* items with the same setup */
+	int	pen_in, pen_out;	/* pen after the setup and at the end */
+	int	pen_changes;		/* pen changes in the drawing */
+	int	style, width;		/* the rest of the setup */
+	double	dash, thickness;
+	Boolean	keeps_setup;		/* the setup still holds at the end */
+	Boolean	has_xy;
+	Boolean	flip;			/* drawn backwards */
+	double	x1, y1, x2, y2;		/* where the pen starts and ends */
+	double	llx, lly, urx, ury;	/* bounding box */
+};
+
+static struct plot_item	*items = NULL;
+static int		n_items = 0, max_items = 0;
+static struct plot_item	*item = NULL;		/* the object being held */
+static FILE		*plot_file;		/* the real output */
+static Hold_buf		hold;
+
+/* make the next object set up everything it uses */
+
+static void
+forget_state()
+{
+	line_color	 = DEFAULT - 1;		/* matches no color	*/
+	line_style	 = DEFAULT - 1;		/* nor line style	*/
+	dash_length	 = DEFAULT;
+	fill_pattern	 = DEFAULT;
+	current_width	 = -1;
+	current_pen	 = 0;
+	current_thickness = 0.3;
+	forget_text	 = True;
+}
+
+static void
+begin_item()
+{
+	if (!ordered)
+	    return;
+	if (n_items == max_items) {
+	    max_items = max_items ? 2*max_items : 256;
+	    if ((items = (struct plot_item *)
+		    realloc(items, max_items*sizeof(struct plot_item))) == NULL) {
+		put_msg(Err_mem);
+		exit(2);
+		}
+	    }
+	item = &items[n_items];
+	item->start = ftell(tfp);
+	item->body = item->rev = item->rev_end = -1;
+	item->sp_start = item->sp_end = -1;
+	item->pen_changes = 0;
+	item->has_xy = item->flip = False;
+	forget_state();
+}
+
+/* the setup is done, the drawing follows */
+
+static void
+item_body()
+{
+	if (!item)
+	    return;
+	item->body = ftell(tfp);
+	item->style = line_style;
+	item->dash = dash_length;
+	item->width = current_width;
+	item->pen_in = current_pen;
+	item->thickness = current_thickness;
+}
+
+/* the drawing is done, what follows draws it backwards */
+
+static void
+item_backwards()
+{
+	if (!item)
+	    return;
+	item->end = item->rev = ftell(tfp);
+}
+
+static void
+end_item()
+{
+	if (!item)
+	    return;
+	if (item->rev >= 0)
+	    item->rev_end = ftell(tfp);
+	else
+	    item->end = ftell(tfp);
+	if (item->body < 0)
+	    item->body = item->start;
+	item->pen_out = current_pen;
+	item->keeps_setup = line_style == item->style &&
+		dash_length == item->dash && current_width == item->width &&
+		current_pen == item->pen_in &&
+		current_thickness == item->thickness;
+	if (item->has_xy)		/* objects drawing nothing are dropped */
+	    n_items++;
+	item = NULL;
+}
+
+/* the pen went to x, y */
+
+static void
+item_xy(x, y)
+    double	x, y;
+{
+	if (!item)
+	    return;
+	if (!item->has_xy) {
+	    item->x1 = item->llx = item->urx = x;
+	    item->y1 = item->lly = item->ury = y;
+	    item->has_xy = True;
+	    }
+	item->x2 = x;
+	item->y2 = y;
+	if (item->llx > x) item->llx = x;
+	if (item->urx < x) item->urx = x;
+	if (item->lly > y) item->lly = y;
+	if (item->ury < y) item->ury = y;
+}
+
+/* the object reaches x, y without the pen going there (after item_xy) */
+
+static void
+item_extent(x, y)
+    double	x, y;
+{
+	if (!item || !item->has_xy)
+	    return;
+	if (item->llx > x) item->llx = x;
+	if (item->urx < x) item->urx = x;
+	if (item->lly > y) item->lly = y;
+	if (item->ury < y) item->ury = y;
+}
+
 void genibmgl_start(objects)
 F_compound	*objects;
 {
@@ -456,6 +616,12 @@ F_compound	*objects;
 		Xmin,Xmax,Ymin,Ymax);
 	if (0.0 < pen_speed && pen_speed < SPEED_LIMIT)
 	    fprintf(tfp, "VS%.2f;\n", pen_speed);
+
+	/* hold the objects until they can be ordered */
+	if (ordered) {
+	    plot_file = tfp;
+	    tfp = hold_open(&hold, "the output for ordering");
+	    }
 }
 
 static arc_tangent(x1, y1, x2, y2, direction, x, y)
@@ -504,6 +670,9 @@ double	x1, y1, x2, y2, arrowht, arrowwid;
 
 	fprintf(tfp, "PA%.4f,%.4f;PD%.4f,%.4f,%.4f,%.4f;PU\n",
 		xc, yc, x2, y2, xd, yd);
+	item_xy(xc, yc);
+	item_xy(x2, y2);
+	item_xy(xd, yd);
 
 	/* restore line style */
 	set_style(style, length);
@@ -570,8 +739,6 @@ double	length;
 static set_width(w)
     int	w;
 {
-    static int current_width=-1;
-
     if (w == current_width) return;
 
     /* Default line width is 0.3 mm; back off to original xfig pen
@@ -588,17 +755,21 @@ static set_width(w)
 static set_color(color)
     int	color;
 {
-    static	int	number		 = 0;	/* 1 <= number <= 8		*/
-    static	double	thickness	 = 0.3;	/* pen thickness in millimeters	*/
 	if (line_color != color) {
 	    line_color  = color;
 	    color	= (colors + color)%colors;
-	    if (number != pen_number[color]) {
-		number  = pen_number[color];
+	    if (current_pen != pen_number[color]) {
+		current_pen  = pen_number[color];
+		if (item && item->body < 0)
+		    item->sp_start = ftell(tfp);
 		fprintf(tfp, "SP%d;\n", pen_number[color]);
+		if (item && item->body < 0)
+		    item->sp_end = ftell(tfp);
+		else if (item)
+		    item->pen_changes++;
 		}
-	    if (thickness != pen_thickness[color]) {
-		thickness  = pen_thickness[color];
+	    if (current_thickness != pen_thickness[color]) {
+		current_thickness  = pen_thickness[color];
 		fprintf(tfp, "PW%.4f;\n", pen_thickness[color]);
 		}
 	    }
@@ -634,27 +805,38 @@ static fill_polygon(pattern, color)
 void arc(sx, sy, cx, cy, theta, delta)
     double	sx, sy, cx, cy, theta, delta;
 {
-	if (ibmgec)
+	if (ibmgec) {
+	    double	r;
 	    if (delta == M_PI/36.0)		/* 5 degrees		*/
 		fprintf(tfp, "AA%.4f,%.4f,%.4f;",
 			cx, cy, theta*DPR);
 	    else
 		fprintf(tfp, "AA%.4f,%.4f,%.4f,%.4f;",
 			cx, cy, theta*DPR, delta*DPR);
+	    if (item) {
+		r = sqrt((sx - cx)*(sx - cx) + (sy - cy)*(sy - cy));
+		item_extent(cx - r, cy - r);
+		item_extent(cx + r, cy + r);
+		item_xy(cx + (sx - cx)*cos(theta) - (sy - cy)*sin(theta),
+			cy + (sy - cy)*cos(theta) + (sx - cx)*sin(theta));
+		}
+	    }
 	else {
-	    double	alpha;
+	    double	alpha, x, y;
 	    if (theta < 0.0)
 		delta = -fabs(delta);
 	    else
 		delta = fabs(delta);
 	    for (alpha = delta; fabs(alpha) < fabs(theta); alpha += delta) {
-		fprintf(tfp, "PA%.4f,%.4f;\n",
-	    		cx + (sx - cx)*cos(alpha) - (sy - cy)*sin(alpha),
-	    		cy + (sy - cy)*cos(alpha) + (sx - cx)*sin(alpha));
+		x = cx + (sx - cx)*cos(alpha) - (sy - cy)*sin(alpha);
+		y = cy + (sy - cy)*cos(alpha) + (sx - cx)*sin(alpha);
+		fprintf(tfp, "PA%.4f,%.4f;\n", x, y);
+		item_xy(x, y);
 		}
-	    fprintf(tfp, "PA%.4f,%.4f;\n",
-	    	    cx + (sx - cx)*cos(theta) - (sy - cy)*sin(theta),
-	    	    cy + (sy - cy)*cos(theta) + (sx - cx)*sin(theta));
+	    x = cx + (sx - cx)*cos(theta) - (sy - cy)*sin(theta);
+	    y = cy + (sy - cy)*cos(theta) + (sx - cx)*sin(theta);
+	    fprintf(tfp, "PA%.4f,%.4f;\n", x, y);
+	    item_xy(x, y);
 	    }
 }
 
@@ -670,6 +852,7 @@ void genibmgl_arc(a)
 	    set_style(a->style, a->style_val);
 	    set_width(a->thickness);
 	    set_color(a->pen_color);
+	    item_body();
 
 	    cx		 = a->center.x/ppi;
 	    cy		 = a->center.y/ppi;
@@ -699,6 +882,7 @@ void genibmgl_arc(a)
 		}
 
 	    fprintf(tfp, "PA%.4f,%.4f;PM;PD;", sx, sy);
+	    item_xy(sx, sy);
 	    arc(sx, sy, cx, cy, theta, DELTA);
 	    fprintf(tfp, "PU;PM2;\n");
 
@@ -732,6 +916,7 @@ void genibmgl_ellipse(e)
 	    set_style(e->style, e->style_val);
 	    set_width(e->thickness);
 	    set_color(e->pen_color);
+	    item_body();
 
 	    a		 = e->radiuses.x/ppi;
 	    b		 = e->radiuses.y/ppi;
@@ -743,6 +928,7 @@ void genibmgl_ellipse(e)
 	    x		 = x0 + cos(angle)*a;
 	    y		 = y0 + sin(angle)*a;
 	    fprintf(tfp, "PA%.4f,%.4f;PM;PD;\n", x, y);
+	    item_xy(x, y);
 	    for (j = 1; j <= 72; j++) { 
 		alpha	 = j*delta;
 		x	 = x0 + cos(angle)*a*cos(alpha)
@@ -750,6 +936,7 @@ void genibmgl_ellipse(e)
 		y	 = y0 + sin(angle)*a*cos(alpha)
 	    		 + cos(angle)*b*sin(alpha);
 		fprintf(tfp, "PA%.4f,%.4f;\n", x, y);
+		item_xy(x, y);
 	    }
 	    fprintf(tfp, "PU;PM2;\n");
 
@@ -770,6 +957,26 @@ void swap(i, j)
 	*j = t;
 }
 
+/* draw an open line again, from the last point to the first */
+
+static void
+backward_line(l)
+    F_line	*l;
+{
+	int	i = l->npts - 1;
+
+	item_backwards();
+	fprintf(tfp, "PA%.4f,%.4f;PM;PD%.4f,%.4f;\n",
+		l->pts[i].x/ppi, l->pts[i].y/ppi,
+		l->pts[i-1].x/ppi, l->pts[i-1].y/ppi);
+	for (i -= 2; i >= 0; i--)
+	    fprintf(tfp, "PA%.4f,%.4f;\n", l->pts[i].x/ppi, l->pts[i].y/ppi);
+	fprintf(tfp, "PU;PM2;\n");
+
+	if (l->thickness != 0)
+	    fprintf(tfp, "EP;\n");
+}
+
 void genibmgl_line(l)
     F_line	*l;
 {
@@ -780,6 +987,7 @@ void genibmgl_line(l)
 	    set_style(l->style, l->style_val);
 	    set_width(l->thickness);
 	    set_color(l->pen_color);
+	    item_body();
 
 	    p	 = l->points;
 	    q	 = p->next;
@@ -788,10 +996,11 @@ void genibmgl_line(l)
 		case	T_POLYLINE:
 		case	T_BOX:
 		case	T_POLYGON:
-		    if (q == NULL)		/* A single point line */
+		    if (q == NULL) {		/* A single point line */
 			fprintf(tfp, "PA%.4f,%.4f;PD;PU;\n",
 				p->x/ppi, p->y/ppi);
-		    else {
+			item_xy(p->x/ppi, p->y/ppi);
+		    } else {
 			if (l->thickness != 0 && l->back_arrow)
 			    draw_arrow_head(q->x/ppi, q->y/ppi,
 		    		    p->x/ppi, p->y/ppi,
@@ -801,11 +1010,14 @@ void genibmgl_line(l)
 			fprintf(tfp, "PA%.4f,%.4f;PM;PD%.4f,%.4f;\n",
 				p->x/ppi, p->y/ppi,
 				q->x/ppi, q->y/ppi);
+			item_xy(p->x/ppi, p->y/ppi);
+			item_xy(q->x/ppi, q->y/ppi);
 			while (q->next != NULL) {
 			    p	 = q;
 			    q	 = q->next;
 			    fprintf(tfp, "PA%.4f,%.4f;\n",
 				    q->x/ppi, q->y/ppi);
+			    item_xy(q->x/ppi, q->y/ppi);
 			    }
 			fprintf(tfp, "PU;PM2;\n");
 
@@ -820,6 +1032,14 @@ void genibmgl_line(l)
 
 			if (0 < l->fill_style && l->fill_style < patterns)
 			    fill_polygon((int)l->fill_style, l->fill_color);
+
+			/* an open line without arrows or fill can also be
+			   drawn from the other end */
+			if (item && l->type == T_POLYLINE &&
+				!(l->thickness != 0 &&
+				    (l->for_arrow || l->back_arrow)) &&
+				!(0 < l->fill_style && l->fill_style < patterns))
+			    backward_line(l);
 			}
 		    break;
 
@@ -850,14 +1070,19 @@ void genibmgl_line(l)
 		    angle = -M_PI/2.0;
 
 		    fprintf(tfp, "PA%.4f,%.4f;PM;PD;\n",  x0, y0 + dy);
+		    item_xy(x0, y0 + dy);
 		    arc(x0, y0 + dy, x0 + dx, y0 + dy, angle, DELTA);
 		    fprintf(tfp, "PA%.4f,%.4f;\n", x1 - dx, y0);
+		    item_xy(x1 - dx, y0);
 		    arc(x1 - dx, y0, x1 - dx, y0 + dy, angle, DELTA);
 		    fprintf(tfp, "PA%.4f,%.4f;\n", x1, y1 - dy);
+		    item_xy(x1, y1 - dy);
 		    arc(x1, y1 - dy, x1 - dx, y1 - dy, angle, DELTA);
 		    fprintf(tfp, "PA%.4f,%.4f;\n", x0 + dx, y1);
+		    item_xy(x0 + dx, y1);
 		    arc(x0 + dx, y1, x0 + dx, y1 - dy, angle, DELTA);
 		    fprintf(tfp, "PA%.4f,%.4f;PU;PM2;\n", x0, y0 + dy);
+		    item_xy(x0, y0 + dy);
 
 		    if (l->thickness != 0)
 			fprintf(tfp, "EP;\n");
@@ -884,10 +1109,11 @@ static bezier_spline(a0, b0, a1, b1, a2, b2, a3, b3)
 
 	x0 = a0; y0 = b0;
 	x3 = a3; y3 = b3;
-	if (fabs(x0 - x3) < THRESHOLD && fabs(y0 - y3) < THRESHOLD)
+	if (fabs(x0 - x3) < THRESHOLD && fabs(y0 - y3) < THRESHOLD) {
 	    fprintf(tfp, "PA%.4f,%.4f;\n", x3, y3);
+	    item_xy(x3, y3);
 
-	else {
+	} else {
 	    tx   = (a1  + a2 )/2.0;	ty   = (b1  + b2 )/2.0;
 	    sx1  = (x0  + a1 )/2.0;	sy1  = (y0  + b1 )/2.0;
 	    sx2  = (sx1 + tx )/2.0;	sy2  = (sy1 + ty )/2.0;
@@ -916,6 +1142,7 @@ F_spline	*s;
 		    s->back_arrow->ht/ppi, s->back_arrow->wid/ppi);
 
 	fprintf(tfp, "PA%.4f,%.4f;PD;\n", x2, y2);
+	item_xy(x2, y2);
 	for (p2 = p1->next, cp2 = cp1->next; p2 != NULL;
 		p1 = p2, cp1 = cp2, p2 = p2->next, cp2 = cp2->next) {
 	    x1	 = x2;
@@ -942,16 +1169,18 @@ double	a1, b1, a2, b2, a3, b3, a4, b4;
 	x4	 = a4; y4 = b4;
 	xmid	 = (a2 + a3)/2.0;
 	ymid	 = (b2 + b3)/2.0;
-	if (fabs(x1 - xmid) < THRESHOLD && fabs(y1 - ymid) < THRESHOLD)
+	if (fabs(x1 - xmid) < THRESHOLD && fabs(y1 - ymid) < THRESHOLD) {
 	    fprintf(tfp, "PA%.4f,%.4f;\n", xmid, ymid);
-	else {
+	    item_xy(xmid, ymid);
+	} else {
 	    quadratic_spline(x1, y1, ((x1+a2)/2.0), ((y1+b2)/2.0),
 		((3.0*a2+a3)/4.0), ((3.0*b2+b3)/4.0), xmid, ymid);
 	    }
 
-	if (fabs(xmid - x4) < THRESHOLD && fabs(ymid - y4) < THRESHOLD)
+	if (fabs(xmid - x4) < THRESHOLD && fabs(ymid - y4) < THRESHOLD) {
 	    fprintf(tfp, "PA%.4f,%.4f;\n", x4, y4);
-	else {
+	    item_xy(x4, y4);
+	} else {
 	    quadratic_spline(xmid, ymid, ((a2+3.0*a3)/4.0), ((b2+3.0*b3)/4.0),
 			((a3+x4)/2.0), ((b3+y4)/2.0), x4, y4);
 	    }
@@ -975,14 +1204,17 @@ F_spline	*s;
 	cx2	 = (x1 + 3.0*x2)/4.0;
 	cy2	 = (y1 + 3.0*y2)/4.0;
 
-	if (closed_spline(s))
+	if (closed_spline(s)) {
 	    fprintf(tfp, "PA%.4f,%.4f;PD;\n ", cx1, cy1);
-	else {
+	    item_xy(cx1, cy1);
+	} else {
 	    if (s->thickness != 0 && s->back_arrow)
 		draw_arrow_head(cx1, cy1, x1, y1,
 			s->back_arrow->ht/ppi, s->back_arrow->wid/ppi);
 	    fprintf(tfp, "PA%.4f,%.4f;PD%.4f,%.4f;\n",
 		    x1, y1, cx1, cy1);
+	    item_xy(x1, y1);
+	    item_xy(cx1, cy1);
 	    }
 
 	for (p = p->next; p != NULL; p = p->next) {
@@ -1015,6 +1247,7 @@ F_spline	*s;
 	    }
 	else {
 	    fprintf(tfp, "PA%.4f,%.4f;PU;\n", x1, y1);
+	    item_xy(x1, y1);
 	    if (s->thickness != 0 && s->for_arrow)
 	    	draw_arrow_head(cx1, cy1, x1, y1,
 			s->for_arrow->ht/ppi, s->for_arrow->wid/ppi);
@@ -1028,6 +1261,7 @@ F_spline	*s;
 	    set_style(s->style, s->style_val);
 	    set_width(s->thickness);
 	    set_color(s->pen_color);
+	    item_body();
 
 	    if (int_spline(s))
 		genibmgl_itp_spline(s);
@@ -1053,6 +1287,12 @@ static	double	angle	 = 0.0;		/* label direction  in radians	*/
 	double	height;			/* character height in centimeters */
 	Boolean newfont=False, newsize=False;
 
+	if (forget_text) {
+	    font  = size = DEFAULT;
+	    theta = angle = HUGE_VAL;
+	    forget_text = False;
+	}
+
 	if (font != FONT(t->font)) {
 	    font  = FONT(t->font);
 	    /* Simulate italic fonts with a 10 degree slant */
@@ -1089,8 +1329,16 @@ static	double	angle	 = 0.0;		/* label direction  in radians	*/
 		    cos(angle), sin(reflected ? -angle: angle));
 	}
 	set_color(t->color);
+	item_body();
 
 	fprintf(tfp, "PA%.4f,%.4f;\n", t->base_x/ppi, t->base_y/ppi);
+	if (item) {
+	    /* a box the label surely fits in, whichever way it goes */
+	    double	r = (strlen(t->cstring) + 1)*t->size/72.0;
+	    item_xy(t->base_x/ppi, t->base_y/ppi);
+	    item_extent(t->base_x/ppi - r, t->base_y/ppi - r);
+	    item_extent(t->base_x/ppi + r, t->base_y/ppi + r);
+	    }
 
 	switch (t->type) {
 	    case DEFAULT:
@@ -1110,9 +1358,430 @@ static	double	angle	 = 0.0;		/* label direction  in radians	*/
 	fprintf(tfp, "LB%s\003\n", t->cstring);
 }
 
+/*
+ * Pen-up travel from where item a leaves the pen (the origin if a is
+ * NULL) to where item b puts it down, with ta and tb turning either
+ * of them round if it can be drawn backwards.
+ */
+
+static double
+hop(a, ta, b, tb)
+    struct plot_item	*a, *b;
+    int			 ta, tb;
+{
+	double	ax, ay, bx, by;
+
+	if (a == NULL)
+	    ax = ay = 0.0;
+	else if (a->flip ^ (ta && a->rev >= 0)) {
+	    ax = a->x1; ay = a->y1;
+	    }
+	else {
+	    ax = a->x2; ay = a->y2;
+	    }
+	if (b->flip ^ (tb && b->rev >= 0)) {
+	    bx = b->x2; by = b->y2;
+	    }
+	else {
+	    bx = b->x1; by = b->y1;
+	    }
+	return sqrt((bx - ax)*(bx - ax) + (by - ay)*(by - ay));
+}
+
+/* the bounding boxes of two items meet, so their depth order matters */
+
+static Boolean
+items_meet(a, b)
+    struct plot_item	*a, *b;
+{
+	return a->llx <= b->urx && b->llx <= a->urx &&
+	       a->lly <= b->ury && b->lly <= a->ury;
+}
+
+/* pen-up travel and pen changes when plotting the items in this order */
+
+static double
+order_travel(order, changes)
+    struct plot_item	**order;
+    int			 *changes;
+{
+	struct plot_item	*last = NULL;
+	double			 travel = 0.0;
+	int			 i, pen = 0;
+
+	*changes = 0;
+	for (i = 0; i < n_items; i++) {
+	    travel += hop(last, 0, order[i], 0);
+	    if (order[i]->pen_in != pen)
+		++*changes;
+	    *changes += order[i]->pen_changes;
+	    pen = order[i]->pen_out;
+	    last = order[i];
+	    }
+	return travel;
+}
+
+/*
+ * The items in a cell of a grid over the figure, to find those whose
+ * bounding boxes meet.  Each cell lists its items in depth order.
+ */
+
+#define		GRID_MAX	64		/* cells along a side	*/
+
+static int	 grid_n;
+static double	 grid_x0, grid_y0, grid_dx, grid_dy;
+static int	*cell_start, *cell_items;
+
+static int
+grid_cell(v, v0, d)
+    double	v, v0, d;
+{
+	int	c;
+
+	if (d <= 0.0)
+	    return 0;
+	c = (v - v0)/d;
+	return c < 0 ? 0 : c >= grid_n ? grid_n - 1 : c;
+}
+
+static void
+item_cells(it, cx0, cy0, cx1, cy1)
+    struct plot_item	*it;
+    int			*cx0, *cy0, *cx1, *cy1;
+{
+	*cx0 = grid_cell(it->llx, grid_x0, grid_dx);
+	*cx1 = grid_cell(it->urx, grid_x0, grid_dx);
+	*cy0 = grid_cell(it->lly, grid_y0, grid_dy);
+	*cy1 = grid_cell(it->ury, grid_y0, grid_dy);
+}
+
+static void
+make_grid()
+{
+	int	i, x, y, cx0, cy0, cx1, cy1;
+	double	llx, lly, urx, ury;
+
+	for (grid_n = 1; grid_n < GRID_MAX && grid_n*grid_n < n_items; grid_n++)
+	    ;
+	llx = urx = items[0].llx;
+	lly = ury = items[0].lly;
+	for (i = 0; i < n_items; i++) {
+	    if (llx > items[i].llx) llx = items[i].llx;
+	    if (urx < items[i].urx) urx = items[i].urx;
+	    if (lly > items[i].lly) lly = items[i].lly;
+	    if (ury < items[i].ury) ury = items[i].ury;
+	    }
+	grid_x0 = llx;
+	grid_y0 = lly;
+	grid_dx = (urx - llx)/grid_n;
+	grid_dy = (ury - lly)/grid_n;
+
+	if ((cell_start = (int *) calloc(grid_n*grid_n + 1, sizeof(int))) == NULL) {
+	    put_msg(Err_mem);
+	    exit(2);
+	    }
+	for (i = 0; i < n_items; i++) {
+	    item_cells(&items[i], &cx0, &cy0, &cx1, &cy1);
+	    for (y = cy0; y <= cy1; y++)
+		for (x = cx0; x <= cx1; x++)
+		    cell_start[y*grid_n + x + 1]++;
+	    }
+	for (i = 0; i < grid_n*grid_n; i++)
+	    cell_start[i+1] += cell_start[i];
+	if ((cell_items = (int *) malloc((cell_start[grid_n*grid_n] + 1)*sizeof(int))) == NULL) {
+	    put_msg(Err_mem);
+	    exit(2);
+	    }
+	for (i = 0; i < n_items; i++) {
+	    item_cells(&items[i], &cx0, &cy0, &cx1, &cy1);
+	    for (y = cy0; y <= cy1; y++)
+		for (x = cx0; x <= cx1; x++)
+		    cell_items[cell_start[y*grid_n + x]++] = i;
+	    }
+	/* the fill moved each start to the next cell's */
+	for (i = grid_n*grid_n; i > 0; i--)
+	    cell_start[i] = cell_start[i-1];
+	cell_start[0] = 0;
+}
+
+/* Maximum distance of the two items whose links 2-opt exchanges. */
+#define		TWO_OPT_SPAN	50
+
+/*
+ * Improve the path order[from..to-1], coming from prev (NULL for the
+ * origin) and going on to next (NULL if nothing follows), by reversing
+ * pieces of it while that shortens the pen-up travel.  Lines in a
+ * reversed piece are drawn backwards if they can be.  A piece must not
+ * hold two items that meet, or their depth order would change.
+ */
+
+static void
+two_opt(order, from, to, prev, next)
+    struct plot_item	**order, *prev, *next;
+    int			  from, to;
+{
+	struct plot_item	*t, *before, *after;
+	int			 i, j, k, passes;
+	double			 fwd, rev, delta;
+	Boolean			 improved = True;
+
+	for (passes = 0; improved && passes < 20; passes++) {
+	    improved = False;
+	    for (i = from; i < to; i++) {
+		before = i > from ? order[i-1] : prev;
+		fwd = rev = 0.0;
+		for (j = i+1; j < to && j <= i + TWO_OPT_SPAN; j++) {
+		    for (k = i; k < j; k++)
+			if (items_meet(order[k], order[j]))
+			    break;
+		    if (k < j)
+			break;
+		    fwd += hop(order[j-1], 0, order[j], 0);
+		    rev += hop(order[j], 1, order[j-1], 1);
+		    after = j+1 < to ? order[j+1] : next;
+		    delta = hop(before, 0, order[j], 1) + rev
+			  - hop(before, 0, order[i], 0) - fwd;
+		    if (after)
+			delta += hop(order[i], 1, after, 0)
+			       - hop(order[j], 0, after, 0);
+		    if (delta < -1e-6) {
+			for (k = 0; i+k <= j-k; k++) {
+			    t = order[i+k]; order[i+k] = order[j-k]; order[j-k] = t;
+			    if (order[i+k]->rev >= 0)
+				order[i+k]->flip = !order[i+k]->flip;
+			    if (i+k < j-k && order[j-k]->rev >= 0)
+				order[j-k]->flip = !order[j-k]->flip;
+			    }
+			improved = True;
+			break;
+			}
+		    }
+		}
+	    }
+}
+
+/*
+ * Order the held items.  An item may go as soon as all the items
+ * before it in depth order that it meets have gone.  Of those ready
+ * the nearest is taken, preferring the items with the same setup, and
+ * then the same pen, as the last one.  Then each run of items with one
+ * setup is improved by 2-opt, and last each line is drawn from the end
+ * nearer its neighbours.
+ */
+
+static void
+order_items(order)
+    struct plot_item	**order;
+{
+	struct plot_item	*last = NULL, *it;
+	int	*npred, *mark, *ready, n_ready = 0;
+	int	 i, j, k, m, r, x, y, cx0, cy0, cx1, cy1;
+	int	 best, class, best_class, key = -1, pen = 0, run;
+	double	 d, best_d;
+	Boolean	 flip, best_flip;
+
+	npred = (int *) calloc(n_items, sizeof(int));
+	mark = (int *) malloc(n_items*sizeof(int));
+	ready = (int *) malloc(n_items*sizeof(int));
+	if (npred == NULL || mark == NULL || ready == NULL) {
+	    put_msg(Err_mem);
+	    exit(2);
+	    }
+	make_grid();
+
+	/* count the items before each one that it meets */
+	for (j = 0; j < n_items; j++)
+	    mark[j] = -1;
+	for (j = 0; j < n_items; j++) {
+	    item_cells(&items[j], &cx0, &cy0, &cx1, &cy1);
+	    for (y = cy0; y <= cy1; y++)
+		for (x = cx0; x <= cx1; x++)
+		    for (k = cell_start[y*grid_n + x];
+			    k < cell_start[y*grid_n + x + 1]; k++) {
+			if ((i = cell_items[k]) >= j)
+			    break;
+			if (mark[i] == j)
+			    continue;
+			mark[i] = j;
+			if (items_meet(&items[i], &items[j]))
+			    npred[j]++;
+			}
+	    if (npred[j] == 0)
+		ready[n_ready++] = j;
+	    }
+
+	for (m = 0; m < n_items; m++) {
+	    best = -1;
+	    best_class = 0;
+	    best_d = 0.0;
+	    best_flip = False;
+	    for (r = 0; r < n_ready; r++) {
+		it = &items[ready[r]];
+		class = it->key == key ? 0 : it->pen_in == pen ? 1 : 2;
+		d = hop(last, 0, it, 0);
+		flip = False;
+		if (it->rev >= 0 && hop(last, 0, it, 1) < d) {
+		    d = hop(last, 0, it, 1);
+		    flip = True;
+		    }
+		if (best == -1 || class < best_class ||
+			(class == best_class && d < best_d)) {
+		    best = r;
+		    best_class = class;
+		    best_d = d;
+		    best_flip = flip;
+		    }
+		}
+	    i = ready[best];
+	    ready[best] = ready[--n_ready];
+	    it = order[m] = &items[i];
+	    it->flip = best_flip;
+	    key = it->keeps_setup ? it->key : -1;
+	    pen = it->pen_out;
+	    last = it;
+
+	    /* release the later items meeting this one */
+	    item_cells(it, &cx0, &cy0, &cx1, &cy1);
+	    for (y = cy0; y <= cy1; y++)
+		for (x = cx0; x <= cx1; x++)
+		    for (k = cell_start[y*grid_n + x + 1] - 1;
+			    k >= cell_start[y*grid_n + x]; k--) {
+			if ((j = cell_items[k]) <= i)
+			    break;
+			if (mark[j] == n_items + i)
+			    continue;
+			mark[j] = n_items + i;
+			if (items_meet(it, &items[j]) && --npred[j] == 0)
+			    ready[n_ready++] = j;
+			}
+	    }
+
+	/* 2-opt inside the runs of items with one setup */
+	for (run = 0, m = 1; m <= n_items; m++)
+	    if (m == n_items || order[m]->key != order[m-1]->key ||
+		    !order[m-1]->keeps_setup) {
+		two_opt(order, run, m, run > 0 ? order[run-1] : NULL,
+			m < n_items ? order[m] : NULL);
+		run = m;
+		}
+
+	/* draw each line from the better end */
+	for (m = 0; m < n_items; m++) {
+	    it = order[m];
+	    if (it->rev < 0)
+		continue;
+	    last = m > 0 ? order[m-1] : NULL;
+	    d = hop(last, 0, it, 0) - hop(last, 0, it, 1);
+	    if (m+1 < n_items)
+		d += hop(it, 0, order[m+1], 0) - hop(it, 1, order[m+1], 0);
+	    if (d > 1e-6)
+		it->flip = !it->flip;
+	    }
+
+	free(npred);
+	free(mark);
+	free(ready);
+	free(cell_start);
+	free(cell_items);
+}
+
+/* Size of the hash table finding the items with the same setup. */
+#define		SETUP_HASH	256
+
+/*
+ * Write the held items in order, leaving out the setup of an item when
+ * the one before has left it in place, and its pen selection when the
+ * pen is already in the holder, and report the pen-up travel and pen
+ * changes saved.
+ */
+
+static void
+write_items()
+{
+	struct plot_item	**order, *setup = NULL, *it;
+	char			 *buf;
+	int			  head[SETUP_HASH], *chain;
+	int			  i, k, n_keys = 0, changes, changes_after, pen;
+	unsigned long		  h;
+	long			  j, len;
+	double			  travel, travel_after;
+
+	tfp = plot_file;
+	buf = hold_data(&hold);
+
+	if (n_items > 0) {
+	    order = (struct plot_item **) malloc(n_items*sizeof(struct plot_item *));
+	    chain = (int *) malloc(n_items*sizeof(int));
+	    if (order == NULL || chain == NULL) {
+		put_msg(Err_mem);
+		exit(2);
+		}
+
+	    /* items with the same setup commands get the same key */
+	    for (h = 0; h < SETUP_HASH; h++)
+		head[h] = -1;
+	    for (i = 0; i < n_items; i++) {
+		len = items[i].body - items[i].start;
+		for (h = 0, j = items[i].start; j < items[i].body; j++)
+		    h = h*31 + (unsigned char) buf[j];
+		h &= SETUP_HASH - 1;
+		for (k = head[h]; k != -1; k = chain[k])
+		    if (items[k].body - items[k].start == len &&
+			    memcmp(buf + items[k].start, buf + items[i].start,
+				len) == 0)
+			break;
+		if (k != -1)
+		    items[i].key = items[k].key;
+		else {
+		    items[i].key = n_keys++;
+		    chain[i] = head[h];
+		    head[h] = i;
+		    }
+		}
+
+	    for (i = 0; i < n_items; i++)
+		order[i] = &items[i];
+	    travel = order_travel(order, &changes);
+	    order_items(order);
+	    travel_after = order_travel(order, &changes_after);
+	    fprintf(stderr, "ibmgl: pen-up travel %.2f in in depth order, %.2f in ordered; %d pen changes, %d ordered\n",
+		    travel*mag, travel_after*mag, changes, changes_after);
+
+	    pen = 0;				/* as in order_travel() */
+	    for (i = 0; i < n_items; i++) {
+		it = order[i];
+		if (setup == NULL || setup->key != it->key) {
+		    if (it->sp_start >= 0 && it->sp_end <= it->body &&
+			    it->pen_in == pen) {
+			fwrite(buf + it->start, 1, it->sp_start - it->start, tfp);
+			fwrite(buf + it->sp_end, 1, it->body - it->sp_end, tfp);
+			}
+		    else
+			fwrite(buf + it->start, 1, it->body - it->start, tfp);
+		    }
+		if (it->flip)
+		    fwrite(buf + it->rev, 1, it->rev_end - it->rev, tfp);
+		else
+		    fwrite(buf + it->body, 1, it->end - it->body, tfp);
+		setup = it->keeps_setup ? it : NULL;
+		pen = it->pen_out;
+		}
+	    free(order);
+	    free(chain);
+	    }
+
+	free(buf);
+	free(items);
+	items = NULL;
+	n_items = max_items = 0;
+}
+
 int
 genibmgl_end()
 {
+	if (ordered)
+	    write_items();
+
 	/* IBMGL ending */
 	fprintf(tfp, "PU;SP;IN;\n");
 
@@ -1123,15 +1792,62 @@ genibmgl_end()
 	return 0;
 }
 
+/* with -O each object is held by itself */
+
+static void
+genibmgl_arc_item(a)
+    F_arc	*a;
+{
+	begin_item();
+	genibmgl_arc(a);
+	end_item();
+}
+
+static void
+genibmgl_ellipse_item(e)
+    F_ellipse	*e;
+{
+	begin_item();
+	genibmgl_ellipse(e);
+	end_item();
+}
+
+static void
+genibmgl_line_item(l)
+    F_line	*l;
+{
+	begin_item();
+	genibmgl_line(l);
+	end_item();
+}
+
+static void
+genibmgl_spline_item(s)
+    F_spline	*s;
+{
+	begin_item();
+	genibmgl_spline(s);
+	end_item();
+}
+
+static void
+genibmgl_text_item(t)
+    F_text	*t;
+{
+	begin_item();
+	genibmgl_text(t);
+	end_item();
+}
+
 struct driver dev_ibmgl = {
      	genibmgl_option,
 	genibmgl_start,
 	gendev_null,
-	genibmgl_arc,
-	genibmgl_ellipse,
-	genibmgl_line,
-	genibmgl_spline,
-	genibmgl_text,
+	genibmgl_arc_item,
+	genibmgl_ellipse_item,
+	genibmgl_line_item,
+	genibmgl_spline_item,
+	genibmgl_text_item,
 	genibmgl_end,
 	EXCLUDE_TEXT
 	};
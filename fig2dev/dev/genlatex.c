@@ -147,7 +147,7 @@ translate2_d(xp, yp)
 	*yp = (double)TOP - *yp -1.0;
 	}
 
-void
+int
 genlatex_option(opt, optarg)
   char opt, *optarg;
 {
@@ -208,8 +208,9 @@ genlatex_option(opt, optarg)
 
 	default:
 	    put_msg(Err_badarg, opt, "latex");
-	    exit(1);
+	    return 1;
     }
+    return 0;
 }
 
 void
@@ -1069,6 +1070,29 @@ int col;
    return;
 }
 
+/* back to the defaults for the next figure of a batch */
+
+void
+genlatex_reset()
+{
+	encoding = 1;
+	verbose = 0;
+	dash_mag = 1.0;
+	thick_width = 2;
+	border_margin = 0;
+	cur_thickness = -1;
+	dot_cmd = thindot;
+	ldot_cmd = thin_ldot;
+	lastcolor = -1;
+	FontSizeOnly = False;
+	/* the default font, as in texfonts.h */
+	texfontnames[0] = "rm";
+#ifdef NFSS
+	texfontfamily[0] = "\\familydefault";
+	texfontseries[0] = "\\mddefault";
+	texfontshape[0] = "\\updefault";
+#endif
+}
 
 struct driver dev_latex = {
      	genlatex_option,
@@ -1080,5 +1104,6 @@ struct driver dev_latex = {
 	genlatex_spline,
 	genlatex_text,
 	genlatex_end,
-	EXCLUDE_TEXT
+	EXCLUDE_TEXT,
+	genlatex_reset
 };
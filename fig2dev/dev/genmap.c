@@ -60,7 +60,7 @@ static hlink* last_link = 0;
 #define ARC_EXPAND  1.02   /* make polygon slightly larger */
 
 
-void
+int
 genmap_option(opt, optarg)
      char opt;
      char *optarg;
@@ -74,8 +74,9 @@ genmap_option(opt, optarg)
     break;
   default:
     put_msg(Err_badarg, opt, "map");
-    exit(1);
+    return 1;
   }
+  return 0;
 }
 
 static char *
@@ -119,7 +119,7 @@ genmf_end()
 	return 0;
 }
 
-void
+int
 genmf_option(opt, optarg)
 char opt;
 char *optarg;
@@ -156,8 +156,9 @@ char *optarg;
 	    break;
 	default:
 	    put_msg(Err_badarg, opt, "mf");
-	    exit(1);
+	    return 1;
     }
+    return 0;
 }
 
 void
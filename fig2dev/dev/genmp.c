@@ -405,7 +405,7 @@ genmp_end()
 	return(0);
 }
 
-void
+int
 genmp_option(opt, optarg)
 char opt, *optarg;
 {
@@ -459,6 +459,7 @@ char opt, *optarg;
 	options[cllen++]=' ';	
 	strcat (options, optarg);
     }
+    return 0;
 }
 
 /* Changes for arrowhead support start here 
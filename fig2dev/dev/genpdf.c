@@ -7,29 +7,612 @@
  * nonexclusive right and license to deal in this software and
  * documentation files (the "Software"), including without limitation the
  * rights to use, copy, modify, merge, publish and/or distribute copies of
- * the Software, and to permit persons who receive copies from any such 
- * party to do so, with the only requirement being that this copyright 
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that this copyright
  * notice remain intact.
  *
  */
 
-/* 
- *	genpdf.c : pdf driver for fig2dev 
+/*
+ *	genpdf.c : pdf driver for fig2dev
  *
  *	Author: Brian V. Smith
  *		Uses genps functions to generate PostScript output then
  *		calls ghostscript (device pdfwrite) to convert it to pdf.
+ *
+ *	The PDF is now written directly: one page whose content stream
+ *	draws the objects with the geometry of genps.c, text in the
+ *	standard 14 fonts, fill patterns as tiling patterns and pictures
+ *	as image XObjects (JPEG files are copied as they are).  Only
+ *	figures with EPS or PDF pictures, or I18N text, still go through
+ *	ghostscript.
  */
 
 #include "fig2dev.h"
 #include "genps.h"
+#include "genpdf.h"
 #include "object.h"
+#include "bound.h"
+#include "readpics.h"
 #include "texfonts.h"
 
+#define		POINT_PER_INCH		72
+#define		ULIMIT_FONT_SIZE	300
+
+#include "psfonts.h"
+
+#ifdef USE_PNG
+#include <zlib.h>
+#endif
+#ifdef USE_XPM
+#include <xpm.h>
+#endif /* USE_XPM */
+
+/* for the version number */
+#include "../../patchlevel.h"
+
+#ifdef I18N
+extern Boolean support_i18n;
+#endif /* I18N */
+
+/* the standard colors (from genps.c) */
+extern struct _rgb {
+	float r, g, b;
+	} rgbcols[];
+
+extern int	JPEGcomponents();
+
+#define	SHADEVAL(F)	1.0*(F)/(NUMSHADES-1)
+#define	TINTVAL(F)	1.0*(F-NUMSHADES+1)/NUMTINTS
+
 static	FILE	*saveofile;
 static	char	*ofile;
 
-void
+/*
+ * Growing buffers for the content stream and for the path of the object
+ * being drawn, which is painted up to three times (fill, pattern, stroke).
+ */
+
+typedef struct {
+	char	*s;
+	int	 n, max;
+} Pdf_buf;
+
+static Pdf_buf	 content, path, dict;
+
+static Boolean	 use_gs = False;	/* send PostScript through ghostscript */
+static FILE	*pdffile;		/* the output, tfp is a sink meanwhile */
+static long	 filepos;		/* bytes written to pdffile */
+static long	*offsets = NULL;	/* of each object, for the xref table */
+static int	 nobjs, maxobjs = 0;
+static double	 scalex, scaley;
+static double	 fllx, flly, furx, fury;
+static int	 pagew, pageh;
+static int	 border_margin = 0;
+static Boolean	 anonymous = False;
+static double	 cur_thickness;
+static int	 cur_joinstyle, cur_capstyle, cur_hscale;
+static Boolean	 dashed;
+
+/* fixed objects; fonts, patterns and images get the numbers that follow */
+#define	CATALOG_OBJ	1
+#define	PAGES_OBJ	2
+#define	PAGE_OBJ	3
+#define	CONTENT_OBJ	4
+#define	INFO_OBJ	5
+
+/* the fonts every PDF viewer has, and their objects (0 if unused) */
+#define	NUM_STD_FONTS	14
+static char	*std_fonts[NUM_STD_FONTS] = {
+		"Times-Roman", "Times-Bold", "Times-Italic", "Times-BoldItalic",
+		"Helvetica", "Helvetica-Bold", "Helvetica-Oblique",
+		"Helvetica-BoldOblique", "Courier", "Courier-Bold",
+		"Courier-Oblique", "Courier-BoldOblique", "Symbol", "ZapfDingbats"
+	};
+static int	 font_obj[NUM_STD_FONTS];
+static int	 encoding_obj;
+static char	*subst_warned[MAX_PSFONT+2];
+
+static int	 pattern_obj[NUMPATTERNS];
+static int	*image_obj = NULL;
+static int	 nimages, maximages = 0;
+
+/* arrowhead points, as in genps.c */
+static Point	 bpts[50], fpts[50];
+static int	 nbpts, nfpts;
+static Point	 bfillpts[50], ffillpts[50], clippts[50];
+static int	 nbfillpts, nffillpts, nclippts;
+static int	 fx1, fy1, fx2, fy2;	/* first and second point of object */
+static int	 lx1, ly1, lx2, ly2;	/* last and second-to-last point */
+
+static Boolean	 eps_picture_exist();
+static void	 set_linewidth();
+static void	 clip_arrows();
+static void	 draw_arrow();
+static void	 draw_picture();
+static void	 fill_path();
+static void	 stroke_path();
+
+/*
+ * The fill patterns of genps.h as PDF content.  They are uncolored tiling
+ * patterns in the default page space, like the PostScript ones; a line
+ * "x y r a1 a2 arc" is turned into Bezier curves.
+ */
+
+static struct {
+	double	 bbox[4];
+	int	 xstep, ystep;
+	char	*proc;
+} pdf_patterns[NUMPATTERNS] = {
+    {{-2, -4, 10, 5}, 8, 4,		/* left30 */
+	".7 w\n-2 -1 m 10 5 l S\n"},
+    {{-2, -4, 10, 5}, 8, 4,		/* right30 */
+	".7 w\n-2 5 m 10 -1 l S\n"},
+    {{-2, -4, 10, 5}, 8, 4,		/* crosshatch30 */
+	".7 w\n-2 5 m 10 -1 l S\n-2 -1 m 10 5 l S\n"},
+    {{-1, -1, 9, 9}, 8, 8,		/* left45 */
+	"1 w\n-1 -1 m 9 9 l S\n"},
+    {{-1, -1, 9, 9}, 8, 8,		/* right45 */
+	"1 w\n-1 9 m 9 -1 l S\n"},
+    {{-1, -1, 9, 9}, 8, 8,		/* crosshatch45 */
+	"1 w\n-1 9 m 9 -1 l S\n-1 -1 m 9 9 l S\n"},
+    {{-1, 0, 17, 17}, 16, 16,		/* bricks */
+	"1 w 0 J\n0 0 m 0 8 l S\n8 8 m 8 16 l S\n0 8 m 16 8 l S\n0 16 m 16 16 l S\n"},
+    {{0, -1, 17, 17}, 16, 16,		/* vertical bricks */
+	"1 w 0 J\n0 0 m 8 0 l S\n8 8 m 16 8 l S\n8 0 m 8 16 l S\n16 0 m 16 16 l S\n"},
+    {{0, 0, 4, 4}, 4, 4,		/* horizontal lines */
+	"1 w 0 J\n0 3.5 m 4 3.5 l S\n"},
+    {{0, 0, 4, 4}, 4, 4,		/* vertical lines */
+	"1 w 0 J\n3.5 0 m 3.5 4 l S\n"},
+    {{0, 0, 4, 4}, 4, 4,		/* crosshatch lines */
+	"1 w 0 J\n3.5 0 m 3.5 4 l S\n0 3.5 m 4 3.5 l S\n"},
+    {{0, 0, 25, 24}, 24, 24,		/* left-shingles */
+	"1 w 0 J\n0 0.5 m 24 0.5 l S\n0 8.5 m 24 8.5 l S\n0 16.5 m 24 16.5 l S\n\
+4 24.5 m 8 16.5 l S\n16 0.5 m 12 8.5 l S\n20 16.5 m 24 8.5 l S\n"},
+    {{0, 0, 25, 24}, 24, 24,		/* right-shingles */
+	"1 w 0 J\n0 0.5 m 24 0.5 l S\n0 8.5 m 24 8.5 l S\n0 16.5 m 24 16.5 l S\n\
+4 8.5 m 8 16.5 l S\n12 0.5 m 16 8.5 l S\n20 16.5 m 24 24.5 l S\n"},
+    {{0, 0, 24, 25}, 24, 24,		/* vertical left-shingles */
+	"1 w 0 J\n0.5 0 m 0.5 24 l S\n8.5 0 m 8.5 24 l S\n16.5 0 m 16.5 24 l S\n\
+8.5 4 m 16.5 8 l S\n0.5 12 m 8.5 16 l S\n16.5 20 m 24.5 24 l S\n"},
+    {{0, 0, 25, 25}, 24, 24,		/* vertical right-shingles */
+	"1 w 0 J\n0.5 0 m 0.5 24 l S\n8.5 0 m 8.5 24 l S\n16.5 0 m 16.5 24 l S\n\
+24.5 4 m 16.5 8 l S\n0.5 16 m 8.5 12 l S\n16.5 20 m 8.5 24 l S\n"},
+    {{0, -1, 17, 9}, 16, 8,		/* fishscales */
+	".7 w 0 J\n8 -7 11 43 137 arc\nS\n0 -3 11 43 137 arc\nS\n16 -3 11 43 137 arc\nS\n"},
+    {{0, -0.5, 8, 8.5}, 8, 8,		/* small fishscales */
+	".7 w 0 J\n4 0 4 0 180 arc\nS\n0 4 4 0 180 arc\nS\n8 4 4 0 180 arc\nS\n"},
+    {{-0.35, -0.35, 16.35, 16.35}, 16, 16,	/* circles */
+	".7 w 0 J\n8 8 8 0 360 arc\nS\n"},
+    {{-0.5, -0.35, 27, 17}, 26, 16,	/* hexagons */
+	".7 w 0 j\n4 0 m 13 0 l 17 8 l 13 16 l 4 16 m 0 8 l 4 0 l 5 0 l S\n17 8 m 26 8 l S\n"},
+    {{0, 0, 16, 16}, 16, 16,		/* octagons */
+	".8 w 0 j\n5 0 m 11 0 l 16 5 l 16 11 l 11 16 l 5 16 l 0 11 l 0 5 l h S\n"},
+    {{0, 0, 8, 8}, 8, 8,		/* horizontal sawtooth lines */
+	".8 w 0 j\n-1 3 m 0 2 l 4 6 l 8 2 l 9 3 l S\n"},
+    {{0, 0, 8.5, 8}, 8, 8,		/* vertical sawtooth lines */
+	".8 w 0 j\n3 -1 m 2 0 l 6 4 l 2 8 l 3 9 l S\n"},
+};
+
+/*
+ * Output
+ */
+
+static char *
+grow(array, max, n, size)
+    char	*array;
+    int		*max, n, size;
+{
+	if (n <= *max)
+	    return array;
+	*max = (n > 2 * *max) ? n : 2 * *max;
+	if (*max < 64)
+	    *max = 64;
+	if ((array = realloc(array, *max * size)) == NULL) {
+	    put_msg(Err_mem);
+	    exit(1);
+	}
+	return array;
+}
+
+static void
+bprintf(Pdf_buf *b, char *fmt, ...)
+{
+	va_list	 ap;
+	int	 len;
+
+	for (;;) {
+	    va_start(ap, fmt);
+	    len = vsnprintf(b->s + b->n, b->max - b->n, fmt, ap);
+	    va_end(ap);
+	    if (len < 0 || len < b->max - b->n)
+		break;
+	    b->s = grow(b->s, &b->max, b->n + len + 1, 1);
+	}
+	if (len > 0)
+	    b->n += len;
+}
+
+/* a number with at most two decimals and no trailing zeros */
+
+static char *
+num(v)
+    double	 v;
+{
+	static char	 bufs[8][24];
+	static int	 next = 0;
+	char		*s, *p;
+
+	s = bufs[next];
+	next = (next + 1) % 8;
+	if (v == (long) v && fabs(v) < 1e9) {	/* most Fig coordinates */
+	    sprintf(s, "%ld", (long) v);
+	    return s;
+	}
+	sprintf(s, "%.2f", v);
+	p = s + strlen(s) - 1;
+	while (*p == '0')
+	    *p-- = '\0';
+	if (*p == '.')
+	    *p = '\0';
+	if (strcmp(s, "-0") == 0)
+	    strcpy(s, "0");
+	return s;
+}
+
+static void
+pdf_printf(char *fmt, ...)
+{
+	va_list	 ap;
+	int	 len;
+
+	va_start(ap, fmt);
+	len = vfprintf(pdffile, fmt, ap);
+	va_end(ap);
+	if (len > 0)
+	    filepos += len;
+}
+
+static void
+pdf_write(data, len)
+    char	*data;
+    long	 len;
+{
+	fwrite(data, 1, len, pdffile);
+	filepos += len;
+}
+
+/* a string in parentheses, escaping what needs it */
+
+static void
+string_to(b, s)
+    Pdf_buf		*b;
+    unsigned char	*s;
+{
+	bprintf(b, "(");
+	for (; *s; s++) {
+	    if (*s == '(' || *s == ')' || *s == '\\')
+		bprintf(b, "\\%c", *s);
+	    else if (*s < ' ' || *s >= 0x80)
+		bprintf(b, "\\%03o", *s);
+	    else
+		bprintf(b, "%c", *s);
+	}
+	bprintf(b, ")");
+}
+
+static int
+new_obj()
+{
+	offsets = (long *) grow((char *) offsets, &maxobjs, nobjs+2, sizeof(long));
+	offsets[++nobjs] = 0;
+	return nobjs;
+}
+
+static void
+begin_obj(n)
+    int		 n;
+{
+	offsets[n] = filepos;
+	pdf_printf("%d 0 obj\n", n);
+}
+
+/* write a stream object; deflate it (fast, the content can be big) if we
+   have zlib */
+
+static void
+write_stream(n, dictstr, data, len, deflate)
+    int		 n;
+    char	*dictstr;
+    char	*data;
+    long	 len;
+    Boolean	 deflate;
+{
+#ifdef USE_PNG
+	unsigned char	*zbuf;
+	uLongf		 zlen;
+#endif
+
+	begin_obj(n);
+#ifdef USE_PNG
+	if (deflate && len > 0) {
+	    zlen = compressBound((uLong) len);
+	    if ((zbuf = (unsigned char *) malloc(zlen)) != NULL &&
+		    compress2(zbuf, &zlen, (unsigned char *) data, (uLong) len,
+				Z_BEST_SPEED) == Z_OK) {
+		pdf_printf("<< %s /Filter /FlateDecode /Length %ld >>\nstream\n",
+				dictstr, (long) zlen);
+		pdf_write((char *) zbuf, (long) zlen);
+		pdf_printf("\nendstream\nendobj\n");
+		free(zbuf);
+		return;
+	    }
+	    if (zbuf)
+		free(zbuf);
+	}
+#endif /* USE_PNG */
+	pdf_printf("<< %s /Length %ld >>\nstream\n", dictstr, len);
+	pdf_write(data, len);
+	pdf_printf("\nendstream\nendobj\n");
+}
+
+/*
+ * Colors and the graphics state
+ */
+
+static void
+get_color(color, rgb)
+    int		 color;
+    double	*rgb;
+{
+	if (color < NUM_STD_COLS) {
+	    rgb[0] = rgbcols[color > 0 ? color : 0].r;
+	    rgb[1] = rgbcols[color > 0 ? color : 0].g;
+	    rgb[2] = rgbcols[color > 0 ? color : 0].b;
+	} else {
+	    rgb[0] = user_colors[color-NUM_STD_COLS].r / 255.0;
+	    rgb[1] = user_colors[color-NUM_STD_COLS].g / 255.0;
+	    rgb[2] = user_colors[color-NUM_STD_COLS].b / 255.0;
+	}
+	if (grayonly)
+	    rgb[0] = rgb[1] = rgb[2] = rgb2luminance(rgb[0], rgb[1], rgb[2]);
+}
+
+/* color for the following fills (stroke False) or strokes */
+
+static void
+set_rgb(rgb, stroke)
+    double	*rgb;
+    Boolean	 stroke;
+{
+	if (grayonly)
+	    bprintf(&content, "%.3f %s\n", rgb[0], stroke? "G": "g");
+	else
+	    bprintf(&content, "%.3f %.3f %.3f %s\n", rgb[0], rgb[1], rgb[2],
+			stroke? "RG": "rg");
+}
+
+static void
+set_color(color, stroke)
+    int		 color;
+    Boolean	 stroke;
+{
+	double	 rgb[3];
+
+	get_color(color, rgb);
+	set_rgb(rgb, stroke);
+}
+
+static void
+set_linewidth(w)
+    double	 w;
+{
+	if (w != cur_thickness) {
+	    cur_thickness = w;
+	    bprintf(&content, "%.3f w\n",
+		    cur_thickness <= THICK_SCALE ?	/* make lines a little thinner */
+				0.5* cur_thickness :
+				cur_thickness - THICK_SCALE);
+	}
+}
+
+static void
+set_linejoin(j)
+    int		 j;
+{
+	if (j != cur_joinstyle) {
+	    cur_joinstyle = j;
+	    bprintf(&content, "%d j\n", cur_joinstyle);
+	}
+}
+
+static void
+set_linecap(j)
+    int		 j;
+{
+	if (j != cur_capstyle) {
+	    cur_capstyle = j;
+	    bprintf(&content, "%d J\n", cur_capstyle);
+	}
+}
+
+/* the dash patterns of genps.c */
+
+static void
+set_style(s, v)
+    int		 s;
+    double	 v;
+{
+	int	 dot;
+
+	v /= 80.0 / ppi;
+	if (v <= 0.0)
+	    return;
+	dot = round(ppi/80.0);
+	if (s == DASH_LINE) {
+	    bprintf(&content, "[%d] 0 d\n", round(v));
+	} else if (s == DOTTED_LINE) {
+	    bprintf(&content, "[%d %d] %d d\n", dot, round(v), round(v));
+	} else if (s == DASH_DOT_LINE) {
+	    bprintf(&content, "[%d %d %d %d] 0 d\n",
+		round(v), round(v*0.5), dot, round(v*0.5));
+	} else if (s == DASH_2_DOTS_LINE) {
+	    bprintf(&content, "[%d %d %d %d %d %d] 0 d\n",
+		round(v), round(v*0.45), dot, round(v*0.333), dot, round(v*0.45));
+	} else if (s == DASH_3_DOTS_LINE) {
+	    bprintf(&content, "[%d %d %d %d %d %d %d %d] 0 d\n",
+		round(v), round(v*0.4), dot, round(v*0.3),
+		dot, round(v*0.3), dot, round(v*0.4));
+	} else {
+	    return;
+	}
+	dashed = True;
+}
+
+static void
+reset_style()
+{
+	if (dashed)
+	    bprintf(&content, "[] 0 d\n");
+	dashed = False;
+}
+
+/*
+ * Paths
+ */
+
+static void
+path_move(x, y)
+    double	 x, y;
+{
+	bprintf(&path, "%s %s m\n", num(x), num(y));
+}
+
+static void
+path_line(x, y)
+    double	 x, y;
+{
+	bprintf(&path, "%s %s l\n", num(x), num(y));
+}
+
+static void
+path_curve(x1, y1, x2, y2, x3, y3)
+    double	 x1, y1, x2, y2, x3, y3;
+{
+	bprintf(&path, "%s %s %s %s %s %s c\n",
+		num(x1), num(y1), num(x2), num(y2), num(x3), num(y3));
+}
+
+/*
+ * Add the part of an ellipse with radii rx, ry turned by rot (radians)
+ * from angle a1 to a2 (degrees; decreasing if a2 < a1) to path b, in
+ * Bezier curves of at most 90 degrees.  The path starts there if first.
+ */
+
+static void
+arc_to(b, cx, cy, rx, ry, rot, a1, a2, first)
+    Pdf_buf	*b;
+    double	 cx, cy, rx, ry, rot, a1, a2;
+    Boolean	 first;
+{
+	double	 cr, sr, d, k, t0, t1, x0, y0, x1, y1, dx0, dy0, dx1, dy1;
+	int	 i, n;
+
+	cr = cos(rot);
+	sr = sin(rot);
+	n = (int) ceil(fabs(a2 - a1) / 90.0 - 0.001);
+	if (n < 1)
+	    n = 1;
+	d = (a2 - a1) / n * M_PI / 180.0;
+	k = 4.0 / 3.0 * tan(d / 4.0);
+	t0 = a1 * M_PI / 180.0;
+#define	EX(t)	(cx + rx*cos(t)*cr - ry*sin(t)*sr)
+#define	EY(t)	(cy + rx*cos(t)*sr + ry*sin(t)*cr)
+#define	EDX(t)	(-rx*sin(t)*cr - ry*cos(t)*sr)
+#define	EDY(t)	(-rx*sin(t)*sr + ry*cos(t)*cr)
+	x0 = EX(t0);
+	y0 = EY(t0);
+	bprintf(b, "%s %s %s\n", num(x0), num(y0), first? "m": "l");
+	for (i = 0; i < n; i++) {
+	    t1 = t0 + d;
+	    x1 = EX(t1);
+	    y1 = EY(t1);
+	    dx0 = EDX(t0); dy0 = EDY(t0);
+	    dx1 = EDX(t1); dy1 = EDY(t1);
+	    bprintf(b, "%s %s %s %s %s %s c\n",
+		num(x0 + k*dx0), num(y0 + k*dy0), num(x1 - k*dx1), num(y1 - k*dy1),
+		num(x1), num(y1));
+	    t0 = t1;
+	    x0 = x1;
+	    y0 = y1;
+	}
+#undef	EX
+#undef	EY
+#undef	EDX
+#undef	EDY
+}
+
+/* paint the path in the way of genps' fill_area() (even/odd rule) */
+
+static void
+fill_path(fill, pen_color, fill_color)
+    int		 fill, pen_color, fill_color;
+{
+	double	 rgb[3], v;
+	int	 i, patnum;
+
+	if (fill_color <= 0 && fill < NUMSHADES+NUMTINTS) {
+	    /* use gray levels for default and black shades and tints */
+	    v = 1.0 - SHADEVAL(fill);
+	    if (v < 0.0)
+		v = 0.0;
+	    bprintf(&content, "%.2f g\n", v);
+	} else if (fill < NUMSHADES) {
+	    /* a shaded color (not black) */
+	    get_color(fill_color, rgb);
+	    for (i = 0; i < 3; i++)
+		rgb[i] *= SHADEVAL(fill);
+	    set_rgb(rgb, False);
+	} else if (fill < NUMSHADES+NUMTINTS) {
+	    /* a tint */
+	    get_color(fill_color, rgb);
+	    for (i = 0; i < 3; i++)
+		rgb[i] += (1.0 - rgb[i]) * TINTVAL(fill);
+	    set_rgb(rgb, False);
+	} else {
+	    /* one of the patterns, on the fill color */
+	    patnum = fill-NUMSHADES-NUMTINTS;
+	    if (patnum >= NUMPATTERNS)
+		patnum = NUMPATTERNS-1;
+	    set_color(fill_color, False);
+	    bprintf(&content, "%.*sf\n", path.n, path.s);
+	    if (pattern_obj[patnum] == 0)
+		pattern_obj[patnum] = new_obj();
+	    get_color(pen_color, rgb);
+	    if (grayonly)
+		bprintf(&content, "/PatGray cs %.3f /P%d scn\n", rgb[0], patnum+1);
+	    else
+		bprintf(&content, "/PatRGB cs %.3f %.3f %.3f /P%d scn\n",
+				rgb[0], rgb[1], rgb[2], patnum+1);
+	    bprintf(&content, "%.*sf\n", path.n, path.s);
+	    return;
+	}
+	bprintf(&content, "%.*sf*\n", path.n, path.s);
+}
+
+static void
+stroke_path(color)
+    int		 color;
+{
+	set_color(color, True);
+	bprintf(&content, "%.*sS\n", path.n, path.s);
+}
+
+/*
+ * Driver
+ */
+
+int
 genpdf_option(opt, optarg)
 char opt;
 char *optarg;
@@ -37,11 +620,22 @@ char *optarg;
 	/* just use the eps options */
 	pdfflag = True;
 	epsflag = True;
-	gen_ps_eps_option(opt, optarg);
+	switch (opt) {
+	  case 'a':
+		anonymous = True;
+		break;
+	  case 'b':
+		sscanf(optarg, "%d", &border_margin);
+		break;
+	  case 'f':
+		psfontnames[0] = psfontnames[1] = optarg;
+		break;
+	}
+	return gen_ps_eps_option(opt, optarg);
 }
 
-void
-genpdf_start(objects)
+static void
+genpdf_gs_start(objects)
 F_compound	*objects;
 {
     /* divert output from ps driver to the pipe into ghostscript */
@@ -64,8 +658,975 @@ F_compound	*objects;
     genps_start(objects);
 }
 
-int
-genpdf_end()
+void
+genpdf_start(objects)
+F_compound	*objects;
+{
+	int	 i;
+
+	use_gs = eps_picture_exist(objects);
+#ifdef I18N
+	if (support_i18n)
+	    use_gs = True;
+#endif /* I18N */
+	if (use_gs) {
+	    genpdf_gs_start(objects);
+	    return;
+	}
+
+	/* like EPS: shift the figure to 0,0 and make the page its size */
+	scalex = scaley = mag * POINT_PER_INCH / ppi;
+	fllx = llx * scalex - border_margin;
+	flly = lly * scaley - border_margin;
+	furx = urx * scalex + border_margin;
+	fury = ury * scaley + border_margin;
+	pagew = (int) ceil(furx - fllx);
+	pageh = (int) ceil(fury - flly);
+
+	content.n = path.n = 0;
+	nobjs = 0;
+	for (i = 0; i < INFO_OBJ; i++)
+	    (void) new_obj();
+	for (i = 0; i < NUM_STD_FONTS; i++)
+	    font_obj[i] = 0;
+	for (i = 0; i < MAX_PSFONT+2; i++)
+	    subst_warned[i] = NULL;
+	encoding_obj = 0;
+	for (i = 0; i < NUMPATTERNS; i++)
+	    pattern_obj[i] = 0;
+	nimages = 0;
+	count_picture_uses(objects);	/* no picture has an XObject yet */
+	cur_thickness = -1.0;
+	cur_joinstyle = cur_capstyle = 0;
+	cur_hscale = 100;
+	dashed = False;
+
+	/* the picture readers write PostScript comments to tfp, keep
+	   them out of the output file */
+	pdffile = tfp;
+	filepos = 0;
+	if ((tfp = fopen("/dev/null", "w")) == NULL)
+	    tfp = tmpfile();
+
+	pdf_printf("%%PDF-1.4\n%%\342\343\317\323\n");
+
+	/* fill the background now if specified */
+	if (bgspec) {
+	    double	 rgb[3];
+
+	    rgb[0] = background.red/65535.0;
+	    rgb[1] = background.green/65535.0;
+	    rgb[2] = background.blue/65535.0;
+	    if (grayonly)
+		rgb[0] = rgb[1] = rgb[2] = rgb2luminance(rgb[0], rgb[1], rgb[2]);
+	    set_rgb(rgb, False);
+	    bprintf(&content, "0 0 %d %d re f\n", pagew, pageh);
+	}
+
+	/* from Fig units, y going down, to points */
+	bprintf(&content, "%.5f 0 0 %.5f %.1f %.1f cm\n", scalex, -scaley, -fllx, fury);
+	bprintf(&content, "10 M\n");	/* make like X server (11 degrees) */
+}
+
+/* Draw a grid on the figure, over the area of the figure like for eps */
+
+void
+genpdf_grid(major, minor)
+    float	major, minor;
+{
+	float	lx, ly, ux, uy;
+	float	x, y;
+	double	thick, thin, f;
+	int	itick, ntick;
+	float	m;
+
+	if (use_gs) {
+	    genps_grid(major, minor);
+	    return;
+	}
+	if (minor == 0.0 && major == 0.0)
+		return;
+	m = minor;
+	if (minor == 0.0)
+		m = major;
+	lx = floor((fllx / scalex) / m) * m;
+	ly = floor((flly / scaley) / m) * m;
+	ux = furx / scalex;
+	uy = fury / scaley;
+	thin = THICK_SCALE;
+	thick = THICK_SCALE * 2.5;
+	/* adjust for difference in xfig/actual scale in metric mode */
+	f = metric? 450.0/472.0: 1.0;
+
+	bprintf(&content, "0.5 G\n");
+	for (x = lx; x <= ux; x += m) {
+	    if (major > 0.0) {
+		itick = (int)(x/major)*major;
+		if (itick == x) {
+		    set_linewidth(thick);
+		} else {
+		    ntick = (int)((x+minor)/major)*major;
+		    if (ntick < x+minor) {
+			set_linewidth(thick);
+			bprintf(&content, "%s %s m %s %s l S\n",
+				num(ntick*f), num(ly*f), num(ntick*f), num(uy*f));
+		    }
+		    set_linewidth(thin);
+		}
+	    } else {
+		set_linewidth(thin);
+	    }
+	    bprintf(&content, "%s %s m %s %s l S\n",
+			num(x*f), num(ly*f), num(x*f), num(uy*f));
+	}
+	for (y = ly; y <= uy; y += m) {
+	    if (major > 0.0) {
+		itick = (int)(y/major)*major;
+		if (itick == y) {
+		    set_linewidth(thick);
+		} else {
+		    ntick = (int)((y+minor)/major)*major;
+		    if (ntick < y+minor) {
+			set_linewidth(thick);
+			bprintf(&content, "%s %s m %s %s l S\n",
+				num(lx*f), num(ntick*f), num(ux*f), num(ntick*f));
+		    }
+		    set_linewidth(thin);
+		}
+	    } else {
+		set_linewidth(thin);
+	    }
+	    bprintf(&content, "%s %s m %s %s l S\n",
+			num(lx*f), num(y*f), num(ux*f), num(y*f));
+	}
+}
+
+void
+genpdf_line(l)
+F_line	*l;
+{
+	F_pos	*p;
+	int	 radius, i, n;
+	int	 xmin, xmax, ymin, ymax;
+	double	 hf_wid, k;
+	Boolean	 clipped;
+
+	if (use_gs) {
+	    genps_line(l);
+	    return;
+	}
+	if (l->type == T_PIC_BOX) {
+	    draw_picture(l);
+	    return;
+	}
+	set_linejoin(l->join_style);
+	set_linecap(l->cap_style);
+	set_linewidth((double)l->thickness);
+	p = l->pts;
+	n = l->npts;
+	path.n = 0;
+	if (n == 1) {			/* a single point line */
+	    if (l->cap_style > 0)
+		hf_wid = 1.0;
+	    else if (l->thickness <= THICK_SCALE)
+		hf_wid = l->thickness/4.0;
+	    else
+		hf_wid = (l->thickness-THICK_SCALE)/2.0;
+	    path_move((double) round(p->x-hf_wid), (double) p->y);
+	    path_line((double) round(p->x+hf_wid), (double) p->y);
+	    stroke_path(l->pen_color);
+	    return;
+	}
+	set_style(l->style, l->style_val);
+
+	xmin = xmax = p->x;
+	ymin = ymax = p->y;
+	for (i = 1; i < n; i++) {
+	    if (xmin > p[i].x)
+		xmin = p[i].x;
+	    else if (xmax < p[i].x)
+		xmax = p[i].x;
+	    if (ymin > p[i].y)
+		ymin = p[i].y;
+	    else if (ymax < p[i].y)
+		ymax = p[i].y;
+	}
+
+	clipped = False;
+	if (l->type == T_ARC_BOX) {
+	    radius = l->radius;
+	    if ((xmax - xmin) / 2 < radius)
+		radius = (xmax - xmin) / 2;
+	    if ((ymax - ymin) / 2 < radius)
+		radius = (ymax - ymin) / 2;
+	    /* quarter circles in the corners, the way arcto goes round */
+	    k = radius * (1.0 - 0.5522847);
+	    path_move((double) xmin+radius, (double) ymin);
+	    path_curve(xmin+k, (double) ymin, (double) xmin, ymin+k,
+			(double) xmin, (double) ymin+radius);
+	    path_line((double) xmin, (double) ymax-radius);
+	    path_curve((double) xmin, ymax-k, xmin+k, (double) ymax,
+			(double) xmin+radius, (double) ymax);
+	    path_line((double) xmax-radius, (double) ymax);
+	    path_curve(xmax-k, (double) ymax, (double) xmax, ymax-k,
+			(double) xmax, (double) ymax-radius);
+	    path_line((double) xmax, (double) ymin+radius);
+	    path_curve((double) xmax, ymin+k, xmax-k, (double) ymin,
+			(double) xmax-radius, (double) ymin);
+	    bprintf(&path, "h\n");
+	} else {
+	    fx1 = p[0].x;	fy1 = p[0].y;
+	    fx2 = p[1].x;	fy2 = p[1].y;
+	    lx2 = p[n-2].x;	ly2 = p[n-2].y;
+	    lx1 = p[n-1].x;	ly1 = p[n-1].y;
+	    if (l->type == T_POLYLINE && (l->for_arrow || l->back_arrow)) {
+		clip_arrows(l, O_POLYLINE);
+		clipped = True;
+	    }
+	    path_move((double) p->x, (double) p->y);
+	    for (i = 1; i < n-1; i++)
+		path_line((double) p[i].x, (double) p[i].y);
+	    if (l->type == T_POLYLINE) {
+		path_line((double) p[n-1].x, (double) p[n-1].y);
+		/* endpoints are coincident, close path so that line join is used */
+		if (fx1 == lx1 && fy1 == ly1)
+		    bprintf(&path, "h\n");
+	    } else {
+		bprintf(&path, "h\n");	/* polygon, close path */
+	    }
+	}
+
+	if (l->fill_style != UNFILLED)
+	    fill_path(l->fill_style, l->pen_color, l->fill_color);
+	if (l->thickness > 0)
+	    stroke_path(l->pen_color);
+	if (clipped)
+	    bprintf(&content, "Q\n");
+	reset_style();
+
+	if (l->back_arrow && l->thickness > 0)
+	    draw_arrow(l->back_arrow, bpts, nbpts, bfillpts, nbfillpts, l->pen_color);
+	if (l->for_arrow && l->thickness > 0)
+	    draw_arrow(l->for_arrow, fpts, nfpts, ffillpts, nffillpts, l->pen_color);
+}
+
+void
+genpdf_spline(s)
+F_spline	*s;
+{
+	F_point		*p, *q;
+	F_control	*a, *b;
+	double		 x1, y1, x2, y2, x3, y3, c, d, sa, sb;
+	Boolean		 clipped;
+
+	if (use_gs) {
+	    genps_spline(s);
+	    return;
+	}
+	if (closed_spline(s)) {
+	    if (s->style == DOTTED_LINE)
+		set_linecap(1);		/* round dots for dotted line */
+	} else {
+	    set_linecap(s->cap_style);	/* open splines can explicitely set capstyle */
+	}
+	set_linewidth((double)s->thickness);
+	set_style(s->style, s->style_val);
+	path.n = 0;
+	clipped = False;
+
+	if (int_spline(s)) {
+	    a = b = s->controls;
+	    p = s->points;
+	    fx1 = p->x;
+	    fy1 = p->y;
+	    fx2 = round(a->rx);
+	    fy2 = round(a->ry);
+	    for (q = p->next; q != NULL; p = q, q = q->next)
+		a = b = a->next;
+	    lx2 = round(b->lx);
+	    ly2 = round(b->ly);
+	    lx1 = p->x;
+	    ly1 = p->y;
+	    if (s->for_arrow || s->back_arrow) {
+		clip_arrows(s, O_SPLINE);
+		clipped = True;
+	    }
+	    a = s->controls;
+	    p = s->points;
+	    path_move((double) p->x, (double) p->y);
+	    for (q = p->next; q != NULL; p = q, q = q->next) {
+		b = a->next;
+		path_curve(a->rx, a->ry, b->lx, b->ly, (double) q->x, (double) q->y);
+		a = b;
+	    }
+	    if (closed_spline(s))
+		bprintf(&path, "h\n");
+	} else {
+	    /* find the first two and the last two points for the arrows */
+	    p = s->points;
+	    x1 = p->x;
+	    y1 = p->y;
+	    p = p->next;
+	    c = p->x;
+	    d = p->y;
+	    x3 = (x1 + c) / 2;
+	    y3 = (y1 + d) / 2;
+	    fx1 = round(x1);
+	    fy1 = round(y1);
+	    fx2 = round(x3);
+	    fy2 = round(y3);
+	    x2 = x1;
+	    y2 = y1;
+	    for (q = p->next; q != NULL; p = q, q = q->next) {
+		x2 = c;
+		y2 = d;
+		c = q->x;
+		d = q->y;
+	    }
+	    lx2 = round(x2);
+	    ly2 = round(y2);
+	    lx1 = round(c);
+	    ly1 = round(d);
+	    if (s->for_arrow || s->back_arrow) {
+		clip_arrows(s, O_SPLINE);
+		clipped = True;
+	    }
+
+	    /* the sections of genps' DrawSplineSection: control points
+	       2/3 of the way to the middle point */
+	    p = s->points;
+	    x1 = p->x;
+	    y1 = p->y;
+	    p = p->next;
+	    c = p->x;
+	    d = p->y;
+	    x3 = sa = (x1 + c) / 2;
+	    y3 = sb = (y1 + d) / 2;
+	    if (closed_spline(s)) {
+		path_move(sa, sb);
+	    } else {
+		path_move(x1, y1);
+		path_line(x3, y3);
+	    }
+	    for (q = p->next; q != NULL; p = q, q = q->next) {
+		x1 = x3;
+		y1 = y3;
+		x2 = c;
+		y2 = d;
+		c = q->x;
+		d = q->y;
+		x3 = (x2 + c) / 2;
+		y3 = (y2 + d) / 2;
+		path_line(x1, y1);
+		path_curve(x1 + (x2-x1)*0.666667, y1 + (y2-y1)*0.666667,
+			x3 + (x2-x3)*0.666667, y3 + (y2-y3)*0.666667, x3, y3);
+	    }
+	    if (closed_spline(s)) {
+		path_line(x3, y3);
+		path_curve(x3 + (c-x3)*0.666667, y3 + (d-y3)*0.666667,
+			sa + (c-sa)*0.666667, sb + (d-sb)*0.666667, sa, sb);
+		bprintf(&path, "h\n");
+	    } else {
+		path_line(c, d);
+	    }
+	}
+
+	if (s->fill_style != UNFILLED)
+	    fill_path(s->fill_style, s->pen_color, s->fill_color);
+	if (s->thickness > 0)
+	    stroke_path(s->pen_color);
+	if (clipped)
+	    bprintf(&content, "Q\n");
+	reset_style();
+
+	if (s->back_arrow && s->thickness > 0)
+	    draw_arrow(s->back_arrow, bpts, nbpts, bfillpts, nbfillpts, s->pen_color);
+	if (s->for_arrow && s->thickness > 0)
+	    draw_arrow(s->for_arrow, fpts, nfpts, ffillpts, nffillpts, s->pen_color);
+}
+
+void
+genpdf_arc(a)
+F_arc	*a;
+{
+	double		angle1, angle2, dx, dy, radius;
+	double		cx, cy, sx, sy, ex, ey;
+	Boolean		clipped;
+
+	if (use_gs) {
+	    genps_arc(a);
+	    return;
+	}
+	cx = a->center.x; cy = a->center.y;
+	sx = a->point[0].x; sy = a->point[0].y;
+	ex = a->point[2].x; ey = a->point[2].y;
+
+	set_linewidth((double)a->thickness);
+	set_linecap(a->cap_style);
+	dx = cx - sx;
+	dy = cy - sy;
+	radius = sqrt(dx*dx+dy*dy);
+	if (cx==sx)
+	    angle1 = (sy-cy > 0? 90.0: -90.0);
+	else
+	    angle1 = atan2(sy-cy, sx-cx) * 180.0 / M_PI;
+	if (cx==ex)
+	    angle2 = (ey-cy > 0? 90.0: -90.0);
+	else
+	    angle2 = atan2(ey-cy, ex-cx) * 180.0 / M_PI;
+
+	/* workaround for arcs with start point = end point; make angles slightly different */
+	if (fabs(angle1 - angle2) < 0.001)
+	    angle2 = angle1 + 0.01;
+	/* direction = 1 -> Counterclockwise, that is arcn in the y-down space */
+	if (a->direction == 1) {
+	    while (angle2 > angle1)
+		angle2 -= 360.0;
+	} else {
+	    while (angle2 < angle1)
+		angle2 += 360.0;
+	}
+
+	clipped = False;
+	if (a->type == T_OPEN_ARC && a->thickness != 0 &&
+		(a->back_arrow || a->for_arrow)) {
+	    clip_arrows(a, O_ARC);
+	    clipped = True;
+	}
+	set_style(a->style, a->style_val);
+
+	path.n = 0;
+	arc_to(&path, cx, cy, radius, radius, 0.0, angle1, angle2, True);
+	if (a->type == T_PIE_WEDGE_ARC) {
+	    path_line(cx, cy);
+	    path_line(sx, sy);
+	}
+	if (a->fill_style != UNFILLED)
+	    fill_path(a->fill_style, a->pen_color, a->fill_color);
+	if (a->thickness > 0)
+	    stroke_path(a->pen_color);
+	if (clipped)
+	    bprintf(&content, "Q\n");
+	reset_style();
+
+	if (a->type == T_OPEN_ARC) {
+	    if (a->back_arrow && a->thickness > 0)
+		draw_arrow(a->back_arrow, bpts, nbpts, bfillpts, nbfillpts, a->pen_color);
+	    if (a->for_arrow && a->thickness > 0)
+		draw_arrow(a->for_arrow, fpts, nfpts, ffillpts, nffillpts, a->pen_color);
+	}
+}
+
+void
+genpdf_ellipse(e)
+F_ellipse	*e;
+{
+	if (use_gs) {
+	    genps_ellipse(e);
+	    return;
+	}
+	set_linewidth((double)e->thickness);
+	set_style(e->style, e->style_val);
+	if (e->style == DOTTED_LINE)
+	    set_linecap(1);	/* round dots */
+	path.n = 0;
+	arc_to(&path, (double) e->center.x, (double) e->center.y,
+		(double) e->radiuses.x, (double) e->radiuses.y,
+		(double) -e->angle, 0.0, 360.0, True);
+	bprintf(&path, "h\n");
+	if (e->fill_style != UNFILLED)
+	    fill_path(e->fill_style, e->pen_color, e->fill_color);
+	if (e->thickness > 0)
+	    stroke_path(e->pen_color);
+	reset_style();
+}
+
+/*
+ * The nearest of the standard 14 fonts for a PostScript font name, with
+ * the horizontal scaling (percent) for the narrow ones.
+ */
+
+static int
+std_font(name, hscale)
+    char	*name;
+    int		*hscale;
+{
+	int	 font;
+
+	*hscale = 100;
+	if (strcmp(name, "Symbol") == 0)
+	    return 12;
+	if (strcmp(name, "ZapfDingbats") == 0)
+	    return 13;
+	if (strncmp(name, "Courier", 7) == 0)
+	    font = 8;
+	else if (strncmp(name, "Helvetica", 9) == 0 || strncmp(name, "AvantGarde", 10) == 0)
+	    font = 4;
+	else
+	    font = 0;
+	if (strncmp(name, "Helvetica-Narrow", 16) == 0)
+	    *hscale = 82;
+	if (strstr(name, "Bold") || strstr(name, "Demi"))
+	    font += 1;
+	if (strstr(name, "Italic") || strstr(name, "Oblique"))
+	    font += 2;
+	return font;
+}
+
+void
+genpdf_text(t)
+F_text	*t;
+{
+	char	*name;
+	double	 size, c, s, dx;
+	int	 font, hscale;
+
+	if (use_gs) {
+	    genps_text(t);
+	    return;
+	}
+	/* ignore hidden text (new for xfig3.2.3/fig2dev3.2.3) */
+	if (hidden_text(t) || *t->cstring == '\0')
+	    return;
+
+	name = PSFONT(t);
+	font = std_font(name, &hscale);
+	if (strcmp(name, std_fonts[font]) != 0 && strncmp(name, "Helvetica-Narrow", 16) != 0
+		&& t->font+1 >= 0 && t->font+1 < MAX_PSFONT+2
+		&& subst_warned[t->font+1] != name) {
+	    fprintf(stderr, "fig2dev: font %s is not one of the standard PDF fonts, using %s\n",
+			name, std_fonts[font]);
+	    subst_warned[t->font+1] = name;
+	}
+	if (font_obj[font] == 0)
+	    font_obj[font] = new_obj();
+	size = PSFONTMAG(t);
+
+	/* the text goes along (cos, -sin) in the y-down space */
+	c = cos((double) t->angle);
+	s = sin((double) t->angle);
+	if (t->type == T_CENTER_JUSTIFIED)
+	    dx = t->length / 2.0;
+	else if (t->type == T_RIGHT_JUSTIFIED)
+	    dx = t->length;
+	else
+	    dx = 0.0;
+
+	set_color(t->color, False);
+	if (hscale != cur_hscale) {
+	    cur_hscale = hscale;
+	    bprintf(&content, "%d Tz\n", hscale);
+	}
+	bprintf(&content, "BT /F%d %s Tf %.4f %.4f %.4f %.4f %s %s Tm\n",
+		font, num(size), c, -s, -s, -c,
+		num(t->base_x - dx*c), num(t->base_y + dx*s));
+	string_to(&content, (unsigned char *) t->cstring);
+	bprintf(&content, " Tj ET\n");
+}
+
+/*
+ * Arrowheads, as in genps.c.  clip_arrows() starts a "q" with a clipping
+ * path that is the whole page minus the arrowheads; the caller ends it.
+ */
+
+static void
+clip_arrows(obj, objtype)
+    F_line	*obj;
+    int		 objtype;
+{
+	int	 i;
+
+	bprintf(&content, "q\n%s %s %s %s re\n",
+		num(fllx/scalex), num((fury - pageh)/scaley),
+		num(pagew/scalex), num(pageh/scaley));
+	if (obj->for_arrow) {
+	    if (objtype == O_ARC) {
+		F_arc  *a = (F_arc *) obj;
+		lx1 = a->point[2].x;
+		ly1 = a->point[2].y;
+		compute_arcarrow_angle(a->center.x, a->center.y,
+				(double) lx1, (double) ly1,
+				a->direction, a->for_arrow, &lx2, &ly2);
+	    }
+	    calc_arrow(lx2, ly2, lx1, ly1, obj->thickness, obj->for_arrow,
+			fpts, &nfpts, ffillpts, &nffillpts, clippts, &nclippts);
+	    for (i = nclippts-1; i >= 0; i--)
+		bprintf(&content, "%d %d %s\n", clippts[i].x, clippts[i].y,
+				i == nclippts-1? "m": "l");
+	    bprintf(&content, "h\n");
+	}
+	if (obj->back_arrow) {
+	    if (objtype == O_ARC) {
+		F_arc  *a = (F_arc *) obj;
+		fx1 = a->point[0].x;
+		fy1 = a->point[0].y;
+		compute_arcarrow_angle(a->center.x, a->center.y,
+				(double) fx1, (double) fy1,
+				a->direction ^ 1, a->back_arrow, &fx2, &fy2);
+	    }
+	    calc_arrow(fx2, fy2, fx1, fy1, obj->thickness, obj->back_arrow,
+			bpts, &nbpts, bfillpts, &nbfillpts, clippts, &nclippts);
+	    for (i = nclippts-1; i >= 0; i--)
+		bprintf(&content, "%d %d %s\n", clippts[i].x, clippts[i].y,
+				i == nclippts-1? "m": "l");
+	    bprintf(&content, "h\n");
+	}
+	bprintf(&content, "W* n\n");
+}
+
+static void
+draw_arrow(arrow, points, npoints, fillpoints, nfillpoints, col)
+    F_arrow	*arrow;
+    Point	*points, *fillpoints;
+    int		 npoints, nfillpoints;
+    int		 col;
+{
+	int	 i, type;
+
+	set_linecap(0);			/* butt line cap for arrowheads */
+	set_linejoin(0);		/* miter join for sharp points */
+	set_linewidth(arrow->thickness);
+	path.n = 0;
+	for (i = 0; i < npoints; i++)
+	    bprintf(&path, "%d %d %s\n", points[i].x, points[i].y, i == 0? "m": "l");
+
+	type = arrow->type;
+	if (type != 0 && type != 6 && type < 13)	/* old heads, close the path */
+	    bprintf(&path, "h\n");
+	if (type == 0) {
+	    stroke_path(col);
+	} else if (arrow->style == 0 && nfillpoints == 0) {
+	    /* hollow, fill with white */
+	    fill_path(NUMSHADES-1, WHITE_COLOR, WHITE_COLOR);
+	    stroke_path(col);
+	} else if (nfillpoints == 0) {
+	    if (type < 13) {
+		if (arrow->style == 0)
+		    fill_path(NUMSHADES-1, WHITE_COLOR, WHITE_COLOR);
+		else
+		    fill_path(NUMSHADES-1, col, col);
+	    }
+	    stroke_path(col);
+	} else {
+	    /* special fill, first fill whole head with white */
+	    fill_path(NUMSHADES-1, WHITE_COLOR, WHITE_COLOR);
+	    stroke_path(col);
+	    path.n = 0;
+	    for (i = 0; i < nfillpoints; i++)
+		bprintf(&path, "%d %d %s\n", fillpoints[i].x, fillpoints[i].y,
+				i == 0? "m": "l");
+	    fill_path(NUMSHADES-1, col, col);
+	}
+}
+
+/*
+ * Pictures
+ */
+
+/* whether the figure has pictures that only ghostscript can put in */
+
+static Boolean
+eps_picture_exist(ob)
+F_compound	*ob;
+{
+	F_compound	*c;
+	F_line		*l;
+	char		 buf[4];
+	int		 n;
+
+	/* (a picture is only opened for this the first time it is seen) */
+	for (l = ob->lines; l != NULL; l = l->next) {
+	    if (l->type != T_PIC_BOX || l->pic == NULL)
+		continue;
+	    n = picture_head(l->pic->file, buf, 4);
+	    if ((n >= 2 && buf[0] == '%' && (buf[1] == '!' || buf[1] == 'P')) ||
+		    (n == 4 && !memcmp(buf, "\305\320\323\306", 4)))	/* DOS EPS */
+		return True;
+	}
+	for (c = ob->compounds; c != NULL; c = c->next)
+	    if (eps_picture_exist(c))
+		return True;
+	return False;
+}
+
+static int
+add_image(n)
+    int		 n;
+{
+	image_obj = (int *) grow((char *) image_obj, &maximages, nimages+1, sizeof(int));
+	image_obj[nimages++] = n;
+	return nimages;
+}
+
+static int
+image_xobject(dictstr, data, len, deflate)
+    char	*dictstr, *data;
+    long	 len;
+    Boolean	 deflate;
+{
+	int	 n;
+
+	n = new_obj();
+	write_stream(n, dictstr, data, len, deflate);
+	return add_image(n);
+}
+
+/*
+ * Copy the (uncompressed) file of a picture into a stream object as it is,
+ * a buffer at a time, from the stream read_picture() read its header from.
+ * The length goes into an object of its own after the stream, so that the
+ * file needn't be read twice.
+ */
+
+static int
+copy_xobject(dictstr, pic)
+    char	*dictstr;
+    F_pic	*pic;
+{
+	FILE	*picf;
+	char	 buf[BUFSIZ];
+	long	 start;
+	int	 n, len_obj, type;
+	size_t	 k;
+
+	if ((picf = picture_data(pic, &type)) == NULL)
+	    return 0;
+	n = new_obj();
+	len_obj = new_obj();
+	begin_obj(n);
+	pdf_printf("<< %s /Length %d 0 R >>\nstream\n", dictstr, len_obj);
+	start = filepos;
+	while ((k = fread(buf, 1, sizeof(buf), picf)) > 0)
+	    pdf_write(buf, (long) k);
+	close_picfile(picf, type);
+	start = filepos - start;
+	pdf_printf("\nendstream\nendobj\n");
+	begin_obj(len_obj);
+	pdf_printf("%ld\nendobj\n", start);
+	return add_image(n);
+}
+
+/*
+ * Write the image XObject of a picture and return its number, 0 if it
+ * can't be put into the PDF.
+ */
+
+static int
+picture_xobject(pic)
+    F_pic	*pic;
+{
+	unsigned char	*bits, *data, *d;
+	int		 pllx, plly, img_w, img_h, ncols;
+	int		 i, im, comps, bpc;
+	Boolean		 adobe;
+	unsigned int	*xpmdata = NULL;
+
+	if (read_picture(pic, &pllx, &plly) == 0)
+	    return 0;
+
+	img_w = pic->bit_size.x;
+	img_h = pic->bit_size.y;
+	ncols = pic->numcols;
+	bits = pic->bitmap;
+#ifdef USE_XPM
+	if (pic->subtype == P_XPM) {
+	    img_w = pic->xpmimage.width;
+	    img_h = pic->xpmimage.height;
+	    ncols = pic->xpmimage.ncolors;
+	    convert_xpm_colors(pic->cmap, pic->xpmimage.colorTable, ncols);
+	    xpmdata = pic->xpmimage.data;
+	}
+#endif /* USE_XPM */
+	if (img_w <= 0 || img_h <= 0)
+	    return 0;
+
+	dict.n = 0;
+	im = 0;
+	switch (pic->subtype) {
+	  case P_XBM:
+	    /* set bits are painted in the pen color */
+	    bprintf(&dict, "/Type /XObject /Subtype /Image /Width %d /Height %d "
+			"/ImageMask true /BitsPerComponent 1 /Decode [1 0]",
+			img_w, img_h);
+	    im = image_xobject(dict.s, (char *) bits, (long) ((img_w+7)/8) * img_h, True);
+	    break;
+
+	  case P_JPEG:
+	    /* the DCT data goes in as it is */
+	    comps = JPEGcomponents(&bpc, &adobe);
+	    bprintf(&dict, "/Type /XObject /Subtype /Image /Width %d /Height %d "
+			"/ColorSpace /Device%s /BitsPerComponent %d /Filter /DCTDecode",
+			img_w, img_h, comps == 1? "Gray": comps == 4? "CMYK": "RGB", bpc);
+	    if (adobe && comps == 4)
+		bprintf(&dict, " /Decode [1 0 1 0 1 0 1 0]");
+	    if ((im = copy_xobject(dict.s, pic)) == 0) {
+		fprintf(stderr, "Unable to read JPEG file '%s'\n", pic->file);
+		return 0;
+	    }
+	    break;
+
+	  case P_XPM:
+	  case P_GIF:
+	  case P_PCX:
+	  case P_PNG:
+	  case P_PPM:
+	  case P_TIF:
+	    if (ncols > 256 && xpmdata == NULL) {
+		/* 24-bit images are stored blue, green, red */
+		if ((data = (unsigned char *) malloc(3 * img_w * img_h)) == NULL) {
+		    put_msg(Err_mem);
+		    return 0;
+		}
+		for (i = 0, d = data; i < img_w * img_h; i++, d += 3) {
+		    d[0] = bits[3*i+2];
+		    d[1] = bits[3*i+1];
+		    d[2] = bits[3*i];
+		    if (grayonly)
+			d[0] = d[1] = d[2] = (unsigned char) (255.0 *
+			    rgb2luminance(d[0]/255.0, d[1]/255.0, d[2]/255.0));
+		}
+		bprintf(&dict, "/Type /XObject /Subtype /Image /Width %d /Height %d "
+			"/ColorSpace /DeviceRGB /BitsPerComponent 8", img_w, img_h);
+		im = image_xobject(dict.s, (char *) data, 3L * img_w * img_h, True);
+		free(data);
+		break;
+	    }
+	    if (ncols > 256)
+		ncols = 256;
+	    if (ncols < 1)
+		ncols = 1;
+	    if (xpmdata) {
+		if ((data = (unsigned char *) malloc(img_w * img_h)) == NULL) {
+		    put_msg(Err_mem);
+		    return 0;
+		}
+		for (i = 0; i < img_w * img_h; i++)
+		    data[i] = (unsigned char) xpmdata[i];
+		bits = data;
+	    }
+	    bprintf(&dict, "/Type /XObject /Subtype /Image /Width %d /Height %d "
+			"/ColorSpace [/Indexed /DeviceRGB %d <", img_w, img_h, ncols-1);
+	    for (i = 0; i < ncols; i++) {
+		if (grayonly) {
+		    int	 g = (int) (255.0 * rgb2luminance(pic->cmap[RED][i]/255.0,
+				pic->cmap[GREEN][i]/255.0, pic->cmap[BLUE][i]/255.0));
+		    bprintf(&dict, "%02x%02x%02x", g, g, g);
+		} else {
+		    bprintf(&dict, "%02x%02x%02x", pic->cmap[RED][i],
+				pic->cmap[GREEN][i], pic->cmap[BLUE][i]);
+		}
+		if (i % 16 == 15)
+		    bprintf(&dict, "\n");
+	    }
+	    bprintf(&dict, ">] /BitsPerComponent 8");
+	    if (pic->transp >= 0 && pic->transp < ncols)
+		bprintf(&dict, " /Mask [%d %d]", pic->transp, pic->transp);
+	    im = image_xobject(dict.s, (char *) bits, (long) img_w * img_h, True);
+	    if (xpmdata)
+		free(bits);
+	    break;
+
+	  default:
+	    fprintf(stderr, "fig2dev: %s: this picture can't be put into the PDF\n",
+			pic->file);
+	    return 0;
+	}
+#ifdef USE_XPM
+	if (pic->subtype == P_XPM)
+	    XpmFreeXpmImage(&pic->xpmimage);
+#endif /* USE_XPM */
+	return im;
+}
+
+/* draw a picture; the XObject of a picture file is only written once */
+
+static void
+draw_picture(l)
+    F_line	*l;
+{
+	F_pic		*pic = l->pic;
+	F_pos		*p = l->pts;
+	double		 u[3], v[3], w, h, t;
+	int		 xmin, ymin, xmax, ymax, dx, dy, rotation;
+	int		 i, im;
+
+	if ((im = picture_mark(pic->file)) == 0) {
+	    if ((im = picture_xobject(pic)) == 0)
+		return;
+	    set_picture_mark(pic->file, im);
+	} else {
+	    /* only the kind of picture is needed from the file */
+	    pic->subtype = picture_subtype(pic->file);
+	}
+
+	xmin = xmax = p[0].x;
+	ymin = ymax = p[0].y;
+	for (i = 1; i < l->npts; i++) {
+	    if (p[i].x < xmin) xmin = p[i].x;
+	    if (p[i].x > xmax) xmax = p[i].x;
+	    if (p[i].y < ymin) ymin = p[i].y;
+	    if (p[i].y > ymax) ymax = p[i].y;
+	}
+	dx = p[2].x - p[0].x;
+	dy = p[2].y - p[0].y;
+	rotation = 0;
+	if (dx < 0 && dy < 0)
+	    rotation = 180;
+	else if (dx < 0 && dy >= 0)
+	    rotation = 90;
+	else if (dy < 0 && dx >= 0)
+	    rotation = 270;
+
+	/*
+	 * Map the image square, (0,0) at the bottom left of the image, onto
+	 * the box.  u and v are the coefficients (constant, s, t) of the
+	 * box coordinates (0..1 from the top left) for image point (s,t);
+	 * the top left corner of the image is at the first point.
+	 */
+	{
+	    double	 pu[3], pv[3];
+
+	    pu[0] = 0.0; pu[1] = 1.0; pu[2] = 0.0;	/* across:  s */
+	    pv[0] = 1.0; pv[1] = 0.0; pv[2] = -1.0;	/* down:  1-t */
+	    if (pic->flipped)
+		for (i = 0; i < 3; i++) {
+		    t = pu[i]; pu[i] = pv[i]; pv[i] = t;
+		}
+	    for (i = 0; i < 3; i++) {
+		switch (rotation) {
+		  case 90:
+		    u[i] = -pv[i]; v[i] = pu[i]; break;
+		  case 180:
+		    u[i] = -pu[i]; v[i] = -pv[i]; break;
+		  case 270:
+		    u[i] = pv[i]; v[i] = -pu[i]; break;
+		  default:
+		    u[i] = pu[i]; v[i] = pv[i]; break;
+		}
+	    }
+	    if (rotation == 90)
+		u[0] += 1.0;
+	    else if (rotation == 180) {
+		u[0] += 1.0; v[0] += 1.0;
+	    } else if (rotation == 270)
+		v[0] += 1.0;
+	}
+	w = xmax - xmin;
+	h = ymax - ymin;
+	bprintf(&content, "q\n");
+	if (pic->subtype == P_XBM)
+	    set_color(l->pen_color, False);
+	bprintf(&content, "%s %s %s %s %s %s cm /Im%d Do\nQ\n",
+		num(w*u[1]), num(h*v[1]), num(w*u[2]), num(h*v[2]),
+		num(xmin + w*u[0]), num(ymin + h*v[0]), im);
+}
+
+/*
+ * The end: write the content, the resources and the cross-reference table
+ */
+
+static int
+genpdf_gs_end()
 {
 	int	 status;
 
@@ -88,17 +1649,157 @@ genpdf_end()
 	return 0;
 }
 
+static void
+write_pattern(n, pat)
+    int		 n, pat;
+{
+	char	*s, *e;
+	double	 cx, cy, r, a1, a2;
+
+	path.n = 0;
+	for (s = pdf_patterns[pat].proc; *s; s = e) {
+	    if ((e = strchr(s, '\n')) == NULL)
+		e = s + strlen(s);
+	    else
+		e++;
+	    if (e - s > 4 && strncmp(e - 4, "arc\n", 4) == 0 &&
+		    sscanf(s, "%lf %lf %lf %lf %lf", &cx, &cy, &r, &a1, &a2) == 5)
+		arc_to(&path, cx, cy, r, r, 0.0, a1, a2, True);
+	    else
+		bprintf(&path, "%.*s", (int) (e - s), s);
+	}
+	dict.n = 0;
+	bprintf(&dict, "/Type /Pattern /PatternType 1 /PaintType 2 /TilingType 2\n"
+		"/BBox [%s %s %s %s] /XStep %d /YStep %d /Resources << >>",
+		num(pdf_patterns[pat].bbox[0]), num(pdf_patterns[pat].bbox[1]),
+		num(pdf_patterns[pat].bbox[2]), num(pdf_patterns[pat].bbox[3]),
+		pdf_patterns[pat].xstep, pdf_patterns[pat].ystep);
+	write_stream(n, dict.s, path.s, (long) path.n, False);
+}
+
+int
+genpdf_end()
+{
+	struct passwd	*who;
+	time_t		 when;
+	char		 date[40];
+	long		 xref;
+	int		 i;
+	Boolean		 any;
+
+	if (use_gs)
+	    return genpdf_gs_end();
+
+	/* back to the real output */
+	if (tfp)
+	    fclose(tfp);
+	tfp = pdffile;
+
+	write_stream(CONTENT_OBJ, "", content.s, (long) content.n, True);
+
+	for (i = 0; i < NUM_STD_FONTS; i++) {
+	    if (font_obj[i] == 0)
+		continue;
+	    begin_obj(font_obj[i]);
+	    pdf_printf("<< /Type /Font /Subtype /Type1 /BaseFont /%s", std_fonts[i]);
+	    if (i < 12) {
+		/* ISO Latin-1 text, with the quotes of the standard encoding */
+		if (encoding_obj == 0)
+		    encoding_obj = new_obj();
+		pdf_printf(" /Encoding %d 0 R", encoding_obj);
+	    }
+	    pdf_printf(" >>\nendobj\n");
+	}
+	if (encoding_obj) {
+	    begin_obj(encoding_obj);
+	    pdf_printf("<< /Type /Encoding /BaseEncoding /WinAnsiEncoding\n"
+		"/Differences [39 /quoteright 96 /quoteleft 128 /grave /acute /circumflex\n"
+		"/tilde /macron /breve /dotaccent /dieresis /ring /cedilla /hungarumlaut\n"
+		"/ogonek /caron 144 /dotlessi 152 /oe /OE] >>\nendobj\n");
+	}
+	for (i = 0; i < NUMPATTERNS; i++)
+	    if (pattern_obj[i])
+		write_pattern(pattern_obj[i], i);
+
+	/* the page and its resources */
+	begin_obj(PAGE_OBJ);
+	pdf_printf("<< /Type /Page /Parent %d 0 R /MediaBox [0 0 %d %d]\n",
+			PAGES_OBJ, pagew, pageh);
+	pdf_printf("/Resources << /ProcSet [/PDF /Text /ImageB /ImageC /ImageI]\n");
+	for (any = False, i = 0; i < NUM_STD_FONTS; i++)
+	    if (font_obj[i]) {
+		pdf_printf("%s/F%d %d 0 R", any? " ": "/Font << ", i, font_obj[i]);
+		any = True;
+	    }
+	if (any)
+	    pdf_printf(" >>\n");
+	for (any = False, i = 0; i < NUMPATTERNS; i++)
+	    if (pattern_obj[i]) {
+		pdf_printf("%s/P%d %d 0 R", any? " ": "/Pattern << ", i+1, pattern_obj[i]);
+		any = True;
+	    }
+	if (any)
+	    pdf_printf(" >>\n/ColorSpace << /PatRGB [/Pattern /DeviceRGB] "
+			"/PatGray [/Pattern /DeviceGray] >>\n");
+	for (i = 0; i < nimages; i++)
+	    pdf_printf("%s/Im%d %d 0 R", i? " ": "/XObject << ", i+1, image_obj[i]);
+	if (nimages)
+	    pdf_printf(" >>\n");
+	pdf_printf(">>\n/Contents %d 0 R >>\nendobj\n", CONTENT_OBJ);
+
+	begin_obj(PAGES_OBJ);
+	pdf_printf("<< /Type /Pages /Kids [%d 0 R] /Count 1 >>\nendobj\n", PAGE_OBJ);
+	begin_obj(CATALOG_OBJ);
+	pdf_printf("<< /Type /Catalog /Pages %d 0 R >>\nendobj\n", PAGES_OBJ);
+
+	begin_obj(INFO_OBJ);
+	dict.n = 0;
+	bprintf(&dict, "<< /Title ");
+	string_to(&dict, (unsigned char *) (name? name: (from? from: "stdin")));
+	bprintf(&dict, "\n/Creator ");
+	string_to(&dict, (unsigned char *) "fig2dev Version " VERSION " Patchlevel " PATCHLEVEL);
+	if (!anonymous && (who = getpwuid(getuid())) != NULL) {
+	    bprintf(&dict, "\n/Author ");
+	    string_to(&dict, (unsigned char *) who->pw_name);
+	}
+	(void) time(&when);
+	strftime(date, sizeof(date), "D:%Y%m%d%H%M%S", localtime(&when));
+	bprintf(&dict, "\n/CreationDate (%s) >>\nendobj\n", date);
+	pdf_write(dict.s, (long) dict.n);
+
+	xref = filepos;
+	pdf_printf("xref\n0 %d\n0000000000 65535 f \n", nobjs+1);
+	for (i = 1; i <= nobjs; i++)
+	    pdf_printf("%010ld 00000 n \n", offsets[i]);
+	pdf_printf("trailer\n<< /Size %d /Root %d 0 R /Info %d 0 R >>\n",
+			nobjs+1, CATALOG_OBJ, INFO_OBJ);
+	pdf_printf("startxref\n%ld\n%%%%EOF\n", xref);
+
+	return ferror(tfp)? -1: 0;
+}
+
+/* back to the defaults for the next figure of a batch */
+
+void
+genpdf_reset()
+{
+	genps_reset();
+	use_gs = False;
+	anonymous = False;
+	border_margin = 0;
+	psfontnames[0] = psfontnames[1] = "Times-Roman";
+}
+
 struct driver dev_pdf = {
   	genpdf_option,
 	genpdf_start,
-	genps_grid,
-	genps_arc,
-	genps_ellipse,
-	genps_line,
-	genps_spline,
-	genps_text,
+	genpdf_grid,
+	genpdf_arc,
+	genpdf_ellipse,
+	genpdf_line,
+	genpdf_spline,
+	genpdf_text,
 	genpdf_end,
-	INCLUDE_TEXT
+	INCLUDE_TEXT,
+	genpdf_reset
 };
-
-
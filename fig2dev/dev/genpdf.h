@@ -21,7 +21,14 @@
  *
  */
 
-extern void	genpdf_option();
+extern int	genpdf_option();
 extern void	genpdf_start();
 extern int	genpdf_end();
 
+extern void	genpdf_grid();
+extern void	genpdf_arc();
+extern void	genpdf_ellipse();
+extern void	genpdf_line();
+extern void	genpdf_spline();
+extern void	genpdf_text();
+extern void	genpdf_reset();
@@ -50,7 +50,7 @@ static int OptLineThick = 0;
 static int OptEllipseFill = 0;
 static int OptNoUnps = 0;    /* prohibit unpsfont() */
 
-void
+int
 genpic_option(opt, optarg)
 char opt, *optarg;
 {
@@ -98,13 +98,14 @@ char opt, *optarg;
 				  OptNoUnps = 1;
 			  else
 			    { fprintf(stderr, "Invalid option: %s\n", optarg);
-			      exit(1);
+			      return 1;
 			    }
 		break;
 	      default:
 		put_msg(Err_badarg, opt, "pic");
-		exit(1);
+		return 1;
 	}
+	return 0;
 }
 
 static
@@ -53,7 +53,7 @@ static char		*plotsymbol = "\\makebox(0,0)[l]{\\tencirc\\symbol{'160}}";
 static int		cur_thickness = -1;
 static Boolean		anonymous = False;
 
-static void
+static int
 genpictex_option(opt, optarg)
 char opt, *optarg;
 {
@@ -107,8 +107,9 @@ char opt, *optarg;
 
 	default:
 		put_msg(Err_badarg, opt, "pictex");
-		exit(1);
+		return 1;
 	}
+        return 0;
 }
 
 #define			TOP	10.5	/* top of page is 10.5 inch */
@@ -36,11 +36,15 @@
  *      splitting into layers.
 */
 
-#include <sys/stat.h>
 #include "fig2dev.h"
 #include "object.h"
 #include "bound.h"
 #include "psencode.h"
+#include "outbuf.h"
+#include "holdbuf.h"
+#include "genraster.h"
+#include "bitmapenc.h"
+#include "readpics.h"
 #include "psfonts.h"
 
 /* for the xpm package */
@@ -67,8 +71,8 @@ static Boolean enable_composite_font = False;
 #define         MAXDEPTH                999
 #define		min(a, b)		(((a) < (b)) ? (a) : (b))
 
-void		gen_ps_eps_option();
-void		putword(), append(), appendhex();
+int		gen_ps_eps_option();
+void		putword();
 
 static	FILE	*saveofile;
 Boolean		epsflag = False;	/* to distinguish PS and EPS */
@@ -76,8 +80,13 @@ Boolean		pdfflag = False;	/* to distinguish PDF and PS/EPS */
 Boolean		asciipreview = False;	/* add ASCII preview? */
 Boolean		tiffpreview = False;	/* add a TIFF preview? */
 Boolean		tiffcolor = False;	/* color or b/w TIFF preview */
-static char	tmpeps[PATH_MAX];	/* temp filename for eps when adding tiff preview */
-static char	tmpprev[PATH_MAX];	/* temp filename for ASCII or tiff preview */
+Boolean		gspreview = False;	/* make the preview with ghostscript? */
+int		pslevel = 2;		/* LanguageLevel; 3 deflates images */
+static Hold_buf	 epshold;		/* holds the eps while the preview is made */
+static F_compound *preview_objects;	/* the figure, to draw the preview */
+static void	 write_preview();
+static int	 gs_preview();
+static void	 write_dos_header();
 
 static Boolean	anonymous = False;
 int		pagewidth = -1;
@@ -90,6 +99,7 @@ static int	cur_joinstyle = 0;
 static int	cur_capstyle = 0;
 int		pages;
 int		no_obj = 0;
+static int	shared_images;		/* images defined once for all copies */
 static int	border_margin = 0;
 static float	fllx, flly, furx, fury;
 
@@ -118,9 +128,10 @@ static void	set_style();
 static void	reset_style();
 static void	set_linejoin();
 static void	set_linecap();
-static void	convert_xpm_colors();
+void		convert_xpm_colors();
 static void	genps_itp_spline();
 static void	genps_ctl_spline();
+static void	put_tenths();
 
 #define SHADEVAL(F)	1.0*(F)/(NUMSHADES-1)
 #define TINTVAL(F)	1.0*(F-NUMSHADES+1)/NUMTINTS
@@ -199,6 +210,7 @@ int	filtype;
 extern	int	read_gif();
 extern	int	read_pcx();
 extern	int	read_eps();
+extern	void	copy_eps();
 extern	int	read_pdf();
 extern	int	read_ppm();
 extern	int	read_tif();
@@ -221,17 +233,22 @@ static	 struct hdr {
 	    int		(*readfunc)();
 	    Boolean	pipeok;
 	}
-	headers[]= {    {"GIF", "GIF",		    3, read_gif,	False},
+	headers[]= {    {"GIF", "GIF",		    3, read_gif,	True},
 #ifdef V4_0
 			{"FIG", "#FIG",		    4, read_figure,	True},
 #endif /* V4_0 */
 			{"PCX", "\012\005\001",	    3, read_pcx,	True},
 			{"EPS", "%!",		    2, read_eps,	True},
+			{"EPS", "\305\320\323\306",  4, read_eps,	True},	/* DOS EPS */
 			{"PDF", "%PDF",		    4, read_pdf,	True},
+			{"PPM", "P1",		    2, read_ppm,	True},
+			{"PPM", "P2",		    2, read_ppm,	True},
 			{"PPM", "P3",		    2, read_ppm,	True},
+			{"PPM", "P4",		    2, read_ppm,	True},
+			{"PPM", "P5",		    2, read_ppm,	True},
 			{"PPM", "P6",		    2, read_ppm,	True},
-			{"TIFF", "II*\000",	    4, read_tif,	False},
-			{"TIFF", "MM\000*",	    4, read_tif,	False},
+			{"TIFF", "II*\000",	    4, read_tif,	True},
+			{"TIFF", "MM\000*",	    4, read_tif,	True},
 			{"XBM", "#define",	    7, read_xbm,	True},
 #ifdef USE_PNG
 			{"PNG", "\211\120\116\107\015\012\032\012", 8, read_png, True},
@@ -249,27 +266,27 @@ static	 struct hdr {
 /* various methods start here */
 /******************************/
 
-void
+int
 geneps_option(opt, optarg)
 char opt;
 char *optarg;
 {
 	epsflag = True;
 	pdfflag = False;
-	gen_ps_eps_option(opt, optarg);
+	return gen_ps_eps_option(opt, optarg);
 }
 
-void
+int
 genps_option(opt, optarg)
 char opt;
 char *optarg;
 {
 	epsflag = False;
 	pdfflag = False;
-	gen_ps_eps_option(opt, optarg);
+	return gen_ps_eps_option(opt, optarg);
 }
 
-void
+int
 gen_ps_eps_option(opt, optarg)
 char opt;
 char *optarg;
@@ -293,6 +310,8 @@ char *optarg;
 	      break;
 
 	  case 'A':			/* add ASCII preview */
+		if (tiffpreview)
+		    goto two_previews;
 		asciipreview = True;
 		break;
 
@@ -309,6 +328,8 @@ char *optarg;
 		break;
 
 	  case 'C':			/* add color TIFF preview (for MicroSloth) */
+		if (asciipreview)
+		    goto two_previews;
 		tiffpreview = True;
 		tiffcolor = True;
 		break;
@@ -395,10 +416,30 @@ char *optarg;
 		break;
 
 	  case 'T':			/* add monochrome TIFF preview (for MicroSloth) */
+		if (asciipreview)
+		    goto two_previews;
 		tiffpreview = True;
 		tiffcolor = False;
 		break;
 
+	  case 'U':			/* make the preview with ghostscript */
+		gspreview = True;
+		break;
+
+	  case 'Q':			/* PostScript LanguageLevel */
+		pslevel = atoi(optarg);
+		if (pslevel < 1 || pslevel > 3) {
+		    fprintf(stderr, "LanguageLevel must be 1, 2 or 3, using 2\n");
+		    pslevel = 2;
+		}
+#ifndef USE_PNG
+		if (pslevel == 3) {
+		    fprintf(stderr, "No zlib, can't compress images for LanguageLevel 3\n");
+		    pslevel = 2;
+		}
+#endif /* USE_PNG */
+		break;
+
 	  case 'x':			/* x offset on page */
 		if (!epsflag) {
 		    xoff = atoi(optarg);
@@ -420,8 +461,13 @@ char *optarg;
 
 	  default:
 		put_msg(Err_badarg, opt, "ps");
-		exit(1);
+		return 1;
 	}
+	return 0;
+
+    two_previews:
+	fprintf(stderr,"Only one type of preview allowed: -A or -T/-C\n");
+	return 1;
 }
 
 void
@@ -442,27 +488,21 @@ F_compound	*objects;
 	char		 filename[512], str[512];
 	FILE		*fp;
 
-	/* make sure user isn't asking for both TIFF and ASCII preview */
-	if (tiffpreview && asciipreview) {
-	    fprintf(stderr,"Only one type of preview allowed: -A or -T/-C\n");
-	    exit(1);
-	}
-
-	/* if the user wants a TIFF preview, route the eps file to a temporary one */
+	/* if the user wants a TIFF preview, hold the eps until its length is known */
+	preview_objects = objects;
 	if (tiffpreview) {
 	    saveofile = tfp;
-	    /* make name for temp output file */
-	    sprintf(tmpeps, "%s/xfig%06d.tmpeps", TMPDIR, getpid());
-	    if ((tfp = fopen(tmpeps, "w"))==0) {
-		fprintf(stderr,"Can't create temp file in %s\n",TMPDIR);
-		exit(1);
-	    }
+	    tfp = hold_open(&epshold, "the eps for the preview");
 	}
 
 	/* now that the file has been read, turn off multipage mode if eps output */
 	if (epsflag)
 	    multi_page = False;
 
+	/* see which pictures are there more than once */
+	count_picture_uses(objects);
+	shared_images = 0;
+
 	scalex = scaley = mag * POINT_PER_INCH / ppi;
 
 	/* this seems to work around Solaris' cc optimizer bug */
@@ -680,6 +720,9 @@ F_compound	*objects;
 					clipux-cliplx,clipuy-cliply);
 	}
 
+	if (pslevel == 3)
+	    fprintf(tfp, "%%%%LanguageLevel: 3\n");
+
 	/* put in the magnification for information purposes */
 	fprintf(tfp, "%%Magnification: %.4f\n",metric? mag*76.2/80.0 : mag);
 	fprintf(tfp, "%%%%EndComments\n");
@@ -702,15 +745,11 @@ F_compound	*objects;
 	    fprintf(tfp, "%%%%EndSetup\n");
 	}
 
-	/* if the user wants an ASCII preview, route the rest of the eps to a temp file */
+	/* if the user wants an ASCII preview, hold the rest of the eps until
+	   the preview has been put in after the header */
 	if (asciipreview) {
 	    saveofile = tfp;
-	    /* make name for temp output file */
-	    sprintf(tmpeps, "%s/xfig%06d.tmpeps", TMPDIR, getpid());
-	    if ((tfp = fopen(tmpeps, "w"))==0) {
-		fprintf(stderr,"Can't create temp file in %s\n",TMPDIR);
-		exit(1);
-	    }
+	    tfp = hold_open(&epshold, "the eps for the preview");
 	}
 
 	/* print any whole-figure comments prefixed with "%" */
@@ -983,9 +1022,6 @@ genps_end()
     double	dx, dy, mul;
     int		i, page;
     int		h, w;
-    int		epslen, tiflen;
-    int		status;
-    struct stat	fstat;
 
     /* for multipage, translate and output objects for each page */
     if (multi_page) {
@@ -1039,76 +1075,6 @@ genps_end()
 	fprintf(tfp, "showpage\n");
     }
 
-    /* does the user want an ASCII or TIFF preview? */
-    if (tiffpreview || asciipreview) {
-	/* must put a showpage so gs will produce output */
-	fprintf(tfp,"showpage\n");
-	/* close temp eps file */
-	fclose(tfp);
-	/* revert original file back to tfp */
-	tfp = saveofile;
-
-	/* make name for temp output file */
-	sprintf(tmpprev, "%s/xfig%06d.tmpprev", TMPDIR, getpid());
-	/* make the ghostscript command to generate the ASCII or TIFF file from the temp eps file */
-	sprintf(gscom, 
- 	    "gs -q -dBATCH -dSAFER -sDEVICE=%s -r72 -g%dx%d -sOutputFile=%s %s > /dev/null < /dev/null",
-		   asciipreview? "bit" : (tiffcolor? "tiff24nc": "tifflzw"),
-		   width, height, tmpprev, tmpeps);
-	if ((status=system(gscom)) != 0) {
-	    fprintf(stderr,"Error calling ghostscript: %s\n",gscom);
-	    fprintf(stderr,"No preview will be produced\n");
-	    /* append the eps */
-	    append(tmpeps, tfp);
-	    /* and cancel the preview */
-	    asciipreview = tiffpreview = False;
-	}
-	if (asciipreview) {
-	    width--;
-	    height--;
-	    /* now attach the preview after the prolog then attach the rest of the eps */
-	    fprintf(tfp, "%%%%BeginPreview: %d %d %d %d\n", width, height, 1, height);
-	    appendhex(tmpprev, tfp, width, height);
-	    fprintf(tfp, "%%%%EndPreview\n");
-	    append(tmpeps, tfp);
-	} else if (tiffpreview) {
-	    /* now make the binary header in the final output file and 
-		append the eps and tiff files */
-	
-	    stat(tmpeps, &fstat);
-	    epslen = fstat.st_size;	/* size of eps file */
-
-	    stat(tmpprev, &fstat);
-	    tiflen = fstat.st_size;	/* size of tif file */
-
-	    /* write header ident C5D0D3C6 */
-	    putc(0xC5, tfp);
-	    putc(0xD0, tfp);
-	    putc(0xD3, tfp);
-	    putc(0xC6, tfp);
-	    /* put byte offset of the EPS part (always 30 - immediately after the header) */
-	    putword(30, tfp);
-	    /* now size of eps part */
-	    putword(epslen, tfp);
-	    /* no Metafile */
-	    putword(0, tfp);
-	    putword(0, tfp);
-	    /* byte offset of TIFF part */
-	    putword(epslen+30, tfp);
-	    /* and length of TIFF part */
-	    putword(tiflen, tfp);
-	    /* finally, FFFF (no checksum) */
-	    putc(0xFF, tfp);
-	    putc(0xFF, tfp);
-	    /* now copy eps out */
-	    append(tmpeps, tfp);
-	    /* and finally, the tiff file */
-	    append(tmpprev, tfp);
-	}
-	/* now get rid of the tmp files */
-	unlink(tmpeps);
-	unlink(tmpprev);
-    }
     /* put any cleanup between %%Trailer and %EOF */
     fprintf(tfp, "%%%%Trailer\n");
     if (pats_used)
@@ -1116,6 +1082,13 @@ genps_end()
     /* final DSC comment for eps output (EOF = end of document) */
     fprintf(tfp, "%%EOF\n");
 
+    /* does the user want an ASCII or TIFF preview? */
+    if (tiffpreview || asciipreview) {
+	/* revert original file back to tfp */
+	tfp = saveofile;
+	write_preview();
+    }
+
     /* all ok */
     return 0;
 }
@@ -1135,60 +1108,238 @@ FILE	*file;
     }
 }
 
-/* append file named in "infilename" to already open FILE "outfile" */
+/*
+ * The EPS previews (-A, -T, -C) are drawn by the scanline renderer of
+ * the bitmap driver (genraster.c), a pixel for each point of the bounding
+ * box.  It has no fonts, so text is shown as bars.  With -U, ghostscript
+ * draws the preview instead, text and pictures included.  The eps is held
+ * in memory meanwhile, and the DOS EPS header is written when its length
+ * and that of the TIFF are known.
+ */
 
-#define BUFLEN 4096
+extern struct driver	*dev;
+extern int		 gendev_objects();
 
-void
-append(infilename, outfile)
-char	*infilename;
-FILE	*outfile;
+static	int	 prev_w, prev_h;
+
+static void
+preview_start(objects)
+F_compound	*objects;
+{
+    raster_start(prev_w, prev_h, 0);
+}
+
+static int
+preview_end()
+{
+    return 0;
+}
+
+static struct driver dev_preview = {
+	gen_ps_eps_option,
+	preview_start,
+	raster_grid,
+	raster_arc,
+	raster_ellipse,
+	raster_line,
+	raster_spline,
+	raster_greek,
+	preview_end,
+	INCLUDE_TEXT,
+	NULL
+};
+
+/* draw the figure into prev_w x prev_h RGB pixels, a pixel a point */
+
+static unsigned char *
+preview_pixels()
+{
+    struct driver	*savedev;
+    double		 savemag;
+    int			 savellx, savelly;
+    unsigned char	*pix;
+
+    savedev = dev;
+    savemag = mag;
+    savellx = llx;
+    savelly = lly;
+    /* the renderer has 80 pixels an inch and starts at llx, lly; the
+       bounding box starts border_margin points before that */
+    mag *= POINT_PER_INCH / 80.0;
+    llx -= round(border_margin * THICK_SCALE / mag);
+    lly -= round(border_margin * THICK_SCALE / mag);
+    dev = &dev_preview;
+    (void) gendev_objects(preview_objects, dev);
+    pix = raster_end();
+    dev = savedev;
+    mag = savemag;
+    llx = savellx;
+    lly = savelly;
+    return pix;
+}
+
+/* write the preview and the held eps to tfp */
+
+static void
+write_preview()
 {
-    FILE  *infile;
-    char   buf[BUFLEN+1];
-    int	   len;
+    unsigned char	*pix, *black, *row;
+    Hold_buf		 prevhold;
+    int			 y;
 
-    if ((infile = fopen(infilename, "r")) == 0) {
-	fprintf(stderr,"Can't open temp file %s\n",infilename);
-	exit(1);
+    if (gspreview && gs_preview() == 0) {
+	hold_close(&epshold);
+	return;
+    }
+    if (asciipreview) {
+	prev_w = width - 1;
+	prev_h = height - 1;
+    } else {
+	prev_w = width;
+	prev_h = height;
     }
-    while (!feof(infile)) {
-	len = fread(buf, 1, BUFLEN, infile);
-	fwrite(buf, len, 1, outfile);
+    pix = preview_pixels();
+
+    if (asciipreview) {
+	/* the preview goes after the header, then the rest of the eps */
+	if ((black = dither_pixels(pix, prev_w, prev_h)) == NULL ||
+		(row = (unsigned char *) malloc(prev_w/8 + 1)) == NULL) {
+	    fprintf(stderr,"Can't allocate memory for preview\n");
+	    exit(1);
+	}
+	fprintf(tfp, "%%%%BeginPreview: %d %d %d %d\n", prev_w, prev_h, 1, prev_h);
+	for (y = 0; y < prev_h; y++) {
+	    fputs("% ", tfp);
+	    pack_bits(black + (long) y * prev_w, prev_w, row, False);
+	    out_HEX(tfp, row, (prev_w+7)/8);
+	    putc('\n', tfp);
+	}
+	fprintf(tfp, "%%%%EndPreview\n");
+	free((char *) black);
+	free((char *) row);
+	hold_write(&epshold, tfp);
+    } else {
+	/* a black and white LZW or a 24-bit TIFF */
+	(void) hold_open(&prevhold, "the preview");
+	if (write_tiff(prevhold.fp, pix, prev_w, prev_h, POINT_PER_INCH,
+			!tiffcolor) != 0) {
+	    fprintf(stderr,"Can't allocate memory for preview\n");
+	    exit(1);
+	}
+	write_dos_header(hold_length(&epshold), hold_length(&prevhold));
+	/* now the eps and then the tiff */
+	hold_write(&epshold, tfp);
+	hold_write(&prevhold, tfp);
+	hold_close(&prevhold);
     }
-    fclose(infile);
+    hold_close(&epshold);
+    raster_free();
 }
 
-/* read file named in "infilename", converting the binary to hex and
-   append to already open FILE "outfile".
-   width is the number of hex values per line that should be written
-   and height is the number of lines total. */
+/* the header of a DOS EPS file with an eps of epslen and a TIFF of tiflen bytes */
 
-void
-appendhex(infilename, outfile, width, height)
-char	*infilename;
-FILE	*outfile;
-int	 width, height;
+static void
+write_dos_header(epslen, tiflen)
+long	epslen, tiflen;
 {
-    FILE  *infile;
-    unsigned char   byte;
-    int	   len, i, j;
+    /* write header ident C5D0D3C6 */
+    putc(0xC5, tfp);
+    putc(0xD0, tfp);
+    putc(0xD3, tfp);
+    putc(0xC6, tfp);
+    /* put byte offset of the EPS part (always 30 - immediately after the header) */
+    putword(30, tfp);
+    /* now size of eps part */
+    putword(epslen, tfp);
+    /* no Metafile */
+    putword(0, tfp);
+    putword(0, tfp);
+    /* byte offset of TIFF part */
+    putword(epslen+30, tfp);
+    /* and length of TIFF part */
+    putword(tiflen, tfp);
+    /* finally, FFFF (no checksum) */
+    putc(0xFF, tfp);
+    putc(0xFF, tfp);
+}
+
+/*
+ * Write the preview that ghostscript makes from the held eps, and the eps.
+ * Returns 1, with nothing written, if gs can't be run.
+ */
 
-    if ((infile = fopen(infilename, "r")) == 0) {
-	fprintf(stderr,"Can't open temp file %s\n",infilename);
-	exit(1);
+static int
+gs_preview()
+{
+    char		 tmpeps[PATH_MAX], tmpprev[PATH_MAX];
+    char		 gscom[2*PATH_MAX+200], block[BUFSIZ];
+    FILE		*fp;
+    unsigned char	*row;
+    long		 tiflen;
+    int			 status, y, len;
+    size_t		 n;
+
+    sprintf(tmpeps, "%s/xfig%06d.tmpeps", TMPDIR, getpid());
+    sprintf(tmpprev, "%s/xfig%06d.tmpprev", TMPDIR, getpid());
+    if ((fp = fopen(tmpeps, "w")) == NULL) {
+	fprintf(stderr,"Can't create temp file in %s\n",TMPDIR);
+	return 1;
     }
-    len = (width+7)/8;
-    for (j=0; j<height; j++) {
-	fprintf(outfile, "%% ");
-	for (i=0; i<len; i++) {
-	    if (fread(&byte, 1, 1, infile) == 0)
-		break;
-	    fprintf(outfile, "%02X", byte);
+    hold_write(&epshold, fp);
+    /* must put a showpage so gs will produce output */
+    fprintf(fp, "showpage\n");
+    if (fclose(fp) != 0) {
+	fprintf(stderr,"Can't write temp file %s\n",tmpeps);
+	unlink(tmpeps);
+	return 1;
+    }
+
+    /* make the ASCII (raw bits) or TIFF file from the temp eps file */
+    sprintf(gscom,
+	"gs -q -dBATCH -dSAFER -sDEVICE=%s -r72 -g%dx%d -sOutputFile=%s %s > /dev/null < /dev/null",
+	asciipreview? "bit" : (tiffcolor? "tiff24nc": "tifflzw"),
+	width, height, tmpprev, tmpeps);
+    status = system(gscom);
+    unlink(tmpeps);
+    if (status != 0 || (fp = fopen(tmpprev, "r")) == NULL) {
+	fprintf(stderr,"Error calling ghostscript: %s\n",gscom);
+	fprintf(stderr,"The preview is drawn without it\n");
+	unlink(tmpprev);
+	return 1;
+    }
+
+    if (asciipreview) {
+	/* gs made rows of width pixels, the preview is one less each way */
+	len = (width+7)/8;
+	if ((row = (unsigned char *) malloc(len)) == NULL) {
+	    fprintf(stderr,"Can't allocate memory for preview\n");
+	    exit(1);
 	}
-	fprintf(outfile, "\n");
+	fprintf(tfp, "%%%%BeginPreview: %d %d %d %d\n",
+		width-1, height-1, 1, height-1);
+	for (y = 0; y < height-1; y++) {
+	    if (fread(row, 1, len, fp) != len)
+		memset((char *) row, 0, len);
+	    fputs("% ", tfp);
+	    out_HEX(tfp, row, (width-1+7)/8);
+	    putc('\n', tfp);
+	}
+	fprintf(tfp, "%%%%EndPreview\n");
+	free((char *) row);
+	hold_write(&epshold, tfp);
+    } else {
+	(void) fseek(fp, 0L, SEEK_END);
+	tiflen = ftell(fp);
+	rewind(fp);
+	write_dos_header(hold_length(&epshold), tiflen);
+	/* now the eps and then the tiff */
+	hold_write(&epshold, tfp);
+	while ((n = fread(block, 1, sizeof block, fp)) > 0)
+	    (void) fwrite(block, 1, n, tfp);
     }
-    fclose(infile);
+    fclose(fp);
+    unlink(tmpprev);
+    return 0;
 }
 
 
@@ -1271,31 +1422,123 @@ double	w;
 	}
 }
 
-static int
-removestr(char *buf, char *str, int *len)
+/*
+ * The EPS, PDF or JPEG picture read last is copied into the output after
+ * its header has been read, so read_picture() leaves its stream open.
+ */
+
+static FILE	*pic_data = NULL;
+static int	 pic_datatype;
+static F_pic	*pic_datapic;
+
+/*
+ * Open the file of picture object pic, find out what kind of image it
+ * is from the first few bytes and read it in with the matching reader.
+ * Returns 1 on success and 0 (after a message) on failure; *pllx, *plly
+ * get the lower-left corner of the image.  A picture that was decoded
+ * before is taken from the cache in readpics.c instead.  The file is
+ * opened once; the reader gets the stream back at its start.
+ */
+
+int
+read_picture(pic, pllx, plly)
+F_pic	*pic;
+int	*pllx, *plly;
 {
-	int	slen = strlen(str)-1;
-	int	i, found=0;
-	char	*cp = buf;
+	FILE		*picf;
+	char		 buf[16], realname[PATH_MAX];
+	int		 i, j, n;
+	Boolean		 found;
+
+	if (pic_data) {
+	    close_picfile(pic_data, pic_datatype);
+	    pic_data = NULL;
+	}
+	if (cached_picture(pic, pllx, plly))
+	    return 1;
+
+	/* open the file and read a few bytes of the header to see what it is */
+	n = 15;
+	if ((picf=sniff_picfile(pic->file, &filtype, realname, buf, &n)) == NULL) {
+		fprintf(stderr,"No such picture file: %s\n",pic->file);
+		return 0;
+	}
+
+	/* now find which header it is */
+	for (i=0; i<NUMHEADERS; i++) {
+	    found = headers[i].nbytes <= n;
+	    for (j=headers[i].nbytes-1; found && j>=0; j--)
+		if (buf[j] != headers[i].bytes[j])
+		    found = False;
+	    if (found)
+		break;
+	}
+	if (!found) {
+	    /* none of the above */
+	    fprintf(stderr,"%s: Unknown image format\n",pic->file);
+	    close_picfile(picf,filtype);
+	    return 0;
+	}
+	if (headers[i].pipeok) {
+	    found = (*headers[i].readfunc)(picf,filtype,pic,pllx,plly) != 0;
+	} else {
+	    /* routines that can't take a stream (e.g. xpm) get the real filename,
+	       or that of a temporary copy if it was uncompressed into memory */
+	    if (!picfile_name(picf, filtype, realname)) {
+		fprintf(stderr,"Can't uncompress picture file: %s\n",pic->file);
+		close_picfile(picf,filtype);
+		return 0;
+	    }
+	    found = (*headers[i].readfunc)(realname,filtype,pic,pllx,plly) != 0;
+	}
+	if (!found) {
+	    fprintf(stderr,"%s: Bad %s format\n",pic->file, headers[i].type);
+	    close_picfile(picf,filtype);
+	    return 0;	/* problem, return */
+	}
+	/* Successful read */
+	if (pic->subtype == P_EPS || pic->subtype == P_JPEG) {
+	    pic_data = picf;
+	    pic_datatype = filtype;
+	    pic_datapic = pic;
+	} else {
+	    close_picfile(picf,filtype);
+	}
+	cache_picture(pic, *pllx, *plly, headers[i].type);
+	return 1;
+}
+
+/*
+ * The stream of picture pic at its start, for copying it; the one that
+ * read_picture() left open if it is there.  Close it with close_picfile().
+ */
 
-	while (cp=strstr(buf,str)) {
-		*len = *len - slen;
-	    	memmove(cp, cp+slen, *len-(cp-buf));
-		*(buf+*len) = '\0';
-		found = 1;
+FILE *
+picture_data(pic, type)
+F_pic	*pic;
+int	*type;
+{
+	FILE	*picf;
+	char	 realname[PATH_MAX];
+
+	if (pic_data && pic_datapic == pic) {
+	    picf = pic_data;
+	    *type = pic_datatype;
+	    pic_data = NULL;
+	    rewind(picf);
+	    return picf;
 	}
-	return found;
+	return open_picfile(pic->file, type, True, realname);
 }
 
 void
 genps_line(l)
 F_line	*l;
 {
-	F_point		*p, *q;
+	F_pos		*p, *q;
 	int		 radius;
-	int		 i;
+	int		 i, n;
 	FILE		*picf;
-	char		 buf[512], realname[PATH_MAX];
 	int		 xmin,xmax,ymin,ymax;
 	int		 pic_w, pic_h, img_w, img_h;
 	float		 hf_wid;
@@ -1314,9 +1557,9 @@ F_line	*l;
 		set_linecap(l->cap_style);
 		set_linewidth((double)l->thickness);
 	}
-	p = l->points;
-	q = p->next;
-	if (q == NULL) { /* A single point line */
+	p = l->pts;
+	n = l->npts;
+	if (n == 1) { /* A single point line */
 	    if (l->cap_style > 0)
 		hf_wid = 1.0;
 	    else if (l->thickness <= THICK_SCALE)
@@ -1335,16 +1578,15 @@ F_line	*l;
 
 	xmin = xmax = p->x;
 	ymin = ymax = p->y;
-	while (p->next != NULL) {	/* find lower left and upper right corners */
-	    p=p->next;
-	    if (xmin > p->x)
-		xmin = p->x;
-	    else if (xmax < p->x)
-		xmax = p->x;
-	    if (ymin > p->y)
-		ymin = p->y;
-	    else if (ymax < p->y)
-		ymax = p->y;
+	for (i = 1; i < n; i++) {	/* find lower left and upper right corners */
+	    if (xmin > p[i].x)
+		xmin = p[i].x;
+	    else if (xmax < p[i].x)
+		xmax = p[i].x;
+	    if (ymin > p[i].y)
+		ymin = p[i].y;
+	    else if (ymax < p[i].y)
+		ymax = p[i].y;
 	    }
 
 	if (l->type == T_ARC_BOX) {
@@ -1369,12 +1611,10 @@ F_line	*l;
 	  /* PICTURE OBJECT */
 		int             dx, dy, rotation;
 		int		pllx, plly, purx, pury;
-		int		i, j;
-		Boolean		found;
-		int		c;
+		int		i, j, shared;
 
-		dx = l->points->next->next->x - l->points->x;
-		dy = l->points->next->next->y - l->points->y;
+		dx = p[2].x - p[0].x;
+		dy = p[2].y - p[0].y;
 		rotation = 0;
 		if (dx < 0 && dy < 0)
 			   rotation = 180;
@@ -1391,64 +1631,21 @@ F_line	*l;
 		else
 	            fprintf(tfp, "0 0 0 setrgbcolor\n");
 
-		/* open the file and read a few bytes of the header to see what it is */
-		if ((picf=open_picfile(l->pic->file, &filtype, True, realname)) == NULL) {
-			fprintf(stderr,"No such picture file: %s\n",l->pic->file);
+		/* find out what kind of picture it is and read it in */
+		if (read_picture(l->pic, &pllx, &plly) == 0)
 			return;
-		}
-
-		for (i=0; i<15; i++) {
-		    if ((c=getc(picf))==EOF)
-		    break;
-		    buf[i]=(char) c;
-		}
-		close_picfile(picf,filtype);
-
-		/* now find which header it is */
-		for (i=0; i<NUMHEADERS; i++) {
-		    found = True;
-		    for (j=headers[i].nbytes-1; j>=0; j--)
-		    if (buf[j] != headers[i].bytes[j]) {
-			found = False;
-			break;
-		    }
-		    if (found)
-		    break;
-		}
-		if (found) {
-		    if (headers[i].pipeok) {
-			/* open it again (it may be a pipe so we can't just rewind) */
-			picf=open_picfile(l->pic->file, &filtype, headers[i].pipeok, realname);
-			/* and read it */
-			if (((*headers[i].readfunc)(picf,filtype,l->pic,&pllx,&plly)) == 0) {
-			    fprintf(stderr,"%s: Bad %s format\n",l->pic->file, headers[i].type);
-			    close_picfile(picf,filtype);
-			    return;	/* problem, return */
-			}
-			/* close file */
-			close_picfile(picf,filtype);
-		    } else {
-			/* routines that can't take a pipe (e.g. xpm) get the real filename */
-			if (((*headers[i].readfunc)(realname,filtype,l->pic,&pllx,&plly)) == 0) {
-			    fprintf(stderr,"%s: Bad %s format\n",l->pic->file, headers[i].type);
-			    return;	/* problem, return */
-			}
-		    }
-		    /* Successful read */
-		} else {
-		    /* none of the above */
-		    fprintf(stderr,"%s: Unknown image format\n",l->pic->file);
-		    return;
-		}
 
 		/* if we have any of the following pic types, we need the ps encoder */
+		/* (LanguageLevel 3 uses the image operator with filters instead) */
 		if ((l->pic->subtype == P_XPM || l->pic->subtype == P_PCX || 
-		    l->pic->subtype == P_PNG) && !psencode_header_done)
+		    l->pic->subtype == P_GIF || l->pic->subtype == P_PNG ||
+		    l->pic->subtype == P_PPM || l->pic->subtype == P_TIF) &&
+		    !psencode_header_done && pslevel < 3)
 			    PSencode_header();
 
 		/* if we have a GIF with a transparent color, we need the transparentimage code */
-		/* Actually, the GIF has been changed to PCX, but we still have the information */
-		if (l->pic->subtype == P_PCX && l->pic->transp != -1 && !transp_header_done)
+		if ((l->pic->subtype == P_GIF || l->pic->subtype == P_PCX) &&
+		    l->pic->transp != -1 && !transp_header_done && pslevel < 3)
 		    PStransp_header();
 
 		/* width, height of image bits (unrotated) */
@@ -1461,6 +1658,24 @@ F_line	*l;
 		purx = img_w+pllx;
 		pury = img_h+plly;
 
+		/* with LanguageLevel 3, an image the figure has more than once
+		   is defined before its first copy and only called after that */
+		shared = 0;
+#ifdef USE_PNG
+		if (pslevel == 3 && !multi_page && (l->pic->subtype == P_GIF ||
+		    l->pic->subtype == P_PCX || l->pic->subtype == P_PNG ||
+		    l->pic->subtype == P_PPM || l->pic->subtype == P_TIF) &&
+		    picture_uses(l->pic->file) > 1 &&
+		    (shared = picture_mark(l->pic->file)) == 0) {
+			shared = ++shared_images;
+			PSflatedefine(shared, img_w, img_h, l->pic->transp,
+			    l->pic->numcols > 256 ? 0 : l->pic->numcols,
+			    l->pic->cmap[RED], l->pic->cmap[GREEN], l->pic->cmap[BLUE], 
+			    l->pic->bitmap);
+			set_picture_mark(l->pic->file, shared);
+		}
+#endif /* USE_PNG */
+
 		fprintf(tfp, "n gs\n");
 
 		/* pic_w, pic_h are the width, height of the Fig pic object, possibly rotated */
@@ -1552,8 +1767,8 @@ F_line	*l;
 
 		/* XBM file */
 		if (l->pic->subtype == P_XBM) {
-			unsigned char	*bit;
-			int		 cwid;
+			unsigned char	*bit, inv[40];
+			int		 cwid, nbytes, k, m;
 
 			fprintf(tfp, "col%d\n ", l->pen_color);
 			fprintf(tfp, "%% Bitmap image follows:\n");
@@ -1570,16 +1785,21 @@ F_line	*l;
 			fprintf(tfp, "imagemask\n");
 			bit = l->pic->bitmap;
 			cwid = 0;
+			nbytes = (purx+7)/8;
 			for (i=0; i<pury; i++) {			/* for each row */
-			    for (j=0; j<(int)((purx+7)/8); j++) {	/* for each byte */
-				fprintf(tfp,"%02x", (unsigned char) ~(*bit++));
-				cwid+=2;
+			    /* the inverted bytes up to the end of the 80-char line */
+			    for (j=0; j<nbytes; j+=m) {
+				m = min(nbytes-j, (80-cwid)/2);
+				for (k=0; k<m; k++)
+				    inv[k] = (unsigned char) ~(*bit++);
+				out_hex(tfp, inv, m);
+				cwid += 2*m;
 				if (cwid >= 80) {
-				    fprintf(tfp,"\n");
+				    putc('\n', tfp);
 				    cwid=0;
 				}
 			    }
-			    fprintf(tfp,"\n");
+			    putc('\n', tfp);
 			}
 
 #ifdef USE_XPM
@@ -1611,6 +1831,13 @@ F_line	*l;
 			    *cp++ = (unsigned char) *dp++;
 				
 			/* now write out the image data in a compressed form */
+#ifdef USE_PNG
+			if (pslevel == 3)
+			    PSflateimage(img_w, img_h, -1, l->pic->xpmimage.ncolors,
+				l->pic->cmap[RED], l->pic->cmap[GREEN], l->pic->cmap[BLUE], 
+				cdata);
+			else
+#endif /* USE_PNG */
 			(void) PSencode(img_w, img_h, -1, l->pic->xpmimage.ncolors,
 				l->pic->cmap[RED], l->pic->cmap[GREEN], l->pic->cmap[BLUE], 
 				cdata);
@@ -1619,9 +1846,10 @@ F_line	*l;
 			XpmFreeXpmImage(&l->pic->xpmimage);
 #endif /* USE_XPM */
 
-		/* GIF, PCX, PNG, or JPEG file */
+		/* GIF, PCX, PNG, PPM, TIFF or JPEG file */
 		} else if (l->pic->subtype == P_GIF || l->pic->subtype == P_PCX || 
-		     l->pic->subtype == P_JPEG || l->pic->subtype == P_PNG) {
+		     l->pic->subtype == P_JPEG || l->pic->subtype == P_PNG ||
+		     l->pic->subtype == P_PPM || l->pic->subtype == P_TIF) {
 
 			if (l->pic->subtype == P_GIF)
 			    fprintf(tfp, "%% GIF image follows:\n");
@@ -1629,15 +1857,33 @@ F_line	*l;
 			    fprintf(tfp, "%% PCX image follows:\n");
 			else if (l->pic->subtype == P_PNG)
 			    fprintf(tfp, "%% PNG image follows:\n");
+			else if (l->pic->subtype == P_PPM)
+			    fprintf(tfp, "%% PPM image follows:\n");
+			else if (l->pic->subtype == P_TIF)
+			    fprintf(tfp, "%% TIFF image follows:\n");
 			else
 			    fprintf(tfp, "%% JPEG image follows:\n");
 			/* scale for size in bits */
 			fprintf(tfp, "%d %d sc\n", purx, pury);
 			if (l->pic->subtype == P_JPEG) {
 			    /* now actually read and format the jpeg file for PS */
-			    JPEGtoPS(l->pic->file, tfp);
+			    if ((picf=picture_data(l->pic, &filtype)) != NULL) {
+				JPEGtoPS(picf, tfp);
+				close_picfile(picf,filtype);
+			    }
 			} else {
-			    /* GIF, PNG and PCX */
+			    /* GIF, PNG, PCX, PPM and TIFF */
+#ifdef USE_PNG
+			    if (shared) {
+				fprintf(tfp, "Im%d\n", shared);
+			    } else if (pslevel == 3) {
+				/* deflated, 24-bit or with a colormap */
+				PSflateimage(img_w, img_h, l->pic->transp,
+				    l->pic->numcols > 256 ? 0 : l->pic->numcols,
+				    l->pic->cmap[RED], l->pic->cmap[GREEN], l->pic->cmap[BLUE], 
+				    l->pic->bitmap);
+			    } else
+#endif /* USE_PNG */
 			    if (l->pic->numcols > 256) {
 				/* 24-bit image, write rgb values */
 				(void) PSrgbimage(tfp, img_w, img_h, l->pic->bitmap);
@@ -1651,25 +1897,15 @@ F_line	*l;
 
 		/* EPS file */
 		} else if (l->pic->subtype == P_EPS) {
-		    int len;
 		    fprintf(tfp, "%% EPS file follows:\n");
-		    if ((picf=open_picfile(l->pic->file, &filtype, True, realname)) == NULL) {
+		    if ((picf=picture_data(l->pic, &filtype)) == NULL) {
 			fprintf(stderr, "Unable to open EPS file '%s': error: %s\n",
 				l->pic->file, strerror(errno));
 			fprintf(tfp, "gr\n");
 			return;
 		    }
-		    /* use read/write() calls in case of binary data! */
-		    /* but flush buffer first */
-		    fflush(tfp);
-		    while ((len = read(fileno(picf),buf,sizeof(buf))) > 0) {
-		    	/* remove any %EOF or %%EOF in file */
-		    	while (removestr(buf,"\n%EOF\n",&len) != 0)
-			    ;
-		    	while (removestr(buf,"\n%%EOF\n",&len) != 0)
-			    ;
-			write(fileno(tfp),buf,len);
-		    }
+		    /* copy the PostScript part of it, without any %EOF or %%EOF */
+		    copy_eps(picf, filtype, tfp);
 		    close_picfile(picf,filtype);
 		}
 
@@ -1690,22 +1926,16 @@ F_line	*l;
 		fprintf(tfp, "%%\n");
 	} else {
 	  /* POLYLINE */
-		p = l->points;
-		q = p->next;
+		q = &p[n-1];
 		/* first point */
-		fpntx1 = p->x;
-		fpnty1 = p->y;
+		fpntx1 = p[0].x;
+		fpnty1 = p[0].y;
 		/* second point */
-		fpntx2 = q->x;
-		fpnty2 = q->y;
-		/* go through the points to get the last two */
-		while (q->next != NULL) {
-		    p = q;
-		    q = q->next;
-		}
+		fpntx2 = p[1].x;
+		fpnty2 = p[1].y;
 		/* next to last point */
-		lpntx2 = p->x;
-		lpnty2 = p->y;
+		lpntx2 = q[-1].x;
+		lpnty2 = q[-1].y;
 		/* last point */
 		lpntx1 = q->x;
 		lpnty1 = q->y;
@@ -1716,17 +1946,15 @@ F_line	*l;
 		}
 
 		/* now output the points */
-		p = l->points;
-		q = p->next;
-		fprintf(tfp, "n %d %d m", p->x, p->y);
-		i=1;
-		while (q->next != NULL) {
-		    p = q;
-		    q = q->next;
-		    fprintf(tfp, " %d %d l", p->x, p->y);
+		fputs("n ", tfp);
+		out_pair(tfp, p->x, ' ', p->y);
+		fputs(" m", tfp);
+		for (i = 1; i < n-1; i++) {
+		    putc(' ', tfp);
+		    out_pair(tfp, p[i].x, ' ', p[i].y);
+		    fputs(" l", tfp);
  	    	    if (i%5 == 0)
 			fprintf(tfp, "\n");
-		    i++;
 		}
 		fprintf(tfp, "\n");
 	}
@@ -1734,7 +1962,9 @@ F_line	*l;
 	/* now fill it, draw the line and/or draw arrow heads */
 	if (l->type != T_PIC_BOX) {	/* make sure it isn't a picture object */
 		if (l->type == T_POLYLINE) {
-		    fprintf(tfp, " %d %d l ", q->x, q->y);
+		    putc(' ', tfp);
+		    out_pair(tfp, p[n-1].x, ' ', p[n-1].y);
+		    fputs(" l ", tfp);
 		    if (fpntx1==lpntx1 && fpnty1==lpnty1)
 			fprintf(tfp, " cp ");	/* endpoints are coincident, close path 
 							so that line join is used */
@@ -1797,6 +2027,7 @@ F_spline	*s;
 	F_point		*p, *q;
 	F_control	*a, *b;
 	int		 xmin, ymin;
+	double		 v[4];
 
 	fprintf(tfp, "%% Interp Spline\n");
 	a = s->controls;
@@ -1835,8 +2066,12 @@ F_spline	*s;
 	    xmin = min(xmin, p->x);
 	    ymin = min(ymin, p->y);
 	    b = a->next;
-	    fprintf(tfp, "\t%.1f %.1f %.1f %.1f %d %d curveto\n",
-			a->rx, a->ry, b->lx, b->ly, q->x, q->y);
+	    v[0] = a->rx; v[1] = a->ry;
+	    v[2] = b->lx; v[3] = b->ly;
+	    putc('\t', tfp);
+	    put_tenths(v, 4);
+	    out_pair(tfp, q->x, ' ', q->y);
+	    fputs(" curveto\n", tfp);
 	    a = b;
 	    }
 	if (closed_spline(s)) fprintf(tfp, " cp ");
@@ -1861,6 +2096,7 @@ genps_ctl_spline(s)
 F_spline	*s;
 {
 	double		a, b, c, d, x1, y1, x2, y2, x3, y3;
+	double		v[6];
 	F_point		*p, *q;
 	int		xmin, ymin;
 
@@ -1940,8 +2176,12 @@ F_spline	*s;
 	    d = q->y;
 	    x3 = (x2 + c) / 2;
 	    y3 = (y2 + d) / 2;
-	    fprintf(tfp, "\t%.1f %.1f %.1f %.1f %.1f %.1f DrawSplineSection\n",
-			x1, y1, x2, y2, x3, y3);
+	    v[0] = x1; v[1] = y1;
+	    v[2] = x2; v[3] = y2;
+	    v[4] = x3; v[5] = y3;
+	    putc('\t', tfp);
+	    put_tenths(v, 6);
+	    fputs("DrawSplineSection\n", tfp);
 	}
 	/*
 	* At this point, (x2,y2) and (c,d) are the position of the
@@ -1968,6 +2208,19 @@ F_spline	*s;
 	    draw_arrow(s, s->for_arrow, fpoints, nfpoints, ffillpoints, nffillpoints, s->pen_color);
 }
 
+/* write the n numbers in v like "%.1f ", for the points of a spline */
+
+static void
+put_tenths(v, n)
+    double	*v;
+    int		 n;
+{
+	for ( ; n > 0; n--, v++) {
+	    out_fixed(tfp, *v, 1);
+	    putc(' ', tfp);
+	}
+}
+
 void
 genps_arc(a)
 F_arc	*a;
@@ -2241,7 +2494,8 @@ int	col;
 	set_linewidth(arrow->thickness);
 	fprintf(tfp, "n ");
 	for (i=0; i<npoints; i++) {
-	    fprintf(tfp, "%d %d ",points[i].x,points[i].y);
+	    out_pair(tfp, points[i].x, ' ', points[i].y);
+	    putc(' ', tfp);
 	    if (i==0)
 		fprintf(tfp, "m ");
 	    else
@@ -2279,7 +2533,8 @@ int	col;
 		    /* now describe the special fill area */
 		    fprintf(tfp, "n ");
 		    for (i=0; i<nfillpoints; i++) {
-			fprintf(tfp, "%d %d ",fillpoints[i].x,fillpoints[i].y);
+			out_pair(tfp, fillpoints[i].x, ' ', fillpoints[i].y);
+			putc(' ', tfp);
 			if (i==0)
 			    fprintf(tfp, "m ");
 			else
@@ -2557,7 +2812,7 @@ F_compound	*ob;
 /* lookup color names and return rgb values from X11
    RGB database file (e.g. /usr/lib/X11/rgb.XXX) */
 
-static void
+void
 convert_xpm_colors(cmap, coltabl, ncols)
 	unsigned char cmap[3][MAXCOLORMAPSIZE];
 	XpmColor *coltabl;
@@ -2619,6 +2874,38 @@ do_split(actual_depth)
     last_depth = actual_depth;
 }
 
+/* back to the defaults for the next figure of a batch */
+
+void
+genps_reset()
+{
+	int	i;
+
+	epsflag = pdfflag = False;
+	asciipreview = tiffpreview = tiffcolor = gspreview = False;
+	pslevel = 2;
+	anonymous = False;
+	useabsolutecoo = False;
+	pagewidth = pageheight = -1;
+	xoff = yoff = 0;
+	border_margin = 0;
+	cur_thickness = 0.0;
+	cur_joinstyle = cur_capstyle = 0;
+	no_obj = 0;
+	fig_number = 0;
+	last_depth = MAXDEPTH+4;
+#ifdef I18N
+	enable_composite_font = False;
+#endif
+	/* the default font, as in psfonts.h and psfonts.c */
+	psfontnames[0] = psfontnames[1] = "Times-Roman";
+	PSfontnames[0] = PSfontnames[1] = "Times-Roman";
+	/* no font has been re-encoded yet */
+	for (i = 0; i <= MAX_PSFONT+1; i++)
+	    if (PSisomap[i] == True)
+		PSisomap[i] = False;
+}
+
 /* driver defs */
 
 struct
@@ -2632,7 +2919,8 @@ driver dev_ps = {
 	genps_spline,
 	genps_text,
 	genps_end,
-	INCLUDE_TEXT
+	INCLUDE_TEXT,
+	genps_reset
 };
 
 /* eps is just like ps except with no: pages, pagesize, orientation, offset */
@@ -2648,5 +2936,6 @@ driver dev_eps = {
 	genps_spline,
 	genps_text,
 	genps_end,
-	INCLUDE_TEXT
+	INCLUDE_TEXT,
+	genps_reset
 };
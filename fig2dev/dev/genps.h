@@ -25,7 +25,7 @@ extern Boolean	epsflag;	/* to distinguish PS and EPS */
 extern Boolean	pdfflag;	/* to distinguish PDF and PS/EPS */
 extern Boolean	tiffpreview;	/* add a TIFF preview? */
 
-extern void	gen_ps_eps_option();
+extern int	gen_ps_eps_option();
 extern void	genps_start();
 extern int	genps_end();
 extern void	genps_grid();
@@ -34,6 +34,10 @@ extern void	genps_ellipse();
 extern void	genps_line();
 extern void	genps_spline();
 extern void	genps_text();
+extern int	read_picture();
+extern FILE	*picture_data();
+extern void	convert_xpm_colors();
+extern void	genps_reset();
 
 
 #define		BEGIN_PROLOG1	"\
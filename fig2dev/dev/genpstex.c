@@ -56,28 +56,30 @@ extern double rad2deg;
 extern void
 	genlatex_start (),
 	gendev_null (),
-     	geneps_option (),
 	genps_start (),
 	genps_arc (),
 	genps_ellipse (),
 	genps_line (),
 	genps_spline (),
-        genlatex_option (),
         genlatex_text (),
         genps_text ();
 extern int
+     	geneps_option (),
+        genlatex_option (),
 	genlatex_end (),
 	genps_end ();
+extern void
+	genlatex_reset ();
 
 static char pstex_file[1000] = "";
 
-void genpstex_t_option(opt, optarg)
+int genpstex_t_option(opt, optarg)
 char opt, *optarg;
 {
-       if (opt == 'p') 
-	   strcpy(pstex_file, optarg);
-       else
-	   genlatex_option(opt, optarg);
+       if (opt != 'p')
+	   return genlatex_option(opt, optarg);
+       strcpy(pstex_file, optarg);
+       return 0;
 }
 
 
@@ -121,11 +123,27 @@ F_text	*t;
 	else gendev_null();
 }
 
-void genpstex_option(opt, optarg)
+void genpdftex_text(t)
+F_text	*t;
+{
+
+	if (!special_text(t))
+	  genpdf_text(t);
+	else gendev_null();
+}
+
+void genpstex_t_reset()
+{
+	pstex_file[0] = '\0';
+	genlatex_reset();
+}
+
+int genpstex_option(opt, optarg)
 char opt, *optarg;
 {
        if (opt != 'p')
-	   genlatex_option(opt, optarg);
+	   return genlatex_option(opt, optarg);
+       return 0;
 }
 
 struct driver dev_pstex_t = {
@@ -138,7 +156,8 @@ struct driver dev_pstex_t = {
 	gendev_null,
 	genpstex_t_text,
 	genlatex_end,
-	INCLUDE_TEXT
+	INCLUDE_TEXT,
+	genpstex_t_reset
 };
 
 struct driver dev_pdftex_t = {
@@ -151,7 +170,8 @@ struct driver dev_pdftex_t = {
 	gendev_null,
 	genpstex_t_text,
 	genlatex_end,
-	INCLUDE_TEXT
+	INCLUDE_TEXT,
+	genpstex_t_reset
 };
 
 struct driver dev_pstex = {
@@ -164,24 +184,22 @@ struct driver dev_pstex = {
 	genps_spline,
 	genpstex_text,
 	genps_end,
-	INCLUDE_TEXT
+	INCLUDE_TEXT,
+	genps_reset
 };
 
-extern void     genpdf_option();
-extern void     genpdf_start();
-extern int      genpdf_end();
-
 struct driver dev_pdftex = {
   	genpdf_option,
 	genpdf_start,
-	genps_grid,
-	genps_arc,
-	genps_ellipse,
-	genps_line,
-	genps_spline,
-	genpstex_text,
+	genpdf_grid,
+	genpdf_arc,
+	genpdf_ellipse,
+	genpdf_line,
+	genpdf_spline,
+	genpdftex_text,
 	genpdf_end,
-	INCLUDE_TEXT
+	INCLUDE_TEXT,
+	genpdf_reset
 };
 
 
@@ -582,7 +582,7 @@ pst_version_cmp(PST_VERSION *a, PST_VERSION *b)
   return strncmp(a->key, b->key, sizeof a->key);
 }
  
-void genpstrx_option(opt, optarg)
+int genpstrx_option(opt, optarg)
 	char opt;
 	char *optarg;
 {
@@ -655,7 +655,7 @@ void genpstrx_option(opt, optarg)
     f = fopen(fn, "w");
     if (!f) {
       fprintf(stderr, "can't write the eps conversion directory %s.\n", Pic_convert_dir);
-      exit(1);
+      return 1;
     }
     fprintf(f, 
 	    "This directory has been used by the fig2dev pstricks driver.\n"
@@ -673,7 +673,7 @@ void genpstrx_option(opt, optarg)
   case 'S':
     if (optarg && sscanf(optarg, "%d", &tmp_int) == 1 && (tmp_int < 8 || tmp_int > 12)) {
       fprintf(stderr, "Scale must be between 8 and 12 inclusively\n");
-      exit(1);
+      return 1;
     }
     mag = ScaleTbl[tmp_int - 8].mag;
     font_size = (double) ScaleTbl[tmp_int - 8].size;
@@ -718,8 +718,9 @@ void genpstrx_option(opt, optarg)
  
   default:
     put_msg(Err_badarg, opt, "pstricks");
-    exit(1);
+    return 1;
   }
+  return 0;
 }
  
 /**********************************************************************/
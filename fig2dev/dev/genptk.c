@@ -62,7 +62,7 @@ static int	full_page = False;
  *   g e n p T k O p t i o n ( )
  */
 
-void
+int
 genptk_option(opt, optarg)
 char opt, *optarg;
 {
@@ -94,9 +94,9 @@ char opt, *optarg;
 
 	default:
 		put_msg(Err_badarg, opt, "tk");
-		exit(1);
+		return 1;
     }
-
+    return 0;
 }
 
 /*
@@ -319,8 +319,6 @@ genptk_line(F_line *l)
  *   d r a w B i t m a p ( )
  */
 
-#define	ReadOK(file,buffer,len)	(fread(buffer, len, 1, file) != 0)
-
 static void
 drawBitmap(F_line *l)
 {
@@ -329,9 +327,9 @@ drawBitmap(F_line *l)
 	F_pic	*p;
 	unsigned char	buf[16];
 	FILE	*fd;
-	int	filtype;	/* file (0) or pipe (1) */
-	int	stat;
-	FILE	*open_picfile();
+	int	filtype;	/* file (0) or memory (2) */
+	int	nhead;
+	FILE	*sniff_picfile();
 	void	close_picfile();
 	char	xname[PATH_MAX];
 	char    isphoto;
@@ -344,19 +342,18 @@ drawBitmap(F_line *l)
 		fprintf(stderr, "drawBitmap: rotated bitmaps not supprted"
 			" by Tk.\n");
 
-	/* see if supported image format first */
+	/* see if supported image format first, from the header read when
+	   the file is opened (an X bitmap is then read from the same stream) */
 
-	if ((fd=open_picfile(p->file, &filtype, True, xname)) == NULL) {
+	memset(buf, 0, sizeof(buf));
+	nhead = 9;
+	if ((fd=sniff_picfile(p->file, &filtype, xname, (char *) buf, &nhead)) == NULL) {
 	    fprintf(stderr,"drawBitmap: can't open bitmap file %s\n",p->file);
 	    return;
 	}
-
-	/* read header */
-
-	stat = ReadOK(fd,buf,6);
-	close_picfile(fd,filtype);
-	if (!stat) {
+	if (nhead < 6) {
 		fprintf(stderr,"drawBitmap: Bitmap file %s too short\n",p->file);
+		close_picfile(fd,filtype);
 		return;
 	}
 
@@ -406,7 +403,6 @@ drawBitmap(F_line *l)
 		niceLine(stfp);
 	} else {
 	    /* Try for an X Bitmap file format. */
-	    rewind(fd);
 	    if (ReadFromBitmapFile(fd, &dx, &dy, &p->bitmap)) {
 		sprintf(stfp, "%s->createBitmap(qw/%fi %fi -anchor nw",
 			canvas, X(l->points->x), Y(l->points->y));
@@ -430,6 +426,7 @@ drawBitmap(F_line *l)
 		fprintf(stderr, "Only X bitmap, TIFF, JPEG, PPM and GIF picture objects "
 			"are supported in Tk canvases.\n");
 	}
+	close_picfile(fd,filtype);
 }
 
 /*
@@ -0,0 +1,1516 @@
+/*
+ * TransFig: Facility for Translating Fig code
+ * Parts Copyright (c) 1989-2002 by Brian V. Smith
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish and/or distribute copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that this copyright
+ * notice remain intact.
+ *
+ */
+
+/*
+ *	genraster.c : scanline renderer for the bitmap driver
+ *
+ *	Draws the figure straight into an RGB pixel buffer, so that the
+ *	bitmap formats can be made without piping PostScript into
+ *	ghostscript.  Every object becomes a set of polygon edges which
+ *	are filled with an active edge list; lines are stroked by filling
+ *	their outline, and the -S smoothing factor selects the number of
+ *	sub-scanlines per pixel row.  The geometry, line widths, dash
+ *	patterns and fills follow what genps.c asks ghostscript to do.
+ *
+ *	Text is not rendered, and JPEG and EPS pictures are shown as
+ *	gray boxes.
+ */
+
+#include "fig2dev.h"
+#include "object.h"
+#include "bound.h"
+#include "genps.h"
+#include "genraster.h"
+
+/* the standard colors (from genps.c) */
+extern struct _rgb {
+	float r, g, b;
+	} rgbcols[];
+
+#define	SHADEVAL(F)	1.0*(F)/(NUMSHADES-1)
+#define	TINTVAL(F)	1.0*(F-NUMSHADES+1)/NUMTINTS
+
+#define	MITERLIMIT	10.0		/* same as the PostScript prologue */
+#define	PAT_SCALE	(72.0/80.0)	/* pattern units (points) per pixel */
+
+typedef struct {
+	double	x, y;
+	} Rpoint;
+
+typedef struct {
+	double	x0, y0, x1, y1;		/* y0 < y1 */
+	double	dxdy;
+	int	dir;			/* +1 going down, -1 going up */
+	} Redge;
+
+typedef struct {
+	double	x;
+	int	dir;
+	} Rcross;
+
+typedef struct {
+	double	xstep, ystep;		/* size of one tile in points */
+	double	hw;			/* half the line width */
+	int	nseg;
+	double	*seg;			/* x1 y1 x2 y2 for each segment */
+	} Rpattern;
+
+static unsigned char *pixels = NULL;
+static int	 pix_w, pix_h;
+static int	 nsub;			/* sub-scanlines per pixel row */
+static double	 sc;			/* pixels per Fig unit */
+static float	*cover = NULL;		/* coverage of the row being filled */
+static int	 cov_l, cov_r;		/* range of cover[] that was touched */
+static unsigned char *mask = NULL;	/* coverage of the stroke being drawn */
+static int	 msk_l, msk_r, msk_t, msk_b;	/* part of mask[] that was touched */
+static Boolean	 to_mask;		/* contours go to mask[] one by one */
+static FILE	*saveofile;
+static Boolean	 text_warned, pic_warned;
+
+static Redge	*edges = NULL;
+static int	 nedges = 0, maxedges = 0;
+static int	*active = NULL;
+static Rcross	*cross = NULL;
+static int	 maxactive = 0, maxcross = 0;
+
+static Rpoint	*path = NULL;		/* the outline of the current object */
+static int	 npath = 0, maxpath = 0;
+static Rpoint	*piece = NULL;		/* scratch for strokes and dashes */
+static int	 npiece = 0, maxpiece = 0;
+static Rpoint	*clean = NULL;
+static int	 maxclean = 0;
+static Rpoint	*circ = NULL;		/* round joins and caps */
+static int	 maxcirc = 0;
+
+#define	DEVX(x)		(((x) - llx) * sc)
+#define	DEVY(y)		(((y) - lly) * sc)
+
+/*
+ * The fill patterns of genps.h, as the lines their PaintProcs stroke:
+ * "xstep ystep linewidth" followed by M x y (moveto), L x y (lineto)
+ * and A cx cy r angle1 angle2 (arc) in points, y going up.
+ */
+
+static char	*pat_desc[NUMPATTERNS] = {
+	"8 4 .7 M -2 -1 L 10 5",					/* left30 */
+	"8 4 .7 M -2 5 L 10 -1",					/* right30 */
+	"8 4 .7 M -2 5 L 10 -1 M -2 -1 L 10 5",				/* crosshatch30 */
+	"8 8 1 M -1 -1 L 9 9",						/* left45 */
+	"8 8 1 M -1 9 L 9 -1",						/* right45 */
+	"8 8 1 M -1 9 L 9 -1 M -1 -1 L 9 9",				/* crosshatch45 */
+	"16 16 1 M 0 0 L 0 8 M 8 8 L 8 16 M 0 8 L 16 8 M 0 16 L 16 16", /* bricks */
+	"16 16 1 M 0 0 L 8 0 M 8 8 L 16 8 M 8 0 L 8 16 M 16 0 L 16 16", /* vertical bricks */
+	"4 4 1 M 0 3.5 L 4 3.5",					/* horizontal lines */
+	"4 4 1 M 3.5 0 L 3.5 4",					/* vertical lines */
+	"4 4 1 M 3.5 0 L 3.5 4 M 0 3.5 L 4 3.5",			/* crosshatch */
+	"24 24 1 M 0 .5 L 24 .5 M 0 8.5 L 24 8.5 M 0 16.5 L 24 16.5 \
+M 4 24.5 L 8 16.5 M 16 .5 L 12 8.5 M 20 16.5 L 24 8.5",		/* left shingles */
+	"24 24 1 M 0 .5 L 24 .5 M 0 8.5 L 24 8.5 M 0 16.5 L 24 16.5 \
+M 4 8.5 L 8 16.5 M 12 .5 L 16 8.5 M 20 16.5 L 24 24.5",		/* right shingles */
+	"24 24 1 M .5 0 L .5 24 M 8.5 0 L 8.5 24 M 16.5 0 L 16.5 24 \
+M 8.5 4 L 16.5 8 M .5 12 L 8.5 16 M 16.5 20 L 24.5 24",		/* vert. left shingles */
+	"24 24 1 M .5 0 L .5 24 M 8.5 0 L 8.5 24 M 16.5 0 L 16.5 24 \
+M 24.5 4 L 16.5 8 M .5 16 L 8.5 12 M 16.5 20 L 8.5 24",		/* vert. right shingles */
+	"16 8 .7 A 8 -7 11 43 137 A 0 -3 11 43 137 A 16 -3 11 43 137",	/* fishscales */
+	"8 8 .7 A 4 0 4 0 180 A 0 4 4 0 180 A 8 4 4 0 180",		/* small fishscales */
+	"16 16 .7 A 8 8 8 0 360",					/* circles */
+	"26 16 .7 M 4 0 L 13 0 L 17 8 L 13 16 M 4 16 L 0 8 L 4 0 L 5 0", /* hexagons */
+	"16 16 .8 M 5 0 L 11 0 L 16 5 L 16 11 L 11 16 L 5 16 L 0 11 L 0 5 L 5 0",
+									/* octagons */
+	"8 8 .8 M -1 3 L 0 2 L 4 6 L 8 2 L 9 3",			/* horiz. sawtooth */
+	"8 8 .8 M 3 -1 L 2 0 L 6 4 L 2 8 L 3 9",			/* vert. sawtooth */
+};
+
+static Rpattern	 patterns[NUMPATTERNS];
+
+static void	 fill_edges();
+static void	 add_contour();
+static void	 mask_row();
+
+/* grow a scratch array to hold at least n elements */
+
+static char *
+grow(array, max, n, size)
+    char	*array;
+    int		*max, n, size;
+{
+	if (n <= *max)
+	    return array;
+	*max = (n > 2 * *max) ? n : 2 * *max;
+	if (*max < 64)
+	    *max = 64;
+	if ((array = realloc(array, *max * size)) == NULL) {
+	    put_msg(Err_mem);
+	    exit(1);
+	}
+	return array;
+}
+
+static void
+path_add(x, y)
+    double	x, y;
+{
+	path = (Rpoint *) grow((char *) path, &maxpath, npath+1, sizeof(Rpoint));
+	path[npath].x = x;
+	path[npath].y = y;
+	npath++;
+}
+
+/* number of chords for an arc of radius r pixels through angle radians */
+
+static int
+arc_steps(r, angle)
+    double	r, angle;
+{
+	double	da;
+	int	n;
+
+	if (r <= 0.5)
+	    return 4;
+	da = 2.0 * acos(1.0 - 0.2 / r);		/* keep within 0.2 pixel of the arc */
+	n = (int) ceil(fabs(angle) / da);
+	if (n < 4)
+	    n = 4;
+	else if (n > 2000)
+	    n = 2000;
+	return n;
+}
+
+/* append an arc (device coordinates, y down) from angle a1 to a2 */
+
+static void
+path_arc(cx, cy, r, a1, a2)
+    double	cx, cy, r, a1, a2;
+{
+	int	i, n;
+	double	a;
+
+	n = arc_steps(r, a2 - a1);
+	for (i = 0; i <= n; i++) {
+	    a = a1 + (a2 - a1) * i / n;
+	    path_add(cx + r * cos(a), cy + r * sin(a));
+	}
+}
+
+/* append a cubic Bezier curve, the current point being its start */
+
+static void
+path_bezier(x0, y0, x1, y1, x2, y2, x3, y3)
+    double	x0, y0, x1, y1, x2, y2, x3, y3;
+{
+	double	len, t, u;
+	int	i, n;
+
+	len = sqrt((x1-x0)*(x1-x0) + (y1-y0)*(y1-y0)) +
+	      sqrt((x2-x1)*(x2-x1) + (y2-y1)*(y2-y1)) +
+	      sqrt((x3-x2)*(x3-x2) + (y3-y2)*(y3-y2));
+	n = 2 + (int) (1.5 * sqrt(len));
+	if (n > 500)
+	    n = 500;
+	for (i = 1; i <= n; i++) {
+	    t = (double) i / n;
+	    u = 1.0 - t;
+	    path_add(u*u*u*x0 + 3*u*u*t*x1 + 3*u*t*t*x2 + t*t*t*x3,
+		     u*u*u*y0 + 3*u*u*t*y1 + 3*u*t*t*y2 + t*t*t*y3);
+	}
+}
+
+/*
+ * Colors
+ */
+
+static void
+get_color(color, rgb)
+    int		 color;
+    double	*rgb;
+{
+	if (color < NUM_STD_COLS) {
+	    rgb[0] = rgbcols[color > 0 ? color : 0].r;
+	    rgb[1] = rgbcols[color > 0 ? color : 0].g;
+	    rgb[2] = rgbcols[color > 0 ? color : 0].b;
+	} else {
+	    rgb[0] = user_colors[color-NUM_STD_COLS].r / 255.0;
+	    rgb[1] = user_colors[color-NUM_STD_COLS].g / 255.0;
+	    rgb[2] = user_colors[color-NUM_STD_COLS].b / 255.0;
+	}
+	if (grayonly)
+	    rgb[0] = rgb[1] = rgb[2] = rgb2luminance(rgb[0], rgb[1], rgb[2]);
+}
+
+/*
+ * Edges and the scanline filler
+ */
+
+static void
+edges_reset()
+{
+	nedges = 0;
+}
+
+static void
+add_edge(x0, y0, x1, y1)
+    double	x0, y0, x1, y1;
+{
+	Redge	*e;
+
+	if (y0 == y1)
+	    return;			/* horizontal edges never cross a scanline */
+	edges = (Redge *) grow((char *) edges, &maxedges, nedges+1, sizeof(Redge));
+	e = &edges[nedges++];
+	if (y0 < y1) {
+	    e->x0 = x0; e->y0 = y0;
+	    e->x1 = x1; e->y1 = y1;
+	    e->dir = 1;
+	} else {
+	    e->x0 = x1; e->y0 = y1;
+	    e->x1 = x0; e->y1 = y0;
+	    e->dir = -1;
+	}
+	e->dxdy = (e->x1 - e->x0) / (e->y1 - e->y0);
+}
+
+/*
+ * Add the closed contour through pts.  Pieces of a stroke are all turned
+ * the same way round so that the nonzero rule paints their union.
+ */
+
+static void
+add_contour(pts, n, orient)
+    Rpoint	*pts;
+    int		 n;
+    Boolean	 orient;
+{
+	int	i, j;
+	double	area;
+
+	if (n < 2)
+	    return;
+	area = 0.0;
+	if (orient)
+	    for (i = 0, j = n-1; i < n; j = i++)
+		area += (pts[j].x - pts[i].x) * (pts[j].y + pts[i].y);
+	if (area >= 0.0) {
+	    for (i = 0, j = n-1; i < n; j = i++)
+		add_edge(pts[j].x, pts[j].y, pts[i].x, pts[i].y);
+	} else {
+	    for (i = 0, j = n-1; i < n; j = i++)
+		add_edge(pts[i].x, pts[i].y, pts[j].x, pts[j].y);
+	}
+	if (to_mask) {
+	    fill_edges(False, (double *) NULL, (Rpattern *) NULL);
+	    edges_reset();
+	}
+}
+
+static void
+add_circle(cx, cy, r)
+    double	cx, cy, r;
+{
+	Rpoint	*c;
+	int	 i, n;
+
+	n = arc_steps(r, 2*M_PI);
+	circ = (Rpoint *) grow((char *) circ, &maxcirc, n, sizeof(Rpoint));
+	c = circ;
+	for (i = 0; i < n; i++) {
+	    c[i].x = cx + r * cos(2*M_PI*i/n);
+	    c[i].y = cy + r * sin(2*M_PI*i/n);
+	}
+	add_contour(c, n, True);
+}
+
+static void
+add_quad(x0, y0, x1, y1, x2, y2, x3, y3)
+    double	x0, y0, x1, y1, x2, y2, x3, y3;
+{
+	Rpoint	q[4];
+
+	q[0].x = x0; q[0].y = y0;
+	q[1].x = x1; q[1].y = y1;
+	q[2].x = x2; q[2].y = y2;
+	q[3].x = x3; q[3].y = y3;
+	add_contour(q, 4, True);
+}
+
+static int
+edge_cmp(e1, e2)
+    Redge	*e1, *e2;
+{
+	return (e1->y0 < e2->y0) ? -1 : (e1->y0 > e2->y0);
+}
+
+static int
+cross_cmp(c1, c2)
+    Rcross	*c1, *c2;
+{
+	return (c1->x < c2->x) ? -1 : (c1->x > c2->x);
+}
+
+/* add the span from xa to xb of one sub-scanline to the row coverage */
+
+static void
+cover_span(xa, xb)
+    double	xa, xb;
+{
+	int	i, ia, ib;
+	double	wgt;
+
+	if (xa < 0.0)
+	    xa = 0.0;
+	if (xb > pix_w)
+	    xb = pix_w;
+	if (xb <= xa)
+	    return;
+	if (nsub == 1) {
+	    /* no smoothing: a pixel is in if its center is */
+	    ia = (int) ceil(xa - 0.5);
+	    ib = (int) ceil(xb - 0.5);
+	    if (ib > pix_w)
+		ib = pix_w;
+	    if (ia >= ib)
+		return;
+	    for (i = ia; i < ib; i++)
+		cover[i] += 1.0;
+	    ib--;
+	} else {
+	    wgt = 1.0 / nsub;
+	    ia = (int) xa;
+	    ib = (int) xb;
+	    if (ia == ib) {
+		cover[ia] += (xb - xa) * wgt;
+	    } else {
+		cover[ia] += (ia + 1 - xa) * wgt;
+		for (i = ia+1; i < ib; i++)
+		    cover[i] += wgt;
+		if (ib < pix_w)
+		    cover[ib] += (xb - ib) * wgt;
+		else
+		    ib = pix_w - 1;
+	    }
+	}
+	if (ia < cov_l)
+	    cov_l = ia;
+	if (ib > cov_r)
+	    cov_r = ib;
+}
+
+/* build the line segments of a fill pattern the first time it is used */
+
+static Rpattern *
+get_pattern(num)
+    int		num;
+{
+	Rpattern *pat = &patterns[num];
+	char	*s, op;
+	double	 v[5], cx, cy, a, *seg;
+	int	 i, n, maxseg, nchars;
+
+	if (pat->seg != NULL)
+	    return pat;
+	s = pat_desc[num];
+	sscanf(s, "%lf %lf %lf%n", &pat->xstep, &pat->ystep, &pat->hw, &nchars);
+	s += nchars;
+	pat->hw /= 2.0;
+	maxseg = 0;
+	pat->nseg = 0;
+	cx = cy = 0.0;
+	while (sscanf(s, " %c%n", &op, &nchars) == 1) {
+	    s += nchars;
+	    n = (op == 'A') ? 5 : 2;
+	    for (i = 0; i < n; i++) {
+		sscanf(s, "%lf%n", &v[i], &nchars);
+		s += nchars;
+	    }
+	    if (op == 'M') {
+		cx = v[0];
+		cy = v[1];
+		continue;
+	    }
+	    /* an arc is cut into 16 chords, plenty at these sizes */
+	    for (i = 0; i < (op == 'A' ? 16 : 1); i++) {
+		pat->seg = (double *) grow((char *) pat->seg, &maxseg,
+				4*(pat->nseg+1), sizeof(double));
+		seg = &pat->seg[4*pat->nseg++];
+		if (op == 'A') {
+		    a = (v[3] + (v[4] - v[3]) * i / 16.0) * M_PI / 180.0;
+		    seg[0] = v[0] + v[2] * cos(a);
+		    seg[1] = v[1] + v[2] * sin(a);
+		    a = (v[3] + (v[4] - v[3]) * (i+1) / 16.0) * M_PI / 180.0;
+		    seg[2] = v[0] + v[2] * cos(a);
+		    seg[3] = v[1] + v[2] * sin(a);
+		} else {
+		    seg[0] = cx;
+		    seg[1] = cy;
+		    seg[2] = cx = v[0];
+		    seg[3] = cy = v[1];
+		}
+	    }
+	}
+	return pat;
+}
+
+/* how much of pixel (x,y) the pen part of a fill pattern covers */
+
+static double
+pattern_cover(pat, x, y)
+    Rpattern	*pat;
+    int		 x, y;
+{
+	double	u, v, px, py, dx, dy, t, d, dmin, hw, c;
+	double	*s;
+	int	i, ox, oy;
+
+	u = fmod((x + 0.5) * PAT_SCALE, pat->xstep);
+	v = fmod((pix_h - y - 0.5) * PAT_SCALE, pat->ystep);
+	dmin = 1e30;
+	for (ox = -1; ox <= 1; ox++)
+	    for (oy = -1; oy <= 1; oy++) {
+		px = u + ox * pat->xstep;
+		py = v + oy * pat->ystep;
+		for (i = 0, s = pat->seg; i < pat->nseg; i++, s += 4) {
+		    dx = s[2] - s[0];
+		    dy = s[3] - s[1];
+		    t = dx*dx + dy*dy;
+		    t = (t > 0.0) ? ((px-s[0])*dx + (py-s[1])*dy) / t : 0.0;
+		    if (t < 0.0)
+			t = 0.0;
+		    else if (t > 1.0)
+			t = 1.0;
+		    dx = s[0] + t*dx - px;
+		    dy = s[1] + t*dy - py;
+		    d = dx*dx + dy*dy;
+		    if (d < dmin)
+			dmin = d;
+		}
+	    }
+	/* thin pattern lines still get a pixel, like they do in ghostscript */
+	hw = pat->hw < PAT_SCALE/2 ? PAT_SCALE/2 : pat->hw;
+	dmin = sqrt(dmin);
+	if (nsub == 1)
+	    return dmin <= hw ? 1.0 : 0.0;
+	c = (hw - dmin) / PAT_SCALE + 0.5;
+	return c < 0.0 ? 0.0 : (c > 1.0 ? 1.0 : c);
+}
+
+/* blend the covered pixels of row y with color rgb */
+
+static void
+paint_row(y, rgb, pat)
+    int		 y;
+    double	*rgb;
+    Rpattern	*pat;
+{
+	unsigned char *p;
+	double	c;
+	int	x, k;
+
+	for (x = cov_l; x <= cov_r; x++) {
+	    c = cover[x];
+	    cover[x] = 0.0;
+	    if (c <= 0.0)
+		continue;
+	    if (c > 1.0)
+		c = 1.0;
+	    if (pat && (c *= pattern_cover(pat, x, y)) <= 0.0)
+		continue;
+	    p = pixels + 3 * (y * pix_w + x);
+	    for (k = 0; k < 3; k++)
+		p[k] = (unsigned char) (p[k] + c * (rgb[k] * 255.0 - p[k]) + 0.5);
+	}
+}
+
+/* keep the larger coverage of row y in the stroke mask */
+
+static void
+mask_row(y)
+    int		y;
+{
+	unsigned char *m;
+	double	c;
+	int	x, v;
+
+	m = mask + y * pix_w;
+	for (x = cov_l; x <= cov_r; x++) {
+	    c = cover[x];
+	    cover[x] = 0.0;
+	    if (c <= 0.0)
+		continue;
+	    v = (c >= 1.0) ? 255 : (int) (c * 255.0 + 0.5);
+	    if (v > m[x])
+		m[x] = v;
+	}
+	if (cov_l < msk_l)
+	    msk_l = cov_l;
+	if (cov_r > msk_r)
+	    msk_r = cov_r;
+	if (y < msk_t)
+	    msk_t = y;
+	if (y > msk_b)
+	    msk_b = y;
+}
+
+/* blend the stroke mask with color rgb and clear it for the next one */
+
+static void
+paint_mask(rgb)
+    double	*rgb;
+{
+	unsigned char *p, *m;
+	double	c;
+	int	x, y, k;
+
+	for (y = msk_t; y <= msk_b; y++) {
+	    m = mask + y * pix_w;
+	    p = pixels + 3 * (y * pix_w + msk_l);
+	    for (x = msk_l; x <= msk_r; x++, p += 3) {
+		if (m[x] == 0)
+		    continue;
+		c = m[x] / 255.0;
+		m[x] = 0;
+		for (k = 0; k < 3; k++)
+		    p[k] = (unsigned char) (p[k] + c * (rgb[k] * 255.0 - p[k]) + 0.5);
+	    }
+	}
+}
+
+/*
+ * Fill the region bounded by the edges with color rgb (masked by pattern
+ * pat, if not NULL) using the even-odd or the nonzero winding rule.
+ * In mask mode the coverage goes to the stroke mask instead.
+ */
+
+static void
+fill_edges(evenodd, rgb, pat)
+    Boolean	 evenodd;
+    double	*rgb;
+    Rpattern	*pat;
+{
+	Redge	*e;
+	Rcross	 c;
+	double	 ymax, sy, xa;
+	int	 row, row0, row1, s, i, j, next, nact, ncross, wind;
+
+	if (nedges == 0)
+	    return;
+	qsort((char *) edges, nedges, sizeof(Redge), edge_cmp);
+	ymax = edges[0].y1;
+	for (i = 1; i < nedges; i++)
+	    if (edges[i].y1 > ymax)
+		ymax = edges[i].y1;
+	row0 = (int) floor(edges[0].y0);
+	row1 = (int) ceil(ymax);
+	if (row0 < 0)
+	    row0 = 0;
+	if (row1 > pix_h)
+	    row1 = pix_h;
+	active = (int *) grow((char *) active, &maxactive, nedges, sizeof(int));
+	cross = (Rcross *) grow((char *) cross, &maxcross, nedges, sizeof(Rcross));
+
+	next = nact = 0;
+	for (row = row0; row < row1; row++) {
+	    cov_l = pix_w;
+	    cov_r = -1;
+	    for (s = 0; s < nsub; s++) {
+		sy = row + (s + 0.5) / nsub;
+		/* drop the edges that ended, pick up those that start */
+		for (i = j = 0; i < nact; i++)
+		    if (edges[active[i]].y1 > sy)
+			active[j++] = active[i];
+		nact = j;
+		for ( ; next < nedges && edges[next].y0 <= sy; next++)
+		    if (edges[next].y1 > sy)
+			active[nact++] = next;
+		/* crossings with this sub-scanline, sorted by x */
+		for (ncross = 0; ncross < nact; ncross++) {
+		    e = &edges[active[ncross]];
+		    cross[ncross].x = e->x0 + (sy - e->y0) * e->dxdy;
+		    cross[ncross].dir = e->dir;
+		}
+		if (ncross > 16) {
+		    qsort((char *) cross, ncross, sizeof(Rcross), cross_cmp);
+		} else {
+		    for (i = 1; i < ncross; i++) {
+			c = cross[i];
+			for (j = i; j > 0 && cross[j-1].x > c.x; j--)
+			    cross[j] = cross[j-1];
+			cross[j] = c;
+		    }
+		}
+		wind = 0;
+		xa = 0.0;
+		for (i = 0; i < ncross; i++) {
+		    if (evenodd) {
+			if ((wind ^= 1) != 0)
+			    xa = cross[i].x;
+			else
+			    cover_span(xa, cross[i].x);
+		    } else {
+			if (wind == 0)
+			    xa = cross[i].x;
+			wind += cross[i].dir;
+			if (wind == 0)
+			    cover_span(xa, cross[i].x);
+		    }
+		}
+	    }
+	    if (cov_r >= cov_l) {
+		if (to_mask)
+		    mask_row(row);
+		else
+		    paint_row(row, rgb, pat);
+	    }
+	}
+}
+
+/*
+ * Strokes
+ */
+
+/* add the outline of a solid (piece of a) line to the edges */
+
+static void
+stroke_piece(pts, n, closed, hw, cap, join)
+    Rpoint	*pts;
+    int		 n;
+    Boolean	 closed;
+    double	 hw;
+    int		 cap, join;
+{
+	Rpoint	*q, *a, *b, *p;
+	double	 dx, dy, len, d0x, d0y, d1x, d1y, crs, dot, sgn;
+	double	 o0x, o0y, o1x, o1y, ax, ay, bx, by;
+	int	 i, m, nseg, k;
+
+	/* drop repeated points */
+	clean = (Rpoint *) grow((char *) clean, &maxclean, n, sizeof(Rpoint));
+	q = clean;
+	for (i = m = 0; i < n; i++)
+	    if (m == 0 || fabs(pts[i].x - q[m-1].x) > 1e-6 ||
+			  fabs(pts[i].y - q[m-1].y) > 1e-6)
+		q[m++] = pts[i];
+	if (closed && m > 1 && fabs(q[0].x - q[m-1].x) <= 1e-6 &&
+			       fabs(q[0].y - q[m-1].y) <= 1e-6)
+	    m--;
+	if (m == 1) {
+	    /* a single point only shows with round or projecting caps */
+	    if (cap == 1)
+		add_circle(q[0].x, q[0].y, hw);
+	    else if (cap == 2)
+		add_quad(q[0].x-hw, q[0].y-hw, q[0].x+hw, q[0].y-hw,
+			 q[0].x+hw, q[0].y+hw, q[0].x-hw, q[0].y+hw);
+	    return;
+	}
+	if (m < 2)
+	    return;
+	if (m == 2)
+	    closed = False;
+
+	nseg = closed ? m : m-1;
+	for (i = 0; i < nseg; i++) {
+	    a = &q[i];
+	    b = &q[(i+1) % m];
+	    dx = b->x - a->x;
+	    dy = b->y - a->y;
+	    len = sqrt(dx*dx + dy*dy);
+	    dx /= len;
+	    dy /= len;
+	    ax = a->x; ay = a->y;
+	    bx = b->x; by = b->y;
+	    if (!closed && cap == 2) {
+		/* projecting caps extend the ends by half the width */
+		if (i == 0) {
+		    ax -= dx * hw;
+		    ay -= dy * hw;
+		}
+		if (i == nseg-1) {
+		    bx += dx * hw;
+		    by += dy * hw;
+		}
+	    }
+	    add_quad(ax - dy*hw, ay + dx*hw, bx - dy*hw, by + dx*hw,
+		     bx + dy*hw, by - dx*hw, ax + dy*hw, ay - dx*hw);
+	}
+
+	/* the joins */
+	for (k = closed ? 0 : 1; k < (closed ? m : m-1); k++) {
+	    p = &q[k];
+	    if (join == 1) {
+		add_circle(p->x, p->y, hw);
+		continue;
+	    }
+	    a = &q[(k + m - 1) % m];
+	    b = &q[(k + 1) % m];
+	    d0x = p->x - a->x; d0y = p->y - a->y;
+	    len = sqrt(d0x*d0x + d0y*d0y);
+	    d0x /= len; d0y /= len;
+	    d1x = b->x - p->x; d1y = b->y - p->y;
+	    len = sqrt(d1x*d1x + d1y*d1y);
+	    d1x /= len; d1y /= len;
+	    crs = d0x*d1y - d0y*d1x;
+	    dot = d0x*d1x + d0y*d1y;
+	    if (fabs(crs) < 1e-9 && dot > 0.0)
+		continue;			/* straight on */
+	    /* offsets to the outer side of the turn */
+	    sgn = (crs > 0.0) ? -hw : hw;
+	    o0x = -d0y * sgn; o0y = d0x * sgn;
+	    o1x = -d1y * sgn; o1y = d1x * sgn;
+	    if (join == 0 && 1.0 + dot >= 2.0 / (MITERLIMIT*MITERLIMIT))
+		add_quad(p->x, p->y, p->x + o0x, p->y + o0y,
+			 p->x + (o0x + o1x) / (1.0 + dot),
+			 p->y + (o0y + o1y) / (1.0 + dot),
+			 p->x + o1x, p->y + o1y);
+	    else
+		/* bevel, also when the miter would be too long */
+		add_quad(p->x, p->y, p->x + o0x, p->y + o0y,
+			 p->x + o1x, p->y + o1y, p->x, p->y);
+	}
+
+	if (!closed && cap == 1) {
+	    add_circle(q[0].x, q[0].y, hw);
+	    add_circle(q[m-1].x, q[m-1].y, hw);
+	}
+}
+
+static void
+piece_add(x, y)
+    double	x, y;
+{
+	piece = (Rpoint *) grow((char *) piece, &maxpiece, npiece+1, sizeof(Rpoint));
+	piece[npiece].x = x;
+	piece[npiece].y = y;
+	npiece++;
+}
+
+/* cut the line into dashes, each of which is stroked with caps */
+
+static void
+stroke_dashed(pts, n, closed, hw, cap, join, dash, ndash, offset)
+    Rpoint	*pts;
+    int		 n;
+    Boolean	 closed;
+    double	 hw;
+    int		 cap, join;
+    double	*dash;
+    int		 ndash;
+    double	 offset;
+{
+	double	 dx, dy, len, pos, left;
+	Boolean	 on;
+	int	 i, di, last;
+
+	di = 0;
+	on = True;
+	left = dash[0];
+	while (offset > 0.0) {
+	    if (offset < left) {
+		left -= offset;
+		break;
+	    }
+	    offset -= left;
+	    di = (di + 1) % ndash;
+	    on = !on;
+	    left = dash[di];
+	}
+	npiece = 0;
+	if (on)
+	    piece_add(pts[0].x, pts[0].y);
+	last = closed ? n : n-1;
+	for (i = 0; i < last; i++) {
+	    dx = pts[(i+1) % n].x - pts[i].x;
+	    dy = pts[(i+1) % n].y - pts[i].y;
+	    len = sqrt(dx*dx + dy*dy);
+	    pos = 0.0;
+	    while (len - pos > left) {
+		pos += left;
+		if (on) {
+		    piece_add(pts[i].x + dx*pos/len, pts[i].y + dy*pos/len);
+		    stroke_piece(piece, npiece, False, hw, cap, join);
+		    npiece = 0;
+		} else {
+		    npiece = 0;
+		    piece_add(pts[i].x + dx*pos/len, pts[i].y + dy*pos/len);
+		}
+		on = !on;
+		di = (di + 1) % ndash;
+		left = dash[di];
+	    }
+	    left -= len - pos;
+	    if (on)
+		piece_add(pts[(i+1) % n].x, pts[(i+1) % n].y);
+	}
+	if (on && npiece > 0)
+	    stroke_piece(piece, npiece, False, hw, cap, join);
+}
+
+/*
+ * Stroke the line through pts with the width, dash style, caps and joins
+ * genps.c would give it, in pen color color.
+ */
+
+static void
+draw_stroke(pts, n, closed, thickness, style, style_val, cap, join, color)
+    Rpoint	*pts;
+    int		 n;
+    Boolean	 closed;
+    double	 thickness;
+    int		 style;
+    double	 style_val;
+    int		 cap, join, color;
+{
+	double	 rgb[3], dash[8], hw, v, dot, offset, total;
+	int	 i, ndash;
+
+	if (thickness <= 0.0 || n < 1)
+	    return;
+	/* genps makes thin lines a little thinner */
+	hw = (thickness <= THICK_SCALE ? 0.5 * thickness : thickness - THICK_SCALE);
+	hw = hw * sc / 2.0;
+	if (hw < 0.5)
+	    hw = 0.5;		/* never thinner than a pixel */
+
+	ndash = 0;
+	offset = 0.0;
+	v = style_val * ppi / 80.0;
+	dot = round(ppi / 80.0);
+	if (v > 0.0) {
+	    switch (style) {
+	      case DASH_LINE:
+		dash[0] = dash[1] = round(v);
+		ndash = 2;
+		break;
+	      case DOTTED_LINE:
+		dash[0] = dot;
+		dash[1] = round(v);
+		offset = round(v);
+		ndash = 2;
+		break;
+	      case DASH_DOT_LINE:
+		dash[0] = round(v);
+		dash[1] = dash[3] = round(v*0.5);
+		dash[2] = dot;
+		ndash = 4;
+		break;
+	      case DASH_2_DOTS_LINE:
+		dash[0] = round(v);
+		dash[1] = dash[5] = round(v*0.45);
+		dash[2] = dash[4] = dot;
+		dash[3] = round(v*0.333);
+		ndash = 6;
+		break;
+	      case DASH_3_DOTS_LINE:
+		dash[0] = round(v);
+		dash[1] = dash[7] = round(v*0.4);
+		dash[2] = dash[4] = dash[6] = dot;
+		dash[3] = dash[5] = round(v*0.3);
+		ndash = 8;
+		break;
+	    }
+	}
+	total = 0.0;
+	for (i = 0; i < ndash; i++)
+	    total += (dash[i] *= sc);
+
+	/*
+	 * The pieces of a stroke (segments, joins and caps) are small convex
+	 * shapes.  Filling them one by one into a mask is much cheaper than
+	 * sorting the crossings of all of them on every scanline, and taking
+	 * the larger coverage where they overlap paints their union.
+	 */
+	edges_reset();
+	msk_l = pix_w;
+	msk_r = -1;
+	msk_t = pix_h;
+	msk_b = -1;
+	to_mask = True;
+	if (ndash > 0 && total > 0.0)
+	    stroke_dashed(pts, n, closed, hw, cap, join, dash, ndash, offset * sc);
+	else
+	    stroke_piece(pts, n, closed, hw, cap, join);
+	to_mask = False;
+	get_color(color, rgb);
+	paint_mask(rgb);
+}
+
+/* fill the closed outline pts the way fill_area() in genps.c does */
+
+static void
+draw_fill(pts, n, fill, pen_color, fill_color)
+    Rpoint	*pts;
+    int		 n, fill, pen_color, fill_color;
+{
+	double	 rgb[3], v;
+	int	 k;
+
+	if (fill == UNFILLED || n < 3)
+	    return;
+	edges_reset();
+	add_contour(pts, n, False);
+	get_color(fill_color, rgb);
+	if (fill_color <= 0 && fill < NUMSHADES+NUMTINTS) {
+	    /* gray levels for default and black shades and tints */
+	    v = 1.0 - SHADEVAL(fill);
+	    if (v < 0.0)
+		v = 0.0;
+	    rgb[0] = rgb[1] = rgb[2] = v;
+	} else if (fill < NUMSHADES) {
+	    for (k = 0; k < 3; k++)
+		rgb[k] *= SHADEVAL(fill);
+	} else if (fill < NUMSHADES+NUMTINTS) {
+	    for (k = 0; k < 3; k++)
+		rgb[k] += (1.0 - rgb[k]) * TINTVAL(fill);
+	} else {
+	    /* pattern: background in the fill color, lines in the pen color */
+	    fill_edges(True, rgb, (Rpattern *) NULL);
+	    get_color(pen_color, rgb);
+	    fill_edges(True, rgb, get_pattern(fill-NUMSHADES-NUMTINTS));
+	    return;
+	}
+	fill_edges(True, rgb, (Rpattern *) NULL);
+}
+
+/* draw an arrowhead on the line from (x1,y1) to (x2,y2), as draw_arrow() in genps.c */
+
+static void
+draw_arrowhead(arrow, x1, y1, x2, y2, linethick, col)
+    F_arrow	*arrow;
+    int		 x1, y1, x2, y2, linethick, col;
+{
+	Point	 points[50], fillpoints[50], clippts[50];
+	int	 npoints, nfillpoints, nclippts;
+	Rpoint	 head[50], fillhead[50];
+	int	 i, type;
+	Boolean	 closed;
+
+	calc_arrow(x1, y1, x2, y2, linethick, arrow, points, &npoints,
+			fillpoints, &nfillpoints, clippts, &nclippts);
+	for (i = 0; i < npoints; i++) {
+	    head[i].x = DEVX(points[i].x);
+	    head[i].y = DEVY(points[i].y);
+	}
+	for (i = 0; i < nfillpoints; i++) {
+	    fillhead[i].x = DEVX(fillpoints[i].x);
+	    fillhead[i].y = DEVY(fillpoints[i].y);
+	}
+	type = arrow->type;
+	closed = (type != 0 && type != 6 && type < 13);	/* old heads are closed */
+	if (type != 0) {
+	    if (nfillpoints == 0) {
+		if (arrow->style == 0)
+		    draw_fill(head, npoints, NUMSHADES-1, WHITE_COLOR, WHITE_COLOR);
+		else if (type < 13)
+		    draw_fill(head, npoints, NUMSHADES-1, col, col);
+	    } else {
+		/* special fill, first fill whole head with white */
+		draw_fill(head, npoints, NUMSHADES-1, WHITE_COLOR, WHITE_COLOR);
+	    }
+	}
+	/* butt caps and miter joins for sharp points */
+	draw_stroke(head, npoints, closed, arrow->thickness, SOLID_LINE, 0.0, 0, 0, col);
+	if (type != 0 && nfillpoints > 0)
+	    draw_fill(fillhead, nfillpoints, NUMSHADES-1, col, col);
+}
+
+/*
+ * The driver
+ */
+
+void
+raster_start(width, height, smooth)
+    int		width, height, smooth;
+{
+	unsigned char bg[3], *p;
+	int	i;
+
+	pix_w = width > 0 ? width : 1;
+	pix_h = height > 0 ? height : 1;
+	sc = mag / THICK_SCALE;
+	/* -S 2 and -S 4 take 4 and 8 sub-scanlines, exact coverage across */
+	nsub = (smooth > 1) ? 2 * smooth : 1;
+
+	if ((pixels = (unsigned char *) malloc(3 * pix_w * pix_h)) == NULL ||
+	    (cover = (float *) calloc(pix_w + 1, sizeof(float))) == NULL ||
+	    (mask = (unsigned char *) calloc(pix_w * pix_h, 1)) == NULL) {
+	    put_msg(Err_mem);
+	    exit(1);
+	}
+	bg[0] = bg[1] = bg[2] = 255;
+	if (bgspec) {
+	    bg[0] = background.red >> 8;
+	    bg[1] = background.green >> 8;
+	    bg[2] = background.blue >> 8;
+	    if (grayonly)
+		bg[0] = bg[1] = bg[2] = (unsigned char) (255.0 *
+			rgb2luminance(bg[0]/255.0, bg[1]/255.0, bg[2]/255.0));
+	}
+	for (i = pix_w * pix_h, p = pixels; i > 0; i--, p += 3) {
+	    p[0] = bg[0];
+	    p[1] = bg[1];
+	    p[2] = bg[2];
+	}
+	text_warned = pic_warned = False;
+
+	/* the picture readers write PostScript comments to tfp, keep
+	   them out of the output file */
+	saveofile = tfp;
+	if ((tfp = fopen("/dev/null", "w")) == NULL)
+	    tfp = tmpfile();
+}
+
+void
+raster_grid(major, minor)
+    float	major, minor;
+{
+	Rpoint	 pts[2];
+	double	 m, x, y, thick;
+
+	if (minor == 0.0 && major == 0.0)
+	    return;
+	m = (minor == 0.0) ? major : minor;
+	for (x = floor(llx / m) * m; x <= urx; x += m) {
+	    thick = (major > 0.0 && fmod(x, major) == 0.0) ?
+				THICK_SCALE * 2.5 : THICK_SCALE;
+	    pts[0].x = pts[1].x = DEVX(x);
+	    pts[0].y = 0.0;
+	    pts[1].y = pix_h;
+	    draw_stroke(pts, 2, False, thick, SOLID_LINE, 0.0, 0, 0, DEFAULT);
+	}
+	for (y = floor(lly / m) * m; y <= ury; y += m) {
+	    thick = (major > 0.0 && fmod(y, major) == 0.0) ?
+				THICK_SCALE * 2.5 : THICK_SCALE;
+	    pts[0].y = pts[1].y = DEVY(y);
+	    pts[0].x = 0.0;
+	    pts[1].x = pix_w;
+	    draw_stroke(pts, 2, False, thick, SOLID_LINE, 0.0, 0, 0, DEFAULT);
+	}
+}
+
+void
+raster_arc(a)
+    F_arc	*a;
+{
+	double	cx, cy, sx, sy, ex, ey, radius, angle1, angle2;
+	int	x, y;
+
+	cx = a->center.x; cy = a->center.y;
+	sx = a->point[0].x; sy = a->point[0].y;
+	ex = a->point[2].x; ey = a->point[2].y;
+	radius = sqrt((cx-sx)*(cx-sx) + (cy-sy)*(cy-sy));
+	angle1 = atan2(sy-cy, sx-cx);
+	angle2 = atan2(ey-cy, ex-cx);
+	/* direction 1 is counterclockwise on the page, decreasing angles here */
+	if (a->direction == 1) {
+	    while (angle2 >= angle1)
+		angle2 -= 2*M_PI;
+	} else {
+	    while (angle2 <= angle1)
+		angle2 += 2*M_PI;
+	}
+	npath = 0;
+	path_arc(DEVX(cx), DEVY(cy), radius * sc, angle1, angle2);
+	if (a->type == T_PIE_WEDGE_ARC) {
+	    path_add(DEVX(cx), DEVY(cy));
+	    path_add(DEVX(sx), DEVY(sy));
+	}
+	if (a->fill_style != UNFILLED)
+	    draw_fill(path, npath, a->fill_style, a->pen_color, a->fill_color);
+	draw_stroke(path, npath, a->type == T_PIE_WEDGE_ARC, (double) a->thickness,
+		a->style, a->style_val, a->cap_style, 0, a->pen_color);
+
+	if (a->type == T_OPEN_ARC && a->thickness > 0) {
+	    if (a->back_arrow) {
+		compute_arcarrow_angle(cx, cy, sx, sy, a->direction ^ 1,
+				a->back_arrow, &x, &y);
+		draw_arrowhead(a->back_arrow, x, y, a->point[0].x, a->point[0].y,
+				a->thickness, a->pen_color);
+	    }
+	    if (a->for_arrow) {
+		compute_arcarrow_angle(cx, cy, ex, ey, a->direction,
+				a->for_arrow, &x, &y);
+		draw_arrowhead(a->for_arrow, x, y, a->point[2].x, a->point[2].y,
+				a->thickness, a->pen_color);
+	    }
+	}
+}
+
+void
+raster_ellipse(e)
+    F_ellipse	*e;
+{
+	double	cx, cy, rx, ry, ca, sa, t, x, y;
+	int	i, n;
+
+	cx = DEVX(e->center.x);
+	cy = DEVY(e->center.y);
+	rx = e->radiuses.x * sc;
+	ry = e->radiuses.y * sc;
+	ca = cos(e->angle);
+	sa = sin(e->angle);
+	n = arc_steps(rx > ry ? rx : ry, 2*M_PI);
+	npath = 0;
+	for (i = 0; i < n; i++) {
+	    t = 2*M_PI*i/n;
+	    x = rx * cos(t);
+	    y = ry * sin(t);
+	    path_add(cx + x*ca + y*sa, cy - x*sa + y*ca);
+	}
+	if (e->fill_style != UNFILLED)
+	    draw_fill(path, npath, e->fill_style, e->pen_color, e->fill_color);
+	draw_stroke(path, npath, True, (double) e->thickness, e->style, e->style_val,
+		e->style == DOTTED_LINE ? 1 : 0, 0, e->pen_color);
+}
+
+/* paint picture object l into its box, nearest pixel */
+
+static void
+draw_picture(l)
+    F_line	*l;
+{
+	F_pic	*pic = l->pic;
+	F_pos	*p = l->pts;
+	unsigned char *pix, *bits;
+	double	 rgb[3], bx0, by0, bx1, by1, u, v, iu, iv, t;
+	int	 xmin, ymin, xmax, ymax, dx, dy, rotation;
+	int	 pllx, plly, img_w, img_h, rowbytes;
+	int	 x, y, x0, x1, y0, y1, sx, sy, i, k;
+	unsigned int *xpmdata = NULL;
+
+	if (read_picture(pic, &pllx, &plly) == 0)
+	    return;
+
+	xmin = xmax = p[0].x;
+	ymin = ymax = p[0].y;
+	for (i = 1; i < l->npts; i++) {
+	    if (p[i].x < xmin) xmin = p[i].x;
+	    if (p[i].x > xmax) xmax = p[i].x;
+	    if (p[i].y < ymin) ymin = p[i].y;
+	    if (p[i].y > ymax) ymax = p[i].y;
+	}
+	dx = p[2].x - p[0].x;
+	dy = p[2].y - p[0].y;
+	rotation = 0;
+	if (dx < 0 && dy < 0)
+	    rotation = 180;
+	else if (dx < 0 && dy >= 0)
+	    rotation = 90;
+	else if (dy < 0 && dx >= 0)
+	    rotation = 270;
+
+	img_w = pic->bit_size.x;
+	img_h = pic->bit_size.y;
+#ifdef USE_XPM
+	if (pic->subtype == P_XPM) {
+	    img_w = pic->xpmimage.width;
+	    img_h = pic->xpmimage.height;
+	    convert_xpm_colors(pic->cmap, pic->xpmimage.colorTable,
+				pic->xpmimage.ncolors);
+	    xpmdata = pic->xpmimage.data;
+	}
+#endif /* USE_XPM */
+	if (pic->subtype != P_XBM && pic->subtype != P_XPM &&
+	    pic->subtype != P_GIF && pic->subtype != P_PCX &&
+	    pic->subtype != P_PNG && pic->subtype != P_PPM &&
+	    pic->subtype != P_TIF) {
+	    /* can't decode these here, just mark the spot */
+	    if (!pic_warned)
+		fprintf(stderr, "fig2dev: %s: JPEG and EPS pictures are drawn as gray boxes\n",
+			pic->file);
+	    pic_warned = True;
+	    npath = 0;
+	    path_add(DEVX(xmin), DEVY(ymin));
+	    path_add(DEVX(xmax), DEVY(ymin));
+	    path_add(DEVX(xmax), DEVY(ymax));
+	    path_add(DEVX(xmin), DEVY(ymax));
+	    draw_fill(path, npath, NUMSHADES/4, DEFAULT, DEFAULT);
+	    return;
+	}
+	if (img_w <= 0 || img_h <= 0)
+	    return;
+
+	bx0 = DEVX(xmin); bx1 = DEVX(xmax);
+	by0 = DEVY(ymin); by1 = DEVY(ymax);
+	x0 = (int) ceil(bx0 - 0.5);
+	x1 = (int) ceil(bx1 - 0.5);
+	y0 = (int) ceil(by0 - 0.5);
+	y1 = (int) ceil(by1 - 0.5);
+	if (x0 < 0) x0 = 0;
+	if (y0 < 0) y0 = 0;
+	if (x1 > pix_w) x1 = pix_w;
+	if (y1 > pix_h) y1 = pix_h;
+	if (bx1 <= bx0 || by1 <= by0)
+	    return;
+
+	get_color(l->pen_color, rgb);
+	bits = pic->bitmap;
+	rowbytes = (img_w + 7) / 8;
+	for (y = y0; y < y1; y++) {
+	    v = (y + 0.5 - by0) / (by1 - by0);
+	    for (x = x0; x < x1; x++) {
+		u = (x + 0.5 - bx0) / (bx1 - bx0);
+		/* the top left corner of the image is at the first point */
+		switch (rotation) {
+		  case 90:  iu = v;	  iv = 1.0 - u;	break;
+		  case 180: iu = 1.0 - u; iv = 1.0 - v;	break;
+		  case 270: iu = 1.0 - v; iv = u;	break;
+		  default:  iu = u;	  iv = v;	break;
+		}
+		if (pic->flipped) {
+		    t = iu; iu = iv; iv = t;
+		}
+		sx = (int) (iu * img_w);
+		sy = (int) (iv * img_h);
+		if (sx >= img_w) sx = img_w - 1;
+		if (sy >= img_h) sy = img_h - 1;
+		pix = pixels + 3 * (y * pix_w + x);
+		if (pic->subtype == P_XBM) {
+		    /* set bits are painted in the pen color */
+		    if (bits[sy * rowbytes + sx / 8] & (0x80 >> (sx & 7)))
+			for (k = 0; k < 3; k++)
+			    pix[k] = (unsigned char) (rgb[k] * 255.0 + 0.5);
+		} else if (xpmdata) {
+		    i = xpmdata[sy * img_w + sx];
+		    pix[0] = pic->cmap[RED][i];
+		    pix[1] = pic->cmap[GREEN][i];
+		    pix[2] = pic->cmap[BLUE][i];
+		} else if (pic->numcols > 256) {
+		    /* 24-bit images are stored blue, green, red */
+		    i = 3 * (sy * img_w + sx);
+		    pix[0] = bits[i+2];
+		    pix[1] = bits[i+1];
+		    pix[2] = bits[i];
+		} else {
+		    i = bits[sy * img_w + sx];
+		    if (i == pic->transp)
+			continue;
+		    pix[0] = pic->cmap[RED][i];
+		    pix[1] = pic->cmap[GREEN][i];
+		    pix[2] = pic->cmap[BLUE][i];
+		}
+		if (grayonly && pic->subtype != P_XBM)
+		    pix[0] = pix[1] = pix[2] = (unsigned char) (255.0 *
+			rgb2luminance(pix[0]/255.0, pix[1]/255.0, pix[2]/255.0));
+	    }
+	}
+#ifdef USE_XPM
+	if (pic->subtype == P_XPM)
+	    XpmFreeXpmImage(&pic->xpmimage);
+#endif /* USE_XPM */
+}
+
+void
+raster_line(l)
+    F_line	*l;
+{
+	F_pos	*p = l->pts;
+	int	 n = l->npts;
+	int	 i, xmin, xmax, ymin, ymax, radius;
+	double	 hf_wid, r;
+	Boolean	 closed;
+
+	if (l->type == T_PIC_BOX) {
+	    draw_picture(l);
+	    return;
+	}
+	npath = 0;
+	if (n == 1) {
+	    /* a single point, drawn as a short line like genps does */
+	    if (l->cap_style > 0)
+		hf_wid = 1.0;
+	    else if (l->thickness <= THICK_SCALE)
+		hf_wid = l->thickness/4.0;
+	    else
+		hf_wid = (l->thickness-THICK_SCALE)/2.0;
+	    path_add(DEVX(round(p->x-hf_wid)), DEVY(p->y));
+	    path_add(DEVX(round(p->x+hf_wid)), DEVY(p->y));
+	    draw_stroke(path, npath, False, (double) l->thickness, SOLID_LINE, 0.0,
+			l->cap_style, l->join_style, l->pen_color);
+	    return;
+	}
+
+	if (l->type == T_ARC_BOX) {
+	    xmin = xmax = p->x;
+	    ymin = ymax = p->y;
+	    for (i = 1; i < n; i++) {
+		if (p[i].x < xmin) xmin = p[i].x;
+		if (p[i].x > xmax) xmax = p[i].x;
+		if (p[i].y < ymin) ymin = p[i].y;
+		if (p[i].y > ymax) ymax = p[i].y;
+	    }
+	    radius = l->radius;
+	    if ((xmax - xmin) / 2 < radius)
+		radius = (xmax - xmin) / 2;
+	    if ((ymax - ymin) / 2 < radius)
+		radius = (ymax - ymin) / 2;
+	    r = radius * sc;
+	    path_arc(DEVX(xmax-radius), DEVY(ymin+radius), r, -M_PI/2, 0.0);
+	    path_arc(DEVX(xmax-radius), DEVY(ymax-radius), r, 0.0, M_PI/2);
+	    path_arc(DEVX(xmin+radius), DEVY(ymax-radius), r, M_PI/2, M_PI);
+	    path_arc(DEVX(xmin+radius), DEVY(ymin+radius), r, M_PI, 1.5*M_PI);
+	    closed = True;
+	} else {
+	    for (i = 0; i < n; i++)
+		path_add(DEVX(p[i].x), DEVY(p[i].y));
+	    /* polylines with coincident endpoints are closed so the join is used */
+	    closed = (l->type != T_POLYLINE ||
+			(p[0].x == p[n-1].x && p[0].y == p[n-1].y));
+	}
+	if (l->fill_style != UNFILLED)
+	    draw_fill(path, npath, l->fill_style, l->pen_color, l->fill_color);
+	draw_stroke(path, npath, closed, (double) l->thickness, l->style, l->style_val,
+		l->cap_style, l->join_style, l->pen_color);
+
+	if (l->type == T_POLYLINE && l->thickness > 0) {
+	    if (l->back_arrow)
+		draw_arrowhead(l->back_arrow, p[1].x, p[1].y, p[0].x, p[0].y,
+				l->thickness, l->pen_color);
+	    if (l->for_arrow)
+		draw_arrowhead(l->for_arrow, p[n-2].x, p[n-2].y, p[n-1].x, p[n-1].y,
+				l->thickness, l->pen_color);
+	}
+}
+
+void
+raster_spline(s)
+    F_spline	*s;
+{
+	F_point		*p, *q;
+	F_control	*a, *b;
+	double		 x1, y1, x2, y2, x3, y3, c, d, sa, sb;
+	int		 fx1, fy1, fx2, fy2, lx1, ly1, lx2, ly2;
+	Boolean		 closed = closed_spline(s);
+
+	npath = 0;
+	p = s->points;
+	if (p == NULL || p->next == NULL)
+	    return;
+	if (int_spline(s)) {
+	    /* interpolated: a Bezier curve between each pair of points */
+	    a = s->controls;
+	    fx1 = p->x; fy1 = p->y;
+	    fx2 = round(a->rx); fy2 = round(a->ry);
+	    lx2 = fx2; ly2 = fy2;
+	    path_add(DEVX(p->x), DEVY(p->y));
+	    for (q = p->next; q != NULL; p = q, q = q->next) {
+		b = a->next;
+		path_bezier(DEVX(p->x), DEVY(p->y), DEVX(a->rx), DEVY(a->ry),
+			    DEVX(b->lx), DEVY(b->ly), DEVX(q->x), DEVY(q->y));
+		lx2 = round(b->lx); ly2 = round(b->ly);
+		a = b;
+	    }
+	    lx1 = p->x; ly1 = p->y;
+	} else {
+	    /* approximated: the quadratic sections of DrawSplineSection */
+	    x1 = p->x; y1 = p->y;
+	    p = p->next;
+	    c = p->x; d = p->y;
+	    x3 = sa = (x1 + c) / 2;
+	    y3 = sb = (y1 + d) / 2;
+	    x2 = x1; y2 = y1;
+	    fx1 = round(x1); fy1 = round(y1);
+	    fx2 = round(x3); fy2 = round(y3);
+	    if (closed) {
+		path_add(DEVX(sa), DEVY(sb));
+	    } else {
+		path_add(DEVX(x1), DEVY(y1));
+		path_add(DEVX(x3), DEVY(y3));
+	    }
+	    for (q = p->next; q != NULL; p = q, q = q->next) {
+		x1 = x3; y1 = y3;
+		x2 = c; y2 = d;
+		c = q->x; d = q->y;
+		x3 = (x2 + c) / 2;
+		y3 = (y2 + d) / 2;
+		path_bezier(DEVX(x1), DEVY(y1),
+			DEVX(x1 + (x2-x1)*0.666667), DEVY(y1 + (y2-y1)*0.666667),
+			DEVX(x3 + (x2-x3)*0.666667), DEVY(y3 + (y2-y3)*0.666667),
+			DEVX(x3), DEVY(y3));
+	    }
+	    if (closed)
+		path_bezier(DEVX(x3), DEVY(y3),
+			DEVX(x3 + (c-x3)*0.666667), DEVY(y3 + (d-y3)*0.666667),
+			DEVX(sa + (c-sa)*0.666667), DEVY(sb + (d-sb)*0.666667),
+			DEVX(sa), DEVY(sb));
+	    else
+		path_add(DEVX(c), DEVY(d));
+	    lx2 = round(x2); ly2 = round(y2);
+	    lx1 = round(c); ly1 = round(d);
+	}
+	if (s->fill_style != UNFILLED)
+	    draw_fill(path, npath, s->fill_style, s->pen_color, s->fill_color);
+	draw_stroke(path, npath, closed, (double) s->thickness, s->style, s->style_val,
+		closed ? (s->style == DOTTED_LINE ? 1 : 0) : s->cap_style, 0,
+		s->pen_color);
+
+	if (s->back_arrow && s->thickness > 0)
+	    draw_arrowhead(s->back_arrow, fx2, fy2, fx1, fy1, s->thickness, s->pen_color);
+	if (s->for_arrow && s->thickness > 0)
+	    draw_arrowhead(s->for_arrow, lx2, ly2, lx1, ly1, s->thickness, s->pen_color);
+}
+
+void
+raster_text(t)
+    F_text	*t;
+{
+	if (!text_warned)
+	    fprintf(stderr, "fig2dev: text is not drawn without ghostscript (-r)\n");
+	text_warned = True;
+}
+
+/*
+ * For the EPS previews, which have no fonts either: the box of the text
+ * as a bar of its color on half-white, as a stand-in for the letters.
+ */
+
+void
+raster_greek(t)
+    F_text	*t;
+{
+	double	 rgb[3];
+	int	 xmin, ymin, xmax, ymax, k;
+
+	text_bound(t, &xmin, &ymin, &xmax, &ymax, INCLUDE_TEXT);
+	npath = 0;
+	path_add(DEVX(xmin), DEVY(ymin));
+	path_add(DEVX(xmax), DEVY(ymin));
+	path_add(DEVX(xmax), DEVY(ymax));
+	path_add(DEVX(xmin), DEVY(ymax));
+	edges_reset();
+	add_contour(path, npath, False);
+	get_color(t->color, rgb);
+	for (k = 0; k < 3; k++)
+	    rgb[k] = 0.5 + 0.5 * rgb[k];
+	fill_edges(True, rgb, (Rpattern *) NULL);
+}
+
+/* finish drawing; the pixels stay valid until raster_free() */
+
+unsigned char *
+raster_end()
+{
+	if (tfp)
+	    fclose(tfp);
+	tfp = saveofile;
+	return pixels;
+}
+
+void
+raster_free()
+{
+	free((char *) pixels);
+	free((char *) cover);
+	free((char *) mask);
+	pixels = NULL;
+	cover = NULL;
+	mask = NULL;
+}
@@ -0,0 +1,30 @@
+/*
+ * TransFig: Facility for Translating Fig code
+ * Parts Copyright (c) 1989-2002 by Brian V. Smith
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish and/or distribute copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that this copyright
+ * notice remain intact.
+ *
+ */
+
+/*
+ *	genraster.h: built-in scanline renderer used by the bitmap driver
+ *
+ */
+
+extern void	raster_start();		/* (width, height, smooth) */
+extern void	raster_grid();
+extern void	raster_arc();
+extern void	raster_ellipse();
+extern void	raster_line();
+extern void	raster_spline();
+extern void	raster_text();
+extern void	raster_greek();		/* text as a bar, for EPS previews */
+extern unsigned char *raster_end();	/* returns the RGB pixels, 3 bytes each */
+extern void	raster_free();
@@ -52,12 +52,10 @@ static void die(const char * msg) {
  
 static char*     macroname=NULL;
 
+/* the arrays double when they are full */
 static int MAX_POINTS=100;
-#define POINT_INC 100
 static int MAX_SHAPES=20;
-#define SHAPE_INC  20
 static int  MAX_SHAPEGROUPS=5;
-#define SHAPEGROUP_INC 5
 #define bool int
 #define true 1
 #define false 0
@@ -124,7 +122,7 @@ static void add_object(char *groupid, int lstart, int depth) {
   char *groupname=NULL;
   bool ispositiv=false;
   if (num_shapes>=MAX_SHAPES) {
-    MAX_SHAPES+=SHAPE_INC;
+    MAX_SHAPES*=2;
     shapes=realloc(shapes, sizeof(shapes[0])*MAX_SHAPES);
    /**debugging stuff fprintf(stderr, "Inc to %d shapes\n", MAX_SHAPES); **/
   }  
@@ -162,7 +160,7 @@ int shapecomp(const void* s1, const void * s2) {
 static void add_shapegroup(int shapestart, int shapeend) {
   if (num_shapegroups>=MAX_SHAPEGROUPS) {
      /* maybe later dynamically realloc */
-     MAX_SHAPEGROUPS+=SHAPEGROUP_INC;
+     MAX_SHAPEGROUPS*=2;
      shapegroups=realloc(shapegroups, sizeof(shapegroups[0])*MAX_SHAPEGROUPS);
   } 
   shapegroups[num_shapegroups].shapestart=shapestart;
@@ -190,7 +188,7 @@ static void print_shapegroups() {
 
 #define ARC_STEP    (M_PI / 23) /* Make a circle to be a 46-gon */
 
-void
+int
 genshape_option(opt, optarg)
      char opt;
      char *optarg;
@@ -204,8 +202,9 @@ genshape_option(opt, optarg)
     break;
   default:
     put_msg(Err_badarg, opt, "shape");
-    exit(1);
+    return 1;
   }
+  return 0;
 }
 
 static bool scaleset=false;
@@ -268,7 +267,7 @@ static bool was_horizontal=false;
 static void add_point(int x, int y, int x2, int y2, bool intersect) {
   if (num_points>=MAX_POINTS) {
     /* realloc the linesegments */
-    MAX_POINTS+=POINT_INC;
+    MAX_POINTS*=2;
     points=realloc(points, sizeof(points[0])*MAX_POINTS);
   }  
   /* look, if this line continues the last one horizontally */
@@ -613,11 +612,10 @@ struct intersect_point {
 typedef struct intersect_point intersect_point;
 static intersect_point *intersect_points=NULL;
 static int MAX_INTERSECTPOINTS=0;
-#define INTERSECTPOINT_INC 100
 
 static realloc_intersects(int minimum) {
   while (minimum>=MAX_INTERSECTPOINTS) {
-    MAX_INTERSECTPOINTS+=INTERSECTPOINT_INC;
+    MAX_INTERSECTPOINTS*=2;
     intersect_points=realloc(intersect_points, sizeof(intersect_points[0])*MAX_INTERSECTPOINTS);
   }  
 }
@@ -729,7 +727,6 @@ typedef struct fullintersect_point fullintersect_point;
 static fullintersect_point* fips;
 static int num_fips=0;
 static int MAX_FIPS=20;
-#define FIPS_INC 20
   
 static void 
 full_intersect(lineseg* lines, int nr1, int nr2, int * num_fip) {
@@ -760,7 +757,7 @@ full_intersect(lineseg* lines, int nr1, int nr2, int * num_fip) {
      && (between_exclude(ls1->x, ls1->x2, xs) || between_exclude(ls1->y, ls1->y2, ys))) {
     if (*num_fip>=MAX_FIPS) {
       /* realloc the fips */
-      MAX_FIPS+=FIPS_INC;
+      MAX_FIPS*=2;
       fips=realloc(fips, sizeof(fips[0])*MAX_FIPS);
     }  
     fips[*num_fip].x=xs;
@@ -776,17 +773,137 @@ full_intersect(lineseg* lines, int nr1, int nr2, int * num_fip) {
     
 }
 
-static void clear_intersects(lineseg *lseg) {
+/* The crossings are found with a sweep from bottom to top.
+   The y values of the vertices are the events and are sorted once;
+   the active edge table holds the edges of the current slab between
+   two events, ordered by x.  Two edges cross inside the slab exactly
+   when the insertion sort, which brings the table into the order at
+   the next event, has to swap them, and edges meeting on an event line
+   have the same x there.  Only these pairs go to full_intersect(), so
+   the work grows with the edges, the edges per scanline and the
+   crossings, not with the square of the edges */
+
+static int *group_edges=NULL;	/* edges of the shapegroup, by lower y */
+static int  num_group_edges;
+static int *aet=NULL;		/* active edge table */
+static int  num_aet;
+static int *event_ys=NULL;
+
+#define YLOW(l)  MIN((l)->y, (l)->y2)
+#define YHIGH(l) MAX((l)->y, (l)->y2)
+
+static int intcomp(const void* i1, const void * i2) {
+  return *((int*)i1) - *((int*)i2);
+}
+
+static int edgecomp(const void* e1, const void * e2) {
+  /* the edges by their lower end, the drawing order otherwise */
+  int y1=YLOW(&points[*((int*)e1)]), y2=YLOW(&points[*((int*)e2)]);
+  if (y1!=y2) return y1-y2;
+  return *((int*)e1) - *((int*)e2);
+}
+
+static int edge_order(int e1, int e2, int y, int side) {
+  /* compare the x of two edges at y, exactly: the x of an edge at y is
+     (x*dy + dx*(y-y1))/dy with dy>0. For equal x the slopes decide the order
+     just above (side>0) or just below (side<0) y, side 0 compares only x */
+  lineseg *l1=&points[e1], *l2=&points[e2];
+  double dx1=l1->x2-l1->x, dy1=l1->y2-l1->y;
+  double dx2=l2->x2-l2->x, dy2=l2->y2-l2->y;
+  double n1, n2;
+  if (dy1<0) { dx1=-dx1; dy1=-dy1; }
+  if (dy2<0) { dx2=-dx2; dy2=-dy2; }
+  n1=(l1->y<l1->y2? l1->x: l1->x2)*dy1 + dx1*(y-YLOW(l1));
+  n2=(l2->y<l2->y2? l2->x: l2->x2)*dy2 + dx2*(y-YLOW(l2));
+  if (n1*dy2 < n2*dy1) return -1;
+  if (n1*dy2 > n2*dy1) return +1;
+  if (side==0) return 0;
+  if (dx1*dy2 < dx2*dy1) return -side;
+  if (dx1*dy2 > dx2*dy1) return +side;
+  return e1-e2;
+}
+
+static void sweep_pair(int e1, int e2) {
+  /* the lines of one polygon are not intersected with each other */
+  if (points[e1].shapenr<points[e2].shapenr) full_intersect(points, e1, e2, &num_fips);
+  if (points[e1].shapenr>points[e2].shapenr) full_intersect(points, e2, e1, &num_fips);
+}
+
+static void sweep_intersects(void) {
+  int i, j, k, e, y, num_ys=0, next=0;
+
+  for (i=0; i<num_group_edges; i++) {
+    if (points[group_edges[i]].y==points[group_edges[i]].y2) continue;
+    /* intersection with horizontal line is *not* needed */
+    event_ys[num_ys++]=points[group_edges[i]].y;
+    event_ys[num_ys++]=points[group_edges[i]].y2;
+  }
+  qsort(event_ys, num_ys, sizeof(event_ys[0]), intcomp);
+  num_aet=0;
+  for (k=0; k<num_ys; k++) {
+    y=event_ys[k];
+    if (k>0 && y==event_ys[k-1]) continue;
+    /* sort the table for just below y, the swapped edges cross in the slab */
+    for (i=1; i<num_aet; i++) {
+      e=aet[i];
+      for (j=i; j>0 && edge_order(aet[j-1], e, y, -1)>0; j--) {
+        sweep_pair(aet[j-1], e);
+        aet[j]=aet[j-1];
+      }
+      aet[j]=e;
+    }
+    /* add the edges starting here and sort for just above y */
+    for (; next<num_group_edges && YLOW(&points[group_edges[next]])<=y; next++) {
+      if (points[group_edges[next]].y!=points[group_edges[next]].y2)
+        aet[num_aet++]=group_edges[next];
+    }
+    for (i=1; i<num_aet; i++) {
+      e=aet[i];
+      for (j=i; j>0 && edge_order(aet[j-1], e, y, +1)>0; j--)
+        aet[j]=aet[j-1];
+      aet[j]=e;
+    }
+    /* edges with the same x at y meet on the event line */
+    for (i=0; i<num_aet; i=j) {
+      for (j=i+1; j<num_aet && edge_order(aet[i], aet[j], y, 0)==0; j++)
+        for (e=i; e<j; e++) sweep_pair(aet[e], aet[j]);
+    }
+    /* and drop the edges ending here */
+    for (i=j=0; i<num_aet; i++) {
+      if (YHIGH(&points[aet[i]])>y) aet[j++]=aet[i];
+    }
+    num_aet=j;
+  }
+}
+
+static int fipcomp(const void* f1, const void * f2) {
+  /* by y, then in the order of the exhaustive pairing */
+#define F1 ((fullintersect_point*)f1)
+#define F2 ((fullintersect_point*)f2)
+  if (F1->y < F2->y) return -1;
+  if (F1->y > F2->y) return +1;
+  if (points[F1->nr1].shapenr!=points[F2->nr1].shapenr)
+    return points[F1->nr1].shapenr-points[F2->nr1].shapenr;
+  if (points[F1->nr2].shapenr!=points[F2->nr2].shapenr)
+    return points[F1->nr2].shapenr-points[F2->nr2].shapenr;
+  if (F1->nr1!=F2->nr1) return F1->nr1-F2->nr1;
+  return F1->nr2-F2->nr2;
+#undef F1
+#undef F2
+}
+
+static void clear_intersects(lineseg *lseg, int first, int last) {
  int i;
- for (i=0; i<num_fips; i++) {
+ for (i=first; i<last; i++) {
    lseg[fips[i].nr1].intersect_hit=false;
    lseg[fips[i].nr2].intersect_hit=false;
  }
 }
 
-static void find_intersects(float y_val, lineseg *lseg, int *num_xvalues) {
+static void find_intersects(float y_val, lineseg *lseg, int *next_fip, int *num_xvalues) {
+ /* the fips are sorted by y, take the ones on this scanline */
  int i;
- for (i=0; i<num_fips; i++) {
+ for (i=*next_fip; i<num_fips && fips[i].y<=y_val; i++) {
    if (fips[i].y==y_val) {
      /* yeah, we found one */
 #define ip intersect_points     
@@ -812,6 +929,7 @@ static void find_intersects(float y_val, lineseg *lseg, int *num_xvalues) {
      (*num_xvalues)++;
    }
  }  
+ *next_fip=i;
 #undef ip 
 }
 
@@ -947,7 +1065,7 @@ void print_inside(float last_xvalue) {
 static void print_shape(int num_yvalues, scanline* scanlines) {
   int y_nr,i;
   float lastscale=0.1;
-  float xmin, xmax;
+  float xmin=0.0, xmax=0.0;
   bool unset=true;
   bool firstline=true;
   
@@ -1012,7 +1130,7 @@ static void print_shape(int num_yvalues, scanline* scanlines) {
 int
 genshape_end()
 { /* everything is done here */
-  int	 i, shapenr,shapenr2, shapestart, shapeend, shapegroupnr;
+  int	 i, shapenr, shapestart, shapeend, shapegroupnr;
   float	 y0, y_val;
   int	 num_yvalues, num_rawyvalues, num_xvalues;
   int	 y_nr=0;
@@ -1021,10 +1139,11 @@ genshape_end()
   float	*y_values;
   float	*above_block_borders, *below_block_borders;
   int	 num_above_borders, num_below_borders;
-  int	 snr, aind, bind;
+  int	 snr, aind, bind, j;
   bool	 equal;
   char	*oldgroupname;
   int	 oldscanlines=0;
+  int	 next_fip, first_fip, next_edge, num_active;
 
   
   if (num_points==0) die("No shape found - have you forgotten to set comments '+'?");
@@ -1033,6 +1152,9 @@ genshape_end()
   MAX_INTERSECTPOINTS=num_points;
   fips=malloc(sizeof(fullintersect_point)*num_points);
   MAX_FIPS=num_points;
+  group_edges=malloc(sizeof(group_edges[0])*num_points);
+  aet=malloc(sizeof(aet[0])*num_points);
+  event_ys=malloc(sizeof(event_ys[0])*2*num_points);
 
   qsort(shapes,num_shapes, sizeof(shapes[0]), shapecomp); 
   /* sort the shapes by their groupname */
@@ -1065,25 +1187,20 @@ genshape_end()
     shapestart=shapegroups[shapegroupnr].shapestart;
     shapeend=shapegroups[shapegroupnr].shapeend;
     
-    /* intersect each polygonline with each other in this shapegroup*/
+    /* the lines of this shapegroup, by their lower end */
+    num_group_edges=0;
+    for (i=0; i<num_points; i++) {
+      if (between_int(shapestart, shapeend, points[i].shapenr)) group_edges[num_group_edges++]=i;
+    }
+    qsort(group_edges, num_group_edges, sizeof(group_edges[0]), edgecomp);
+
+    /* intersect the polygonlines with each other in this shapegroup,
+       avoid intersecting the lines of one polygon
+       can cause confusion, but has the effect that the polygons *may not*
+       intersect itself like an '8' for example */
     num_fips=0;
-    for (shapenr=shapestart; shapenr<=shapeend; shapenr++) {
-      for (shapenr2=shapenr+1; shapenr2<=shapeend; shapenr2++) {
-
-       int nr1, nr2;
-       for (nr1=shapes[shapenr].linestart; nr1<=shapes[shapenr].lineend; nr1++) {
-         /* all lines from shape shapenr */
-         for (nr2=shapes[shapenr2].linestart; nr2<=shapes[shapenr2].lineend; nr2++) {
-          /* have to be compared with all lines from shape shapenr2 */
-          /* avoid intersecting the lines of one polygon
-             can cause confusion, but has the effect that the polygons *may not*
-             intersect itself like an '8' for example */
-           full_intersect(points, nr1, nr2, &num_fips);
-          /* fprintf(stderr, "Intersecting %d/%d \n", nr1, nr2); */
-         }  /* lines from shape shapenr2 */
-       } /* lines from shape shapenr */
-      }  /* shapenr2 */
-    } /* shapenr */  
+    sweep_intersects();
+    qsort(fips, num_fips, sizeof(fips[0]), fipcomp);
 
     /* Now sort all existing y-Coordinates */
     /* allocate memory */
@@ -1110,6 +1227,9 @@ genshape_end()
     else scanlines=realloc(scanlines, sizeof(scanline)*(num_yvalues+oldscanlines));
     /* make it bigger, if this a second pass */
     
+    next_fip=0;
+    next_edge=0;
+    num_active=0;
     for (y_nr=0; y_nr<num_yvalues; y_nr++) {
       y_val=y_values[y_nr];
   
@@ -1121,16 +1241,21 @@ genshape_end()
          with all defined lines in this shapegroup */
       num_xvalues=0;
       /* first look for intersection points of polygons */
-      clear_intersects(points);
-      find_intersects(y_val, points, &num_xvalues);
-      /* then compute horizontal intersections, leave out the found intersect-points */
-      for (i=0; i<num_points; i++) {
-        if (between_int(shapestart, shapeend, points[i].shapenr)) {
-           /* only in this shapegroup */
-           intersect(y_val, &points[i], &num_xvalues);
-           
-        }
+      first_fip=next_fip;
+      find_intersects(y_val, points, &next_fip, &num_xvalues);
+      /* then compute horizontal intersections with the lines reaching this
+         scanline, leave out the found intersect-points */
+      for (; next_edge<num_group_edges && YLOW(&points[group_edges[next_edge]])<=y_val; next_edge++)
+        aet[num_active++]=group_edges[next_edge];
+      for (i=j=0; i<num_active; i++) {
+        if (YHIGH(&points[aet[i]])>=y_val) aet[j++]=aet[i];
+      }
+      num_active=j;
+      qsort(aet, num_active, sizeof(aet[0]), intcomp);
+      for (i=0; i<num_active; i++) {
+        intersect(y_val, &points[aet[i]], &num_xvalues);
       }
+      clear_intersects(points, first_fip, next_fip);
       
       /* allocate memory for the blocks */
       above_block_borders=malloc(sizeof(float)*num_xvalues*2);
@@ -1410,9 +1535,12 @@ genshape_end()
   /* now print the result */
   print_shape(oldscanlines, scanlines);
 
-  destroy_scanlines(scanlines, num_yvalues);
+  destroy_scanlines(scanlines, oldscanlines);
   free(intersect_points);
   free(fips);
+  free(group_edges);
+  free(aet);
+  free(event_ys);
   cleanup_memory();   
   /* all ok */
   return 0;
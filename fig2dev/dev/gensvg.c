@@ -164,11 +164,17 @@
 #include "fig2dev.h"
 #include "object.h"
 #include "bound.h"
+#include "outbuf.h"
+#include "readpics.h"
 #include "../../patchlevel.h"
 
 static void svg_arrow();
 static void generate_tile(int);
 static void svg_dash(int,double);
+static Boolean svg_jpeg_href(char *, char *);
+
+extern FILE *open_picfile();
+extern void close_picfile();
           
 #define PREAMBLE "<?xml version=\"1.0\" standalone=\"no\"?>\n"\
 "<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 1.1//EN\"\n"\
@@ -236,6 +242,7 @@ int     arrowx1, arrowy1;	/* first point of object */
 int     arrowx2, arrowy2;	/* second point of object */
 
 static int tileno=0; /* number of current tile */ 
+static int picno; /* number of the last picture symbol */
 
 static F_point *p;
 
@@ -336,7 +343,58 @@ linewidth_adj(int linewidth)
 }
 
 
-void
+/*
+ * JPEG pictures are embedded as base64 data: URIs.  The file is copied as
+ * it is, a buffer at a time, and never decoded.  Writes head and the
+ * xlink:href attribute, or returns False (and writes nothing) for other
+ * pictures, which are referenced by their file name.  A JPEG picture that
+ * the figure has more than once goes into a <symbol> which every copy
+ * <use>s.
+ */
+
+static Boolean
+svg_jpeg_href (char *file, char *head)
+{
+    static char b64[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    unsigned char in[57*64];	/* 57 bytes make a line of 76 characters */
+    char out[77];
+    char realname[PATH_MAX];
+    FILE *picf;
+    size_t n, i, j;
+    unsigned long w;
+    int type;
+
+    if ((picf = open_picfile (file, &type, True, realname)) == NULL)
+	return False;
+    n = fread (in, 1, sizeof(in), picf);
+    if (n < 3 || in[0] != 0xff || in[1] != 0xd8 || in[2] != 0xff) {
+	close_picfile (picf, type);
+	return False;
+    }
+    fprintf (tfp, "%sxlink:href=\"data:image/jpeg;base64,\n", head);
+    /* a full buffer is a multiple of 3 bytes, only the last one is padded */
+    do {
+	for (i = 0; i < n; ) {
+	    for (j = 0; j < 76 && i < n; i += 3) {
+		w = (unsigned long) in[i] << 16;
+		if (i+1 < n) w |= in[i+1] << 8;
+		if (i+2 < n) w |= in[i+2];
+		out[j++] = b64[(w >> 18) & 63];
+		out[j++] = b64[(w >> 12) & 63];
+		out[j++] = i+1 < n ? b64[(w >> 6) & 63] : '=';
+		out[j++] = i+2 < n ? b64[w & 63] : '=';
+	    }
+	    out[j++] = '\n';
+	    fwrite (out, 1, j, tfp);
+	}
+    } while (n == sizeof(in) && (n = fread (in, 1, sizeof(in), picf)) > 0);
+    close_picfile (picf, type);
+    fprintf (tfp, "\"");
+    return True;
+}
+
+int
 gensvg_option (opt, optarg)
      char    opt;
      char   *optarg;
@@ -351,8 +409,9 @@ gensvg_option (opt, optarg)
       	    break;
       	default:
       	    put_msg (Err_badarg, opt, "svg");
-      	    exit (1);
+      	    return 1;
     }
+    return 0;
 }
 
 void
@@ -404,6 +463,10 @@ gensvg_start (objects)
     if (objects->comments)
 	print_comments ("<desc>", objects->comments, "</desc>");
     fprintf (tfp, "<g style=\"stroke-width:.025in; fill:none\">\n");
+
+    /* JPEG pictures that are there more than once are put in only once */
+    count_picture_uses (objects);
+    picno = 0;
     /* only define the patterns if one is used */
 
 
@@ -420,22 +483,42 @@ void
 gensvg_line (l)
      F_line *l;
 {
-int px,py,firstpoint;
+int px,py,i,n;
 int px2,py2,width,height,rotation;
 double dx,dy,len,cosa,sina,cosa1,sina1;
 double hl;
+F_pos *pt;
+int id;
+char head[128];
 
 
     if (!l->points) return; /*safeguard against old, buggy fig files*/
+    pt = l->pts;
+    n = l->npts;
     
     if (l->type ==5 ) {
 	fprintf (tfp,"<!-- Image -->\n");
-	fprintf (tfp,"<image xlink:href=\"file://%s\" preserveAspectRatio=\"none\"\n",l->pic->file);
-	p=l->points;
-	px=p->x;
-	py=p->y;
-	px2=p->next->next->x;
-	py2=p->next->next->y;
+	if ((id = picture_mark (l->pic->file)) == 0 &&
+		picture_uses (l->pic->file) > 1) {
+	    sprintf (head, "<symbol id=\"pic%d\" viewBox=\"0 0 1 1\" "
+		"preserveAspectRatio=\"none\">\n<image width=\"1\" height=\"1\" ",
+		picno + 1);
+	    if (svg_jpeg_href (l->pic->file, head)) {
+		fprintf (tfp, " preserveAspectRatio=\"none\" />\n</symbol>\n");
+		id = ++picno;
+		set_picture_mark (l->pic->file, id);
+	    }
+	}
+	if (id != 0)
+	    fprintf (tfp, "<use xlink:href=\"#pic%d\"\n", id);
+	else if (svg_jpeg_href (l->pic->file, "<image "))
+	    fprintf (tfp, " preserveAspectRatio=\"none\"\n");
+	else
+	    fprintf (tfp,"<image xlink:href=\"file://%s\" preserveAspectRatio=\"none\"\n",l->pic->file);
+	px=pt[0].x;
+	py=pt[0].y;
+	px2=pt[2].x;
+	py2=pt[2].y;
 	width=px2-px;
 	height=py2-py;
 	rotation=0;
@@ -468,10 +551,10 @@ double hl;
     {
     fprintf (tfp, "<!-- Line: box -->\n");
     print_comments ("<!-- ", l->comments, " -->");
-	px=l->points->x;
-	py=l->points->y;
-	px2=l->points->next->next->x;
-	py2=l->points->next->next->y;
+	px=pt[0].x;
+	py=pt[0].y;
+	px2=pt[2].x;
+	py2=pt[2].y;
 	width=abs(px2-px);
 	height=abs(py2-py);
 	px=(px<px2)?px:px2;
@@ -522,13 +605,12 @@ double hl;
     fprintf (tfp, "<!-- Line -->\n");
     print_comments ("<!-- ", l->comments, " -->");
     fprintf (tfp, "<%s points=\"", (l->type == 1 ? "polyline" : "polygon"));
-	px=py=-100000;
-	firstpoint=0;
-    for (p = l->points; p; p = p->next) {
-	if (px != -100000) {
-		if (firstpoint && l->back_arrow) {
-		dx=(double)(p->x-px);
-		dy=(double)(p->y-py);
+    for (i = 0; i < n-1; i++) {
+	px=pt[i].x;
+	py=pt[i].y;
+	if (i == 0 && l->back_arrow) {
+		dx=(double)(pt[1].x-px);
+		dy=(double)(pt[1].y-py);
 		len=sqrt(dx*dx+dy*dy);
 		sina1= dy/len;
 		cosa1= dx/len;
@@ -538,18 +620,20 @@ double hl;
                   hl = 1.1 * l->thickness;
 		px += (int)(hl * cosa1 +0.5);
 		py += (int)(hl * sina1 +0.5);
-		firstpoint=0;	
-		}
-	fprintf(tfp, "%d,%d\n", (int) (px*mag), (int) (py*mag));
 	}
-	arrowx1 = arrowx2;
-	arrowy1 = arrowy2;
-	arrowx2 = p->x;
-	arrowy2 = p->y;
-	if (px == -100000) firstpoint=1;
-	px=p->x;
-	py=p->y;
+	out_pair(tfp, (int) (px*mag), ',', (int) (py*mag));
+	putc('\n', tfp);
     }
+	/* last two points, for the forward arrow */
+	if (n > 1) {
+		arrowx1 = pt[n-2].x;
+		arrowy1 = pt[n-2].y;
+	} else {
+		arrowx1 = arrowx2;
+		arrowy1 = arrowy2;
+	}
+	arrowx2 = px = pt[n-1].x;
+	arrowy2 = py = pt[n-1].y;
 	if (!l->for_arrow) 
 	   fprintf(tfp, "%d,%d\n", (int) (px*mag), (int) (py*mag));
 	else { 
@@ -587,8 +671,9 @@ double hl;
 	fprintf (tfp, "</g>\n");	
 
     fprintf (tfp, "<%s points=\"", (l->type == 1 ? "polyline" : "polygon"));
-    for (p = l->points; p; p = p->next) {
-	fprintf (tfp, "%d,%d\n", (int) (p->x * mag), (int) (p->y * mag));
+    for (i = 0; i < n; i++) {
+	out_pair(tfp, (int) (pt[i].x * mag), ',', (int) (pt[i].y * mag));
+	putc('\n', tfp);
     }
 
     fprintf (tfp, "\" style=\"stroke:#%6.6x;stroke-width:%d;\n",
@@ -611,14 +696,11 @@ double hl;
 	svg_arrow(l, l->for_arrow, l->pen_color);
     }
     if (l->back_arrow != NULL) {
-	p = l->points;
-	if (!p) return; /*safeguard against old, buggy fig files*/
-	arrowx2=p->x - l->thickness*cosa1  ;
-	arrowy2=p->y - l->thickness*sina1 ;
-	p = p->next;
-	if (!p) return; /*safeguard against old, buggy fig files*/
-	arrowx1 = p->x;
-	arrowy1 = p->y;
+	arrowx2=pt[0].x - l->thickness*cosa1  ;
+	arrowy2=pt[0].y - l->thickness*sina1 ;
+	if (n < 2) return; /*safeguard against old, buggy fig files*/
+	arrowx1 = pt[1].x;
+	arrowy1 = pt[1].y;
 	svg_arrow(l, l->back_arrow, l->pen_color);
     }
 }
@@ -635,7 +717,8 @@ gensvg_spline (s) /* not used by fig2dev */
 	     rgbColorVal (s->pen_color), (int) ceil (linewidth_adj(s->thickness) * mag));
     fprintf (tfp, "M %d,%d \n C", (int) (s->points->x * mag), (int) (s->points->y * mag));
     for (p = s->points++; p; p = p->next) {
-	fprintf (tfp, "%d,%d\n", (int) (p->x * mag), (int) (p->y * mag));
+	out_pair(tfp, (int) (p->x * mag), ',', (int) (p->y * mag));
+	putc('\n', tfp);
     }
     fprintf (tfp, "\"/>\n");
 }
@@ -913,8 +996,8 @@ svg_arrow(F_line *obj, F_arrow *arrow, int pen_color)
       fprintf (tfp, "<!-- Arrowhead on XXXpoint %d %d - %d %d-->\n",(int)(arrowx1*mag),(int)(arrowy1*mag),(int)(arrowx2*mag),(int)(arrowy2*mag));
       fprintf (tfp, "<%s points=\"", (arrow->type == 0 ? "polyline" : "polygon"));
       for (i = 0; i < npoints; i++) {
-          fprintf (tfp, "%d %d\n", (int) (points[i].x * mag),
-      	     (int) (points[i].y * mag));
+          out_pair(tfp, (int) (points[i].x * mag), ' ', (int) (points[i].y * mag));
+          putc('\n', tfp);
       }
       if (arrow->type > 0)
           fprintf (tfp, "\n");
@@ -933,8 +1016,8 @@ svg_arrow(F_line *obj, F_arrow *arrow, int pen_color)
 		    /* now fill the special area */
 		    fprintf (tfp, "<path d=\"M ");
 		    for (i = 0; i < nfillpoints; i++) {
-			fprintf (tfp, "%d %d\n", (int) (fillpoints[i].x * mag),
-			     (int) (fillpoints[i].y * mag));
+			out_pair(tfp, (int) (fillpoints[i].x * mag), ' ', (int) (fillpoints[i].y * mag));
+			putc('\n', tfp);
 		    }
 		    fprintf (tfp, "Z\n");
 		    fprintf (tfp, "\" style=\"stroke:#%6.6x;stroke-width:%d;stroke-miterlimit:8;\n",
@@ -1178,6 +1261,14 @@ void svg_dash(int style, double val)
              }     
 }
 
+/* back to the defaults for the next figure of a batch */
+
+static void
+gensvg_reset ()
+{
+    tileno = 0;
+}
+
 /* driver defs */
 
 struct driver dev_svg = {
@@ -1190,5 +1281,6 @@ struct driver dev_svg = {
     gensvg_spline,
     gensvg_text,
     gensvg_end,
-    INCLUDE_TEXT
+    INCLUDE_TEXT,
+    gensvg_reset
 };
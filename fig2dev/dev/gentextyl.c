@@ -45,7 +45,7 @@ static int		line_style = 0; /* Textyl solid line style */
 static int 		linethick = 2;  /* Range is 1-12 `pixels' */
  
 
-static void
+static int
 gentextyl_option(opt, optarg)
 char opt, *optarg;
 {
@@ -80,7 +80,7 @@ char opt, *optarg;
 		    linethick = atoi(optarg);
                     if (linethick < 1 || linethick > 12) {
                       put_msg(Err_badarg, opt, "textyl");
-                      exit(1);
+                      return 1;
                     }
 		    break;
 
@@ -92,8 +92,9 @@ char opt, *optarg;
 
 	default:
 		put_msg(Err_badarg, opt, "textyl");
-		exit(1);
+		return 1;
 	}
+  return 0;
 }
 
 #define			TOP	(10.5)	/* top of page is 10.5 inch */
@@ -59,7 +59,7 @@ static int	full_page = False;
  *   g e n T k O p t i o n ( )
  */
 
-void
+int
 gentk_option(opt, optarg)
 char opt, *optarg;
 {
@@ -100,9 +100,9 @@ char opt, *optarg;
 
 	default:
 		put_msg(Err_badarg, opt, "tk");
-		exit(1);
+		return 1;
     }
-
+    return 0;
 }
 
 /*
@@ -327,8 +327,6 @@ gentk_line(F_line *l)
  *   d r a w B i t m a p ( )
  */
 
-#define	ReadOK(file,buffer,len)	(fread(buffer, len, 1, file) != 0)
-
 static void
 drawBitmap(F_line *l)
 {
@@ -338,9 +336,9 @@ drawBitmap(F_line *l)
 	F_pic	*p;
 	unsigned char	buf[16];
 	FILE	*fd;
-	int	filtype;	/* file (0) or pipe (1) */
-	int	stat;
-	FILE	*open_picfile();
+	int	filtype;	/* file (0) or memory (2) */
+	int	nhead;
+	FILE	*sniff_picfile();
 	void	close_picfile();
 	char	xname[PATH_MAX];
 
@@ -353,15 +351,15 @@ drawBitmap(F_line *l)
 
 	/* see if GIF first */
 
-	if ((fd=open_picfile(p->file, &filtype, True, xname)) == NULL) {
+	nhead = 7;
+	if ((fd=sniff_picfile(p->file, &filtype, xname, (char *) buf, &nhead)) == NULL) {
 	    fprintf(stderr,"Can't open image file %s\n",p->file);
 	    return;
 	}
 
-	/* read header */
+	/* the header has been read, the stream is at the start again */
 
-	stat = ReadOK(fd,buf,7);
-	if (!stat) {
+	if (nhead < 7) {
 		fprintf(stderr,"Image file %s too short\n",p->file);
 		close_picfile(fd,filtype);
 		return;
@@ -389,7 +387,6 @@ drawBitmap(F_line *l)
 	    niceLine("\n");
 	} else {
 	    /* Try for an X Bitmap file format. */
-	    rewind(fd);
 	    if (ReadFromBitmapFile(fd, &x, &y, &p->bitmap)) {
 		sprintf(stfp, "%s create bitmap %fi %fi -anchor nw",
 			canvas, X(l->points->x), Y(l->points->y));
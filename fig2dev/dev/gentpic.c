@@ -95,7 +95,7 @@ void gentpic_arc(), gentpic_line();
 static void bezier_spline();
 static void newline();
 
-void gentpic_option(opt, optarg)
+int gentpic_option(opt, optarg)
 char opt, *optarg;
 {
 	switch (opt) {
@@ -120,8 +120,9 @@ char opt, *optarg;
 
  	default:
 		put_msg(Err_badarg, opt, "tpic");
-		exit(1);
+		return 1;
 	}
+	return 0;
 }
 
 static double convy(a)
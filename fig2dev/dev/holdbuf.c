@@ -0,0 +1,129 @@
+/*
+ * TransFig: Facility for Translating Fig code
+ * Parts Copyright (c) 1989-2002 by Brian V. Smith
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish and/or distribute copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that this copyright
+ * notice remain intact.
+ *
+ */
+
+/*
+ * Output held back before it is written.
+ *
+ * The EPS of a previewed figure can only be written once the length of
+ * its preview is known, and the plotter drivers (gbx, ibmgl) write their
+ * objects once they have been put in order.  Meanwhile the output goes
+ * to a stream into memory, or to an anonymous temporary file when the
+ * system has no open_memstream() (HAVE_NO_OPEN_MEMSTREAM).
+ */
+
+#include "fig2dev.h"
+#include "holdbuf.h"
+
+/* start holding; what says what is held, for the error message */
+
+FILE *
+hold_open(h, what)
+    Hold_buf	*h;
+    char	*what;
+{
+	h->buf = NULL;
+	h->len = 0;
+#ifndef HAVE_NO_OPEN_MEMSTREAM
+	h->fp = open_memstream(&h->buf, &h->len);
+#else
+	h->fp = tmpfile();
+#endif /* HAVE_NO_OPEN_MEMSTREAM */
+	if (h->fp == NULL) {
+	    fprintf(stderr, "Can't hold %s: %s\n", what, strerror(errno));
+	    exit(1);
+	}
+	return h->fp;
+}
+
+/* the number of bytes held so far */
+
+long
+hold_length(h)
+    Hold_buf	*h;
+{
+	(void) fflush(h->fp);
+#ifndef HAVE_NO_OPEN_MEMSTREAM
+	return (long) h->len;
+#else
+	return ftell(h->fp);
+#endif /* HAVE_NO_OPEN_MEMSTREAM */
+}
+
+/* copy what is held to fp; more can be held after it */
+
+void
+hold_write(h, fp)
+    Hold_buf	*h;
+    FILE	*fp;
+{
+#ifndef HAVE_NO_OPEN_MEMSTREAM
+	(void) fflush(h->fp);
+	(void) fwrite(h->buf, 1, h->len, fp);
+#else
+	char	 block[BUFSIZ];
+	size_t	 n;
+
+	rewind(h->fp);
+	while ((n = fread(block, 1, sizeof block, h->fp)) > 0)
+	    (void) fwrite(block, 1, n, fp);
+	(void) fseek(h->fp, 0L, SEEK_END);
+#endif /* HAVE_NO_OPEN_MEMSTREAM */
+}
+
+/* stop holding, and drop what is held */
+
+void
+hold_close(h)
+    Hold_buf	*h;
+{
+	fclose(h->fp);
+	h->fp = NULL;
+	if (h->buf)
+	    free(h->buf);
+	h->buf = NULL;
+	h->len = 0;
+}
+
+/* stop holding, and return what is held in memory from malloc(), with
+   a '\0' after it; its length is left in h->len */
+
+char *
+hold_data(h)
+    Hold_buf	*h;
+{
+	char	*buf;
+
+#ifndef HAVE_NO_OPEN_MEMSTREAM
+	fclose(h->fp);			/* may still move the buffer */
+	buf = h->buf;
+#else
+	h->len = ftell(h->fp);
+	if ((buf = malloc(h->len + 1)) == NULL) {
+	    put_msg(Err_mem);
+	    exit(2);
+	}
+	rewind(h->fp);
+	if (fread(buf, 1, h->len, h->fp) != h->len) {
+	    fprintf(stderr, "Can't read back the held output: %s\n",
+		    strerror(errno));
+	    exit(1);
+	}
+	buf[h->len] = '\0';
+	fclose(h->fp);
+#endif /* HAVE_NO_OPEN_MEMSTREAM */
+	h->fp = NULL;
+	h->buf = NULL;
+	return buf;
+}
@@ -0,0 +1,31 @@
+/*
+ * TransFig: Facility for Translating Fig code
+ * Parts Copyright (c) 1989-2002 by Brian V. Smith
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish and/or distribute copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that this copyright
+ * notice remain intact.
+ *
+ */
+
+/*
+ *	holdbuf.h: output held back in memory before it is written
+ *
+ */
+
+typedef struct hold_buf {
+	FILE	*fp;		/* the held output is written here */
+	char	*buf;		/* and kept here (open_memstream) */
+	size_t	 len;
+} Hold_buf;
+
+extern FILE	*hold_open();		/* (h, what) start holding, exits if it can't */
+extern long	 hold_length();		/* (h) bytes held so far */
+extern void	 hold_write();		/* (h, fp) copy what is held to fp */
+extern void	 hold_close();		/* (h) stop holding and drop the output */
+extern char	*hold_data();		/* (h) stop holding, return the output */
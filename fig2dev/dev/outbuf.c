@@ -0,0 +1,193 @@
+/*
+ * TransFig: Facility for Translating Fig code
+ * Parts Copyright (c) 1989-2002 by Brian V. Smith
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish and/or distribute copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that this copyright
+ * notice remain intact.
+ *
+ */
+
+/*
+ * Output of numbers without going through printf.
+ *
+ * The drivers write coordinates, colors and image data a token at a time.
+ * Parsing a printf format for every number costs more than formatting the
+ * number, so the hot loops use these instead.  They write to the same stdio
+ * stream as the fprintf calls around them, which keeps the order of the
+ * output, and give exactly the bytes that the printf conversion would.
+ */
+
+#include "fig2dev.h"
+#include "outbuf.h"
+
+#define	OUTBUF_SIZE	65536	/* stdio buffer for the output file */
+
+static char	hexdigit[] = "0123456789abcdef";
+static char	HEXdigit[] = "0123456789ABCDEF";
+
+/* give the output file a large buffer; call it before writing to fp */
+
+void
+out_buffer(fp)
+    FILE	*fp;
+{
+	(void) setvbuf(fp, (char *) NULL, _IOFBF, OUTBUF_SIZE);
+}
+
+/* put the decimal digits of n before end, return the first one */
+
+static char *
+put_digits(end, n)
+    char		*end;
+    unsigned long	 n;
+{
+	do {
+	    *--end = '0' + n % 10;
+	    n /= 10;
+	} while (n);
+	return end;
+}
+
+/* like fprintf(fp, "%d", n) */
+
+void
+out_int(fp, n)
+    FILE	*fp;
+    int		 n;
+{
+	char	 buf[24], *p;
+
+	if (n < 0) {
+	    p = put_digits(buf + sizeof buf, (unsigned long) -(long) n);
+	    *--p = '-';
+	} else {
+	    p = put_digits(buf + sizeof buf, (unsigned long) n);
+	}
+	(void) fwrite(p, 1, buf + sizeof buf - p, fp);
+}
+
+/* like fprintf(fp, "%d%c%d", x, sep, y), for the points of a path */
+
+void
+out_pair(fp, x, sep, y)
+    FILE	*fp;
+    int		 x, sep, y;
+{
+	char	 buf[48], *p, *end;
+
+	end = buf + sizeof buf;
+	if (y < 0) {
+	    p = put_digits(end, (unsigned long) -(long) y);
+	    *--p = '-';
+	} else {
+	    p = put_digits(end, (unsigned long) y);
+	}
+	*--p = sep;
+	if (x < 0) {
+	    p = put_digits(p, (unsigned long) -(long) x);
+	    *--p = '-';
+	} else {
+	    p = put_digits(p, (unsigned long) x);
+	}
+	(void) fwrite(p, 1, end - p, fp);
+}
+
+/*
+ * Like fprintf(fp, "%.*f", prec, v).  printf rounds the exact decimal value
+ * of v; v * 10^prec is off from it by at most half a unit in the last place,
+ * so its rounding agrees unless the fraction is within a hair of one half.
+ * Those, huge values and anything not finite go to fprintf.
+ */
+
+void
+out_fixed(fp, v, prec)
+    FILE	*fp;
+    double	 v;
+    int		 prec;
+{
+	static double	scale[] = { 1.0, 10.0, 100.0, 1e3, 1e4, 1e5, 1e6 };
+	char		buf[40], *p, *end;
+	double		a, r, f;
+	unsigned long	n;
+	Boolean		neg;
+	int		i;
+
+	if (prec < 0 || prec > 6 || !(v > -1e9 && v < 1e9)) {
+	    fprintf(fp, "%.*f", prec, v);
+	    return;
+	}
+	/* -0.0, and small negative numbers, come out as "-0.0" from printf */
+	neg = v < 0.0 || (v == 0.0 && 1.0/v < 0.0);
+	a = (neg ? -v : v) * scale[prec];
+	r = floor(a);
+	f = a - r;
+	if (a >= 1e9 || (f > 0.5 - 1e-6 && f < 0.5 + 1e-6)) {
+	    fprintf(fp, "%.*f", prec, v);
+	    return;
+	}
+	n = (unsigned long) r + (f > 0.5);
+
+	end = buf + sizeof buf;
+	p = end;
+	for (i = 0; i < prec; i++) {
+	    *--p = '0' + n % 10;
+	    n /= 10;
+	}
+	if (prec > 0)
+	    *--p = '.';
+	p = put_digits(p, n);
+	if (neg)
+	    *--p = '-';
+	(void) fwrite(p, 1, end - p, fp);
+}
+
+/* write each of the n bytes as two hex digits taken from digits[] */
+
+static void
+put_hex(fp, c, n, digits)
+    FILE		*fp;
+    unsigned char	*c;
+    int			 n;
+    char		*digits;
+{
+	char	 buf[512], *p;
+	int	 m;
+
+	while (n > 0) {
+	    m = n < (int) sizeof buf / 2 ? n : (int) sizeof buf / 2;
+	    n -= m;
+	    for (p = buf; m > 0; m--, c++) {
+		*p++ = digits[*c >> 4];
+		*p++ = digits[*c & 0xf];
+	    }
+	    (void) fwrite(buf, 1, p - buf, fp);
+	}
+}
+
+/* like fprintf(fp, "%02x", c) for each of the n bytes */
+
+void
+out_hex(fp, c, n)
+    FILE		*fp;
+    unsigned char	*c;
+    int			 n;
+{
+	put_hex(fp, c, n, hexdigit);
+}
+
+/* like fprintf(fp, "%02X", c) for each of the n bytes */
+
+void
+out_HEX(fp, c, n)
+    FILE		*fp;
+    unsigned char	*c;
+    int			 n;
+{
+	put_hex(fp, c, n, HEXdigit);
+}
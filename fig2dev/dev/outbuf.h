@@ -0,0 +1,26 @@
+/*
+ * TransFig: Facility for Translating Fig code
+ * Parts Copyright (c) 1989-2002 by Brian V. Smith
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish and/or distribute copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that this copyright
+ * notice remain intact.
+ *
+ */
+
+/*
+ *	outbuf.h: output of numbers without printf
+ *
+ */
+
+extern void	out_buffer();		/* (fp) large stdio buffer */
+extern void	out_int();		/* (fp, n) like "%d" */
+extern void	out_pair();		/* (fp, x, sep, y) like "%d%c%d" */
+extern void	out_fixed();		/* (fp, v, prec) like "%.*f" */
+extern void	out_hex();		/* (fp, bytes, n) like "%02x" each */
+extern void	out_HEX();		/* (fp, bytes, n) like "%02X" each */
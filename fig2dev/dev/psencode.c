@@ -17,10 +17,35 @@
  */
 
 #include "fig2dev.h"
+#include "outbuf.h"
+#include "psimage.h"
+#ifdef USE_PNG
+#include <zlib.h>
+#endif
 
 #define MAXWIDTH       16384
 
-#define put_string nc=strlen(s); for(i=0;i<nc;i++) (putc((s[i]),tfp)); Nbyte += nc
+#define RLE_LINE	72		/* hex digits on an RLE line */
+#define RLE_BLOCK	(64*(RLE_LINE+1))	/* RLE lines written at once */
+
+/* append the packet (run, color) to the RLE lines in s */
+#define put_packet(run, color) \
+  { \
+    if (nc == RLE_LINE) { \
+      s[pos++] = '\n'; \
+      nc = 0; \
+      if (pos == RLE_BLOCK) { \
+	(void) fwrite(s, 1, pos, tfp); \
+	Nbyte += pos; \
+	pos = 0; \
+      } \
+    } \
+    s[pos++] = h[(run) / 16]; \
+    s[pos++] = h[(run) % 16]; \
+    s[pos++] = h[(color) / 16]; \
+    s[pos++] = h[(color) % 16]; \
+    nc += 4; \
+  }
 
 typedef unsigned char	byte;
 static	char		**str;
@@ -239,9 +264,9 @@ PSencode(Width, Height, Transparent, Ncol, R, G, B, data)
 {
 
   long    Nbyte;
-  char    s[80];
-  byte    *ptr, *end;
-  int     i, nc, k, current, previous, run, y;
+  char    s[RLE_BLOCK+8];
+  byte    *ptr, *end, *lim, *q;
+  int     nc, pos, k, previous, run;
 
   static char h[] = "0123456789abcdef";
 
@@ -273,12 +298,10 @@ PSencode(Width, Height, Transparent, Ncol, R, G, B, data)
 
   /* colormap */
   for (k=0; k<Ncol; k++) {
-    sprintf(s,"%02x%02x%02x", R[k], G[k], B[k]);   put_string; 
-    if (k % 10 == 9 || k == Ncol-1) { 
-      sprintf(s,"\n");                             put_string;
-    } else {
-      sprintf(s, " "); 	                           put_string;
-    }
+    s[0] = R[k]; s[1] = G[k]; s[2] = B[k];
+    out_hex(tfp, (byte *) s, 3);
+    putc((k % 10 == 9 || k == Ncol-1) ? '\n' : ' ', tfp);
+    Nbyte += 7;
   }
   if (Transparent != -1) {
 	fprintf(tfp,"\n > ] setcolorspace\n");
@@ -287,44 +310,36 @@ PSencode(Width, Height, Transparent, Ncol, R, G, B, data)
 
   /* RUN-LENGTH COMPRESSION */
 
+  /*
+   * The rows follow one another in data and runs go on from one row to
+   * the next, so the image is taken as one long row.  Each packet is the
+   * run length less one and the color, and there are 18 packets to a line.
+   */
   run   = 0;
   nc    = 0;
-  s[72] = '\n';
-  s[73] = '\0';
-  for(y=0; y<Height; y++) {
-    ptr = (data+y*Width);
-    end = ptr + Width;
-    if (y == 0) previous = *ptr++;
-    while (ptr < end) {
-      current = *ptr++;
-      if (current == previous && run < 255) {
-        run++;
-        continue;
-      }
-      if (nc == 72) {
-        put_string; 
-        nc = 0;
-      }
-      s[nc++] = h[run / 16];
-      s[nc++] = h[run % 16];
-      s[nc++] = h[previous / 16];
-      s[nc++] = h[previous % 16];
-      previous = current;
-      run = 0;
-    }
-  }
-
-  if (nc == 72) {
-    put_string; 
-    nc = 0;
+  pos   = 0;
+  ptr   = data;
+  end   = data + (long) Width * Height;
+  previous = *ptr++;
+  for (;;) {
+    /* extend the run as far as the data and the limit of 256 allow */
+    lim = ptr + (255 - run);
+    if (lim > end)
+      lim = end;
+    for (q = ptr; q < lim && *q == previous; q++)
+      ;
+    run += q - ptr;
+    ptr = q;
+    if (ptr == end)
+      break;
+    put_packet(run, previous);
+    previous = *ptr++;
+    run = 0;
   }
-  s[nc++] = h[run / 16];
-  s[nc++] = h[run % 16];
-  s[nc++] = h[previous / 16];
-  s[nc++] = h[previous % 16];
-  s[nc++] = '\n';
-  s[nc]   = '\0';
-  put_string; 
+  put_packet(run, previous);
+  s[pos++] = '\n';
+  (void) fwrite(s, 1, pos, tfp);
+  Nbyte += pos;
   return Nbyte;
 }
 
@@ -339,6 +354,8 @@ PSrgbimage(file, width, height, data)
 {
     int		 c, h, w, left;
     unsigned char *p;
+    char	 line[15*6+1], *q;
+    static char	 hexdigit[] = "0123456789abcdef";
 
     fprintf(file,"/picstr 192 string def\n");
     fprintf(file,"%d %d 8\n",width, height);
@@ -346,17 +363,25 @@ PSrgbimage(file, width, height, data)
     fprintf(file,"{currentfile picstr readhexstring pop}\n");
     fprintf(file,"false 3 colorimage\n");
 
+    /* 15 pixels to a line */
     c = 0;
     p = data;
+    q = line;
     for (h=0; h<height; h++) {
     	for (w=0; w<width; w++) {
-	    fprintf(file,"%02x%02x%02x", *(p+2), *(p+1), *p);
+	    *q++ = hexdigit[p[2] >> 4]; *q++ = hexdigit[p[2] & 0xf];
+	    *q++ = hexdigit[p[1] >> 4]; *q++ = hexdigit[p[1] & 0xf];
+	    *q++ = hexdigit[p[0] >> 4]; *q++ = hexdigit[p[0] & 0xf];
 	    p += 3;
 	    c++;
-	    if ((c % 15) == 0)
-		fprintf(file,"\n");
+	    if ((c % 15) == 0) {
+		*q++ = '\n';
+		(void) fwrite(line, 1, q - line, file);
+		q = line;
+	    }
 	}
     }
+    (void) fwrite(line, 1, q - line, file);
     /* now output zeroes to pad to 64 triples (length of picstr) */
     left = ((int)((c+63) / 64)) * 64 - c;
     for (c=0; c<left; c++) {
@@ -366,3 +391,203 @@ PSrgbimage(file, width, height, data)
     }
     fprintf(file,"\n");
 }
+
+#ifdef USE_PNG
+
+/* the Paeth predictor of PNG, applied to a row of n bytes with bpp bytes
+   per pixel (prev is the row above, NULL for the first row) */
+
+static void
+paeth_row(out, row, prev, n, bpp)
+    byte	*out, *row, *prev;
+    int		 n, bpp;
+{
+    int		 i, a, b, c, p, pa, pb, pc;
+
+    for (i = 0; i < n; i++) {
+	a = i >= bpp ? row[i-bpp] : 0;
+	b = prev ? prev[i] : 0;
+	c = i >= bpp && prev ? prev[i-bpp] : 0;
+	p = a + b - c;
+	pa = abs(p - a);
+	pb = abs(p - b);
+	pc = abs(p - c);
+	if (pa <= pb && pa <= pc)
+	    p = a;
+	else if (pb <= pc)
+	    p = b;
+	else
+	    p = c;
+	out[i] = row[i] - p;
+    }
+}
+
+/* deflate what is in z and pass it on to the ASCII85 encoder */
+
+static int
+deflate_out(z, flush)
+    z_stream	*z;
+    int		 flush;
+{
+    byte	 zbuf[8192];
+    int		 status;
+
+    do {
+	z->next_out = zbuf;
+	z->avail_out = sizeof zbuf;
+	status = deflate(z, flush);
+	if (status == Z_STREAM_ERROR)
+	    return status;
+	ASCII85Write(zbuf, sizeof zbuf - z->avail_out);
+    } while (z->avail_out == 0);
+    return status;
+}
+
+/*
+ * Write the colorspace and the dictionary of a LanguageLevel 3 image, with
+ * the deflated data coming from source.  Ncol is 0 for a 24-bit image,
+ * which goes through the PNG Paeth predictor, otherwise the data has one
+ * byte per pixel indexing the R, G, B colormap.  A Transparent color index
+ * becomes the /MaskColor of a type 4 image.  The image is drawn into the
+ * unit square, like PSencode() and PSrgbimage() do.
+ */
+
+static void
+flate_image(Width, Height, Transparent, Ncol, R, G, B, source)
+    int		Width, Height, Transparent, Ncol;
+    byte	R[], G[], B[];
+    char	*source;
+{
+    byte	 rgb[3];
+    int		 k;
+
+    if (Ncol > 0) {
+	fprintf(tfp, "[/Indexed /DeviceRGB %d <\n", Ncol-1);
+	for (k = 0; k < Ncol; k++) {
+	    rgb[0] = R[k]; rgb[1] = G[k]; rgb[2] = B[k];
+	    out_hex(tfp, rgb, 3);
+	    putc((k % 10 == 9 || k == Ncol-1) ? '\n' : ' ', tfp);
+	}
+	fprintf(tfp, "> ] setcolorspace\n");
+    } else {
+	fprintf(tfp, "/DeviceRGB setcolorspace\n");
+    }
+    fprintf(tfp, "<< /ImageType %d /Width %d /Height %d /BitsPerComponent 8\n",
+		Transparent != -1 ? 4 : 1, Width, Height);
+    fprintf(tfp, "   /Decode [%s] /ImageMatrix [%d 0 0 %d 0 %d]\n",
+		Ncol > 0 ? "0 255" : "0 1 0 1 0 1", Width, -Height, Height);
+    if (Transparent != -1)
+	fprintf(tfp, "   /MaskColor [%d]\n", Transparent);
+    fprintf(tfp, "   /DataSource %s\n", source);
+    if (Ncol > 0)
+	fprintf(tfp, "\t/FlateDecode filter\n");
+    else
+	fprintf(tfp, "\t<< /Predictor 15 /Colors 3 /Columns %d >> /FlateDecode filter\n",
+		Width);
+    fprintf(tfp, ">> image\n");
+}
+
+/* deflate the image data (24-bit BGR triples are reordered and predicted)
+   and write it in ASCII85 */
+
+static void
+flate_data(Width, Height, Ncol, data)
+    int		Width, Height, Ncol;
+    unsigned char *data;
+{
+    z_stream	 z;
+    byte	*row, *prev, *line, *p, *q;
+    int		 rowlen, x, y;
+    Boolean	 zok;
+
+    z.zalloc = Z_NULL;
+    z.zfree = Z_NULL;
+    z.opaque = Z_NULL;
+    if (!(zok = deflateInit(&z, Z_DEFAULT_COMPRESSION) == Z_OK)) {
+	fprintf(stderr, "fig2dev: can't initialize zlib for image\n");
+	Height = 0;
+    }
+    rowlen = Ncol > 0 ? Width : 3 * Width;
+    row = prev = line = NULL;
+    if (zok && Ncol == 0 && ((row = (byte *) malloc(rowlen)) == NULL ||
+		(prev = (byte *) malloc(rowlen)) == NULL ||
+		(line = (byte *) malloc(rowlen + 1)) == NULL)) {
+	fprintf(stderr, "fig2dev: can't allocate memory for image\n");
+	Height = 0;
+    }
+
+    /* on errors the data is cut short, but still ends properly */
+    ASCII85Begin(tfp);
+    for (y = 0; y < Height; y++) {
+	if (Ncol > 0) {
+	    z.next_in = data + (long) y * Width;
+	    z.avail_in = Width;
+	} else {
+	    /* BGR to RGB, then the filter type byte and the Paeth differences */
+	    p = data + (long) y * rowlen;
+	    for (x = 0, q = row; x < Width; x++, p += 3) {
+		*q++ = p[2];
+		*q++ = p[1];
+		*q++ = p[0];
+	    }
+	    line[0] = 4;
+	    paeth_row(line + 1, row, y > 0 ? prev : (byte *) NULL, rowlen, 3);
+	    p = prev; prev = row; row = p;
+	    z.next_in = line;
+	    z.avail_in = rowlen + 1;
+	}
+	(void) deflate_out(&z, Z_NO_FLUSH);
+    }
+    if (zok) {
+	(void) deflate_out(&z, Z_FINISH);
+	deflateEnd(&z);
+    }
+    ASCII85End();
+    putc('\n', tfp);
+    if (row) free(row);
+    if (prev) free(prev);
+    if (line) free(line);
+}
+
+/* write an image for PostScript LanguageLevel 3, its data follows inline */
+
+void
+PSflateimage(Width, Height, Transparent, Ncol, R, G, B, data)
+    int		Width, Height, Transparent, Ncol;
+    byte	R[], G[], B[];
+    unsigned char *data;
+{
+    if (Ncol == 0)
+	Transparent = -1;		/* only a colormap has a transparent index */
+    flate_image(Width, Height, Transparent, Ncol, R, G, B,
+		"currentfile /ASCII85Decode filter");
+    flate_data(Width, Height, Ncol, data);
+}
+
+/*
+ * Define procedure Im<Ident> to draw the image like PSflateimage() does.
+ * The deflated data is kept in a ReusableStreamDecode filter, Im<Ident>Data,
+ * which is rewound every time, so that an image drawn many times is only
+ * in the file once.
+ */
+
+void
+PSflatedefine(Ident, Width, Height, Transparent, Ncol, R, G, B, data)
+    int		Ident, Width, Height, Transparent, Ncol;
+    byte	R[], G[], B[];
+    unsigned char *data;
+{
+    char	 source[40];
+
+    if (Ncol == 0)
+	Transparent = -1;
+    fprintf(tfp, "/Im%dData currentfile /ASCII85Decode filter /ReusableStreamDecode filter\n",
+		Ident);
+    flate_data(Width, Height, Ncol, data);
+    fprintf(tfp, "def\n/Im%d {\n", Ident);
+    sprintf(source, "Im%dData dup 0 setfileposition", Ident);
+    flate_image(Width, Height, Transparent, Ncol, R, G, B, source);
+    fprintf(tfp, "} bind def\n");
+}
+
+#endif /* USE_PNG */
@@ -19,3 +19,5 @@ void	PSencode_header();
 void	PStransp_header();
 long	PSencode();
 void	PSrgbimage();
+void	PSflateimage();
+void	PSflatedefine();
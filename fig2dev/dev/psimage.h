@@ -32,3 +32,8 @@ typedef struct {
 
 #define	DPI_IGNORE (float) (-1.0) /* dummy value for imagedata.dpi       */
 #define DPI_USE_FILE ((float) 0.0)/* dummy value for imagedata.dpi       */
+
+/* ASCII85 encoding of data handed over in pieces (asc85ec.c) */
+extern void ASCII85Begin(FILE *out);
+extern void ASCII85Write(unsigned char *p, size_t n);
+extern void ASCII85End(void);
@@ -13,8 +13,18 @@
  *
  */
 
+#ifdef HAVE_COPY_FILE_RANGE
+#define _GNU_SOURCE		/* for copy_file_range() */
+#endif
 #include "fig2dev.h"
 #include "object.h"
+#include <sys/stat.h>
+#ifndef HAVE_NO_MMAP
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
 
 /* for both procedures:
      return codes:  1 : success
@@ -22,6 +32,23 @@
 */
 
 static int	read_eps_pdf();
+static int	eof_line();
+static Boolean	copy_eps_map();
+static void	splice_eps();
+
+/*
+ * An EPS file with a DOS binary header (from Windows programs) has the
+ * PostScript at an offset given in the header, followed by a TIFF or
+ * Windows metafile preview.  read_eps() finds it; copy_eps() copies from
+ * there.
+ */
+
+#define	DOS_EPS_MAGIC	"\305\320\323\306"
+
+static long	eps_start;		/* where the PostScript starts */
+static long	eps_len;		/* and its length, -1 if to the end */
+
+#define	EPS_BLOCK	65536		/* for copying EPS files */
 
 /* read a PDF file */
 
@@ -74,7 +101,23 @@ read_eps_pdf(file, filetype, pic, llx, lly, pdf_flag)
 	pic->bit_size.y = 10;
 	nested = 0;
 
-	while (fgets(buf, 512, file) != NULL) {
+	/* look for a DOS EPS header */
+	eps_start = 0;
+	eps_len = -1;
+	if (!pdf_flag && fread(buf, 1, 12, file) == 12 &&
+		!memcmp(buf, DOS_EPS_MAGIC, 4)) {
+	    eps_start = (buf[4] & 0xff) | (buf[5] & 0xff) << 8 |
+			(buf[6] & 0xff) << 16 | (long) (buf[7] & 0xff) << 24;
+	    eps_len = (buf[8] & 0xff) | (buf[9] & 0xff) << 8 |
+			(buf[10] & 0xff) << 16 | (long) (buf[11] & 0xff) << 24;
+	}
+	if (fseek(file, eps_start, SEEK_SET) != 0) {
+	    fprintf(stderr,"Bad EPS file: %s\n", pic->file);
+	    return 0;
+	}
+
+	while ((eps_len < 0 || ftell(file) < eps_start + eps_len) &&
+		fgets(buf, 512, file) != NULL) {
 	    /* look for /MediaBox for pdf file */
 	    if (pdf_flag) {
 		if (!strncmp(buf, "/MediaBox", 8)) {	/* look for the MediaBox spec */
@@ -117,3 +160,195 @@ read_eps_pdf(file, filetype, pic, llx, lly, pdf_flag)
 	fprintf(tfp, "%%\n");
 	return 1;
 }
+
+/*
+ * Copy the PostScript of the EPS file read last by read_eps() from stream
+ * file (of type filetype, see open_picfile()) to out, without the lines
+ * that are only %%EOF or %EOF, which would end the including document.
+ * The file goes through a buffer a block at a time, or if it is a plain
+ * file and out a regular one, it is mapped to find those lines and the
+ * rest is copied by the kernel.
+ */
+
+void
+copy_eps(file, filetype, out)
+    FILE	*file;
+    int		 filetype;
+    FILE	*out;
+{
+	static char	*buf = NULL;
+	char		*p, *q, *keep, *end;
+	long		 left;
+	size_t		 have, want, n;
+	Boolean		 more, linestart;
+	int		 k;
+
+#ifndef HAVE_NO_MMAP
+	if (filetype == 0) {
+	    struct stat	 st;
+
+	    if (fstat(fileno(out), &st) == 0 && S_ISREG(st.st_mode) &&
+		    copy_eps_map(file, out))
+		return;
+	}
+#endif /* HAVE_NO_MMAP */
+	if (buf == NULL && (buf = malloc(EPS_BLOCK)) == NULL) {
+	    fprintf(stderr,"Can't allocate memory to copy EPS file\n");
+	    return;
+	}
+	if (fseek(file, eps_start, SEEK_SET) != 0)
+	    return;
+	left = eps_len;
+	have = 0;		/* bytes kept from the last block */
+	linestart = True;	/* buf starts a line */
+	do {
+	    want = EPS_BLOCK - have;
+	    if (left >= 0 && want > (size_t) left)
+		want = left;
+	    n = want > 0? fread(buf + have, 1, want, file): 0;
+	    if (left >= 0)
+		left -= n;
+	    more = n > 0 && left != 0;
+	    end = buf + have + n;
+	    p = keep = buf;
+	    if (!linestart) {
+		if ((q = memchr(p, '\n', end - p)) == NULL)
+		    p = end;
+		else
+		    p = q + 1;
+		linestart = q != NULL;
+	    }
+	    /* p is at the start of a line, or at the end */
+	    while (p < end) {
+		if ((k = eof_line(p, end, more)) < 0)
+		    break;		/* could be one, keep it for the next block */
+		if (k > 0) {
+		    fwrite(keep, 1, p - keep, out);
+		    keep = p += k;
+		    continue;
+		}
+		if ((q = memchr(p, '\n', end - p)) == NULL) {
+		    p = end;
+		    linestart = False;
+		} else {
+		    p = q + 1;
+		}
+	    }
+	    fwrite(keep, 1, p - keep, out);
+	    have = end - p;
+	    memmove(buf, p, have);
+	} while (more);
+}
+
+/*
+ * The length of the line at p if it is only %%EOF or %EOF, with its end of
+ * line; 0 if it isn't, and -1 if it can't be told from the data up to end
+ * and more is to come.
+ */
+
+static int
+eof_line(p, end, more)
+    char	*p, *end;
+    Boolean	 more;
+{
+	static char	*marker[] = { "%%EOF", "%EOF" };
+	char		*q;
+	int		 i, n;
+
+	for (i = 0; i < 2; i++) {
+	    n = strlen(marker[i]);
+	    if (end - p < n) {
+		if (more && !memcmp(p, marker[i], end - p))
+		    return -1;
+		continue;
+	    }
+	    if (memcmp(p, marker[i], n))
+		continue;
+	    q = p + n;
+	    if (q < end && *q == '\r')
+		q++;
+	    if (q == end)
+		return more? -1: q - p;
+	    if (*q == '\n')
+		return q + 1 - p;
+	    if (q[-1] == '\r')
+		return q - p;		/* a line ending in CR only */
+	}
+	return 0;
+}
+
+#ifndef HAVE_NO_MMAP
+
+/* copy_eps() from a plain file to a regular file, False if it can't be mapped */
+
+static Boolean
+copy_eps_map(file, out)
+    FILE	*file, *out;
+{
+	struct stat	 st;
+	char		*base, *p, *q, *keep, *end;
+	int		 k;
+
+	if (fstat(fileno(file), &st) != 0 || eps_start >= st.st_size ||
+		(base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+			fileno(file), 0)) == (char *) MAP_FAILED)
+	    return False;
+#ifdef MADV_SEQUENTIAL
+	(void) madvise(base, st.st_size, MADV_SEQUENTIAL);
+#endif
+	p = keep = base + eps_start;
+	end = base + st.st_size;
+	if (eps_len >= 0 && eps_len < end - p)
+	    end = p + eps_len;
+	/* the output goes around stdio from here on */
+	fflush(out);
+	while (p < end) {
+	    if ((k = eof_line(p, end, False)) > 0) {
+		splice_eps(fileno(file), base, keep, p - keep, fileno(out));
+		keep = p += k;
+	    } else if ((q = memchr(p, '\n', end - p)) == NULL) {
+		p = end;
+	    } else {
+		p = q + 1;
+	    }
+	}
+	splice_eps(fileno(file), base, keep, p - keep, fileno(out));
+	(void) munmap(base, st.st_size);
+	return True;
+}
+
+/*
+ * Copy the len bytes at p, of file fd mapped at base, to file ofd; by the
+ * kernel if it can, else from the map.
+ */
+
+static void
+splice_eps(fd, base, p, len, ofd)
+    int		 fd, ofd;
+    char	*base, *p;
+    long	 len;
+{
+	ssize_t	 n;
+#if defined(HAVE_COPY_FILE_RANGE) || defined(HAVE_SENDFILE)
+	off_t	 off;
+
+	off = p - base;
+	while (len > 0) {
+#ifdef HAVE_COPY_FILE_RANGE
+	    n = copy_file_range(fd, &off, ofd, NULL, (size_t) len, 0);
+#else
+	    n = sendfile(ofd, fd, &off, (size_t) len);
+#endif
+	    if (n <= 0)
+		break;		/* not between these files, write the rest */
+	    len -= n;
+	}
+	p = base + off;
+#endif /* HAVE_COPY_FILE_RANGE || HAVE_SENDFILE */
+	while (len > 0 && (n = write(ofd, p, (size_t) len)) > 0) {
+	    p += n;
+	    len -= n;
+	}
+}
+
+#endif /* HAVE_NO_MMAP */
@@ -28,9 +28,6 @@
 #include "fig2dev.h"
 #include "object.h"
 
-extern	FILE	*open_picfile();
-extern	int	 _read_pcx();
-
 #define BUFLEN 1024
 
 /* Some of the following code is extracted from giftopnm.c, from the netpbm package */
@@ -49,13 +46,17 @@ extern	int	 _read_pcx();
 static Boolean	 ReadColorMap();
 static Boolean	 DoGIFextension();
 static int	 GetDataBlock();
+static Boolean	 ReadImage();
 
 #define LOCALCOLORMAP		0x80
+#define INTERLACE		0x40
 #define	ReadOK(file,buffer,len)	(fread(buffer, len, 1, file) != 0)
 #define BitSet(byte, bit)	(((byte) & (bit)) == (bit))
 
 #define LM_to_uint(a,b)			(((b)<<8)|(a))
 
+#define MAX_LZW_BITS		12
+
 struct {
 	unsigned int	Width;
 	unsigned int	Height;
@@ -78,29 +79,18 @@ struct {
 */
 
 int
-read_gif(filename,filetype,pic,llx,lly)
-    char	   *filename;
+read_gif(file,filetype,pic,llx,lly)
+    FILE	   *file;
     int		    filetype;
     F_pic	   *pic;
     int		   *llx, *lly;
 {
-	char		 buf[BUFLEN],pcxname[PATH_MAX];
-	char		 realname[PATH_MAX];
-	FILE		*file, *giftopcx;
-	int		 i, stat, size;
+	unsigned char	 buf[BUFLEN];
+	int		 i;
 	int		 useGlobalColormap;
-	unsigned int	 bitPixel;
+	unsigned int	 bitPixel, width, height;
 	unsigned char	 c;
 	char		 version[4];
-	unsigned char    transp[3]; /* RGB of transparent color (if any) */
-
-	/* open the file */
-	if ((file=open_picfile(filename, &filetype, False, realname)) == NULL) {
-		fprintf(stderr,"No such GIF file: %s\n",realname);
-		return 0;
-	}
-
-	/* first read header to look for any transparent color extension */
 
 	*llx = *lly = 0;
 
@@ -131,10 +121,12 @@ read_gif(filename,filetype,pic,llx,lly)
 	GifScreen.Background      = (unsigned int) buf[5];
 	GifScreen.AspectRatio     = (unsigned int) buf[6];
 
+	bitPixel = 2;
 	if (BitSet(buf[4], LOCALCOLORMAP)) {	/* Global Colormap */
 		if (!ReadColorMap(file,GifScreen.BitPixel,pic->cmap)) {
 			return 0;	/* error reading global colormap */
 		}
+		bitPixel = GifScreen.BitPixel;
 	}
 
 	/* assume no transparent color for now */
@@ -145,8 +137,8 @@ read_gif(filename,filetype,pic,llx,lly)
 			return 0;	/* EOF / read error on image data */
 		}
 
-		if (c == ';') {			/* GIF terminator, finish up */
-			break;			/* all done */
+		if (c == ';') {			/* GIF terminator without an image */
+			return 0;
 		}
 
 		if (c == '!') { 		/* Extension */
@@ -161,78 +153,189 @@ read_gif(filename,filetype,pic,llx,lly)
 		}
 
 		if (! ReadOK(file,buf,9)) {
-			return 1;	/* couldn't read left/top/width/height */
+			return 0;	/* couldn't read left/top/width/height */
 		}
 
 		useGlobalColormap = ! BitSet(buf[8], LOCALCOLORMAP);
 
-		bitPixel = 1<<((buf[8]&0x07)+1);
-
 		if (! useGlobalColormap) {
+		    bitPixel = 1<<((buf[8]&0x07)+1);
 		    if (!ReadColorMap(file, bitPixel, pic->cmap)) {
 			fprintf(stderr,"error reading local GIF colormap\n" );
-			return 1;
+			return 0;
 		    }
 		}
 		break;				/* image starts here, header is done */
 	}
 
+	width = LM_to_uint(buf[4],buf[5]);
+	height = LM_to_uint(buf[6],buf[7]);
+	if (width == 0 || height == 0)
+		return 0;
+
 	/* output PostScript comment */
 	fprintf(tfp, "%% Originally from a GIF File: %s\n\n", pic->file);
 
-	/* save transparent indicator */
-	pic->transp = Gif89.transparent;
-	/* and RGB values */
-	if (pic->transp != -1) {
-	    transp[RED]   = pic->cmap[RED][pic->transp];
-	    transp[GREEN] = pic->cmap[GREEN][pic->transp];
-	    transp[BLUE]  = pic->cmap[BLUE][pic->transp];
+	/* decode the image right into the bitmap, one palette index per
+	   pixel; the transparent color keeps its index */
+	if ((pic->bitmap = malloc(width * height)) == NULL) {
+		fprintf(stderr,"Can't allocate memory for GIF image\n");
+		return 0;
 	}
-
-	/* reposition the file at the beginning */
-	fseek(file, 0, SEEK_SET);
-	
-	/* now call giftopnm and ppmtopcx */
-
-	/* make name for temp output file */
-	sprintf(pcxname, "%s/%s%06d.pix", TMPDIR, "xfig-pcx", getpid());
-	/* make command to convert gif to pcx into temp file */
-	sprintf(buf, "giftopnm -quiet | ppmtopcx -quiet > %s 2> /dev/null", pcxname);
-	if ((giftopcx = popen(buf,"w" )) == 0) {
-	    fprintf(stderr,"Cannot open pipe to giftoppm\n");
-	    return 0;
+	if (!ReadImage(file, pic->bitmap, width, height, BitSet(buf[8], INTERLACE))) {
+		free(pic->bitmap);
+		pic->bitmap = NULL;
+		return 0;
 	}
-	while ((size=fread(buf, 1, BUFLEN, file)) != 0) {
-	    fwrite(buf, size, 1, giftopcx);
+
+	pic->subtype = P_GIF;
+	pic->transp = Gif89.transparent;
+	pic->numcols = bitPixel;
+	pic->bit_size.x = width;
+	pic->bit_size.y = height;
+	/* if user wants grayscale (-N) then map to gray */
+	if (grayonly)
+	    for (i = 0; i < pic->numcols; i++)
+		pic->cmap[RED][i] = pic->cmap[GREEN][i] = pic->cmap[BLUE][i] =
+		    (int) (rgb2luminance(pic->cmap[RED][i]/255.0,
+					pic->cmap[GREEN][i]/255.0,
+					pic->cmap[BLUE][i]/255.0)*255.0);
+
+	return 1;
+}
+
+/*
+ * Decode the LZW data of an image into bitmap (width*height bytes), rows
+ * in the order of the interlace passes if interlaced.  A premature end of
+ * the data leaves the rest of the image at index 0, like giftopnm.
+ */
+
+static Boolean
+ReadImage(fd, bitmap, width, height, interlaced)
+FILE		*fd;
+unsigned char	*bitmap;
+unsigned int	 width, height;
+int		 interlaced;
+{
+	static short	 prefix[1<<MAX_LZW_BITS];
+	static unsigned char suffix[1<<MAX_LZW_BITS];
+	static unsigned char stack[(1<<MAX_LZW_BITS)+1];
+	static int	 pass_start[4] = { 0, 4, 2, 1 };
+	static int	 pass_step[4] = { 8, 8, 4, 2 };
+	unsigned char	 block[256], *sp, *row, *end;
+	unsigned char	 c, first;
+	unsigned long	 datum;
+	int		 bits, count, bp;
+	int		 min_code_size, code_size, code_mask, clear, eoi;
+	int		 code, incode, oldcode, avail;
+	unsigned int	 x, y;
+	int		 pass;
+
+	if (! ReadOK(fd,&c,1))
+		return False;
+	min_code_size = c;
+	if (min_code_size < 1 || min_code_size >= MAX_LZW_BITS) {
+		fprintf(stderr,"bad GIF code size %d\n", min_code_size);
+		return False;
 	}
-	/* close pipe */
-	pclose(giftopcx);
-	if ((giftopcx = fopen(pcxname, "rb")) == NULL) {
-	    fprintf(stderr,"Can't open temp output file\n");
-	    return 0;
+	clear = 1 << min_code_size;
+	eoi = clear + 1;
+	for (code = 0; code < clear; code++) {
+		prefix[code] = -1;
+		suffix[code] = code;
 	}
-	/* now call _read_pcx to read the pcx file */
-	stat = _read_pcx(giftopcx, pic);
-	/* close file */
-	fclose(giftopcx);
-
-	/* remove temp file */
-	unlink(pcxname);
-
-	/* now match original transparent colortable index with possibly new 
-	   colortable from ppmtopcx */
-	if (pic->transp != -1) {
-	    for (i=0; i<pic->numcols; i++) {
-		if (pic->cmap[RED][i]   == transp[RED] &&
-		    pic->cmap[GREEN][i] == transp[GREEN] &&
-		    pic->cmap[BLUE][i]  == transp[BLUE])
+	code_size = min_code_size + 1;
+	code_mask = (1 << code_size) - 1;
+	avail = clear + 2;
+	oldcode = -1;
+	first = 0;
+
+	memset(bitmap, 0, width * height);
+	x = y = 0;
+	pass = 0;
+	row = bitmap;
+	end = bitmap + width * height;
+
+	datum = 0;
+	bits = count = bp = 0;
+	for (;;) {
+		/* next code from the data sub-blocks */
+		while (bits < code_size) {
+			if (count == 0) {
+				if ((count = GetDataBlock(fd, block)) <= 0)
+					return True;	/* premature end */
+				bp = 0;
+			}
+			datum |= (unsigned long) block[bp++] << bits;
+			bits += 8;
+			count--;
+		}
+		code = datum & code_mask;
+		datum >>= code_size;
+		bits -= code_size;
+
+		if (code == clear) {
+			code_size = min_code_size + 1;
+			code_mask = (1 << code_size) - 1;
+			avail = clear + 2;
+			oldcode = -1;
+			continue;
+		}
+		if (code == eoi)
 			break;
-	    }
-	    if (i < pic->numcols)
-		pic->transp = i;
+
+		sp = stack;
+		if (oldcode == -1) {
+			if (code >= clear)
+				break;		/* corrupt data */
+			*sp++ = first = code;
+			oldcode = code;
+		} else {
+			incode = code;
+			if (code >= avail) {
+				if (code > avail)
+					break;	/* corrupt data */
+				*sp++ = first;
+				code = oldcode;
+			}
+			while (code >= clear) {
+				*sp++ = suffix[code];
+				code = prefix[code];
+			}
+			*sp++ = first = code;
+			if (avail < (1<<MAX_LZW_BITS)) {
+				prefix[avail] = oldcode;
+				suffix[avail] = first;
+				avail++;
+				if (avail > code_mask && code_size < MAX_LZW_BITS) {
+					code_size++;
+					code_mask = (1 << code_size) - 1;
+				}
+			}
+			oldcode = incode;
+		}
+
+		/* put the string out, it is on the stack backwards */
+		while (sp > stack && row < end) {	/* drop extra pixels */
+			row[x] = *--sp;
+			if (++x == width) {
+				x = 0;
+				if (interlaced) {
+					y += pass_step[pass];
+					while (y >= height && pass < 3)
+						y = pass_start[++pass];
+				} else {
+					y++;
+				}
+				row = y < height? bitmap + y * width: end;
+			}
+		}
 	}
 
-	return stat;
+	/* skip the rest of the data */
+	while (GetDataBlock(fd, block) > 0)
+		;
+	return True;
 }
 
 static Boolean
@@ -29,9 +29,6 @@
 #include "object.h"
 #include "psimage.h"
 
-extern void	 close_picfile();
-extern FILE	*open_picfile();
-
 #ifdef REQUIRES_GETOPT
 int      getopt(int nargc, char **nargv, char *ostr);
 #endif
@@ -86,20 +83,32 @@ read_jpg(file, filetype, pic, llx, lly)
 	return 1;			/* all ok */
 }
 
+/* color components of the JPEG file read last by read_jpg(), for the
+   drivers that copy the compressed data unchanged (e.g. PDF) */
+
+int
+JPEGcomponents(bits, adobe)
+    int		*bits;
+    Boolean	*adobe;
+{
+	*bits = image.bits_per_component;
+	*adobe = image.adobe;
+	return image.components;
+}
+
 /* here's where we read the rest of the jpeg file and format for PS */
 
+/* jpegfile is the stream read_jpg() read, back at its start */
+
 void 
-JPEGtoPS(char *jpegfile, FILE *PSfile) {
+JPEGtoPS(FILE *jpegfile, FILE *PSfile) {
   imagedata	*JPEG;
   size_t	 n;
   time_t	 t;
-  int		 i, filtype;
-  char		 realname[PATH_MAX];
+  int		 i;
 
   JPEG = &image;
-
-  /* reopen the file */
-  JPEG->fp = open_picfile(jpegfile, &filtype, True, realname);
+  JPEG->fp = jpegfile;
 
   time(&t);
 
@@ -205,8 +214,6 @@ JPEGtoPS(char *jpegfile, FILE *PSfile) {
 	    break;
     }
 
-    /* close the jpeg file */
-    close_picfile(JPEG->fp, filtype);
 }
 
 /* The following enum is stolen from the IJG JPEG library
@@ -66,8 +66,7 @@ void dispbyte(unsigned char *ptr,int *xp,int *yp,int c,int w,int h,
               int real_bpp,int byteline,int *planep,int *pmaskp);
 
 
-/* _read_pcx() is called from read_pcx(), read_gif(), read_ppm(),
-   read_tif() and read_epsf().
+/* _read_pcx() is called from read_pcx().
  */
 
 void pcx_decode();
@@ -17,13 +17,89 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include "fig2dev.h"
+#include "object.h"
+#include "readpics.h"
+#ifdef USE_PNG
+#include <zlib.h>
+#endif
 
 char * xf_basename();
 
+/*
+ * Compressed pictures are uncompressed into memory (type 2), so that the
+ * stream can be rewound after looking at the first bytes.  That is done
+ * with zlib, or for files zlib can't read (.Z) by reading the output of
+ * gunzip.  Readers that want a file name get the picture uncompressed
+ * into a temporary file (type 3), never next to the original.
+ */
+
+typedef struct pic_stream {
+	FILE			*file;
+	char			*data;		/* type 2: the uncompressed data */
+	size_t			 len;
+	char			*tmpname;	/* type 3: the temporary file */
+	struct pic_stream	*next;
+} Pic_stream;
+
+static Pic_stream	*pic_streams = NULL;
+static int		 ntmpfiles = 0;
+
+static FILE	*uncompress_picfile();
+static char	*more_data();
+static void	 remember_head();
+
+/*
+ * Find the file of picture 'name': the name itself, or with .gz, .z or .Z
+ * appended, or failing that, the name without its directory in the current
+ * one.  The name found goes into 'found' and its status into 'status'.
+ * Returns 0 for a plain file, 1 for a compressed one and -1 if there is
+ * none.  If only the bare name exists 'name' is changed to it.
+ */
+
+static int
+find_picfile(name, found, status)
+    char	*name, *found;
+    struct stat	*status;
+{
+    static char	*suffix[] = { ".gz", ".z", ".Z" };
+    int		 i;
+
+    /* see if the filename ends with .gz or .z */
+    if ((strlen(name) > 3 && !strcmp(".gz", name + (strlen(name)-3))) ||
+	      ((strlen(name) > 2 && !strcmp(".z", name + (strlen(name)-2))))) {
+	strcpy(found, name);
+	return stat(found, status) == 0? 1: -1;
+    }
+    /* check for straight name first */
+    strcpy(found, name);
+    if (stat(found, status) == 0)
+	return 0;
+    /* no, see if the file with .gz, .z or .Z appended exists */
+    for (i = 0; i < (int) (sizeof(suffix)/sizeof(suffix[0])); i++) {
+	strcpy(found, name);
+	strcat(found, suffix[i]);
+	if (stat(found, status) == 0)
+	    return 1;
+    }
+    /* can't find it, if there is a path, strip it and look in the
+       current directory */
+    if (strchr(name, '/')) {
+	strcpy(found, xf_basename(name));
+	if (stat(found, status) == 0) {
+	    strcpy(name, found);
+	    return 0;
+	}
+    }
+    strcpy(found, name);
+    return -1;
+}
+
 /* 
-   Open the file 'name' and return its type (real file=0, pipe=1) in 'type'.
+   Open the file 'name' and return its type (real file=0, memory=2,
+   temporary file=3) in 'type'.  The stream can always be rewound.
    Return the full name in 'retname'.  This will have a .gz or .Z if the file is
-   zipped/compressed.
+   zipped/compressed, or is the name of the uncompressed temporary file if
+   pipeok is False.
    The return value is the FILE stream.
 */
 
@@ -35,112 +111,511 @@ open_picfile(name, type, pipeok, retname)
     char	*retname;
 {
     char	 unc[PATH_MAX+20];	/* temp buffer for gunzip command */
-    FILE	*fstream;		/* handle on file  */
     struct stat	 status;
-    char	*gzoption;
 
-    *type = 0;
-    *retname = '\0';
-    if (pipeok)
-	gzoption = "-c";		/* tell gunzip to output to stdout */
-    else
-	gzoption = "";
+    if ((*type = find_picfile(name, retname, &status)) < 0) {
+	*type = 0;
+	return NULL;
+    }
+    if (*type == 0)
+	return fopen(retname, "rb");
+    /* make command to uncompress it to stdout */
+    sprintf(unc, "gunzip %s-c %s", strcmp(name, retname)? "": "-q ", retname);
+    return uncompress_picfile(retname, unc, type, pipeok, retname);
+}
+
+static FILE *
+uncompress_picfile(name, unc, type, pipeok, retname)
+    char	*name, *unc;
+    int		*type;
+    Boolean	 pipeok;
+    char	*retname;
+{
+    Pic_stream	*ps;
+    FILE	*fstream, *gunzip;
+    char	*data, cmd[2*PATH_MAX+20];
+    size_t	 len, max;
+    int		 n;
+#ifdef USE_PNG
+    gzFile	 gz;
+#endif
 
-    /* see if the filename ends with .Z or .z or .gz */
-    if ((strlen(name) > 3 && !strcmp(".gz", name + (strlen(name)-3))) ||
-	      ((strlen(name) > 2 && !strcmp(".z", name + (strlen(name)-2))))) {
-	/* yes, make command to uncompress it */
-	sprintf(unc,"gunzip -q %s %s", gzoption, name);
-	*type = 1;
-    /* no, see if the file with .gz, .z or .Z appended exists */
-    /* failing that, if there is an absolute path, strip it and look in current directory */
+    if ((ps = (Pic_stream *) malloc(sizeof(Pic_stream))) == NULL)
+	return NULL;
+    ps->data = ps->tmpname = NULL;
+
+    if (!pipeok) {
+	/* the reader wants a file, uncompress into a temporary one */
+	if ((ps->tmpname = malloc(strlen(TMPDIR) + 32)) == NULL) {
+	    free(ps);
+	    return NULL;
+	}
+	sprintf(ps->tmpname, "%s/xfig-pic%06d.%d", TMPDIR, getpid(), ntmpfiles++);
+	fstream = NULL;
+#ifdef USE_PNG
+	if ((gz = gzopen(name, "rb")) != NULL && !gzdirect(gz) &&
+		(fstream = fopen(ps->tmpname, "wb")) != NULL) {
+	    char	 buf[BUFSIZ];
+
+	    while ((n = gzread(gz, buf, sizeof(buf))) > 0)
+		fwrite(buf, 1, n, fstream);
+	    fclose(fstream);
+	    if (n < 0)
+		unlink(ps->tmpname);
+	    fstream = n < 0? NULL: fopen(ps->tmpname, "rb");
+	}
+	if (gz)
+	    gzclose(gz);
+	if (fstream == NULL)
+#endif /* USE_PNG */
+	{
+	    sprintf(cmd, "%s > %s", unc, ps->tmpname);
+	    if (system(cmd) == 0)
+		fstream = fopen(ps->tmpname, "rb");
+	}
+	if (fstream == NULL) {
+	    unlink(ps->tmpname);
+	    free(ps->tmpname);
+	    free(ps);
+	    return NULL;
+	}
+	strcpy(retname, ps->tmpname);
+	*type = 3;
     } else {
-	/* check for straight name first */
-	if (!stat(name, &status)) {
-	    /* found it, skip other checks */
-	    *type = 0;
-	} else {
-	    /* no, check for .gz */
-	    strcpy(retname, name);
-	    strcat(retname, ".gz");
-	    if (!stat(retname, &status)) {
-		/* yes, found with .gz */
-		sprintf(unc, "gunzip %s %s", gzoption, retname);
-		*type = 1;
-		name = retname;
-	    } else {
-		/* no, check for .z */
-		strcpy(retname, name);
-		strcat(retname, ".z");
-		if (!stat(retname, &status)) {
-		    /* yes, found with .z */
-		    sprintf(unc, "gunzip %s %s", gzoption, retname);
-		    *type = 1;
-		    name = retname;
-		} else {
-		    /* no, check for .Z */
-		    strcpy(retname, name);
-		    strcat(retname, ".Z");
-		    if (!stat(retname, &status)) {
-			/* yes, found with .Z */
-			sprintf(unc, "gunzip %s %s", gzoption, retname);
-			*type = 1;
-			name = retname;
-		    } else {
-			/* can't find it, if there is an absolute path, strip it and look in
-			   current directory */
-			if (strchr(name,'/')) {
-			    /* yes, strip it off */
-			    strcpy(retname, xf_basename(name));
-			    if (!stat(retname, &status)) {
-				*type = 0;
-				strcpy(name, retname);
-			    }
-			}
-		    }
+	fstream = NULL;
+	data = NULL;
+	len = max = 0;
+#ifdef USE_PNG
+	/* read it all into memory with zlib */
+	if ((gz = gzopen(name, "rb")) != NULL) {
+	    do {
+		if (len == max && (data = more_data(data, len, &max)) == NULL) {
+		    n = -1;
+		    break;
 		}
+		n = gzread(gz, data + len, max - len);
+		if (n > 0)
+		    len += n;
+	    } while (n > 0);
+	    /* gzread() passes files it can't uncompress (e.g. .Z) through */
+	    if (n != 0 || len == 0 || gzdirect(gz))
+		len = 0;
+	    gzclose(gz);
+	}
+	if (len == 0)
+#endif /* USE_PNG */
+	{
+	    /* or read the output of gunzip into memory */
+	    if (data == NULL)
+		max = 0;
+	    if ((gunzip = popen(unc, "r")) != NULL) {
+		do {
+		    if (len == max && (data = more_data(data, len, &max)) == NULL)
+			break;
+		    len += n = fread(data + len, 1, max - len, gunzip);
+		} while (n > 0);
+		(void) pclose(gunzip);
+		if (data == NULL)
+		    len = 0;
 	    }
 	}
-    }
-    /* if a pipe, but the caller needs a file, uncompress the file now */
-    if (*type == 1 && !pipeok) {
-	char *p;
-	system(unc);
-	if (p=strrchr(name,'.')) {
-	    *p = '\0';		/* terminate name before last .gz, .z or .Z */
+	if (len == 0 || (fstream = fmemopen(data, len, "rb")) == NULL) {
+	    if (data)
+		free(data);
+	    free(ps);
+	    return NULL;
 	}
-	strcpy(retname, name);
-	/* force to plain file now */
-	*type = 0;
+	ps->data = data;
+	ps->len = len;
+	*type = 2;
     }
+    ps->file = fstream;
+    ps->next = pic_streams;
+    pic_streams = ps;
+    return fstream;
+}
 
-    /* no appendages, just see if it exists */
-    /* and restore the original name */
-    strcpy(retname, name);
-    if (stat(name, &status) != 0) {
-	fstream = NULL;
-    } else {
-	switch (*type) {
-	  case 0:
-	    fstream = fopen(name, "rb");
+void
+close_picfile(file,type)
+    FILE	*file;
+    int		type;
+{
+    Pic_stream	*ps, **prev;
+
+    if (type == 1) {
+	pclose(file);
+	return;
+    }
+    fclose(file);
+    if (type == 0)
+	return;
+    /* free the data or remove the temporary file */
+    for (prev = &pic_streams; (ps = *prev) != NULL; prev = &ps->next)
+	if (ps->file == file) {
+	    *prev = ps->next;
+	    if (ps->data)
+		free(ps->data);
+	    if (ps->tmpname) {
+		unlink(ps->tmpname);
+		free(ps->tmpname);
+	    }
+	    free(ps);
 	    break;
-	  case 1:
-	    fstream = popen(unc,"r");
+	}
+}
+
+/* make room for more data after the len bytes of data, NULL if none */
+
+static char *
+more_data(data, len, max)
+    char	*data;
+    size_t	 len, *max;
+{
+    char	*more;
+
+    *max = *max? 2 * *max: 65536;
+    if ((more = realloc(data, *max)) == NULL) {
+	if (data)
+	    free(data);
+	return NULL;
+    }
+    return more;
+}
+
+/*
+ * Open picture 'name' like open_picfile() and read the first *nhead
+ * bytes of it into head, for telling what kind of picture it is.  The
+ * number of bytes read goes into *nhead and the stream is rewound, so
+ * that the reader gets all of it.  The bytes are also remembered for
+ * picture_head().
+ */
+
+FILE *
+sniff_picfile(name, type, retname, head, nhead)
+    char	*name;
+    int		*type;
+    char	*retname, *head;
+    int		*nhead;
+{
+    FILE	*file;
+
+    if ((file = open_picfile(name, type, True, retname)) == NULL)
+	return NULL;
+    *nhead = fread(head, 1, (size_t) *nhead, file);
+    rewind(file);
+    remember_head(name, head, *nhead);
+    return file;
+}
+
+/*
+ * For the readers that want a file name: if the picture 'file' opened by
+ * open_picfile() is in memory, write it into a temporary file, whose name
+ * goes into retname.  Otherwise retname already holds the file.  Returns
+ * False if the file can't be written.
+ */
+
+Boolean
+picfile_name(file, type, retname)
+    FILE	*file;
+    int		 type;
+    char	*retname;
+{
+    Pic_stream	*ps;
+    FILE	*tmp;
+
+    if (type != 2)
+	return True;
+    for (ps = pic_streams; ps != NULL; ps = ps->next)
+	if (ps->file == file)
 	    break;
+    if (ps == NULL)
+	return False;
+    if (ps->tmpname == NULL) {
+	if ((ps->tmpname = malloc(strlen(TMPDIR) + 32)) == NULL)
+	    return False;
+	sprintf(ps->tmpname, "%s/xfig-pic%06d.%d", TMPDIR, getpid(), ntmpfiles++);
+	if ((tmp = fopen(ps->tmpname, "wb")) == NULL ||
+		fwrite(ps->data, 1, ps->len, tmp) != ps->len) {
+	    if (tmp)
+		fclose(tmp);
+	    unlink(ps->tmpname);
+	    free(ps->tmpname);
+	    ps->tmpname = NULL;
+	    return False;
 	}
+	fclose(tmp);
     }
-    return fstream;
+    strcpy(retname, ps->tmpname);
+    return True;
+}
+
+/*
+ * Pictures that have been read are remembered by the file they came from,
+ * its size and modification time, and the options that change what the
+ * readers make of it.  The pictures that are only decoded into the F_pic
+ * (GIF, PCX, PNG, PPM, TIFF and X11 bitmaps) needn't be read again for
+ * another copy of them, in the same figure or a later one of a batch; the
+ * copies share the bitmap, which is never freed.  Each file also has a
+ * mark that a driver can use for the one thing it writes for all copies
+ * of the picture in its output.
+ */
+
+#define	PIC_HEAD	16
+
+typedef struct pic_cache {
+	char		 *file;		/* the name find_picfile() found */
+	off_t		  size;
+	time_t		  mtime;
+	Boolean		  gray;		/* grayonly */
+	long		  bg;		/* the background color, -1 if none */
+	int		  uses;		/* copies in the figure being converted */
+	int		  mark;		/* what the driver made of it */
+	int		  subtype;	/* the kind of picture, -1 if not read */
+	Boolean		  decoded;	/* pic, llx and lly hold the picture */
+	char		  head[PIC_HEAD]; /* the first bytes of the file */
+	int		  nhead;	/* how many, -1 if not looked at */
+	char		 *type;		/* and the reader of it */
+	F_pic		  pic;
+	int		  llx, lly;
+	struct pic_cache *next;
+} Pic_cache;
+
+static Pic_cache	*pic_cache = NULL;
+
+static void		 count_pictures();
+
+/* the entry for picture file 'name', NULL if there is no such file */
+
+static Pic_cache *
+find_cached(name)
+    char	*name;
+{
+    Pic_cache	*pc;
+    struct stat	 status;
+    char	 found[PATH_MAX];
+    long	 bg;
+
+    if (find_picfile(name, found, &status) < 0)
+	return NULL;
+    bg = bgspec? ((long) (background.red >> 8) << 16) |
+		((background.green >> 8) << 8) | (background.blue >> 8): -1L;
+    for (pc = pic_cache; pc != NULL; pc = pc->next)
+	if (pc->size == status.st_size && pc->mtime == status.st_mtime &&
+		pc->gray == grayonly && pc->bg == bg && !strcmp(pc->file, found))
+	    return pc;
+
+    /* a new picture, or the file has changed */
+    if ((pc = (Pic_cache *) malloc(sizeof(Pic_cache))) == NULL)
+	return NULL;
+    if ((pc->file = malloc(strlen(found) + 1)) == NULL) {
+	free(pc);
+	return NULL;
+    }
+    strcpy(pc->file, found);
+    pc->size = status.st_size;
+    pc->mtime = status.st_mtime;
+    pc->gray = grayonly;
+    pc->bg = bg;
+    pc->uses = pc->mark = 0;
+    pc->subtype = -1;
+    pc->decoded = False;
+    pc->nhead = -1;
+    pc->next = pic_cache;
+    pic_cache = pc;
+    return pc;
+}
+
+/*
+ * Fill in pic from the copy of its file that was read before, if there is
+ * one, and write the comments its reader wrote.  Returns True if so, with
+ * the lower-left corner in *llx, *lly.
+ */
+
+Boolean
+cached_picture(pic, llx, lly)
+    F_pic	*pic;
+    int		*llx, *lly;
+{
+    Pic_cache	*pc;
+
+    if ((pc = find_cached(pic->file)) == NULL || !pc->decoded)
+	return False;
+    pic->subtype = pc->pic.subtype;
+    pic->bitmap = pc->pic.bitmap;
+    memcpy(pic->cmap, pc->pic.cmap, sizeof(pic->cmap));
+    pic->numcols = pc->pic.numcols;
+    pic->transp = pc->pic.transp;
+    pic->hw_ratio = pc->pic.hw_ratio;
+    pic->bit_size = pc->pic.bit_size;
+    *llx = pc->llx;
+    *lly = pc->lly;
+
+    if (!strcmp(pc->type, "GIF"))
+	fprintf(tfp, "%% Originally from a GIF File: %s\n\n", pic->file);
+    else if (!strcmp(pc->type, "PPM") || !strcmp(pc->type, "TIFF"))
+	fprintf(tfp, "%% Originally from a %s File: %s\n\n", pc->type, pic->file);
+    else if (!strcmp(pc->type, "XBM"))
+	fprintf(tfp, "%% Begin Imported X11 Bitmap File: %s\n\n", pic->file);
+    if (pic->subtype == P_PCX)
+	fprintf(tfp, "%% Begin Imported PCX File: %s\n\n", pic->file);
+    return True;
 }
 
+/*
+ * Remember picture pic, just read with lower-left corner llx, lly by the
+ * reader for type (GIF, PPM...).
+ */
+
 void
-close_picfile(file,type)
+cache_picture(pic, llx, lly, type)
+    F_pic	*pic;
+    int		 llx, lly;
+    char	*type;
+{
+    Pic_cache	*pc;
+
+    if ((pc = find_cached(pic->file)) == NULL)
+	return;
+    pc->subtype = pic->subtype;
+    switch (pic->subtype) {
+      case P_GIF:
+      case P_PCX:
+      case P_PNG:
+      case P_PPM:
+      case P_TIF:
+      case P_XBM:
+	break;
+      default:
+	/* the JPEG and EPS readers keep state of their own for the
+	   drivers, and XPM images are freed after use */
+	return;
+    }
+    if (pic->bitmap == NULL)
+	return;
+    pc->pic = *pic;
+    pc->llx = llx;
+    pc->lly = lly;
+    pc->type = type;
+    pc->decoded = True;
+}
+
+/* remember the first n bytes of picture file 'name' */
+
+static void
+remember_head(name, head, n)
+    char	*name, *head;
+    int		 n;
+{
+    Pic_cache	*pc;
+
+    if ((pc = find_cached(name)) == NULL)
+	return;
+    pc->nhead = n < PIC_HEAD? n: PIC_HEAD;
+    memcpy(pc->head, head, (size_t) pc->nhead);
+}
+
+/*
+ * Put the first n (at most 16) bytes of picture file 'name' into head
+ * and return how many there are, -1 if the file can't be read.  The file
+ * is only opened if it hasn't been looked at before.
+ */
+
+int
+picture_head(name, head, n)
+    char	*name, *head;
+    int		 n;
+{
+    Pic_cache	*pc;
     FILE	*file;
-    int		type;
+    char	 realname[PATH_MAX];
+    int		 type;
+
+    if ((pc = find_cached(name)) != NULL && pc->nhead >= n) {
+	memcpy(head, pc->head, (size_t) n);
+	return n;
+    }
+    if (n > PIC_HEAD)
+	n = PIC_HEAD;
+    if ((file = sniff_picfile(name, &type, realname, head, &n)) == NULL)
+	return -1;
+    close_picfile(file, type);
+    return n;
+}
+
+/* the kind of picture file 'name' is (P_EPS...), -1 if it wasn't read */
+
+int
+picture_subtype(name)
+    char	*name;
 {
-    if (type == 0)
-	fclose(file);
-    else
-	pclose(file);
+    Pic_cache	*pc;
+
+    return (pc = find_cached(name)) != NULL? pc->subtype: -1;
+}
+
+/*
+ * Count the copies of each picture in the figure, and clear the marks the
+ * drivers left on the pictures of the previous one.
+ */
+
+void
+count_picture_uses(objects)
+    F_compound	*objects;
+{
+    Pic_cache	*pc;
+
+    for (pc = pic_cache; pc != NULL; pc = pc->next)
+	pc->uses = pc->mark = 0;
+    count_pictures(objects);
+}
+
+static void
+count_pictures(ob)
+    F_compound	*ob;
+{
+    F_compound	*c;
+    F_line	*l;
+    Pic_cache	*pc;
+
+    for (l = ob->lines; l != NULL; l = l->next)
+	if (l->type == T_PIC_BOX && l->pic != NULL &&
+		(pc = find_cached(l->pic->file)) != NULL)
+	    pc->uses++;
+    for (c = ob->compounds; c != NULL; c = c->next)
+	count_pictures(c);
+}
+
+/* how many copies of picture file 'name' the figure has */
+
+int
+picture_uses(name)
+    char	*name;
+{
+    Pic_cache	*pc;
+
+    return (pc = find_cached(name)) != NULL? pc->uses: 0;
+}
+
+/* the mark of picture file 'name' in this output, 0 if none */
+
+int
+picture_mark(name)
+    char	*name;
+{
+    Pic_cache	*pc;
+
+    return (pc = find_cached(name)) != NULL? pc->mark: 0;
+}
+
+void
+set_picture_mark(name, mark)
+    char	*name;
+    int		 mark;
+{
+    Pic_cache	*pc;
+
+    if ((pc = find_cached(name)) != NULL)
+	pc->mark = mark;
 }
 
 /* for systems without basename() (e.g. SunOS 4.1.3) */
@@ -0,0 +1,34 @@
+/*
+ * TransFig: Facility for Translating Fig code
+ * Parts Copyright (c) 1989-2002 by Brian V. Smith
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish and/or distribute copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that this copyright
+ * notice remain intact.
+ *
+ */
+
+/*
+ *	readpics.h: the pictures that have been read
+ *
+ */
+
+extern FILE	*open_picfile();	/* (name, &type, pipeok, realname) */
+extern void	close_picfile();	/* (file, type) */
+extern FILE	*sniff_picfile();	/* (name, &type, realname, head, &n) */
+extern Boolean	picfile_name();		/* (file, type, realname) for readers
+					   that want a file */
+extern int	picture_head();		/* (name, head, n) first n bytes */
+
+extern Boolean	cached_picture();	/* (pic, &llx, &lly) fill in a copy */
+extern void	cache_picture();	/* (pic, llx, lly, type) remember it */
+extern int	picture_subtype();	/* (name) P_EPS..., -1 if not read */
+extern void	count_picture_uses();	/* (objects) for the next two */
+extern int	picture_uses();		/* (name) copies in the figure */
+extern int	picture_mark();		/* (name) what the driver made of it */
+extern void	set_picture_mark();	/* (name, mark) */
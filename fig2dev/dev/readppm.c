@@ -13,10 +13,20 @@
  *
  */
 
+/*
+ * Portable anymaps are decoded here.  PBM (P1, P4) pictures get a black
+ * and white colormap and PGM (P2, P5) ones a gray ramp, one byte per
+ * pixel; PPM (P3, P6) pictures are kept in 24 bits, blue, green, red like
+ * the other readers store them.  Samples with a maxval other than 255 are
+ * scaled to 8 bits.
+ */
+
 #include "fig2dev.h"
 #include "object.h"
 
-extern	int	_read_pcx();
+int		_read_ppm();
+static int	ppm_number();
+static int	ppm_bit();
 
 /* return codes:  1 : success
 		  0 : failure
@@ -29,38 +39,174 @@ read_ppm(file,filetype,pic,llx,lly)
     F_pic	   *pic;
     int		   *llx, *lly;
 {
-	char	 buf[512],pcxname[PATH_MAX];
-	FILE	*giftopcx;
-	int	 stat, size;
-
 	*llx = *lly = 0;
 	/* output PostScript comment */
 	fprintf(tfp, "%% Originally from a PPM File: %s\n\n", pic->file);
+	return _read_ppm(file, pic);
+}
+
+/* _read_ppm() is called from read_ppm() and read_tif() */
+
+int
+_read_ppm(file,pic)
+    FILE	   *file;
+    F_pic	   *pic;
+{
+	unsigned char	*row, *bit;
+	int		 format, w, h, maxval, nsamp, ssize, rowlen;
+	int		 x, y, i, v, s[3];
 
-	/* make name for temp output file */
-	sprintf(pcxname, "%s/%s%06d.pix", TMPDIR, "xfig-pcx", getpid());
-	/* make command to convert gif to pcx into temp file */
-	sprintf(buf, "ppmtopcx > %s 2> /dev/null", pcxname);
-	if ((giftopcx = popen(buf,"w" )) == 0) {
-	    fprintf(stderr,"Cannot open pipe to giftoppm\n");
+	if (getc(file) != 'P' || (format = getc(file) - '0') < 1 || format > 6)
+	    return 0;
+	if ((w = ppm_number(file)) <= 0 || (h = ppm_number(file)) <= 0)
+	    return 0;
+	maxval = 1;
+	if (format != 1 && format != 4 &&
+		((maxval = ppm_number(file)) <= 0 || maxval > 65535))
+	    return 0;
+	/* the header of the raw formats ends with the white space after
+	   the last number, ppm_number() has read it */
+
+	nsamp = format == 3 || format == 6 ? 3 : 1;
+	ssize = maxval > 255 ? 2 : 1;
+	if (w > (INT_MAX / 6) / h) {
+	    fprintf(stderr,"PPM image too large: %d x %d\n", w, h);
+	    return 0;
+	}
+	if ((pic->bitmap = malloc(w * h * nsamp)) == NULL) {
+	    fprintf(stderr,"Can't allocate memory for PPM image\n");
+	    return 0;
+	}
+	rowlen = format == 4 ? (w + 7) / 8 : w * nsamp * ssize;
+	row = NULL;
+	if (format >= 4 && (row = (unsigned char *) malloc(rowlen)) == NULL) {
+	    fprintf(stderr,"Can't allocate memory for PPM image\n");
+	    free(pic->bitmap);
+	    pic->bitmap = NULL;
 	    return 0;
 	}
-	while ((size=fread(buf, 1, 512, file)) != 0) {
-	    fwrite(buf, size, 1, giftopcx);
+
+	bit = pic->bitmap;
+	for (y = 0; y < h; y++) {
+	    if (row && fread(row, 1, rowlen, file) != (size_t) rowlen)
+		break;
+	    for (x = 0; x < w; x++) {
+		for (i = 0; i < nsamp; i++) {
+		    switch (format) {
+		      case 1:
+			v = ppm_bit(file);
+			break;
+		      case 2:
+		      case 3:
+			v = ppm_number(file);
+			break;
+		      case 4:
+			v = (row[x >> 3] >> (7 - (x & 7))) & 1;
+			break;
+		      default:
+			if (ssize == 1)
+			    v = row[x * nsamp + i];
+			else
+			    v = (row[2 * (x * nsamp + i)] << 8) |
+				row[2 * (x * nsamp + i) + 1];
+			break;
+		    }
+		    if (v < 0)
+			goto short_data;
+		    if (v > maxval)
+			v = maxval;
+		    if (maxval != 255 && format != 1 && format != 4)
+			v = (v * 255 + maxval / 2) / maxval;
+		    s[i] = v;
+		}
+		if (nsamp == 1) {
+		    *bit++ = s[0];
+		} else {
+		    if (grayonly)
+			s[0] = s[1] = s[2] = (int) (rgb2luminance(s[0]/255.0,
+					s[1]/255.0, s[2]/255.0)*255.0);
+		    *bit++ = s[2];
+		    *bit++ = s[1];
+		    *bit++ = s[0];
+		}
+	    }
 	}
-	/* close pipe */
-	pclose(giftopcx);
-	if ((giftopcx = fopen(pcxname, "rb")) == NULL) {
-	    fprintf(stderr,"Can't open temp output file\n");
+    short_data:
+	if (row)
+	    free(row);
+	if (y < h) {
+	    free(pic->bitmap);
+	    pic->bitmap = NULL;
 	    return 0;
 	}
-	/* now call _read_pcx to read the pcx file */
-	stat = _read_pcx(giftopcx, pic);
+
+	pic->subtype = P_PPM;
 	pic->transp = -1;
-	/* close file */
-	fclose(giftopcx);
-	/* remove temp file */
-	unlink(pcxname);
+	pic->bit_size.x = w;
+	pic->bit_size.y = h;
+	pic->hw_ratio = (float) h / w;
+	if (nsamp == 3) {
+	    pic->numcols = 2<<24;		/* 24 bits, no colormap */
+	} else if (format == 1 || format == 4) {
+	    /* a set bit is black */
+	    pic->numcols = 2;
+	    pic->cmap[RED][0] = pic->cmap[GREEN][0] = pic->cmap[BLUE][0] = 255;
+	    pic->cmap[RED][1] = pic->cmap[GREEN][1] = pic->cmap[BLUE][1] = 0;
+	} else {
+	    pic->numcols = 256;
+	    for (i = 0; i < 256; i++)
+		pic->cmap[RED][i] = pic->cmap[GREEN][i] = pic->cmap[BLUE][i] = i;
+	}
+	return 1;
+}
+
+/* skip white space and comments, return the next character */
+
+static int
+ppm_skip(file)
+    FILE	*file;
+{
+	int	 c;
+
+	while ((c = getc(file)) == '#' || c == ' ' || c == '\t' ||
+			c == '\n' || c == '\r' || c == '\f' || c == '\v')
+	    if (c == '#')
+		while ((c = getc(file)) != EOF && c != '\n')
+		    ;
+	return c;
+}
+
+/* the next decimal number, -1 if there is none; the character after it
+   is read too (the white space that ends the header of the raw formats) */
+
+static int
+ppm_number(file)
+    FILE	*file;
+{
+	int	 c, n;
+
+	if ((c = ppm_skip(file)) < '0' || c > '9')
+	    return -1;
+	n = 0;
+	do {
+	    if (n < 100000)
+		n = 10 * n + c - '0';
+	} while ((c = getc(file)) >= '0' && c <= '9');
+	if (c == '#')
+	    while ((c = getc(file)) != EOF && c != '\n')
+		;
+	return n;
+}
+
+/* the next pixel of a plain PBM file, the digits needn't be separated */
+
+static int
+ppm_bit(file)
+    FILE	*file;
+{
+	int	 c;
 
-	return stat;
+	if ((c = ppm_skip(file)) != '0' && c != '1')
+	    return -1;
+	return c - '0';
 }
@@ -13,57 +13,582 @@
  *
  */
 
+/*
+ * TIFF pictures are decoded here: the first image of the file, in strips
+ * that are uncompressed or compressed with LZW, PackBits or (with zlib)
+ * Deflate, with or without the horizontal predictor.  Bilevel, gray and
+ * palette images get a colormap and one byte per pixel, RGB images are
+ * kept in 24 bits, stored blue, green, red like the other readers do.
+ * Anything else (tiled, separate plane, CMYK and YCbCr images, CCITT and
+ * JPEG compression, ...) is converted with tifftopnm as before.
+ */
+
 #include "fig2dev.h"
 #include "object.h"
+#ifdef USE_PNG
+#include <zlib.h>
+#endif
+
+/* tags */
+#define	TIF_WIDTH		256
+#define	TIF_HEIGHT		257
+#define	TIF_BITSPERSAMPLE	258
+#define	TIF_COMPRESSION		259
+#define	TIF_PHOTOMETRIC		262
+#define	TIF_STRIPOFFSETS	273
+#define	TIF_SAMPLESPERPIXEL	277
+#define	TIF_ROWSPERSTRIP	278
+#define	TIF_STRIPBYTECOUNTS	279
+#define	TIF_PLANARCONFIG	284
+#define	TIF_PREDICTOR		317
+#define	TIF_COLORMAP		320
+#define	TIF_TILEWIDTH		322
+
+/* compression */
+#define	TIF_NONE		1
+#define	TIF_LZW			5
+#define	TIF_DEFLATE		8
+#define	TIF_PACKBITS		32773
+#define	TIF_ADOBE_DEFLATE	32946
+
+/* photometric interpretation */
+#define	TIF_WHITEISZERO		0
+#define	TIF_BLACKISZERO		1
+#define	TIF_RGB			2
+#define	TIF_PALETTE		3
 
-extern	int	_read_pcx();
+typedef unsigned char	byte;
+
+static FILE	*tif;
+static Boolean	 motorola;		/* big-endian ("MM") file */
+
+static unsigned long	 tif_get();
+static unsigned long	 tif_value();
+static unsigned long	*tif_array();
+static void		 tif_lzw();
+static void		 tif_packbits();
+#ifdef USE_PNG
+static void		 tif_inflate();
+#endif
+static void		 tif_predict();
+static int		 tif_sample();
+static int		 tif_external();
+extern int		 _read_ppm();
 
 /* return codes:  1 : success
 		  0 : invalid file
 */
 
 int
-read_tif(filename,filetype,pic,llx,lly)
-    char	   *filename;
+read_tif(file,filetype,pic,llx,lly)
+    FILE	   *file;
     int		    filetype;
     F_pic	   *pic;
     int		   *llx, *lly;
 {
-	char	 buf[2*PATH_MAX+40],pcxname[PATH_MAX];
-	FILE	*tiftopcx;
-	int	 stat;
+	byte		 head[8], *dir, *e, *data, *strip, *row, *bit;
+	unsigned long	*offsets, *counts, *cmap;
+	unsigned long	 noffsets, ncounts, ncmap, nent, nstrips, k;
+	unsigned long	 bps, spp, comp, photo, pred, planar, rps;
+	long		 w, h, rowbytes, rows, want, len, x, y;
+	int		 ncol, i, r, g, b, stat;
+	Boolean		 tiled;
+	char		 why[80];
 
 	*llx = *lly = 0;
 	/* output PostScript comment */
 	fprintf(tfp, "%% Originally from a TIFF File: %s\n\n", pic->file);
 
-	/* make name for temp output file */
-	sprintf(pcxname, "%s/%s%06d.pix", TMPDIR, "xfig-pcx", getpid());
-	/* make command to convert tif to pnm then to pcx into temp file */
-	sprintf(buf, "tifftopnm %s 2> /dev/null | ppmtopcx > %s 2> /dev/null",
-		filename, pcxname);
-	if ((tiftopcx = popen(buf,"w" )) == 0) {
-	    fprintf(stderr,"Cannot open pipe to tifftopnm or ppmtopcx\n");
-	    /* remove temp file */
-	    unlink(pcxname);
-	    return 0;
+	tif = file;
+	stat = 0;
+	why[0] = '\0';
+	dir = data = strip = NULL;
+	offsets = counts = cmap = NULL;
+	noffsets = ncounts = ncmap = 0;
+
+	/* the header and the directory of the first image */
+	if (fread(head, 1, 8, tif) != 8)
+	    goto done;
+	motorola = head[0] == 'M';
+	if (fseek(tif, (long) tif_get(head + 4, 4), SEEK_SET) != 0 ||
+		fread(head, 1, 2, tif) != 2)
+	    goto done;
+	nent = tif_get(head, 2);
+	if ((dir = (byte *) malloc(12 * nent + 1)) == NULL ||
+		fread(dir, 12, nent, tif) != nent)
+	    goto done;
+
+	w = h = 0;
+	bps = spp = comp = pred = planar = 1;
+	photo = TIF_BLACKISZERO;
+	rps = 0;
+	tiled = False;
+	for (e = dir; e < dir + 12 * nent; e += 12) {
+	    switch (tif_get(e, 2)) {
+	      case TIF_WIDTH:		w = (long) tif_value(e); break;
+	      case TIF_HEIGHT:		h = (long) tif_value(e); break;
+	      case TIF_BITSPERSAMPLE:	bps = tif_value(e); break;
+	      case TIF_COMPRESSION:	comp = tif_value(e); break;
+	      case TIF_PHOTOMETRIC:	photo = tif_value(e); break;
+	      case TIF_SAMPLESPERPIXEL:	spp = tif_value(e); break;
+	      case TIF_ROWSPERSTRIP:	rps = tif_value(e); break;
+	      case TIF_PLANARCONFIG:	planar = tif_value(e); break;
+	      case TIF_PREDICTOR:	pred = tif_value(e); break;
+	      case TIF_TILEWIDTH:	tiled = True; break;
+	      case TIF_STRIPOFFSETS:
+		if (offsets == NULL)
+		    offsets = tif_array(e, &noffsets);
+		break;
+	      case TIF_STRIPBYTECOUNTS:
+		if (counts == NULL)
+		    counts = tif_array(e, &ncounts);
+		break;
+	      case TIF_COLORMAP:
+		if (cmap == NULL)
+		    cmap = tif_array(e, &ncmap);
+		break;
+	    }
 	}
-	/* close pipe */
-	pclose(tiftopcx);
-	if ((tiftopcx = fopen(pcxname, "rb")) == NULL) {
-	    fprintf(stderr,"Can't open temp output file\n");
-	    /* remove temp file */
-	    unlink(pcxname);
-	    return 0;
+
+	/* see if it is something we can read */
+	if (w <= 0 || h <= 0 || spp < 1 || (offsets == NULL && !tiled))
+	    goto done;
+	if (tiled || (planar != 1 && spp > 1)) {
+	    sprintf(why, "Tiled or planar TIFF files are not supported");
+	    goto done;
+	}
+	switch (photo) {
+	  case TIF_WHITEISZERO:
+	  case TIF_BLACKISZERO:
+	    i = bps == 1 || bps == 2 || bps == 4 || bps == 8 || bps == 16;
+	    break;
+	  case TIF_PALETTE:
+	    i = (bps == 1 || bps == 2 || bps == 4 || bps == 8) &&
+			cmap != NULL && ncmap >= 3UL << bps;
+	    break;
+	  case TIF_RGB:
+	    i = (bps == 8 || bps == 16) && spp >= 3;
+	    break;
+	  default:
+	    i = 0;
+	    break;
+	}
+	if (!i) {
+	    sprintf(why, "TIFF images of type %lu with %lu bits per sample are not supported",
+			photo, bps);
+	    goto done;
+	}
+	if (comp != TIF_NONE && comp != TIF_LZW && comp != TIF_PACKBITS
+#ifdef USE_PNG
+		&& comp != TIF_DEFLATE && comp != TIF_ADOBE_DEFLATE
+#endif
+		) {
+	    sprintf(why, "TIFF compression %lu is not supported", comp);
+	    goto done;
+	}
+	if (w > (INT_MAX / 6) / h || spp > 16) {
+	    fprintf(stderr,"TIFF image too large: %ld x %ld\n", w, h);
+	    goto done;
+	}
+
+	/* decode the strips into data, a short strip leaves zeros */
+	rowbytes = (w * spp * bps + 7) / 8;
+	if (rps == 0 || rps > (unsigned long) h)
+	    rps = h;
+	nstrips = (h + rps - 1) / rps;
+	if (noffsets < nstrips ||
+		(data = (byte *) calloc(rowbytes * h, 1)) == NULL)
+	    goto done;
+	for (k = 0; k < nstrips; k++) {
+	    rows = h - k * rps < rps ? h - k * rps : rps;
+	    want = rows * rowbytes;
+	    len = counts && k < ncounts ? (long) counts[k] : want;
+	    if (len <= 0)
+		continue;
+	    if ((row = (byte *) realloc(strip, len)) == NULL)
+		goto done;
+	    strip = row;
+	    if (fseek(tif, (long) offsets[k], SEEK_SET) != 0)
+		goto done;
+	    len = fread(strip, 1, len, tif);
+	    row = data + k * rps * rowbytes;
+	    switch (comp) {
+	      case TIF_NONE:
+		memcpy(row, strip, len < want ? len : want);
+		break;
+	      case TIF_LZW:
+		tif_lzw(strip, len, row, want);
+		break;
+	      case TIF_PACKBITS:
+		tif_packbits(strip, len, row, want);
+		break;
+#ifdef USE_PNG
+	      default:
+		tif_inflate(strip, len, row, want);
+		break;
+#endif
+	    }
+	}
+	if (pred == 2)
+	    for (y = 0; y < h; y++)
+		tif_predict(data + y * rowbytes, w, (int) spp, (int) bps);
+
+	/* and put the pixels into the bitmap */
+	if ((pic->bitmap = malloc(w * h * (photo == TIF_RGB ? 3 : 1))) == NULL) {
+	    fprintf(stderr,"Can't allocate memory for TIFF image\n");
+	    goto done;
+	}
+	bit = pic->bitmap;
+	for (y = 0; y < h; y++) {
+	    row = data + y * rowbytes;
+	    for (x = 0; x < w; x++) {
+		if (photo == TIF_RGB) {
+		    r = tif_sample(row, x * spp, (int) bps);
+		    g = tif_sample(row, x * spp + 1, (int) bps);
+		    b = tif_sample(row, x * spp + 2, (int) bps);
+		    if (grayonly)
+			r = g = b = (int) (rgb2luminance(r/255.0, g/255.0, b/255.0)*255.0);
+		    *bit++ = b;
+		    *bit++ = g;
+		    *bit++ = r;
+		} else {
+		    *bit++ = tif_sample(row, x * spp, (int) bps);
+		}
+	    }
 	}
-	/* now call _read_pcx to read the pcx file */
-	stat = _read_pcx(tiftopcx, pic);
+
+	pic->subtype = P_TIF;
 	pic->transp = -1;
-	/* close the temp file */
-	fclose(tiftopcx);
-	/* and remove it */
-	unlink(pcxname);
+	pic->bit_size.x = w;
+	pic->bit_size.y = h;
+	pic->hw_ratio = (float) h / w;
+	ncol = bps >= 8 ? 256 : 1 << bps;
+	if (photo == TIF_RGB) {
+	    pic->numcols = 2<<24;		/* 24 bits, no colormap */
+	} else if (photo == TIF_PALETTE) {
+	    /* the colormap has 16 bits, all reds, then greens, then blues */
+	    pic->numcols = ncol;
+	    for (i = 0; i < ncol; i++) {
+		pic->cmap[RED][i] = cmap[i] >> 8;
+		pic->cmap[GREEN][i] = cmap[ncol + i] >> 8;
+		pic->cmap[BLUE][i] = cmap[2 * ncol + i] >> 8;
+		/* if user wants grayscale (-N) then map to gray */
+		if (grayonly)
+		    pic->cmap[RED][i] = pic->cmap[GREEN][i] = pic->cmap[BLUE][i] =
+			(int) (rgb2luminance(pic->cmap[RED][i]/255.0,
+					pic->cmap[GREEN][i]/255.0,
+					pic->cmap[BLUE][i]/255.0)*255.0);
+	    }
+	} else {
+	    pic->numcols = ncol;
+	    for (i = 0; i < ncol; i++) {
+		g = i * 255 / (ncol - 1);
+		if (photo == TIF_WHITEISZERO)
+		    g = 255 - g;
+		pic->cmap[RED][i] = pic->cmap[GREEN][i] = pic->cmap[BLUE][i] = g;
+	    }
+	}
+	stat = 1;
+
+    done:
+	if (dir) free(dir);
+	if (data) free(data);
+	if (strip) free(strip);
+	if (offsets) free(offsets);
+	if (counts) free(counts);
+	if (cmap) free(cmap);
+	if (stat == 0 && (stat = tif_external(file, pic)) == 0 && why[0])
+	    fprintf(stderr, "%s\n", why);
+	return stat;
+}
+
+/*
+ * The pictures the decoder above can't read go through tifftopnm, as
+ * all TIFF pictures once did.  It wants a file, so the picture, which
+ * may have been uncompressed into memory, is copied into a temporary
+ * one first.
+ */
+
+static int
+tif_external(file, pic)
+    FILE	*file;
+    F_pic	*pic;
+{
+	char	 tmpname[PATH_MAX], cmd[PATH_MAX+40], buf[BUFSIZ];
+	FILE	*tmp, *pnm;
+	size_t	 n;
+	int	 stat;
 
+	sprintf(tmpname, "%s/xfig-tif%06d", TMPDIR, getpid());
+	if ((tmp = fopen(tmpname, "wb")) == NULL)
+	    return 0;
+	rewind(file);
+	while ((n = fread(buf, 1, sizeof(buf), file)) > 0)
+	    if (fwrite(buf, 1, n, tmp) != n)
+		break;
+	if (fclose(tmp) != 0 || n > 0) {
+	    unlink(tmpname);
+	    return 0;
+	}
+	sprintf(cmd, "tifftopnm %s 2> /dev/null", tmpname);
+	if ((pnm = popen(cmd, "r")) == NULL) {
+	    fprintf(stderr,"Cannot open pipe to tifftopnm\n");
+	    unlink(tmpname);
+	    return 0;
+	}
+	stat = _read_ppm(pnm, pic);
+	(void) pclose(pnm);
+	unlink(tmpname);
+	if (stat)
+	    pic->subtype = P_TIF;
 	return stat;
 }
 
+/* the n-byte number at p, in the byte order of the file */
+
+static unsigned long
+tif_get(p, n)
+    byte	*p;
+    int		 n;
+{
+	unsigned long	 v;
+	int		 i;
+
+	v = 0;
+	for (i = 0; i < n; i++)
+	    v |= (unsigned long) p[motorola ? i : n - 1 - i] << (8 * (n - 1 - i));
+	return v;
+}
+
+/*
+ * The values of directory entry e, in a new array; their number goes into
+ * *np.  Only BYTE, SHORT and LONG values are read, NULL for anything else.
+ */
+
+static unsigned long *
+tif_array(e, np)
+    byte		*e;
+    unsigned long	*np;
+{
+	unsigned long	 count, i, *v;
+	byte		*p, *buf;
+	int		 size;
+
+	switch (tif_get(e + 2, 2)) {
+	  case 1:  size = 1; break;
+	  case 3:  size = 2; break;
+	  case 4:  size = 4; break;
+	  default: return NULL;
+	}
+	count = tif_get(e + 4, 4);
+	if (count == 0 || count > 1UL << 24 ||
+		(v = (unsigned long *) malloc(count * sizeof(unsigned long))) == NULL)
+	    return NULL;
+	buf = NULL;
+	p = e + 8;
+	if (count * size > 4) {
+	    /* the values are somewhere else in the file */
+	    if ((buf = (byte *) malloc(count * size)) == NULL ||
+		    fseek(tif, (long) tif_get(e + 8, 4), SEEK_SET) != 0 ||
+		    fread(buf, size, count, tif) != count) {
+		if (buf)
+		    free(buf);
+		free(v);
+		return NULL;
+	    }
+	    p = buf;
+	}
+	for (i = 0; i < count; i++)
+	    v[i] = tif_get(p + i * size, size);
+	if (buf)
+	    free(buf);
+	*np = count;
+	return v;
+}
+
+/* the first value of directory entry e */
+
+static unsigned long
+tif_value(e)
+    byte	*e;
+{
+	unsigned long	*v, n, first;
+
+	if ((v = tif_array(e, &n)) == NULL)
+	    return 0;
+	first = v[0];
+	free(v);
+	return first;
+}
+
+/*
+ * Uncompress the LZW data in[inlen] into out[outlen].  The codes are 9 to
+ * 12 bits, highest bit first, and get one bit wider a code early.
+ */
+
+static void
+tif_lzw(in, inlen, out, outlen)
+    byte	*in, *out;
+    long	 inlen, outlen;
+{
+	unsigned short	 prefix[4096];
+	byte		 suffix[4096], stack[4097];
+	unsigned long	 bits;
+	long		 pos, n;
+	int		 nbits, width, next, code, old, c, first, sp;
+
+	bits = 0;
+	nbits = 0;
+	width = 9;
+	next = 258;
+	old = -1;
+	first = 0;
+	pos = n = 0;
+	while (n < outlen) {
+	    while (nbits < width) {
+		if (pos >= inlen)
+		    return;
+		bits = (bits << 8) | in[pos++];
+		nbits += 8;
+	    }
+	    nbits -= width;
+	    code = (bits >> nbits) & ((1 << width) - 1);
+	    if (code == 257)			/* end of information */
+		return;
+	    if (code == 256) {			/* clear */
+		width = 9;
+		next = 258;
+		old = -1;
+		continue;
+	    }
+	    if (old == -1) {
+		if (code > 255)
+		    return;
+		out[n++] = first = old = code;
+		continue;
+	    }
+	    if (code > next)
+		return;
+	    sp = 0;
+	    c = code;
+	    if (code == next) {
+		/* the code being defined: the old string and its first byte */
+		stack[sp++] = first;
+		c = old;
+	    }
+	    while (c > 255) {
+		stack[sp++] = suffix[c];
+		c = prefix[c];
+	    }
+	    stack[sp++] = first = c;
+	    while (sp > 0 && n < outlen)
+		out[n++] = stack[--sp];
+	    if (next < 4096) {
+		prefix[next] = old;
+		suffix[next] = first;
+		next++;
+	    }
+	    old = code;
+	    if (next + 1 >= 1 << width && width < 12)
+		width++;
+	}
+}
+
+/* uncompress the PackBits data in[inlen] into out[outlen] */
+
+static void
+tif_packbits(in, inlen, out, outlen)
+    byte	*in, *out;
+    long	 inlen, outlen;
+{
+	long	 pos, n;
+	int	 c;
+
+	pos = n = 0;
+	while (pos < inlen && n < outlen) {
+	    c = in[pos++];
+	    if (c < 128) {
+		/* c+1 bytes as they are */
+		for (c++; c > 0 && pos < inlen && n < outlen; c--)
+		    out[n++] = in[pos++];
+	    } else if (c > 128) {
+		/* the next byte 257-c times */
+		if (pos >= inlen)
+		    break;
+		for (c = 257 - c; c > 0 && n < outlen; c--)
+		    out[n++] = in[pos];
+		pos++;
+	    }
+	}
+}
+
+#ifdef USE_PNG
+
+/* uncompress the Deflate data in[inlen] into out[outlen] */
+
+static void
+tif_inflate(in, inlen, out, outlen)
+    byte	*in, *out;
+    long	 inlen, outlen;
+{
+	z_stream	 z;
+
+	z.zalloc = Z_NULL;
+	z.zfree = Z_NULL;
+	z.opaque = Z_NULL;
+	z.next_in = in;
+	z.avail_in = inlen;
+	if (inflateInit(&z) != Z_OK)
+	    return;
+	z.next_out = out;
+	z.avail_out = outlen;
+	(void) inflate(&z, Z_FINISH);
+	inflateEnd(&z);
+}
+
+#endif /* USE_PNG */
+
+/* undo the horizontal differencing of the w pixels of a row */
+
+static void
+tif_predict(row, w, spp, bps)
+    byte	*row;
+    long	 w;
+    int		 spp, bps;
+{
+	long	 i;
+	int	 v, hi, lo;
+
+	if (bps == 8) {
+	    for (i = spp; i < w * spp; i++)
+		row[i] += row[i - spp];
+	} else if (bps == 16) {
+	    hi = motorola ? 0 : 1;
+	    lo = 1 - hi;
+	    for (i = spp; i < w * spp; i++) {
+		v = ((row[2*i+hi] << 8) | row[2*i+lo]) +
+			((row[2*(i-spp)+hi] << 8) | row[2*(i-spp)+lo]);
+		row[2*i+hi] = v >> 8;
+		row[2*i+lo] = v;
+	    }
+	}
+}
+
+/* sample k of a row with bps bits per sample, 16-bit ones cut to 8 */
+
+static int
+tif_sample(row, k, bps)
+    byte	*row;
+    long	 k;
+    int		 bps;
+{
+	switch (bps) {
+	  case 8:
+	    return row[k];
+	  case 16:
+	    return row[2 * k + (motorola ? 0 : 1)];
+	  default:
+	    return (row[(k * bps) >> 3] >> (8 - bps - ((k * bps) & 7))) &
+			((1 << bps) - 1);
+	}
+}
@@ -284,5 +284,5 @@ ReadFromBitmapFile (file, width, height, data_ret)
     *width = ww;
     *height = hh;
 
-    RETURN (1);
+    return 1;		/* not RETURN(), the caller keeps the data */
 }
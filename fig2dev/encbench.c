@@ -0,0 +1,395 @@
+/*
+ * TransFig: Facility for Translating Fig code
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish and/or distribute copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that this copyright
+ * notice remain intact.
+ *
+ */
+
+/*
+ * encbench: throughput of the image encoders of the PostScript driver.
+ *
+ * A photo-like RGB image (smooth shading with noise) is encoded with
+ * ASCII85Encode() and ASCIIHexEncode() of dev/asc85ec.c, and a colormapped
+ * image (flat areas with a noisy band) with the run-length PSencode() of
+ * dev/psencode.c.  Each encoder is checked to give the same bytes as the
+ * character at a time encoder it replaced, which is kept here as old_*(),
+ * and then both are timed writing to /dev/null.  MB/s is megabytes of image
+ * data per second.
+ *
+ *	encbench [-w width] [-h height] [-r rounds]
+ *
+ * The default is 3000 x 2000 pixels and 3 rounds.  "make encbench" builds
+ * it.  The exit status is 1 if some output differs.
+ */
+
+#include "fig2dev.h"
+#include "dev/psencode.h"
+#include <time.h>
+
+extern int	ASCII85Encode();
+extern void	ASCIIHexEncode();
+
+typedef unsigned char byte;
+
+/* psencode.c writes to tfp and keeps track of its headers */
+FILE	*tfp;
+Boolean	psencode_header_done, transp_header_done;
+
+
+/* the encoders as they were, one character at a time */
+
+static unsigned char old_buf[4];
+static unsigned long power85[5] = { 1L, 85L, 85L*85, 85L*85*85, 85L*85*85*85};
+static int old_outbytes;
+
+static int
+old_ReadSomeBytes(FILE * in)
+{
+  register int count, i;
+
+  for (count = 0; count < 4; count++) {
+    if ((i = getc(in)) == EOF)
+      break;
+    else
+      old_buf[count] = (byte) i;
+  }
+  return count;
+}
+
+static void
+old_outbyte(byte c, FILE * out)
+{
+  if (fputc(c, out) == EOF) {
+    fprintf(stderr, "encbench: write error\n");
+    exit(2);
+  }
+  if (++old_outbytes > 63 || (old_outbytes == 1 && c == '%')) {
+    fputc('\n', out);
+    old_outbytes = 0;
+  }
+}
+
+static int
+old_ASCII85Encode(FILE * in, FILE * out)
+{
+  register int i, count;
+  unsigned long word, v;
+
+  old_outbytes = 0;
+  while ((count = old_ReadSomeBytes(in)) == 4) {
+    word = ((unsigned long)(((unsigned int)old_buf[0] << 8) + old_buf[1]) << 16) +
+                   (((unsigned int)old_buf[2] << 8) + old_buf[3]);
+    if (word == 0)
+      old_outbyte('z', out);
+    else
+      for (i = 4; i >= 0; i--) {
+	v = word / power85[i];
+	old_outbyte((byte) (v + '!'), out);
+	word -= v * power85[i];
+      }
+  }
+  word = 0;
+  if (count != 0) {
+    for (i = count-1; i >= 0; i--)
+      word += (unsigned long)old_buf[i] << 8 * (3-i);
+    for (i = 4; i >= 4-count; i--) {
+      v = word / power85[i];
+      old_outbyte((byte) (v + '!'), out);
+      word -= v * power85[i];
+    }
+  }
+  fputc('~', out);
+  fputc('>', out);
+  return 0;
+}
+
+static void
+old_ASCIIHexEncode(FILE *in, FILE * out) {
+  static char buffer[512];
+  static char BinToHex[] = "0123456789ABCDEF";
+  int CharsPerLine;
+  size_t i, n;
+  unsigned char *p;
+
+  CharsPerLine = 0;
+  fputc('\n', out);
+  while ((n = fread(buffer, 1, sizeof(buffer), in)) != 0)
+    for (i = 0, p = (unsigned char *) buffer; i < n; i++, p++) {
+      fputc(BinToHex[*p>>4], out);
+      fputc(BinToHex[*p & 0x0F], out);
+      if ((CharsPerLine += 2) >= 64) {
+        fputc('\n', out);
+        CharsPerLine = 0;
+      }
+    }
+  fputc('>', out);
+}
+
+#define put_string nc=strlen(s); for(i=0;i<nc;i++) (putc((s[i]),tfp)); Nbyte += nc
+
+static long
+old_PSencode(Width, Height, Transparent, Ncol, R, G, B, data)
+    int		Width, Height, Transparent, Ncol;
+    byte	R[], G[], B[];
+    unsigned char *data;
+{
+  long    Nbyte;
+  char    s[80];
+  byte    *ptr, *end;
+  int     i, nc, k, current, previous = 0, run, y;
+
+  static char h[] = "0123456789abcdef";
+
+  if (Transparent != -1) {
+	fprintf(tfp,"[/Indexed /DeviceRGB %d <\n",Ncol-1);
+  } else {
+	fprintf(tfp, "%%***********************************************\n");
+	fprintf(tfp, "%%*              Image decoding                 *\n");
+	fprintf(tfp, "%%***********************************************\n");
+	fprintf(tfp, "DisplayImage\n");
+	fprintf(tfp,"%d %d\n", Width, Height);
+	fprintf(tfp,"%d\n",Ncol);
+  }
+  Nbyte = 0;
+  for (k=0; k<Ncol; k++) {
+    sprintf(s,"%02x%02x%02x", R[k], G[k], B[k]);   put_string;
+    if (k % 10 == 9 || k == Ncol-1) {
+      sprintf(s,"\n");                             put_string;
+    } else {
+      sprintf(s, " ");                             put_string;
+    }
+  }
+  if (Transparent != -1) {
+	fprintf(tfp,"\n > ] setcolorspace\n");
+	fprintf(tfp,"%d %d %d transparentimage\n",Width,Height,Transparent);
+  }
+  run   = 0;
+  nc    = 0;
+  s[72] = '\n';
+  s[73] = '\0';
+  for(y=0; y<Height; y++) {
+    ptr = (data+y*Width);
+    end = ptr + Width;
+    if (y == 0) previous = *ptr++;
+    while (ptr < end) {
+      current = *ptr++;
+      if (current == previous && run < 255) {
+        run++;
+        continue;
+      }
+      if (nc == 72) {
+        put_string;
+        nc = 0;
+      }
+      s[nc++] = h[run / 16];
+      s[nc++] = h[run % 16];
+      s[nc++] = h[previous / 16];
+      s[nc++] = h[previous % 16];
+      previous = current;
+      run = 0;
+    }
+  }
+  if (nc == 72) {
+    put_string;
+    nc = 0;
+  }
+  s[nc++] = h[run / 16];
+  s[nc++] = h[run % 16];
+  s[nc++] = h[previous / 16];
+  s[nc++] = h[previous % 16];
+  s[nc++] = '\n';
+  s[nc]   = '\0';
+  put_string;
+  return Nbyte;
+}
+
+
+/* test images */
+
+static int	width = 3000, height = 2000;
+static byte	*rgb, *pix;
+static byte	R[256], G[256], B[256];
+static FILE	*rgbfile;		/* rgb, for the FILE * encoders */
+
+static void
+make_images()
+{
+    int		x, y, v;
+    byte	*p;
+
+    rgb = (byte *) malloc((size_t) width * height * 3);
+    pix = (byte *) malloc((size_t) width * height);
+    if (rgb == NULL || pix == NULL) {
+	fprintf(stderr, "encbench: out of memory\n");
+	exit(2);
+    }
+    srand(1);
+    /* shading with noise, and some black rows for the "z" of ASCII85 */
+    for (y = 0, p = rgb; y < height; y++)
+	for (x = 0; x < width; x++) {
+	    v = y % 97 == 0 ? 0 : rand() % 17 - 8;
+	    *p++ = y % 97 == 0 ? 0 : (byte) ((x * 255 / width + v) & 0xff);
+	    *p++ = y % 97 == 0 ? 0 : (byte) ((y * 255 / height + v) & 0xff);
+	    *p++ = y % 97 == 0 ? 0 :
+		(byte) (((x + y) * 127 / (width + height) + v) & 0xff);
+	}
+    /* flat areas, a noisy band and some black rows */
+    for (y = 0, p = pix; y < height; y++)
+	for (x = 0; x < width; x++)
+	    if (y % 97 == 0)
+		*p++ = 0;
+	    else if (y > height/3 && y < height/2)
+		*p++ = (byte) (rand() % 64);
+	    else
+		*p++ = (byte) ((x / 37 + y / 53) & 0xff);
+    for (x = 0; x < 256; x++) {
+	R[x] = x;
+	G[x] = 255 - x;
+	B[x] = (x * 7) & 0xff;
+    }
+    if ((rgbfile = tmpfile()) == NULL ||
+	fwrite(rgb, 1, (size_t) width * height * 3, rgbfile) !=
+		(size_t) width * height * 3) {
+	fprintf(stderr, "encbench: can't write a temporary file\n");
+	exit(2);
+    }
+}
+
+/* run encoder number e (0 new, 1 old) of kind k into out */
+
+#define A85	0
+#define HEX	1
+#define RLE	2
+
+static char	*kind_name[] = { "ASCII85", "hex", "RLE (PSencode)" };
+
+static void
+encode(k, e, out)
+    int		k, e;
+    FILE	*out;
+{
+    rewind(rgbfile);
+    tfp = out;
+    switch (k) {
+      case A85:
+	if (e == 0)
+	    (void) ASCII85Encode(rgbfile, out);
+	else
+	    (void) old_ASCII85Encode(rgbfile, out);
+	break;
+      case HEX:
+	if (e == 0)
+	    ASCIIHexEncode(rgbfile, out);
+	else
+	    old_ASCIIHexEncode(rgbfile, out);
+	break;
+      case RLE:
+	if (e == 0)
+	    (void) PSencode(width, height, -1, 256, R, G, B, pix);
+	else
+	    (void) old_PSencode(width, height, -1, 256, R, G, B, pix);
+	break;
+    }
+    fflush(out);
+}
+
+/* compare the contents of two files, return 1 if they are the same */
+
+static int
+same_output(a, b)
+    FILE	*a, *b;
+{
+    char	ba[BUFSIZ], bb[BUFSIZ];
+    size_t	na, nb;
+
+    rewind(a);
+    rewind(b);
+    do {
+	na = fread(ba, 1, sizeof(ba), a);
+	nb = fread(bb, 1, sizeof(bb), b);
+	if (na != nb || memcmp(ba, bb, na) != 0)
+	    return 0;
+    } while (na > 0);
+    return 1;
+}
+
+int
+main(argc, argv)
+    int		argc;
+    char	*argv[];
+{
+    FILE	*out[2], *null;
+    double	secs[2], mb;
+    clock_t	c0;
+    int		rounds = 3, bad = 0;
+    int		i, k, e, r;
+
+    for (i = 1; i < argc - 1; i += 2) {
+	if (strcmp(argv[i], "-w") == 0)
+	    width = atoi(argv[i+1]);
+	else if (strcmp(argv[i], "-h") == 0)
+	    height = atoi(argv[i+1]);
+	else if (strcmp(argv[i], "-r") == 0)
+	    rounds = atoi(argv[i+1]);
+	else
+	    break;
+    }
+    /* PSencode takes at most 16384 pixels either way */
+    if (i < argc || width < 1 || width > 16384 || height < 1 ||
+		height > 16384 || rounds < 1) {
+	fprintf(stderr, "usage: %s [-w width] [-h height] [-r rounds]\n",
+		argv[0]);
+	exit(2);
+    }
+    make_images();
+    if ((null = fopen("/dev/null", "w")) == NULL) {
+	perror("/dev/null");
+	exit(2);
+    }
+    /* the drivers write through a 64K buffer too */
+    setvbuf(null, NULL, _IOFBF, 65536);
+
+    printf("%d x %d pixels, %d rounds\n", width, height, rounds);
+    printf("%-16s %10s %10s %9s %9s\n", "encoder", "MB", "old MB/s",
+	   "MB/s", "speedup");
+    for (k = A85; k <= RLE; k++) {
+	for (e = 0; e < 2; e++) {
+	    if ((out[e] = tmpfile()) == NULL) {
+		fprintf(stderr, "encbench: can't make a temporary file\n");
+		exit(2);
+	    }
+	    encode(k, e, out[e]);
+	}
+	if (!same_output(out[0], out[1])) {
+	    printf("%-16s output differs from the old encoder\n",
+		   kind_name[k]);
+	    bad++;
+	}
+	fclose(out[0]);
+	fclose(out[1]);
+
+	/* interleave the rounds so that both see the same machine */
+	secs[0] = secs[1] = 0.0;
+	for (r = 0; r < rounds; r++)
+	    for (e = 1; e >= 0; e--) {
+		c0 = clock();
+		encode(k, e, null);
+		secs[e] += (double) (clock() - c0) / CLOCKS_PER_SEC;
+	    }
+	mb = (double) width * height * (k == RLE ? 1 : 3) / 1e6;
+	printf("%-16s %10.1f %10.1f %9.1f %8.1fx\n", kind_name[k], mb,
+	       mb * rounds / secs[1], mb * rounds / secs[0],
+	       secs[0] > 0.0 ? secs[1] / secs[0] : 0.0);
+    }
+    if (bad)
+	exit(1);
+    printf("output identical\n");
+    exit(0);
+}
@@ -24,23 +24,34 @@
 #include <sys/types.h>
 #endif
 #include <sys/file.h>
+#include <sys/wait.h>
+#include <sys/time.h>
 #include "fig2dev.h"
 #include "alloc.h"
 #include "object.h"
 #include "drivers.h"
 #include "bound.h"
 #include "read.h"
+#include "trans_spline.h"
+#include "dev/outbuf.h"
 
 extern	int	 fig_getopt();
 extern	char	*optarg;
-extern	int	 optind;
+extern	int	 optind, opterr, optreset;
 char		 lang[40];
 int		 parse_gridspec();
 static void	 grid_usage();
 int		 gendev_objects();
+static int	 skip_options();
+static int	 convert_figure();
+static int	 add_jobs();
+static int	 read_manifest();
+static int	 run_batch();
+static void	 reset_state();
+static void	 gen_xspline();
 
 void	help_msg();
-void	depth_option();
+int	depth_option();
 int	depth_filter(int);
 
 /* hex names for Fig colors */
@@ -56,6 +67,7 @@ char	*Fig_color_names[] = {
 		};
 
 struct driver *dev = NULL;
+static int	nworkers = 1;	/* processes for a batch (-J) */
 
 #ifdef I18N
 char	Usage[] = "Usage: %s [-L language] [-f font] [-s size] [-m scale] [-j] [input [output]]\n";
@@ -109,6 +121,8 @@ float	max_dimension;		/* if the user chooses max figure dimension (-Z) */
 Boolean	psencode_header_done = False; /* if we have already emitted PSencode header */
 Boolean	transp_header_done = False;   /* if we have already emitted transparent image header */
 Boolean	grayonly = False;	/* convert colors to grayscale (-N option) */
+double	curve_res;		/* output resolution (dpi) for flattening X-splines,
+				   set by the driver's start function if it knows */
 
 struct obj_rec {
 	void (*gendev)();
@@ -174,12 +188,18 @@ put_msg(char *fmt, ...)
 /* all option letters must be in this string */
 
 #ifdef I18N
-#define ARGSTRING	"AaB:b:C:cD:d:E:eFf:G:g:hI:i:jkKl:L:Mm:Nn:OoPp:q:R:rS:s:Tt:UVvX:x:Y:y:WwZ:z:?"
+#define ARGSTRING	"AaB:b:C:cD:d:E:eFf:G:g:hI:i:jkKl:L:Mm:Nn:OoPp:q:Q:R:rS:s:Tt:UVvX:x:Y:y:WwZ:z:?"
 #else
-#define ARGSTRING	"AaB:b:C:cD:d:E:eFf:G:g:hI:i:kKl:L:Mm:Nn:OoPp:q:R:rS:s:Tt:UVvX:x:Y:y:WwZ:z:?"
+#define ARGSTRING	"AaB:b:C:cD:d:E:eFf:G:g:hI:i:kKl:L:Mm:Nn:OoPp:q:Q:R:rS:s:Tt:UVvX:x:Y:y:WwZ:z:?"
 #endif
 
-void
+/*
+ * Parse the options.  Returns 0 to go on with the conversion, 1 after an
+ * error and -1 when there is nothing to convert (-h, -V).  Only main()
+ * exits, so that a bad line of a batch doesn't end the batch.
+ */
+
+int
 get_args(argc, argv)
 int	 argc;
 char	*argv[];
@@ -202,11 +222,11 @@ char	*argv[];
 							VERSION, PATCHLEVEL);
 		    if (c == 'h')
 			help_msg();
-		    exit(0);
-		    break;
+		    return -1;
 
 	        case 'D':	                /* depth filtering */
-		    depth_option(optarg);
+		    if (depth_option(optarg) != 0)
+			return 1;
 		    continue;			/* don't pass to driver */
 
    	        case 'K':
@@ -279,7 +299,7 @@ char	*argv[];
 			for (i=0; *drivers[i].name; i++)
 				fprintf(stderr,"%s ",drivers[i].name);
 			fprintf(stderr,"\n");
-			exit(1);
+			return 1;
 		    }
 		    break;
 
@@ -308,15 +328,16 @@ char	*argv[];
 
 		case '?':			/* usage 		*/
 			fprintf(stderr,Usage,prog);
-			exit(1);
+			return 1;
 	    }
 
 	    /* pass options through to driver */
 	    if (!dev) {
 		fprintf(stderr, "No graphics language specified.\n");
-		exit(1);
+		return 1;
 	    }
-	    dev->option(c, optarg);
+	    if (dev->option(c, optarg) != 0)
+		return 1;
       	}
 	/* adjust font size after option loop to make sure we have any -m first,
 	   which affects fontmag */
@@ -324,19 +345,20 @@ char	*argv[];
 
       	if (!dev) {
 		fprintf(stderr, "No graphics language specified.\n");
-		exit(1);
+		return 1;
       	}
 
 	/* make sure user doesn't specify both mag and max dimension */
 	if (magspec && maxdimspec) {
 		fprintf(stderr, "Must specify only one of -m (magnification) and -Z (max dimension).\n");
-		exit(1);
+		return 1;
 	}
 
 	if (optind < argc)
 		from = argv[optind++];	/*  from file  */
 	if (optind < argc)
 		to   = argv[optind];	/*  to file    */
+	return 0;
 }
 
 int
@@ -377,15 +399,66 @@ main(argc, argv)
 int	 argc;
 char	*argv[];
 {
-	F_compound	objects;
-	int		status;
+	int		status, n;
+	char		*num;
 
 #ifdef HAVE_SETMODE
 	setmode(1,O_BINARY); /* stdout is binary */
 #endif
 
+	prog = argv[0];
+
+	/* -J N first: convert the figures of a batch with N processes */
+	if (argc > 1 && strncmp(argv[1], "-J", 2) == 0) {
+	    num = argv[1][2]? &argv[1][2]: argc > 2? argv[2]: "";
+	    if (!isdigit(num[0]) || (nworkers = atoi(num)) < 1) {
+		fprintf(stderr, "%s: -J needs the number of processes\n", prog);
+		exit(1);
+	    }
+	    n = argv[1][2]? 1: 2;
+	    argv[n] = argv[0];
+	    argc -= n;
+	    argv += n;
+	}
+
+	/* batch mode: one conversion per line of the manifest */
+	if (argc > 1 && strncmp(argv[1], "-@", 2) == 0) {
+	    if (argv[1][2] == '\0' && argc < 3) {
+		fprintf(stderr, "%s: -@ needs the name of a manifest file\n", prog);
+		exit(1);
+	    }
+	    if (read_manifest(argv[1][2]? &argv[1][2]: argv[2]) != 0)
+		exit(1);
+	    exit(run_batch());
+	}
+
+	/* more than one pair of files is a batch too */
+	if (argc - skip_options(argc, argv, (struct driver **) NULL) > 2) {
+	    if (add_jobs(argc, argv, 0) != 0)
+		exit(1);
+	    exit(run_batch());
+	}
+
 	/* get the options */
-	get_args(argc, argv);
+	if ((status = get_args(argc, argv)) != 0)
+	    exit(status < 0? 0: status);
+
+	status = convert_figure();
+	exit(status);
+}
+
+static Boolean	stdout_buffered = False;	/* out_buffer() done on stdout */
+
+/*
+ * Convert the figure in "from" (stdin if NULL) to "to" (stdout if NULL)
+ * with the driver and options that get_args() has set up.
+ */
+
+static int
+convert_figure()
+{
+	F_compound	objects;
+	int		status;
 
 	/* read the Fig file */
 
@@ -401,20 +474,28 @@ char	*argv[];
 	if (status != 0) {
 	    if (from) 
 		read_fail_message(from, status);
-	    exit(1);
+	    free_arena();
+	    return 1;
 	}
 
-	if (to == NULL)
+	if (to == NULL) {
 	    tfp = stdout;
-	else {
+	    if (!stdout_buffered) {
+		out_buffer(stdout);
+		stdout_buffered = True;
+	    }
+	} else {
 	    if (strstr(to, ".fig") == to + strlen(to)-4) {
 	   	fprintf(stderr,"Outfile is a .fig file, aborting\n");
-		exit(1);
+		free_arena();
+		return 1;
 	    }
 	    if ((tfp = fopen(to, "wb")) == NULL) {
 		fprintf(stderr, "Couldn't open %s\n", to);
-		exit(1);
+		free_arena();
+		return 1;
 	    }
+	    out_buffer(tfp);
 	}
 
 	/* Compute bounding box of objects, supressing texts if indicated */
@@ -448,7 +529,465 @@ char	*argv[];
 	status = gendev_objects(&objects, dev);
 	if ((tfp != stdout) && (tfp != 0)) 
 	    (void)fclose(tfp);
-	exit(status);
+	else if (tfp == stdout)
+	    (void)fflush(stdout);
+	free_arena();
+	return status;
+}
+
+/*
+ * Batch mode.
+ *
+ * Many figures are converted by one process, so the colors, fonts and
+ * whatever the drivers load are set up only once.  Between two figures
+ * reset_state() puts the globals of fig2dev.c and the driver that was
+ * used back to their defaults.  The options are parsed anew for every
+ * figure.  Drivers that have no reset function convert in a child
+ * process, which starts from the state the parent never changed.
+ */
+
+/* find the first file name in argv, and the driver that -L asks for */
+
+static int
+skip_options(argc, argv, drv)
+    int			 argc;
+    char		*argv[];
+    struct driver	**drv;
+{
+	int	c, i, first;
+
+	if (drv)
+	    *drv = NULL;
+	optind = 1;
+	optreset = 1;
+	opterr = 0;		/* get_args() will complain */
+	while ((c = fig_getopt(argc, argv, ARGSTRING)) != EOF)
+	    if (c == 'L' && drv && *drv == NULL)
+		for (i=0; *drivers[i].name; i++)
+		    if (!strcmp(optarg, drivers[i].name))
+			*drv = drivers[i].dev;
+	first = optind;
+	optind = 1;
+	optreset = 1;
+	opterr = 1;
+	return first;
+}
+
+/* convert infile to outfile with the options in argv */
+
+static int
+convert_job(argc, argv, infile, outfile)
+    int		 argc;
+    char	*argv[];
+    char	*infile, *outfile;
+{
+	struct driver	*drv;
+	int		 status;
+	pid_t		 pid;
+
+	(void) skip_options(argc, argv, &drv);
+	if (drv != NULL && drv->reset == NULL) {
+	    (void) fflush(NULL);
+	    if ((pid = fork()) == 0) {
+		if ((status = get_args(argc, argv)) != 0)
+		    _exit(status < 0? 0: 1);
+		from = infile;
+		to = outfile;
+		status = convert_figure();
+		/* flush what the driver left open, but don't let exit()
+		   touch the streams shared with the parent */
+		(void) fflush(NULL);
+		_exit(status == 0? 0: 1);
+	    }
+	    if (pid > 0) {
+		if (waitpid(pid, &status, 0) != pid)
+		    return 1;
+		return (WIFEXITED(status) && WEXITSTATUS(status) == 0)? 0: 1;
+	    }
+	    /* no child, do it here and hope for the best */
+	}
+	if ((status = get_args(argc, argv)) != 0) {
+	    reset_state();
+	    return status < 0? 0: 1;
+	}
+	from = infile;
+	to = outfile;
+	status = convert_figure();
+	reset_state();
+	return status;
+}
+
+/*
+ * The jobs of a batch: one pair of files each, with the options that go
+ * with them.  They are all collected first so that they can be handed
+ * out to several worker processes (-J N).
+ */
+
+typedef struct {
+	int	 argc;
+	char	**argv;
+	char	*infile, *outfile;
+	int	 line_no;		/* in the manifest, 0 for the command line */
+} Batch_job;
+
+static Batch_job *jobs = NULL;
+static int	 njobs = 0, maxjobs = 0;
+static char	*manifest_name = NULL;
+
+static int
+add_job(argc, argv, infile, outfile, line_no)
+    int		 argc;
+    char	*argv[];
+    char	*infile, *outfile;
+    int		 line_no;
+{
+	if (njobs >= maxjobs) {
+	    maxjobs = maxjobs? 2*maxjobs: 64;
+	    if ((jobs = (Batch_job *) realloc((char *) jobs,
+				maxjobs * sizeof(Batch_job))) == NULL) {
+		put_msg(Err_mem);
+		return 1;
+	    }
+	}
+	jobs[njobs].argc = argc;
+	jobs[njobs].argv = argv;
+	jobs[njobs].infile = infile;
+	jobs[njobs].outfile = outfile;
+	jobs[njobs].line_no = line_no;
+	njobs++;
+	return 0;
+}
+
+/* add a job for each pair of files that follows the options in argv */
+
+static int
+add_jobs(argc, argv, line_no)
+    int		 argc;
+    char	*argv[];
+    int		 line_no;
+{
+	int	 i, first;
+
+	first = skip_options(argc, argv, (struct driver **) NULL);
+	if (argc - first <= 2)
+	    return add_job(argc, argv, first < argc? argv[first]: (char *) NULL,
+			first+1 < argc? argv[first+1]: (char *) NULL, line_no);
+	if ((argc - first) % 2 != 0) {
+	    if (line_no)
+		fprintf(stderr, "%s: line %d of %s: ", prog, line_no, manifest_name);
+	    else
+		fprintf(stderr, "%s: ", prog);
+	    fprintf(stderr, "input and output files must come in pairs\n");
+	    return 1;
+	}
+	for (i = first; i < argc; i += 2)
+	    if (add_job(argc, argv, argv[i], argv[i+1], line_no) != 0)
+		return 1;
+	return 0;
+}
+
+/*
+ * Each line of a manifest holds the arguments of one fig2dev command,
+ * e.g. "-L eps -m 0.8 fig1.fig fig1.eps".  Arguments with blanks may be
+ * put in double quotes, and lines starting with '#' are comments.
+ */
+
+#define MAXBATCHARGS	100
+
+static int
+read_manifest(manifest)
+    char	*manifest;
+{
+	FILE	*fp;
+	char	 line[BUFSIZ*4], *args[MAXBATCHARGS+1], **argv, *p;
+	int	 nargs, line_no, i;
+
+	if (strcmp(manifest, "-") == 0)
+	    fp = stdin;
+	else if ((fp = fopen(manifest, "r")) == NULL) {
+	    fprintf(stderr, "%s: can't open manifest %s\n", prog, manifest);
+	    return 1;
+	}
+	manifest_name = manifest;
+	line_no = 0;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+	    line_no++;
+	    args[0] = prog;
+	    nargs = 1;
+	    for (p = line; ; ) {
+		while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+		    p++;
+		if (*p == '\0' || (*p == '#' && nargs == 1))
+		    break;
+		if (nargs >= MAXBATCHARGS) {
+		    fprintf(stderr, "%s: too many arguments in line %d of %s\n",
+				prog, line_no, manifest);
+		    break;
+		}
+		if (*p == '"') {
+		    args[nargs++] = ++p;
+		    while (*p && *p != '"')
+			p++;
+		} else {
+		    args[nargs++] = p;
+		    while (*p && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r')
+			p++;
+		}
+		if (*p)
+		    *p++ = '\0';
+	    }
+	    if (nargs == 1)
+		continue;
+	    /* the jobs keep pointers into their argument vector */
+	    if ((argv = (char **) malloc((nargs+1) * sizeof(char *))) == NULL) {
+		put_msg(Err_mem);
+		return 1;
+	    }
+	    argv[0] = prog;
+	    for (i = 1; i < nargs; i++)
+		if ((argv[i] = strdup(args[i])) == NULL) {
+		    put_msg(Err_mem);
+		    return 1;
+		}
+	    argv[nargs] = NULL;
+	    if (add_jobs(nargs, argv, line_no) != 0)
+		return 1;
+	}
+	if (fp != stdin)
+	    fclose(fp);
+	return 0;
+}
+
+static void
+report_failed(j)
+    Batch_job	*j;
+{
+	if (j->line_no)
+	    fprintf(stderr, "%s: line %d of %s failed\n", prog, j->line_no,
+			manifest_name);
+	else
+	    fprintf(stderr, "%s: converting %s failed\n", prog,
+			j->infile? j->infile: "standard input");
+}
+
+static int
+do_job(j)
+    Batch_job	*j;
+{
+	if (convert_job(j->argc, j->argv, j->infile, j->outfile) == 0)
+	    return 0;
+	report_failed(j);
+	return 1;
+}
+
+/*
+ * The workers of a batch.  Each is a copy of this process and has its
+ * own globals, so the drivers don't have to know that they run side by
+ * side.  A worker reads the number of its next job from its own pipe,
+ * converts it and writes the status back on another, so the parent
+ * always knows which job each worker is doing.
+ */
+
+typedef struct {
+	pid_t	 pid;
+	int	 to, from;		/* job numbers to it, statuses from it */
+	int	 job;			/* the job it is doing, or -1 */
+} Batch_worker;
+
+static Batch_worker *workers;
+
+/* start worker w, returns 0 if it runs */
+
+static int
+start_worker(w)
+    int		 w;
+{
+	int	 jobfds[2], statfds[2], i, status;
+
+	if (pipe(jobfds) != 0)
+	    return 1;
+	if (pipe(statfds) != 0) {
+	    close(jobfds[0]);
+	    close(jobfds[1]);
+	    return 1;
+	}
+	(void) fflush(NULL);
+	if ((workers[w].pid = fork()) == 0) {
+	    (void) signal(SIGPIPE, SIG_DFL);
+	    for (i = 0; i < nworkers; i++)
+		if (i != w && workers[i].pid > 0) {
+		    close(workers[i].to);
+		    close(workers[i].from);
+		}
+	    close(jobfds[1]);
+	    close(statfds[0]);
+	    while (read(jobfds[0], (char *) &i, sizeof(i)) == sizeof(i)) {
+		status = do_job(&jobs[i]);
+		(void) fflush(NULL);
+		if (write(statfds[1], (char *) &status, sizeof(status)) != sizeof(status))
+		    break;
+	    }
+	    _exit(0);
+	}
+	close(jobfds[0]);
+	close(statfds[1]);
+	if (workers[w].pid < 0) {
+	    close(jobfds[1]);
+	    close(statfds[0]);
+	    return 1;
+	}
+	workers[w].to = jobfds[1];
+	workers[w].from = statfds[0];
+	workers[w].job = -1;
+	return 0;
+}
+
+/* stop worker w */
+
+static void
+stop_worker(w)
+    int		 w;
+{
+	close(workers[w].to);
+	close(workers[w].from);
+	(void) waitpid(workers[w].pid, (int *) NULL, 0);
+	workers[w].pid = -1;
+	workers[w].job = -1;
+}
+
+/* hand job i to worker w, returns 1 if it has taken it */
+
+static int
+give_job(w, i)
+    int		 w, i;
+{
+	workers[w].job = -1;
+	if (write(workers[w].to, (char *) &i, sizeof(i)) != sizeof(i))
+	    return 0;		/* it has died, select() will tell */
+	workers[w].job = i;
+	return 1;
+}
+
+/*
+ * Run the jobs with nworkers processes, one without -J.  A worker takes
+ * its next job when it is done with the last, so a worker that gets the
+ * big figures doesn't hold up the others.  If a worker dies in a job,
+ * e.g. a driver calls exit(), only that job fails: it is reported and a
+ * new worker takes over.  What the workers can't do is done here.
+ */
+
+static int
+run_batch()
+{
+	fd_set	 fds;
+	int	 w, n, next, failed, status, maxfd;
+	void	 (*oldpipe)();
+
+	failed = next = 0;
+	if (nworkers > njobs)
+	    nworkers = njobs;
+	if ((workers = (Batch_worker *) malloc(nworkers * sizeof(Batch_worker))) == NULL) {
+	    put_msg(Err_mem);
+	    return 1;
+	}
+	for (w = 0; w < nworkers; w++)
+	    workers[w].pid = -1;
+	/* a worker that has died must not take this process with it */
+	oldpipe = signal(SIGPIPE, SIG_IGN);
+
+	for (w = 0; w < nworkers && next < njobs; w++)
+	    if (start_worker(w) == 0 && give_job(w, next))
+		next++;
+	for (;;) {
+	    FD_ZERO(&fds);
+	    maxfd = -1;
+	    for (w = n = 0; w < nworkers; w++)
+		if (workers[w].pid > 0) {
+		    FD_SET(workers[w].from, &fds);
+		    if (workers[w].from > maxfd)
+			maxfd = workers[w].from;
+		    n++;
+		}
+	    if (n == 0)
+		break;
+	    if (select(maxfd + 1, &fds, (fd_set *) NULL, (fd_set *) NULL,
+			(struct timeval *) NULL) < 0) {
+		if (errno == EINTR)
+		    continue;
+		perror(prog);
+		for (w = 0; w < nworkers; w++)
+		    if (workers[w].pid > 0) {
+			if (workers[w].job >= 0) {
+			    report_failed(&jobs[workers[w].job]);
+			    failed++;
+			}
+			stop_worker(w);
+		    }
+		break;
+	    }
+	    for (w = 0; w < nworkers; w++) {
+		if (workers[w].pid <= 0 || !FD_ISSET(workers[w].from, &fds))
+		    continue;
+		if (read(workers[w].from, (char *) &status, sizeof(status))
+			== sizeof(status)) {
+		    failed += status;
+		    if (next < njobs && give_job(w, next))
+			next++;
+		    else if (next >= njobs)
+			stop_worker(w);
+		    continue;
+		}
+		/* it has died, maybe in a job */
+		if (workers[w].job >= 0) {
+		    report_failed(&jobs[workers[w].job]);
+		    failed++;
+		}
+		stop_worker(w);
+		if (next < njobs && start_worker(w) == 0 && give_job(w, next))
+		    next++;
+	    }
+	}
+	(void) signal(SIGPIPE, oldpipe);
+	free((char *) workers);
+
+	/* no workers, or none left */
+	while (next < njobs)
+	    failed += do_job(&jobs[next++]);
+	return failed? 1: 0;
+}
+
+/* put everything the options and the last figure changed back to the defaults */
+
+static void
+reset_state()
+{
+	if (dev && dev->reset)
+	    (*dev->reset)();
+	dev = NULL;
+	from = to = name = NULL;
+	font_size = 0.0;
+	correct_font_size = False;
+	mag = fontmag = 1.0;
+	tfp = NULL;
+	llx = lly = urx = ury = 0;
+	landscape = center = False;
+	orientspec = centerspec = magspec = transspec = multispec = False;
+	paperspec = boundingboxspec = maxdimspec = False;
+	multi_page = overlap = False;
+	gif_transparent[0] = '\0';
+	boundingbox[0] = '\0';
+	bgspec = False;
+	grid_minor_spacing = grid_major_spacing = 0.0;
+	mult = 0.0;
+	psencode_header_done = transp_header_done = False;
+	grayonly = False;
+	depth_index = 0;
+	adjust_boundingbox = 0;
+#ifdef I18N
+	support_i18n = False;
+#endif
+	optind = 1;
+	optreset = 1;
 }
 
 void
@@ -466,6 +1005,9 @@ help_msg()
 	printf("%s ",drivers[i].name);
     }
     printf("\n");
+    printf("  -@ manifest	convert the figures of each line in manifest (batch mode)\n");
+    printf("		  (more than one pair of input and output files also works)\n");
+    printf("  -J N		(first, before -@ or the files of a batch) convert with N processes\n");
     printf("  -h		print this message, fig2dev version number and exit\n");
     printf("  -V		print fig2dev version number and exit\n");
     printf("  -D +/-list	include or exclude depths listed\n");
@@ -518,9 +1060,11 @@ help_msg()
     printf("  -g color	background color\n");
     printf("  -N		convert all colors to grayscale\n");
     printf("  -n name	set title part of PostScript output to name\n");
+    printf("  -Q level	PostScript LanguageLevel (3 compresses images with Flate)\n");
     printf("  -R \"Wx [Wy X0 Y0]\" force width, height and origin in relative coordinates\n");
     printf("			 (relative to lower-left of figure bounds)\n");
     printf("  -T		add monochrome TIFF preview (for Microsoft apps)\n");
+    printf("  -U		make the preview with ghostscript\n");
 
     printf("GBX (Gerber, RS-247-X)  Options:\n");
     printf("  -d [mm|in]	Output dimensions assumed to be millimeters or inches.\n");
@@ -541,6 +1085,7 @@ help_msg()
     printf("  -i [on|off]	Controls the output of comments describing the type of objects being\n");
     printf("		output.  The text appears as comments starting with ## on each line in\n");
     printf("		the output file.  By default this is on.\n");
+    printf("  -O		Order the objects by aperture and to cut down the travel between them.\n");
 
     printf("IBM-GL Options:\n");
     printf("  -a		select ISO A4 paper size if default is ANSI A, or vice versa\n");
@@ -550,6 +1095,7 @@ help_msg()
     printf("  -k		precede output with PCL command to use HP/GL\n");
     printf("  -l pattfile	load patterns for pattern fill from file\n");
     printf("  -m mag,x0,y0	magnification with optional offset in inches\n");
+    printf("  -O		order the objects to save pen changes and pen-up travel\n");
     printf("  -P		rotate figure to portrait (default is landscape)\n");
     printf("  -p pensfile	load plotter pen specs from file\n");
     printf("  -S speed	set pen speed in cm/sec\n");
@@ -604,7 +1150,9 @@ help_msg()
     printf("  -n name	set title part of PostScript output to name\n");
     printf("  -O        	overlap pages in multiple page mode (-M)\n");
     printf("  -p dummyarg	portrait mode (dummy argument required after \"-p\")\n");
+    printf("  -Q level	PostScript LanguageLevel (3 compresses images with Flate)\n");
     printf("  -T		add monochrome TIFF preview (for Microsoft apps)\n");
+    printf("  -U		make the preview with ghostscript\n");
     printf("  -x offset	shift figure left/right by offset units (1/72 inch)\n");
     printf("  -y offset	shift figure up/down by offset units (1/72 inch)\n");
     printf("  -z papersize	set the papersize (see man pages for available sizes)\n");
@@ -664,6 +1212,7 @@ help_msg()
     printf("  -F		use correct font sizes (points instead of 1/80inch)\n");
     printf("  -g color	background color\n");
     printf("  -N		convert all colors to grayscale\n");
+    printf("  -r		draw without ghostscript (no text)\n");
     printf("  -S smooth	specify smoothing factor [1=none, 2=some 4=more]\n");
 
     printf("GIF Options:\n");
@@ -674,11 +1223,42 @@ help_msg()
 
 }
 
-/* count primitive objects & create pointer array */
-static int compound_dump(com, array, count, dev)
+/*
+ * The objects of the figure, in the order of the file, flattened into one
+ * array by compound_dump() and then sorted by depth.  Objects that the -D
+ * option leaves out are not put in at all.
+ */
+
+static struct obj_rec	*rec_array = NULL;
+static int		 nrecs, maxrecs = 0;
+static int		 nobjects;	/* all objects, also those left out */
+
+static void
+add_rec(gendev, obj, depth)
+    void		(*gendev)();
+    char		*obj;
+    int			 depth;
+{
+	nobjects++;
+	if (!depth_filter(depth))
+	    return;
+	if (nrecs >= maxrecs) {
+	    maxrecs = maxrecs ? 2 * maxrecs : 256;
+	    if ((rec_array = (struct obj_rec *) realloc(rec_array,
+				maxrecs * sizeof(struct obj_rec))) == NULL) {
+		put_msg(Err_mem);
+		exit(1);
+	    }
+	}
+	rec_array[nrecs].gendev = gendev;
+	rec_array[nrecs].obj = obj;
+	rec_array[nrecs].depth = depth;
+	nrecs++;
+}
+
+static void
+compound_dump(com, dev)
     F_compound		*com;
-    struct obj_rec	*array;
-    int			 count;
     struct driver	*dev;
 {
   	F_arc		*a;
@@ -689,48 +1269,77 @@ static int compound_dump(com, array, count, dev)
 	F_text		*t;
 
 	for (c = com->compounds; c != NULL; c = c->next)
-	  count = compound_dump(c, array, count, dev);
-	for (a = com->arcs; a != NULL; a = a->next) {
-	  if (array) {
-		array[count].gendev = dev->arc;
-		array[count].obj = (char *)a;
-		array[count].depth = a->depth;
-	  }
-	  count += 1;
-	}
-	for (e = com->ellipses; e != NULL; e = e->next) {
-	  if (array) {
-		array[count].gendev = dev->ellipse;
-		array[count].obj = (char *)e;
-		array[count].depth = e->depth;
-	  }
-	  count += 1;
-	}
-	for (l = com->lines; l != NULL; l = l->next) {
-	  if (array) {
-		array[count].gendev = dev->line;
-		array[count].obj = (char *)l;
-		array[count].depth = l->depth;
-	  }
-	  count += 1;
+	  compound_dump(c, dev);
+	for (a = com->arcs; a != NULL; a = a->next)
+	  add_rec(dev->arc, (char *)a, a->depth);
+	for (e = com->ellipses; e != NULL; e = e->next)
+	  add_rec(dev->ellipse, (char *)e, e->depth);
+	for (l = com->lines; l != NULL; l = l->next)
+	  add_rec(dev->line, (char *)l, l->depth);
+	for (s = com->splines; s != NULL; s = s->next)
+	  add_rec(x_spline(s) ? gen_xspline : dev->spline, (char *)s, s->depth);
+	for (t = com->texts; t != NULL; t = t->next)
+	  add_rec(dev->text, (char *)t, t->depth);
+}
+
+/*
+ * Sort the n records by decreasing depth, keeping the order of the file
+ * within a depth.  Fig depths go from 0 to 999, so one counting pass over
+ * the depths in use does it; a figure with a wider spread of depths takes
+ * a second pass over the upper 16 bits.  Returns the sorted array, which
+ * is either recs or tmp.
+ */
+
+#define DEPTH_KEY(r)	((((unsigned) maxd - (unsigned) (r)->depth) >> shift) & 0xffff)
+
+static struct obj_rec *
+depth_sort(recs, tmp, n)
+    struct obj_rec	*recs, *tmp;
+    int			 n;
+{
+	struct obj_rec	*src, *dst, *r;
+	int		*count;
+	int		 i, maxd, mind, nkeys, shift, sum, c;
+
+	if (n < 2)
+	    return recs;
+	maxd = mind = recs[0].depth;
+	for (r = recs+1; r < recs+n; r++) {
+	    if (r->depth > maxd)
+		maxd = r->depth;
+	    else if (r->depth < mind)
+		mind = r->depth;
 	}
-	for (s = com->splines; s != NULL; s = s->next) {
-	  if (array) {
-		array[count].gendev = dev->spline;
-		array[count].obj = (char *)s;
-		array[count].depth = s->depth;
-	  }
-	  count += 1;
+	if ((unsigned) maxd - (unsigned) mind <= 0xffff)
+	    nkeys = (unsigned) maxd - (unsigned) mind + 1;
+	else
+	    nkeys = 0x10000;
+	if ((count = (int *) malloc(nkeys * sizeof(int))) == NULL) {
+	    put_msg(Err_mem);
+	    exit(1);
 	}
-	for (t = com->texts; t != NULL; t = t->next) {
-	  if (array) {
-		array[count].gendev = dev->text;
-		array[count].obj = (char *)t;
-		array[count].depth = t->depth;
-	  }
-	  count += 1;
+
+	src = recs;
+	dst = tmp;
+	for (shift = 0; shift < 32; shift += 16) {
+	    if (shift > 0 && ((unsigned) maxd - (unsigned) mind) >> shift == 0)
+		break;
+	    memset(count, 0, nkeys * sizeof(int));
+	    for (r = src; r < src+n; r++)
+		count[DEPTH_KEY(r)]++;
+	    for (i = sum = 0; i < nkeys; i++) {
+		c = count[i];
+		count[i] = sum;
+		sum += c;
+	    }
+	    for (r = src; r < src+n; r++)
+		dst[count[DEPTH_KEY(r)]++] = *r;
+	    r = src;
+	    src = dst;
+	    dst = r;
 	}
-	return count;
+	free(count);
+	return src;
 }
 
 int
@@ -738,45 +1347,60 @@ gendev_objects(objects, dev)
     F_compound		*objects;
     struct driver	*dev;
 {
-	int	obj_count, rec_comp();
 	int	status;
-	struct	obj_rec *rec_array, *r; 
+	struct	obj_rec *sorted, *tmp, *r; 
 
 	/* dump object pointers to an array */
-	obj_count = compound_dump(objects, 0, 0, dev);
-	if (!obj_count) {
+	nrecs = nobjects = 0;
+	compound_dump(objects, dev);
+	if (!nobjects) {
 	    fprintf(stderr, "fig2dev: No objects in Fig file\n");
 	    return -1;
 	}
-	rec_array = (struct obj_rec *)malloc(obj_count*sizeof(struct obj_rec));
-	(void)compound_dump(objects, rec_array, 0, dev);
 
 	/* sort object array by depth */
-	qsort(rec_array, obj_count, sizeof(struct obj_rec), rec_comp);
+	if ((tmp = (struct obj_rec *) malloc((nrecs+1) * sizeof(struct obj_rec))) == NULL) {
+	    put_msg(Err_mem);
+	    exit(1);
+	}
+	sorted = depth_sort(rec_array, tmp, nrecs);
 
 	/* generate header */
+	curve_res = DEF_CURVE_RES;
 	(*dev->start)(objects);
 
 	/* draw any grid specified */
 	(*dev->grid)(grid_major_spacing, grid_minor_spacing);
 
 	/* generate objects in sorted order */
-	for (r = rec_array; r<rec_array+obj_count; r++)
-	  if (depth_filter(r->depth))
+	for (r = sorted; r < sorted+nrecs; r++)
 	    (*(r->gendev))(r->obj);
 
 	/* generate trailer */
 	status = (*dev->end)();
 
-	free(rec_array);
+	free(tmp);
 
 	return status;
 }
 
-int rec_comp(r1, r2)
-    struct obj_rec	*r1, *r2;
+/*
+ * Flatten an X-spline to half a pixel at the resolution of the output,
+ * and hand it to the driver as a polyline or polygon.
+ */
+
+static void
+gen_xspline(s)
+    F_spline		*s;
 {
-	return (r2->depth - r1->depth);
+	F_line	*l;
+	double	 tolerance;
+
+	tolerance = ppi / (2.0 * curve_res * mag);
+	if (tolerance < 0.25)		/* the points are whole Fig units */
+	    tolerance = 0.25;
+	if ((l = create_line_with_spline(s, tolerance)) != NULL)
+	    (*dev->line)(l);
 }
 
 /* null operation */
@@ -793,7 +1417,7 @@ void gendev_null() {
  *  d1:d2   include/exclude this range of depths
  */
 
-static void
+static int
 depth_usage()
 {
     fprintf(stderr,"%s: help for -D option:\n",prog);
@@ -801,10 +1425,12 @@ depth_usage()
     fprintf(stderr,"  -D -rangelist  means keep all depths but those in rangelist.\n");
     fprintf(stderr,"  Rangelist can be a list of numbers or ranges of numbers, e.g.:\n");
     fprintf(stderr,"    10,40,55,60:70,99\n");
-    exit(1);
+    return 1;
 }
 
-void
+/* returns 0, or 1 if s can't be parsed */
+
+int
 depth_option(s)
 char *s;
 {
@@ -815,7 +1441,7 @@ char *s;
     case '-':
 	break;
     default:
-	depth_usage();
+	return depth_usage();
   }
   
   for (d = depth_opt; depth_index < NUMDEPTHS && *s; ++depth_index, d++) {
@@ -823,12 +1449,12 @@ char *s;
     d->d1 = d->d2 = -1;
     d->d1 = strtol(s,&s,10);
     if (d->d1 < 0) 
-      depth_usage();
+      return depth_usage();
     switch(*s) {		/* what's the delim? */
       case ':':			/* parse a range */
 	d->d2 = strtol(s+1,&s,10);
 	if (d->d2 < d->d1) 
-	    depth_usage();
+	    return depth_usage();
 	break;
       case ',':			/* just start the next one */
 	s++;
@@ -837,9 +1463,10 @@ char *s;
   }
   if (depth_index >= NUMDEPTHS) {
     fprintf(stderr,"%s: Too many -D values!\n",prog);
-    exit(1);
+    return 1;
   }
   d->d1 = -1;
+  return 0;
 }
 
 int
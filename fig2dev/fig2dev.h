@@ -97,7 +97,8 @@ typedef struct _RGB {
  * Device driver interface structure
  */
 struct driver {
- 	void (*option)();	/* interpret driver-specific options */
+ 	int (*option)();	/* interpret driver-specific options (returns
+				   1 for a bad one) */
   	void (*start)();	/* output file header */
   	void (*grid)();		/* draw grid */
 	void (*arc)();		/* object generators */
@@ -109,6 +110,8 @@ struct driver {
   	int text_include;	/* include text length in bounding box */
 #define INCLUDE_TEXT 1
 #define EXCLUDE_TEXT 0
+	void (*reset)();	/* restore the defaults for the next figure
+				   of a batch (NULL if the driver can't) */
 };
 
 extern float	rgb2luminance();
@@ -158,6 +161,7 @@ extern char	gscom[];	/* to build up a command for ghostscript */
 extern Boolean	psencode_header_done; /* if we have already emitted PSencode header */
 extern Boolean	transp_header_done;   /* if we have already emitted transparent image header */
 extern Boolean	grayonly;	/* convert colors to grayscale (-N option) */
+extern double	curve_res;	/* output resolution (dpi) for flattening X-splines */
 
 struct paperdef
 {
@@ -50,13 +50,14 @@ index (s, c)
 /*
  * get option letter from argument vector
  */
-int	opterr = 1,		/* useless, never set or used */
+int	opterr = 1,		/* print messages for bad options */
 	optind = 1,		/* index into parent argv vector */
-	optopt;			/* character checked for validity */
+	optopt,			/* character checked for validity */
+	optreset = 0;		/* set (with optind = 1) to scan a new vector */
 char	*optarg;		/* argument associated with option */
 
-#define tell(s)	fputs(*nargv,stderr);fputs(s,stderr); \
-		fputc(optopt,stderr);fputc('\n',stderr);return(BADCH);
+#define tell(s)	if (opterr) { fputs(*nargv,stderr);fputs(s,stderr); \
+		fputc(optopt,stderr);fputc('\n',stderr); } return(BADCH);
 
 int
 fig_getopt(nargc,nargv,ostr)
@@ -68,6 +69,10 @@ fig_getopt(nargc,nargv,ostr)
 	register char	*oli;		/* option letter list index */
 	char	*index();
 
+	if (optreset) {			/* start over on a new vector */
+		optreset = 0;
+		place = EMSG;
+	}
 	if(!*place) {			/* update scanning pointer */
 		if(optind >= nargc || *(place = nargv[optind]) != '-' || !*++place) return(EOF);
 		if (*place == '-') {	/* found "--" */
@@ -124,6 +124,8 @@ typedef		struct f_line {
 			struct f_arrow		*back_arrow;
 			int			cap_style;
 			struct f_point		*points;
+			struct f_pos		*pts;	/* the same points packed */
+			int			npts;	/* into an array (pack_points()) */
 /* IMPORTANT: everything above this point must be in the same order 
 	      for ARC, LINE and SPLINE (LINE has join_style following cap_style */
  			int			join_style;
@@ -264,6 +266,8 @@ typedef		struct f_spline {
 			struct f_arrow		*back_arrow;
 			int			cap_style;
 			struct f_point		*points;
+			struct f_pos		*pts;	/* the same points packed */
+			int			npts;	/* into an array (pack_points()) */
 /* IMPORTANT: everything above this point must be in the same order 
 	      for ARC, LINE and SPLINE (LINE has join_style following cap_style */
 
@@ -18,6 +18,11 @@
 #include <ctype.h>
 #include <errno.h>
 #include <sys/param.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef HAVE_NO_MMAP
+#include <sys/mman.h>
+#endif
 #include "alloc.h"
 #include "fig2dev.h"
 #include "object.h"
@@ -57,6 +62,14 @@ static void		 note_pattern();
 static void		 skip_line();
 static int		 backslash_count();
 static int		 save_comment();
+static int		 map_input();
+static void		 unmap_input();
+static char		*in_gets();
+static int		 scan_int();
+static int		 scan_double();
+static int		 scan_point();
+static int		 scan_controls();
+static int		 scan_fields(char *fmt, ...);
 
 #define			FILL_CONVERT(f) \
 				((v2_flag || (f) < WHITE_FILL) \
@@ -83,6 +96,19 @@ char		*comments[MAXCOMMENTS];	/* comments saved for current object */
 int		 numcom;		/* current comment index */
 Boolean		 com_alloc = False;	/* whether or not the comment array has been init. */
 
+/* The whole Fig file (version 1.4 and newer) is mapped into memory, or read
+   into one buffer if it is a pipe, and parsed from there. */
+static char	*in_base = NULL;	/* start of the input */
+static char	*in_ptr;		/* current read position */
+static char	*in_end;		/* one past the last input character */
+static size_t	 in_maplen = 0;		/* length of the mapping, 0 if malloc'ed */
+
+/* exact powers of ten for the fast path of scan_double() */
+static double	 pow10tab[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
 void
 read_fail_message(file, err)
 char	*file;
@@ -166,17 +192,20 @@ F_compound	*obj;
 	bzero((char*)obj, COMOBJ_SIZE);
 	/* put the character back */
 	ungetc(c, fp);
-	if (c == '#')
-	    status = read_objects(fp, obj);
-	else
+	if (c == '#') {
+	    if ((status = map_input(fp)) == 0) {
+		status = read_objects(obj);
+		unmap_input();
+	    }
+	} else {
 	    status = read_1_3_objects(fp, obj);
+	}
 	(void)fclose(fp);
 	return status;
 }
 	
 int
-read_objects(fp, obj)
-FILE		*fp;
+read_objects(obj)
 F_compound	*obj;
 {
 	F_ellipse	*e, *le = NULL;
@@ -188,7 +217,7 @@ F_compound	*obj;
 	int		object, coord_sys, len;
 
 	bzero((char*)obj, COMOBJ_SIZE);
-	(void) fgets(buf, BUF_SIZE, fp);	/* get the version line */
+	(void) in_gets(buf, BUF_SIZE);		/* get the version line */
 	len = strlen(buf);
 	if (len > 0)
 	    buf[len-1] = '\0';			/* remove newline */
@@ -213,7 +242,7 @@ F_compound	*obj;
 	if (v30_flag) {
 	    /* read the orientation spec (landscape/portrait) */
 	    line_no=1;
-	    if (get_line(fp) < 0) {
+	    if (get_line() < 0) {
 		put_msg("File is truncated at landscape/portrait specification.");
 		return -1;
 	    }
@@ -223,7 +252,7 @@ F_compound	*obj;
 		landscape = !strncasecmp(buf,"land",4);
 
 	    /* now read the metric/inches spec OR centering spec */
-	    if (get_line(fp) < 0) {
+	    if (get_line() < 0) {
 		put_msg("File is truncated at metric/inches or centering specification.");
 		return -1;
 	    }
@@ -234,7 +263,7 @@ F_compound	*obj;
 		if (!centerspec)
 		    center = strncasecmp(buf,"flush",5);
 		/* now read metric/inches spec */
-		if (get_line(fp) < 0) {
+		if (get_line() < 0) {
 		    put_msg("File is truncated at metric/inches specification.");
 		    return -1;
 		}
@@ -251,7 +280,7 @@ F_compound	*obj;
 	    if (v32_flag) {
 		char *p;
 		/* read the paper size */
-		if (get_line(fp) < 0) {
+		if (get_line() < 0) {
 		    put_msg("File is truncated at paper size specification.");
 		    return -1;
 		}
@@ -263,7 +292,7 @@ F_compound	*obj;
 		}
 
 		/* read the magnification */
-		if (get_line(fp) < 0) {
+		if (get_line() < 0) {
 		    put_msg("File is truncated at magnification specification.");
 		    return -1;
 		}
@@ -273,7 +302,7 @@ F_compound	*obj;
 		    fontmag = mag = atof(buf)/100.0;
 
 		/* read the multiple page flag */
-		if (get_line(fp) < 0) {
+		if (get_line() < 0) {
 		    put_msg("File is truncated at multiple page specification.");
 		    return -1;
 		}
@@ -281,7 +310,7 @@ F_compound	*obj;
 		    multi_page = (strncasecmp(buf,"multiple",8) == 0);
 
 		/* Read the GIF transparent color. */
-		if (get_line(fp) < 0) {
+		if (get_line() < 0) {
 		    put_msg("File is truncated at transparent color specification.");
 		    return -1;
 		}
@@ -309,11 +338,11 @@ F_compound	*obj;
 	}
 
 	/* now read for resolution and coord_sys (coord_sys is not used) */
-	if (get_line(fp) < 0) {
+	if (get_line() < 0) {
 	    put_msg("File is truncated at resolution specification.");
 	    return -1;
 	    }
-	if (sscanf(buf,"%lf%d\n", &ppi, &coord_sys) != 2) {
+	if (scan_fields("fd", &ppi, &coord_sys) != 2) {
 	    put_msg("Incomplete resolution information at line %d", line_no);
 	    return -1;
 	    }
@@ -323,14 +352,14 @@ F_compound	*obj;
 	/* attach any comments found thus far to the whole figure */
 	obj->comments = attach_comments();
 
-	while (get_line(fp) > 0) {
-	    if (sscanf(buf, "%d", &object) != 1) {
+	while (get_line() > 0) {
+	    if (scan_fields("d", &object) != 1) {
 		put_msg("Incorrect format at line %d", line_no);
 		return -1;
 		}
 	    switch (object) {
 		case O_COLOR_DEF:
-		    read_colordef(fp);
+		    read_colordef();
 		    if (num_object) {
 			put_msg("Color definitions must come before other objects (line %d).",
 				line_no);
@@ -339,7 +368,7 @@ F_compound	*obj;
 		    num_usr_cols++;
 		    break;
 		case O_POLYLINE :
-		    if ((l = read_lineobject(fp)) == NULL) 
+		    if ((l = read_lineobject()) == NULL) 
 			return -1;
 #ifdef V4_0
 		    if ((l->pic != NULL) && (l->pic->figure != NULL)) {
@@ -366,17 +395,9 @@ F_compound	*obj;
 		    break;
 #endif /* V4_0 */
 		case O_SPLINE :
-		    if ((s = read_splineobject(fp)) == NULL) { 
+		    if ((s = read_splineobject()) == NULL) { 
 			return -1;
 			}
-		    if (v32_flag){ /* s is a line */
-		      if (ll)
-			ll = (ll->next = (F_line *) s);
-		      else 
-			ll = obj->lines = (F_line *) s;
-		      num_object++;
-		      break;		      
-		    }
 		    if (ls)
 			ls = (ls->next = s);
 		    else 
@@ -393,7 +414,7 @@ F_compound	*obj;
 		    num_object++;
 		    break;
 		case O_ARC :
-		    if ((a = read_arcobject(fp)) == NULL) 
+		    if ((a = read_arcobject()) == NULL) 
 			return -1;
 		    if (la)
 			la = (la->next = a);
@@ -402,7 +423,7 @@ F_compound	*obj;
 		    num_object++;
 		    break;
 		case O_TEXT :
-		    if ((t = read_textobject(fp)) == NULL) 
+		    if ((t = read_textobject()) == NULL) 
 			return -1;
 		    if (lt)
 			lt = (lt->next = t);
@@ -411,7 +432,7 @@ F_compound	*obj;
 		    num_object++;
 		    break;
 		case O_COMPOUND :
-		    if ((c = read_compoundobject(fp)) == NULL) 
+		    if ((c = read_compoundobject()) == NULL) 
 			return -1;
 		    if (lc)
 			lc = (lc->next = c);
@@ -423,7 +444,7 @@ F_compound	*obj;
 		    put_msg("Incorrect object code at line %d", line_no);
 		    return -1;
 		} /*  switch */
-	} /*  while (get_line(fp)) */
+	} /*  while (get_line()) */
 
 	/* if user color was requested for GIF transparent color, get the
 	   rgb values from the user color array now that we've read them in */
@@ -433,11 +454,11 @@ F_compound	*obj;
 		if (user_col_indx[i] == gif_colnum)
 		    break;
 	    if (i < num_usr_cols)
-		sprintf(gif_transparent,"#%2x%2x%2x", 
+		sprintf(gif_transparent,"#%02x%02x%02x", 
 				user_colors[i].r,user_colors[i].g,user_colors[i].b);
 	}
 
-	if (feof(fp))
+	if (in_ptr >= in_end)
 	    return 0;
 	else
 	    return errno;
@@ -445,8 +466,7 @@ F_compound	*obj;
 } /*  read_objects */
 
 static void
-read_colordef(fp)
-    FILE	   *fp;
+read_colordef()
 { 
     int		    c,r,g,b;
 
@@ -481,8 +501,7 @@ fix_color(color)
 }
 
 static F_arc *
-read_arcobject(fp)
-FILE	*fp;
+read_arcobject()
 {
 	F_arc	*a;
 	int	n, fa, ba;
@@ -499,7 +518,7 @@ FILE	*fp;
 	a->back_arrow = NULL;
 	a->next = NULL;
 	if (v30_flag) {
-	    n = sscanf(buf, "%*d%d%d%d%d%d%d%d%d%lf%d%d%d%d%lf%lf%d%d%d%d%d%d\n",
+	    n = scan_fields("*ddddddddfddddffdddddd",
 		&a->type, &a->style, &a->thickness, 
 		&a->pen_color, &a->fill_color, &a->depth, &a->pen, &a->fill_style, 
 		&a->style_val, &a->cap_style,
@@ -509,7 +528,7 @@ FILE	*fp;
 		&a->point[1].x, &a->point[1].y, 
 		&a->point[2].x, &a->point[2].y);
 	} else {
-	    n = sscanf(buf, "%*d%d%d%d%d%d%d%d%lf%d%d%d%lf%lf%d%d%d%d%d%d\n",
+	    n = scan_fields("*dddddddfdddffdddddd",
 		&a->type, &a->style, &a->thickness, 
 		&a->pen_color, &a->depth, &a->pen, &a->fill_style, 
 		&a->style_val, &a->direction, &fa, &ba,
@@ -522,7 +541,6 @@ FILE	*fp;
 	}
 	if ((v30_flag && n != 21) || (!v30_flag && n != 19)) {
 	    put_msg(Err_incomp, "arc", line_no);
-	    free((char*)a);
 	    return NULL;
 	}
 	a->thickness *= round(THICK_SCALE);
@@ -532,16 +550,16 @@ FILE	*fp;
 	fix_color(&a->pen_color);
 	fix_color(&a->fill_color);
 	if (fa) {
-	    if (get_line(fp) < 0 || 
-	        sscanf(buf, "%d%d%lf%lf%lf", &type, &style, &thickness, &wid, &ht) != 5) {
+	    if (get_line() < 0 || 
+	        scan_fields("ddfff", &type, &style, &thickness, &wid, &ht) != 5) {
 		    put_msg(Err_incomp, "arc", line_no);
 		    return NULL;
 	    }
 	    a->for_arrow = make_arrow(type, style, thickness, wid, ht);
 	}
 	if (ba) {
-	    if (get_line(fp) < 0 || 
-	        sscanf(buf, "%d%d%lf%lf%lf", &type, &style, &thickness, &wid, &ht) != 5) {
+	    if (get_line() < 0 || 
+	        scan_fields("ddfff", &type, &style, &thickness, &wid, &ht) != 5) {
 		    put_msg(Err_incomp, "arc", line_no);
 		    return NULL;
 	    }
@@ -552,8 +570,7 @@ FILE	*fp;
 	}
 
 static F_compound *
-read_compoundobject(fp)
-FILE	*fp;
+read_compoundobject()
 {
 	F_arc		*a, *la = NULL;
 	F_ellipse	*e, *le = NULL;
@@ -573,22 +590,21 @@ FILE	*fp;
 	com->next = NULL;
 	com->comments = attach_comments();	/* attach any comments */
 
-	n = sscanf(buf, "%*d%d%d%d%d\n", &com->nwcorner.x, &com->nwcorner.y,
+	n = scan_fields("*dddd", &com->nwcorner.x, &com->nwcorner.y,
 		&com->secorner.x, &com->secorner.y);
 	if (n != 4) {
 	    put_msg(Err_incomp, "compound", line_no);
-	    free((char*)com);
 	    return NULL;
 	    }
-	while (get_line(fp) > 0) {
-	    if (sscanf(buf, "%d", &object) != 1) {
+	while (get_line() > 0) {
+	    if (scan_fields("d", &object) != 1) {
 		put_msg(Err_incomp, "compound", line_no);
 		free_compound(&com);
 		return NULL;
 		}
 	    switch (object) {
 		case O_POLYLINE :
-		    if ((l = read_lineobject(fp)) == NULL) { 
+		    if ((l = read_lineobject()) == NULL) { 
 			free_line(&l);
 			return NULL;
 			}
@@ -610,17 +626,10 @@ FILE	*fp;
 #endif /* V4_0 */
 		    break;
 		case O_SPLINE :
-		    if ((s = read_splineobject(fp)) == NULL) { 
+		    if ((s = read_splineobject()) == NULL) { 
 			free_spline(&s);
 			return NULL;
 			}
-		    if (v32_flag){ /* s is a line */
-		      if (ll)
-			ll = (ll->next = (F_line *) s);
-		      else 
-			ll = com->lines = (F_line *) s;
-		      break;		      
-		    }
 		    if (ls)
 			ls = (ls->next = s);
 		    else 
@@ -637,7 +646,7 @@ FILE	*fp;
 			le = com->ellipses = e;
 		    break;
 		case O_ARC :
-		    if ((a = read_arcobject(fp)) == NULL) { 
+		    if ((a = read_arcobject()) == NULL) { 
 			free_arc(&a);
 			return NULL;
 			}
@@ -647,7 +656,7 @@ FILE	*fp;
 			la = com->arcs = a;
 		    break;
 		case O_TEXT :
-		    if ((t = read_textobject(fp)) == NULL) { 
+		    if ((t = read_textobject()) == NULL) { 
 			free_text(&t);
 			return NULL;
 			}
@@ -657,7 +666,7 @@ FILE	*fp;
 			lt = com->texts = t;
 		    break;
 		case O_COMPOUND :
-		    if ((c = read_compoundobject(fp)) == NULL) { 
+		    if ((c = read_compoundobject()) == NULL) { 
 			free_compound(&c);
 			return NULL;
 			}
@@ -673,7 +682,7 @@ FILE	*fp;
 		    return NULL;
 		} /*  switch */
 	    }
-	if (feof(fp))
+	if (in_ptr >= in_end)
 	    return com;
 	else
 	    return NULL;
@@ -690,7 +699,7 @@ read_ellipseobject()
 	e->pen = 0;
 	e->next = NULL;
 	if (v30_flag) {
-	    n = sscanf(buf, "%*d%d%d%d%d%d%d%d%d%lf%d%lf%d%d%d%d%d%d%d%d\n",
+	    n = scan_fields("*ddddddddfdfdddddddd",
 		&e->type, &e->style, &e->thickness,
 		&e->pen_color, &e->fill_color, &e->depth, &e->pen, &e->fill_style,
 		&e->style_val, &e->direction, &e->angle,
@@ -699,7 +708,7 @@ read_ellipseobject()
 		&e->start.x, &e->start.y, 
 		&e->end.x, &e->end.y);
 	} else {
-	    n = sscanf(buf, "%*d%d%d%d%d%d%d%d%lf%d%lf%d%d%d%d%d%d%d%d\n",
+	    n = scan_fields("*dddddddfdfdddddddd",
 		&e->type, &e->style, &e->thickness,
 		&e->pen_color, &e->depth, &e->pen, &e->fill_style,
 		&e->style_val, &e->direction, &e->angle,
@@ -711,7 +720,6 @@ read_ellipseobject()
 	}
 	if ((v30_flag && n != 19) || (!v30_flag && n != 18)) {
 	    put_msg(Err_incomp, "ellipse", line_no);
-	    free((char*)e);
 	    return NULL;
 	    }
 	fix_color(&e->pen_color);
@@ -725,8 +733,7 @@ read_ellipseobject()
 }
 
 static F_line *
-read_lineobject(fp)
-FILE	*fp;
+read_lineobject()
 {
 	F_line	*l;
 	F_point	*p, *q;
@@ -738,6 +745,8 @@ FILE	*fp;
 
 	Line_malloc(l);
 	l->points = NULL;
+	l->pts = NULL;
+	l->npts = 0;
 	l->pen = 0;
 	l->fill_style = 0;
 	l->for_arrow = NULL;
@@ -746,18 +755,18 @@ FILE	*fp;
 	l->join_style = 0;
 	l->cap_style = 0;        /* butt line cap */
 
-	sscanf(buf,"%*d%d",&l->type);	/* get the line type */
+	scan_fields("*d",&l->type);	/* get the line type */
 
 	radius_flag = v30_flag || v21_flag || (v2_flag && l->type == T_ARC_BOX);
 	if (radius_flag) {
 	    if (v30_flag) {
-		n = sscanf(buf, "%*d%d%d%d%d%d%d%d%d%lf%d%d%d%d%d%d",
+		n = scan_fields("*ddddddddfdddddd",
 		&l->type,&l->style,&l->thickness,&l->pen_color,&l->fill_color,
 		&l->depth,&l->pen,&l->fill_style,&l->style_val,
 		&l->join_style,&l->cap_style,
 		&l->radius,&fa,&ba,&npts);
 	    } else {
-		n = sscanf(buf, "%*d%d%d%d%d%d%d%d%lf%d%d%d",
+		n = scan_fields("*dddddddfddd",
 		&l->type,&l->style,&l->thickness,&l->pen_color,
 		&l->depth,&l->pen,&l->fill_style,&l->style_val,&l->radius,&fa, &ba);
 		l->fill_color = l->pen_color;
@@ -765,7 +774,7 @@ FILE	*fp;
 	}
 	/* old format uses pen for radius of arc-box corners */
 	else {
-	    n = sscanf(buf, "%*d%d%d%d%d%d%d%d%lf%d%d",
+	    n = scan_fields("*dddddddfdd",
 			&l->type,&l->style,&l->thickness,&l->pen_color,
 			&l->depth,&l->pen,&l->fill_style,&l->style_val,&fa,&ba);
 	    l->fill_color = l->pen_color;
@@ -780,7 +789,6 @@ FILE	*fp;
 	if ((!radius_flag && n!=10) ||
 	     (radius_flag && ((!v30_flag && n!=11)||(v30_flag && n!=15)))) {
 	    put_msg(Err_incomp, "line", line_no);
-	    free((char*)l);
 	    return NULL;
 	}
 	l->radius *= round(THICK_SCALE);
@@ -793,29 +801,28 @@ FILE	*fp;
 	fix_color(&l->pen_color);
 	fix_color(&l->fill_color);
 	if (fa) {
-	    if (get_line(fp) < 0 || 
-	        sscanf(buf, "%d%d%lf%lf%lf", &type, &style, &thickness, &wid, &ht) != 5) {
+	    if (get_line() < 0 || 
+	        scan_fields("ddfff", &type, &style, &thickness, &wid, &ht) != 5) {
 		    put_msg(Err_incomp, "line", line_no);
 		    return NULL;
 	    }
 	    l->for_arrow = make_arrow(type, style, thickness, wid, ht);
 	}
 	if (ba) {
-	    if (get_line(fp) < 0 || 
-	        sscanf(buf, "%d%d%lf%lf%lf", &type, &style, &thickness, &wid, &ht) != 5) {
+	    if (get_line() < 0 || 
+	        scan_fields("ddfff", &type, &style, &thickness, &wid, &ht) != 5) {
 		    put_msg(Err_incomp, "line", line_no);
 		    return NULL;
 	    }
 	    l->back_arrow = make_arrow(type, style, thickness, wid, ht);
 	}
     	if (l->type == T_PIC_BOX) {
-	    Pic_malloc(l->pic);
-	    l->pic->transp = -1;
-	    if (l->pic  == NULL) {
-		free((char *) l);
+	    if ((Pic_malloc(l->pic)) == NULL) {
+		put_msg(Err_mem);
 		return (NULL);
 	    }
-	    if (get_line(fp) < 0 || 
+	    l->pic->transp = -1;
+	    if (get_line() < 0 || 
 	      sscanf(buf, "%d %[^\n]", &l->pic->flipped, file) != 2) {
 	        put_msg(Err_incomp,
 		    "Picture object", line_no);
@@ -848,7 +855,7 @@ FILE	*fp;
 
 	/* read first point of line */
 	line_no++;
-	if (fscanf(fp, "%d%d", &p->x, &p->y) != 2) {
+	if (scan_point(&p->x, &p->y) != 2) {
 	  put_msg(Err_incomp, "line", line_no);
 	  free_linestorage(l);
 	  return(NULL);
@@ -857,8 +864,8 @@ FILE	*fp;
 	if (!v30_flag)
 	   npts = 1000000;
 	for (--npts; npts > 0; npts--) {
-	  count_lines_correctly(fp);
-	  if (fscanf(fp, "%d%d", &x, &y) != 2) {
+	  count_lines_correctly();
+	  if (scan_point(&x, &y) != 2) {
 	    put_msg(Err_incomp, "line", line_no);
 	    free_linestorage(l);
 	    return NULL;
@@ -876,19 +883,21 @@ FILE	*fp;
 	  p->next = q;
 	  p = q;
 	}
+	if (!pack_points(l)) {
+	    free_linestorage(l);
+	    return NULL;
+	}
 
 	l->comments = attach_comments();	/* attach any comments */
 	/* skip to the end of the line */
-	skip_line(fp);
+	skip_line();
 	return l;
 }
 
 static F_spline *
-read_splineobject(fp)
-FILE	*fp;
+read_splineobject()
 {
 	F_spline	*s;
-	F_line          *l;
 	F_point		*p, *q;
 	F_control	*cp, *cq;
 	int		c, n, x, y, fa, ba;
@@ -898,6 +907,8 @@ FILE	*fp;
 
 	Spline_malloc(s);
 	s->points = NULL;
+	s->pts = NULL;
+	s->npts = 0;
 	s->controls = NULL;
 	s->pen = 0;
 	s->fill_style = 0;
@@ -906,13 +917,13 @@ FILE	*fp;
 	s->next = NULL;
 
 	if (v30_flag) {
-	    n = sscanf(buf, "%*d%d%d%d%d%d%d%d%d%lf%d%d%d%d",
+	    n = scan_fields("*ddddddddfdddd",
 	    	&s->type, &s->style, &s->thickness,
 		&s->pen_color, &s->fill_color,
 		&s->depth, &s->pen, &s->fill_style, &s->style_val,
 		&s->cap_style, &fa, &ba, &npts);
 	} else {
-	    n = sscanf(buf, "%*d%d%d%d%d%d%d%d%lf%d%d",
+	    n = scan_fields("*dddddddfdd",
 	    	&s->type, &s->style, &s->thickness, &s->pen_color,
 		&s->depth, &s->pen, &s->fill_style, &s->style_val, &fa, &ba);
 	    s->fill_color = s->pen_color;
@@ -920,7 +931,6 @@ FILE	*fp;
 	}
 	if ((v30_flag && n != 13) || (!v30_flag && n != 10)) {
 	    put_msg(Err_incomp, "spline", line_no);
-	    free((char*)s);
 	    return NULL;
 	    }
 	s->thickness *= round(THICK_SCALE);
@@ -930,16 +940,16 @@ FILE	*fp;
 	fix_color(&s->pen_color);
 	fix_color(&s->fill_color);
 	if (fa) {
-	    if (get_line(fp) < 0 || 
-	        sscanf(buf, "%d%d%lf%lf%lf", &type, &style, &thickness, &wid, &ht) != 5) {
+	    if (get_line() < 0 || 
+	        scan_fields("ddfff", &type, &style, &thickness, &wid, &ht) != 5) {
 		    put_msg(Err_incomp, "spline", line_no);
 		    return NULL;
 	    }
 	    s->for_arrow = make_arrow(type, style, thickness, wid, ht);
 	}
 	if (ba) {
-	    if (get_line(fp) < 0 || 
-	        sscanf(buf, "%d%d%lf%lf%lf", &type, &style, &thickness, &wid, &ht) != 5) {
+	    if (get_line() < 0 || 
+	        scan_fields("ddfff", &type, &style, &thickness, &wid, &ht) != 5) {
 		    put_msg(Err_incomp, "spline", line_no);
 		    return NULL;
 	    }
@@ -949,7 +959,7 @@ FILE	*fp;
 	/* Read points */
 	/* read first point of line */
 	line_no++;
-	if ((n = fscanf(fp, "%d%d", &x, &y)) != 2) {
+	if ((n = scan_point(&x, &y)) != 2) {
 	    put_msg(Err_incomp, "spline", line_no);
 	    free_splinestorage(s);
 	    return NULL;
@@ -965,8 +975,8 @@ FILE	*fp;
 		npts = 1000000;
 	for (--npts; npts > 0; npts--) {
 	    /* keep track of newlines for line counter */
-	    count_lines_correctly(fp);
-	    if (fscanf(fp, "%d%d", &x, &y) != 2) {
+	    count_lines_correctly();
+	    if (scan_point(&x, &y) != 2) {
 		put_msg(Err_incomp, "spline", line_no);
 		p->next = NULL;
 		free_splinestorage(s);
@@ -986,10 +996,16 @@ FILE	*fp;
 	    c++;
 	    }
 	p->next = NULL;
+	if (!pack_points((F_line *) s)) {
+	    free_splinestorage(s);
+	    return NULL;
+	    }
 	s->comments = attach_comments();	/* attach any comments */
 
 	if (v32_flag) {
-	    /* transform x-splines into lines */
+	    /* X-spline; it stays a curve through bounding and depth
+	       sorting and is flattened for the resolution of the output
+	       in gendev_objects() */
 
 	    F_control * ptr;
 	    double control_s;
@@ -998,8 +1014,8 @@ FILE	*fp;
 	    ptr = s->controls;
 	    while (ptr) {    /* read controls */
 		/* keep track of newlines for line counter */
-		count_lines_correctly(fp);
-		if ((n = fscanf(fp, "%lf", &control_s)) != 1) {
+		count_lines_correctly();
+		if ((n = scan_double(&control_s)) != 1) {
 		  put_msg(Err_incomp, "spline", line_no);
 		  free_splinestorage(s);
 		  return NULL;
@@ -1007,24 +1023,22 @@ FILE	*fp;
 		ptr->s = control_s;
 		ptr = ptr->next;
 	      }
+	    /* all 3.2 splines are X-splines, whatever the type says */
+	    s->type = closed_spline(s) ? T_CLOSED_XSPLINE : T_OPEN_XSPLINE;
 
-	    l = create_line_with_spline(s);
-	    free_splinestorage(s);  
 	    /* skip to end of line */
-	    skip_line(fp);
-	    if (l == NULL)
-		return NULL;
-	    return (F_spline *)l;   /* return the new line */
+	    skip_line();
+	    return s;
 	  }
 
 	if (approx_spline(s)) {
-	    skip_line(fp);
+	    skip_line();
 	    return s;
 	}
 	/* Read controls from older versions */
 	/* keep track of newlines for line counter */
-	count_lines_correctly(fp);
-	if ((n = fscanf(fp, "%lf%lf%lf%lf", &lx, &ly, &rx, &ry)) != 4) {
+	count_lines_correctly();
+	if ((n = scan_controls(&lx, &ly, &rx, &ry)) != 4) {
 	    put_msg(Err_incomp, "spline", line_no);
 	    free_splinestorage(s);
 	    return NULL;
@@ -1038,8 +1052,8 @@ FILE	*fp;
 	cp->rx = rx; cp->ry = ry;
 	while (--c) {
 	    /* keep track of newlines for line counter */
-	    count_lines_correctly(fp);
-	    if (fscanf(fp, "%lf%lf%lf%lf", &lx, &ly, &rx, &ry) != 4) {
+	    count_lines_correctly();
+	    if (scan_controls(&lx, &ly, &rx, &ry) != 4) {
 		put_msg(Err_incomp, "spline", line_no);
 		cp->next = NULL;
 		free_splinestorage(s);
@@ -1059,13 +1073,12 @@ FILE	*fp;
 	cp->next = NULL;
 
 	/* skip to the end of the line */
-	skip_line(fp);
+	skip_line();
 	return s;
 }
 
 static F_text *
-read_textobject(fp)
-FILE	*fp;
+read_textobject()
 {
 	F_text	*t;
 	int	n, ignore = 0;
@@ -1100,7 +1113,6 @@ FILE	*fp;
 	}
 	if ((n != 14) && (n != 13)) {
 	  put_msg(Err_incomp, "text", line_no);
-	  free((char*)t);
  	  return NULL;
 	}
 
@@ -1131,7 +1143,7 @@ FILE	*fp;
 	  /* Read in the subsequent lines of the text if there are more */
 	  do {
 	    line_no++;				/* As is done in get_line */
-	    if (fgets(s_temp, BUF_SIZE, fp) == NULL)
+	    if (in_gets(s_temp, BUF_SIZE) == NULL)
 		break;
 	    len = strlen(s_temp)-1;		/* ignore newline */
 	    if (s_temp[len-1] == '\r') {	/* strip any trailing CR */
@@ -1187,10 +1199,9 @@ FILE	*fp;
 	}
 	if (strlen(s) == 0) 
 		(void)strcpy(s, " ");
-	t->cstring = (char*)calloc((unsigned)(strlen(s)), sizeof(char));
+	t->cstring = fig_alloc(strlen(s));
 	if (NULL == t->cstring) {
 	    put_msg(Err_mem);
-	    free((char*)t);
 	    return NULL;
 	}
 	(void)strcpy(t->cstring, s+1);
@@ -1277,6 +1288,35 @@ backslash_count(cp, start)
   return count;
 }
 
+/*
+ * Copy the points of a line (or spline, which starts the same way) into
+ * one array, for the drivers that walk them in a tight loop.  Whoever
+ * changes the F_point list afterwards has to call this again.
+ */
+
+int
+pack_points(l)
+    F_line	*l;
+{
+    F_point	*p;
+    F_pos	*a;
+    int		 n;
+
+    for (n = 0, p = l->points; p != NULL; p = p->next)
+	n++;
+    if ((a = (F_pos *) fig_alloc(n * sizeof(F_pos))) == NULL) {
+	put_msg(Err_mem);
+	return 0;
+    }
+    l->pts = a;
+    l->npts = n;
+    for (p = l->points; p != NULL; p = p->next, a++) {
+	a->x = p->x;
+	a->y = p->y;
+    }
+    return 1;
+}
+
 /* attach comments in linked list */ 
 
 static F_comment *
@@ -1288,15 +1328,25 @@ attach_comments()
     if (numcom == 0)
 	return NULL;
 
-    icomp = comp = (F_comment *) malloc(COMMENT_SIZE);
+    if (NULL == (icomp = Comment_malloc(comp))) {
+	put_msg(Err_mem);
+	numcom = 0;
+	return NULL;
+    }
     for (i=0; i<numcom; i++) {
-	comp->comment = malloc(strlen(comments[i])+1);
-	strcpy(comp->comment, comments[i]);
+	comp->next = NULL;
+	if (NULL == (comp->comment = fig_strdup(comments[i]))) {
+	    put_msg(Err_mem);
+	    comp->comment = "";
+	    break;
+	}
 	if (i<numcom-1) {
-	    comp->next = (F_comment *) malloc(COMMENT_SIZE);
+	    if (NULL == (Comment_malloc(comp->next))) {
+		put_msg(Err_mem);
+		break;
+	    }
 	    comp = comp->next;
-	} else
-	    comp->next = NULL;
+	}
     }
     /* reset comment number */
     numcom = 0;
@@ -1304,17 +1354,16 @@ attach_comments()
 }
 
 static int
-get_line(fp)
-    FILE	   *fp;
+get_line()
 {
     int		    len;
     while (1) {
-	if (NULL == fgets(buf, BUF_SIZE, fp)) {
+	if (NULL == in_gets(buf, BUF_SIZE)) {
 	    return (-1);
 	}
 	line_no++;
 	if (*buf == '#') {			/* save any comments */
-	    if (save_comment(fp) < 0)
+	    if (save_comment() < 0)
 		return -1;
 	} else if (*buf != '\n') {		/* Skip empty lines */
 	    len = strlen(buf);
@@ -1329,8 +1378,7 @@ get_line(fp)
 /* save a comment line to be stored with the *subsequent* object */
 
 static int
-save_comment(fp)
-    FILE	   *fp;
+save_comment()
 {
     int		    i;
 
@@ -1354,13 +1402,14 @@ save_comment(fp)
 /* skip to the end of the current line and any subsequent blank lines */
 
 static void
-skip_line(fp)
-    FILE	   *fp;
+skip_line()
 {
-    while (fgetc(fp) != '\n') {
-	if (feof(fp))
-	    return;
-    }
+    char	   *nl;
+
+    if ((nl = memchr(in_ptr, '\n', in_end - in_ptr)))
+	in_ptr = nl+1;
+    else
+	in_ptr = in_end;
 }
 
 /* keep track which patterns are used (if any) */
@@ -1520,17 +1569,302 @@ print_comments(string1, comment, string2)
  */
 
 static void
-count_lines_correctly(fp)
-    FILE *fp;
+count_lines_correctly()
 {
-    int cc;
-    do{
-	cc=getc(fp);
-	if (cc=='\n') {
+    while (in_ptr < in_end) {
+	if (*in_ptr == '\n') {
 	   line_no++;
-	   cc=getc(fp);
+	   if (++in_ptr >= in_end)
+		break;
+	}
+	if (*in_ptr != ' ' && *in_ptr != '\t')
+	    break;
+	in_ptr++;
+    }
+}
+
+/* Map the rest of the Fig file at fp into memory.  If fp is not a regular
+ * file (e.g. stdin from a pipe) or can't be mapped, read it into one
+ * malloc'ed buffer instead.  Returns 0 or an errno value.
+ */
+
+static int
+map_input(fp)
+    FILE	   *fp;
+{
+    struct stat	    st;
+    long	    off;
+    size_t	    size, len, n;
+    char	   *p;
+
+    in_maplen = 0;
+    size = 0;
+    if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode))
+	size = st.st_size;
+    /* the stdio position, not the descriptor's, since we have already read from fp */
+    off = ftell(fp);
+#ifndef HAVE_NO_MMAP
+    if (size > 0 && off >= 0 && off < size) {
+	p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+	if (p != (char *) MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+	    (void) madvise(p, size, MADV_SEQUENTIAL);
+#endif
+	    in_base = p;
+	    in_ptr = p + off;
+	    in_end = p + size;
+	    in_maplen = size;
+	    return 0;
 	}
-    } while (cc==' '||cc=='\t');
-    ungetc(cc,fp);
+    }
+#endif /* HAVE_NO_MMAP */
+
+    /* allocate for the whole file if we know its size, and grow for pipes */
+    size = (size > 0 && off >= 0 && off < size)? size - off + 1: 65536;
+    if ((in_base = malloc(size)) == NULL) {
+	put_msg(Err_mem);
+	return ENOMEM;
+    }
+    len = 0;
+    while ((n = fread(in_base+len, 1, size-len, fp)) > 0) {
+	len += n;
+	if (len == size) {
+	    size *= 2;
+	    if ((p = realloc(in_base, size)) == NULL) {
+		free(in_base);
+		in_base = NULL;
+		put_msg(Err_mem);
+		return ENOMEM;
+	    }
+	    in_base = p;
+	}
+    }
+    if (ferror(fp)) {
+	free(in_base);
+	in_base = NULL;
+	return errno;
+    }
+    in_ptr = in_base;
+    in_end = in_base + len;
+    return 0;
+}
+
+static void
+unmap_input()
+{
+    if (in_base == NULL)
+	return;
+#ifndef HAVE_NO_MMAP
+    if (in_maplen)
+	(void) munmap(in_base, in_maplen);
+    else
+#endif
+	free(in_base);
+    in_base = NULL;
+    in_maplen = 0;
+}
+
+/* like fgets() but from the mapped input */
+
+static char *
+in_gets(s, size)
+    char	   *s;
+    int		    size;
+{
+    char	   *lim, *nl;
+    int		    n;
+
+    if (in_ptr >= in_end)
+	return NULL;
+    lim = (in_end - in_ptr < size-1)? in_end: in_ptr + size-1;
+    if ((nl = memchr(in_ptr, '\n', lim - in_ptr)))
+	lim = nl+1;
+    n = lim - in_ptr;
+    memcpy(s, in_ptr, n);
+    s[n] = '\0';
+    in_ptr = lim;
+    return s;
+}
+
+/* Convert an integer at *pp (no further than end) like scanf("%d") does,
+ * advancing *pp past it.  Returns 1 if a number was found, 0 otherwise.
+ */
+
+static int
+scan_num_int(pp, end, val)
+    char	  **pp, *end;
+    int		   *val;
+{
+    char	   *p = *pp;
+    int		    neg = 0;
+    long	    n = 0;
+
+    while (p < end && isspace((unsigned char) *p))
+	p++;
+    if (p < end && (*p == '-' || *p == '+'))
+	neg = (*p++ == '-');
+    if (p >= end || !isdigit((unsigned char) *p)) {
+	*pp = p;
+	return 0;
+    }
+    while (p < end && isdigit((unsigned char) *p)) {
+	if (n <= 214748363L)		/* don't overflow */
+	    n = n*10 + (*p - '0');
+	p++;
+    }
+    *val = neg? -n: n;
+    *pp = p;
+    return 1;
+}
+
+/* Convert a floating point number at *pp like scanf("%lf") does.
+ * Up to 15 significant digits and a decimal exponent of at most 22 are
+ * converted exactly with one multiplication or division; anything else
+ * is handed to strtod().
+ */
+
+static int
+scan_num_double(pp, end, val)
+    char	  **pp, *end;
+    double	   *val;
+{
+    char	   *p = *pp, *start, *q, tok[64];
+    int		    neg = 0, ndigits = 0, nsig = 0, exp10 = 0, e, eneg, slow = 0;
+    double	    m = 0.0;
+
+    while (p < end && isspace((unsigned char) *p))
+	p++;
+    start = p;
+    if (p < end && (*p == '-' || *p == '+'))
+	neg = (*p++ == '-');
+    for (; p < end && isdigit((unsigned char) *p); p++, ndigits++) {
+	if (m == 0.0 && *p == '0')
+	    continue;
+	if (++nsig > 15)
+	    slow = 1;
+	else
+	    m = m*10.0 + (*p - '0');
+    }
+    if (p < end && *p == '.') {
+	for (p++; p < end && isdigit((unsigned char) *p); p++, ndigits++) {
+	    if (m == 0.0 && *p == '0') {
+		exp10--;
+		continue;
+	    }
+	    if (++nsig > 15)
+		slow = 1;
+	    else
+		m = m*10.0 + (*p - '0');
+	    exp10--;
+	}
+    }
+    if (ndigits == 0 || (p < end && (*p == 'x' || *p == 'X')))
+	slow = 1;			/* hex, inf, nan or garbage */
+    else if (p < end && (*p == 'e' || *p == 'E')) {
+	q = p+1;
+	eneg = 0;
+	if (q < end && (*q == '-' || *q == '+'))
+	    eneg = (*q++ == '-');
+	if (q < end && isdigit((unsigned char) *q)) {
+	    for (e = 0; q < end && isdigit((unsigned char) *q); q++)
+		if (e < 10000)
+		    e = e*10 + (*q - '0');
+	    exp10 += eneg? -e: e;
+	    p = q;
+	}
+    }
+    if (!slow && exp10 >= -22 && exp10 <= 22) {
+	m = exp10 < 0? m / pow10tab[-exp10]: m * pow10tab[exp10];
+	*val = neg? -m: m;
+	*pp = p;
+	return 1;
+    }
+
+    /* slow path: let strtod() have a copy of the token */
+    for (q = start, e = 0; q < end && e < sizeof(tok)-1 &&
+			!isspace((unsigned char) *q) && *q != '\0'; )
+	tok[e++] = *q++;
+    tok[e] = '\0';
+    *val = strtod(tok, &q);
+    *pp = start + (q - tok);
+    return q != tok;
+}
+
+/* read an integer from the input */
+
+static int
+scan_int(val)
+    int		   *val;
+{
+    return scan_num_int(&in_ptr, in_end, val);
+}
+
+/* read a floating point number from the input */
+
+static int
+scan_double(val)
+    double	   *val;
+{
+    return scan_num_double(&in_ptr, in_end, val);
+}
+
+/* read the x and y of a point, in that order; like fscanf(fp, "%d%d", ...)
+ * returns the number of values read
+ */
+
+static int
+scan_point(x, y)
+    int		   *x, *y;
+{
+    if (!scan_int(x))
+	return 0;
+    return scan_int(y) ? 2 : 1;
+}
+
+/* read the four numbers of an old spline control point, in order */
+
+static int
+scan_controls(lx, ly, rx, ry)
+    double	   *lx, *ly, *rx, *ry;
+{
+    if (!scan_double(lx))
+	return 0;
+    if (!scan_double(ly))
+	return 1;
+    if (!scan_double(rx))
+	return 2;
+    return scan_double(ry) ? 4 : 3;
+}
+
+/* Convert the numbers in buf according to fmt, one character per field:
+ * 'd' for an int, 'f' for a double, and '*' for an int that is skipped.
+ * Like sscanf(), returns the number of fields assigned before the first
+ * one that could not be converted.
+ */
+
+static int
+scan_fields(char *fmt, ...)
+{
+    va_list	    ap;
+    char	   *p = buf, *end = buf + BUF_SIZE;
+    int		    n = 0, dummy;
+
+    va_start(ap, fmt);
+    for (; *fmt; fmt++) {
+	if (*fmt == '*') {
+	    if (!scan_num_int(&p, end, &dummy))
+		break;
+	} else if (*fmt == 'd') {
+	    if (!scan_num_int(&p, end, va_arg(ap, int *)))
+		break;
+	    n++;
+	} else {
+	    if (!scan_num_double(&p, end, va_arg(ap, double *)))
+		break;
+	    n++;
+	}
+    }
+    va_end(ap);
+    return n;
 }
 
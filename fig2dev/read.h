@@ -20,3 +20,4 @@ extern int	readfp_fig();
 extern void	read_fail_message();
 extern int	read_1_3_objects();
 extern void	print_comments();
+extern int	pack_points();
@@ -25,6 +25,7 @@
 #include "fig2dev.h"
 #include "object.h"
 #include "free.h"
+#include "read.h"
 
 /*******    Fig 1.3 subtype of objects    *******/
 #define			DRAW_ELLIPSE_BY_RAD 	1
@@ -166,7 +167,6 @@ FILE	*fp;
 	a->type = T_OPEN_ARC;
 	if (n != 17) {
 	    put_msg("incomplete arc data");
-	    free((char*)a);
 	    return(NULL);
 	    }
 	if (f) {
@@ -305,7 +305,6 @@ FILE	*fp;
 		&e->end.x, &e->end.y);
 	if (n != 13) {
 	    put_msg("incomplete ellipse data");
-	    free((char*)e);
 	    return(NULL);
 	    }
 	if (t == DRAW_ELLIPSE_BY_RAD)
@@ -336,12 +335,12 @@ FILE			*fp;
 	l->back_arrow = NULL;
 	l->next = NULL;
 	l->points = Point_malloc(p);
+	p->next = NULL;
 	n = fscanf(fp, " %d %d %d %lf %d %d %d %d %d %d", &t, 
 		&l->style, &l->thickness, &l->style_val,
 		&f, &b, &h, &w, &p->x, &p->y);
 	if (n != 10) {
 	    put_msg("incomplete line data");
-	    free((char*)l);
 	    return(NULL);
 	    }
 	if (t == DRAW_POLYLINE)
@@ -374,6 +373,10 @@ FILE			*fp;
 	    p->next = q;
 	    p = q;
 	    }
+	if (!pack_points(l)) {
+	    free_linestorage(l);
+	    return(NULL);
+	    }
 	return(l);
 	}
 
@@ -395,13 +398,13 @@ FILE	*fp;
 	s->controls = NULL;
 	s->next = NULL;
 	s->points = Point_malloc(p);
+	p->next = NULL;
 	n = fscanf(fp, " %d %d %d %lf %d %d %d %d %d %d", 
 	    	&t, &s->style, &s->thickness, &s->style_val,
 	    	&f, &b,
 	    	&h, &w, &p->x, &p->y);
 	if (n != 10) {
 	    put_msg("incomplete spline data");
-	    free((char*)s);
 	    return(NULL);
 	    }
 	if (t == DRAW_CLOSEDSPLINE)
@@ -432,6 +435,10 @@ FILE	*fp;
 	    p->next = q;
 	    p = q;
 	    }
+	if (!pack_points((F_line *) s)) {
+	    free_splinestorage(s);
+	    return(NULL);
+	    }
 	return(s);
 	}
 
@@ -456,13 +463,11 @@ FILE	*fp;
 		&t->base_x, &t->base_y, buf);
 	if (n != 8) {
 	    put_msg("incomplete text data");
-	    free((char*)t);
 	    return(NULL);
 	    }
-	t->cstring = (char *) calloc((unsigned)(strlen(buf)+1), sizeof(char));
+	t->cstring = fig_strdup(buf);
 	if (t->cstring == NULL) {
 	    put_msg(Err_mem);
-	    free((char*) t);
 	    return(NULL);
 	    }
 	(void)strcpy(t->cstring, buf);
@@ -0,0 +1,212 @@
+/*
+ * TransFig: Facility for Translating Fig code
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish and/or distribute copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that this copyright
+ * notice remain intact.
+ *
+ */
+
+/*
+ * shapebench: time the shape (shapepar) driver on generated outlines.
+ *
+ * Each figure is a smooth closed outline of n points ("+a") with a wavy
+ * hole of n points ("-a") that crosses it about 2*m times.  Both are
+ * sampled at the same angles around the same center, so the crossings are
+ * counted exactly from the sign changes of the difference of the radii.
+ * For every size the CPU time of "fig2dev -L shape" and the size of its
+ * output are printed, with the time divided by (n+k) log2 n, where k is
+ * the number of crossings, and by the bytes written.  With a sweep the
+ * first stays about constant as n grows.  More crossings also mean more
+ * pieces on every scanline and so more output, and then the time per byte
+ * is what stays constant.
+ *
+ *	shapebench [-f fig2dev] [-n points] [-m waves] [-s steps] [-k]
+ *
+ * The sizes start at -n points (1000) and double -s times (5).  With -k
+ * the outline stays at -n points and the waves of the hole double instead,
+ * starting at -m (8).  The hole needs at least 32 points per wave.  With
+ * many waves on a large outline the driver can give up on a figure ("Outside
+ * all polygons"), as it did before the sweep; such a row says "failed".
+ * "make shapebench" builds it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+static char	*fig2dev = "./fig2dev";
+
+/* radii of the outline and of the hole at angle t */
+
+static double
+outline_r(R, t, ph)
+    double	R, t, *ph;
+{
+    return R * (1 + .15*sin(2*t + ph[0]) + .08*sin(3*t + ph[1]));
+}
+
+static double
+hole_r(R, t, ph, m)
+    double	R, t, *ph;
+    int		m;
+{
+    return R * (.75 + .5*sin(m*t + ph[2]));
+}
+
+static void
+polygon(fp, comment, depth, R, n, ph, m, hole)
+    FILE	*fp;
+    char	*comment;
+    int		depth, n, m, hole;
+    double	R, *ph;
+{
+    double	t, r;
+    int		i;
+
+    fprintf(fp, "# %s\n2 3 0 1 0 7 %d -1 -1 0.000 0 0 -1 0 0 %d\n\t",
+	    comment, depth, n + 1);
+    for (i = 0; i <= n; i++) {
+	t = 2 * M_PI * (i % n) / n;
+	r = hole ? hole_r(R, t, ph, m) : outline_r(R, t, ph);
+	fprintf(fp, " %d %d", (int) (2*R + r*cos(t)), (int) (2*R + r*sin(t)));
+    }
+    fprintf(fp, "\n");
+}
+
+/* write the figure to file, return the number of crossings */
+
+static int
+make_figure(file, n, m)
+    char	*file;
+    int		n, m;
+{
+    FILE	*fp;
+    double	ph[3], R, t, d, dprev;
+    int		i, k;
+
+    R = n < 400 ? 4000.0 : 10.0 * n;
+    for (i = 0; i < 3; i++)
+	ph[i] = 6.3 * rand() / RAND_MAX;
+    if ((fp = fopen(file, "w")) == NULL) {
+	perror(file);
+	exit(2);
+    }
+    fprintf(fp, "#FIG 3.2\nLandscape\nCenter\nInches\nLetter\n100.00\n");
+    fprintf(fp, "Single\n-2\n1200 2\n");
+    polygon(fp, "+a", 60, R, n, ph, m, 0);
+    polygon(fp, "-a", 50, R, n, ph, m, 1);
+    fclose(fp);
+
+    for (i = k = 0, dprev = 0.0; i <= n; i++) {
+	t = 2 * M_PI * (i % n) / n;
+	d = outline_r(R, t, ph) - hole_r(R, t, ph, m);
+	if (i > 0 && (d < 0) != (dprev < 0))
+	    k++;
+	dprev = d;
+    }
+    return k;
+}
+
+/* CPU seconds of running fig2dev -L shape on file, output to out, or -1 */
+
+static double
+run_shape(file, out)
+    char	*file, *out;
+{
+    struct rusage	ru0, ru1;
+    pid_t		pid;
+    int			status;
+
+    fflush(stdout);
+    getrusage(RUSAGE_CHILDREN, &ru0);
+    if ((pid = fork()) < 0) {
+	perror("fork");
+	exit(2);
+    }
+    if (pid == 0) {
+	if (freopen(out, "w", stdout) == NULL)
+	    _exit(2);
+	execl(fig2dev, fig2dev, "-L", "shape", file, (char *) NULL);
+	perror(fig2dev);
+	_exit(2);
+    }
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status))
+	return -1.0;
+    getrusage(RUSAGE_CHILDREN, &ru1);
+    if (WEXITSTATUS(status) != 0)
+	return -1.0;
+    return (ru1.ru_utime.tv_sec - ru0.ru_utime.tv_sec) +
+	   (ru1.ru_stime.tv_sec - ru0.ru_stime.tv_sec) +
+	   1e-6 * ((ru1.ru_utime.tv_usec - ru0.ru_utime.tv_usec) +
+		   (ru1.ru_stime.tv_usec - ru0.ru_stime.tv_usec));
+}
+
+int
+main(argc, argv)
+    int		argc;
+    char	*argv[];
+{
+    char	file[64], out[64];
+    struct stat	st;
+    double	secs;
+    int		n = 1000, m = 8, steps = 5, waves = 0;
+    int		c, i, k;
+
+    while ((c = getopt(argc, argv, "f:n:m:s:k")) != EOF)
+	switch (c) {
+	  case 'f': fig2dev = optarg; break;
+	  case 'n': n = atoi(optarg); break;
+	  case 'm': m = atoi(optarg); break;
+	  case 's': steps = atoi(optarg); break;
+	  case 'k': waves = 1; break;
+	  default:
+	    fprintf(stderr, "usage: %s [-f fig2dev] [-n points] [-m waves] [-s steps] [-k]\n",
+		    argv[0]);
+	    exit(2);
+	}
+    if (m < 1 || n < 32 * m || steps < 1) {
+	fprintf(stderr, "shapebench: -n must be at least 32 times -m\n");
+	exit(2);
+    }
+
+    sprintf(file, "/tmp/shapebench%d.fig", (int) getpid());
+    sprintf(out, "/tmp/shapebench%d.tex", (int) getpid());
+    srand(1);
+    /* start the program once so that it is in the cache */
+    (void) make_figure(file, n, m);
+    (void) run_shape(file, out);
+
+    printf("%8s %6s %9s %10s %9s %15s %8s\n", "points", "waves",
+	   "crossings", "output", "seconds", "us/((n+k)lg n)", "ns/byte");
+    for (i = 0; i < steps && n >= 32 * m; i++) {
+	k = make_figure(file, n, m);
+	secs = run_shape(file, out);
+	if (secs < 0.0 || stat(out, &st) < 0 || st.st_size == 0)
+	    printf("%8d %6d %9d    failed\n", n, m, k);
+	else
+	    printf("%8d %6d %9d %10ld %9.3f %15.3f %8.1f\n", n, m, k,
+		   (long) st.st_size, secs,
+		   1e6 * secs / ((n + k) * log((double) n) / log(2.0)),
+		   1e9 * secs / st.st_size);
+	if (waves)
+	    m *= 2;
+	else
+	    n *= 2;
+    }
+    unlink(file);
+    unlink(out);
+    exit(0);
+}
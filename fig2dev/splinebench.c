@@ -0,0 +1,180 @@
+/*
+ * TransFig: Facility for Translating Fig code
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish and/or distribute copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that this copyright
+ * notice remain intact.
+ *
+ */
+
+/*
+ * splinebench: flatten random X-splines with the batched evaluator of
+ * trans_spline.c and with the scalar one (trans_spline.c compiled with
+ * -DSCALAR_SPLINE, linked in as scalar_xspline_points()), check that both
+ * give the same points and report the time each takes.
+ *
+ *	splinebench [-n splines] [-p points] [-r rounds] [-t tolerance] [-s seed]
+ *
+ * "make splinebench" builds it.  The exit status is 1 if the points differ.
+ */
+
+#include "fig2dev.h"
+#include "object.h"
+#include "trans_spline.h"
+#include <time.h>
+
+extern F_pos	*scalar_xspline_points();
+
+char	Err_mem[] = "Running out of memory.";
+
+void
+put_msg(char *fmt, ...)
+{
+    va_list argptr;
+
+    va_start(argptr, fmt);
+    vfprintf(stderr, fmt, argptr);
+    va_end(argptr);
+    fprintf(stderr, "\n");
+}
+
+/* not used: create_line_with_spline() is not called */
+int
+pack_points(l)
+    F_line	*l;
+{
+    return 1;
+}
+
+static F_spline *
+random_spline(npts)
+    int		npts;
+{
+    F_spline	*s;
+    F_point	*p, **pp;
+    F_control	*c = NULL, **cp;
+    int		i;
+
+    s = (F_spline *) calloc(1, sizeof(F_spline));
+    s->type = 4 + (rand() & 1);			/* open or closed X-spline */
+    pp = &s->points;
+    cp = &s->controls;
+    for (i = 0; i < npts; i++) {
+	p = (F_point *) calloc(1, sizeof(F_point));
+	p->x = rand() % 12000;
+	p->y = rand() % 12000;
+	*pp = p;
+	pp = &p->next;
+	c = (F_control *) calloc(1, sizeof(F_control));
+	/* a mix of approximating, interpolating and in-between shapes */
+	switch (rand() % 4) {
+	  case 0:  c->s = 1.0; break;
+	  case 1:  c->s = -1.0; break;
+	  case 2:  c->s = 0.0; break;
+	  default: c->s = (rand() % 2001 - 1000) / 1000.0; break;
+	}
+	*cp = c;
+	cp = &c->next;
+    }
+    /* the ends of an open spline are angular */
+    if (open_spline(s))
+	s->controls->s = c->s = 0.0;
+    return s;
+}
+
+int
+main(argc, argv)
+    int		argc;
+    char	*argv[];
+{
+    F_spline	**spl;
+    F_pos	*pts, *ref;
+    double	tolerance = 0.25;
+    double	t_batch, t_scalar;
+    clock_t	c0;
+    long	npoints = 0;
+    int		nsplines = 3000, maxpts = 20, rounds = 5, seed = 1;
+    int		i, j, r, n, nref, bad = 0;
+
+    for (i = 1; i < argc - 1; i += 2) {
+	if (strcmp(argv[i], "-n") == 0)
+	    nsplines = atoi(argv[i+1]);
+	else if (strcmp(argv[i], "-p") == 0)
+	    maxpts = atoi(argv[i+1]);
+	else if (strcmp(argv[i], "-r") == 0)
+	    rounds = atoi(argv[i+1]);
+	else if (strcmp(argv[i], "-t") == 0)
+	    tolerance = atof(argv[i+1]);
+	else if (strcmp(argv[i], "-s") == 0)
+	    seed = atoi(argv[i+1]);
+	else
+	    break;
+    }
+    if (i < argc || nsplines < 1 || maxpts < 3 || rounds < 1 ||
+		tolerance <= 0.0) {
+	fprintf(stderr, "usage: %s [-n splines] [-p points] [-r rounds] [-t tolerance] [-s seed]\n",
+		argv[0]);
+	exit(2);
+    }
+
+    srand(seed);
+    spl = (F_spline **) malloc(nsplines * sizeof(F_spline *));
+    for (i = 0; i < nsplines; i++)
+	spl[i] = random_spline(3 + rand() % (maxpts - 2));
+
+    /* the same points from both */
+    ref = NULL;
+    for (i = 0; i < nsplines; i++) {
+	if ((pts = scalar_xspline_points(spl[i], tolerance, &nref)) == NULL)
+	    exit(1);
+	ref = (F_pos *) realloc(ref, nref * sizeof(F_pos));
+	memcpy(ref, pts, nref * sizeof(F_pos));
+	if ((pts = xspline_points(spl[i], tolerance, &n)) == NULL)
+	    exit(1);
+	npoints += n;
+	if (n != nref) {
+	    fprintf(stderr, "spline %d: %d points, scalar %d\n", i, n, nref);
+	    bad++;
+	    continue;
+	}
+	for (j = 0; j < n; j++)
+	    if (pts[j].x != ref[j].x || pts[j].y != ref[j].y) {
+		fprintf(stderr, "spline %d point %d: (%d,%d), scalar (%d,%d)\n",
+			i, j, pts[j].x, pts[j].y, ref[j].x, ref[j].y);
+		bad++;
+		break;
+	    }
+    }
+
+    /* interleave the rounds so that both see the same machine */
+    t_batch = t_scalar = 0.0;
+    for (r = 0; r < rounds; r++) {
+	c0 = clock();
+	for (i = 0; i < nsplines; i++)
+	    (void) scalar_xspline_points(spl[i], tolerance, &n);
+	t_scalar += (double) (clock() - c0) / CLOCKS_PER_SEC;
+	c0 = clock();
+	for (i = 0; i < nsplines; i++)
+	    (void) xspline_points(spl[i], tolerance, &n);
+	t_batch += (double) (clock() - c0) / CLOCKS_PER_SEC;
+    }
+
+    printf("%d splines, %ld points, tolerance %g, %d rounds\n",
+	   nsplines, npoints, tolerance, rounds);
+    printf("scalar  %8.3f s  %8.1f ns/point\n", t_scalar,
+	   1e9 * t_scalar / ((double) npoints * rounds));
+    printf("batched %8.3f s  %8.1f ns/point  (%.2fx)\n", t_batch,
+	   1e9 * t_batch / ((double) npoints * rounds),
+	   t_batch > 0.0 ? t_scalar / t_batch : 0.0);
+    if (bad) {
+	printf("%d splines differ\n", bad);
+	exit(1);
+    }
+    printf("points identical\n");
+    exit(0);
+}
@@ -17,22 +17,17 @@
 #include "alloc.h"
 #include "object.h"
 #include "free.h"
+#include "read.h"
 #include "trans_spline.h"
 
 
-struct zXPoint
-{
-  int x,y;
-}; 
-
-typedef struct zXPoint zXPoint;
-
-
-
 /* declarations for splines */
 
-#define MIN_NUMPOINTS_FOR_QUICK_REDRAW     5
-#define MAX_SPLINE_STEP                    0.2
+/* each segment is cut in at least 2^MIN_SPLINE_DEPTH pieces, so that an
+   S-shaped segment whose middle lies on its chord isn't taken for straight,
+   and in at most 2^MAX_SPLINE_DEPTH */
+#define MIN_SPLINE_DEPTH	2
+#define MAX_SPLINE_DEPTH	10
 
 #define COPY_CONTROL_POINT(P0, S0, P1, S1) \
       P0 = P1; \
@@ -50,105 +45,94 @@ typedef struct zXPoint zXPoint;
       COPY_CONTROL_POINT(P2, S2, P1->next, S1->next);               \
       COPY_CONTROL_POINT(P3, S3, P2->next, S2->next)
 
-#define SPLINE_SEGMENT_LOOP(K, P0, P1, P2, P3, S1, S2, PREC) \
-      step = step_computing(K, P0, P1, P2, P3, S1, S2, PREC);    \
-      spline_segment_computing(step, K, P0, P1, P2, P3, S1, S2)
+#define SPLINE_SEGMENT_LOOP(K, P0, P1, P2, P3, S1, S2, TOL) \
+      if (!spline_segment_computing(K, P0, P1, P2, P3, S1, S2, TOL)) \
+	  return NULL
+
 
+/* one segment of an X-spline, between p1 and p2 */
 
+typedef struct {
+  int     k;
+  F_point *p0, *p1, *p2, *p3;
+  double  s1, s2;
+} Segment;
 
-static void          spline_segment_computing();
-static float         step_computing();
-static INLINE void   point_adding();
+static Boolean       spline_segment_computing();
+#ifdef SCALAR_SPLINE
+static Boolean       segment_flattening();
 static INLINE void   point_computing();
 static INLINE void   negative_s1_influence();
 static INLINE void   negative_s2_influence();
 static INLINE void   positive_s1_influence();
 static INLINE void   positive_s2_influence();
+#else
+static void          segment_computing();
+#endif
 static INLINE double f_blend();
 static INLINE double g_blend();
 static INLINE double h_blend();
-static void          free_point_array();
-static int           num_points();
-static void          too_many_points();
+static void          arrow_trimming();
 static F_line	     *create_line();
 static F_point	     *create_point();
 static F_control     *create_cpoint();
 
 /************** CURVE DRAWING FACILITIES ****************/
 
+/* the points of the last spline, reused from one spline to the next */
 static int	npoints;
-static zXPoint *points;
-static int	max_points;
-static int	allocstep;
+static F_pos   *points = NULL;
+static int	max_points = 0;
 
 
 static void
-free_point_array(pts)
-     zXPoint *pts;
+init_point_array()
 {
-  free(pts);
+    npoints = 0;
 }
 
 
+/* make room for n more points */
 
 static		Boolean
-init_point_array(init_size, step_size)
-    int		    init_size, step_size;
+reserve_points(n)
+    int		    n;
 {
-    npoints = 0;
-    max_points = init_size;
-    allocstep = step_size;
-    if (max_points > MAXNUMPTS) {
-	max_points = MAXNUMPTS;
-    }
-    if ((points = (zXPoint *) malloc(max_points * sizeof(zXPoint))) == 0) {
-	fprintf(stderr, "xfig: insufficient memory to allocate point array\n");
+    F_pos	   *tmp_p;
+    int		    new_max;
+
+    if (npoints + n <= max_points)
+	return True;
+    for (new_max = max_points ? max_points : 512; new_max < npoints + n; )
+	new_max *= 2;
+    if ((tmp_p = (F_pos *) realloc(points, new_max * sizeof(F_pos))) == 0) {
+	put_msg(Err_mem);
 	return False;
     }
+    points = tmp_p;
+    max_points = new_max;
     return True;
 }
 
+/* add a point, for which there must be room */
 
-
-static void
-too_many_points()
-{
-  fprintf(stderr,
-	  "Too many points, recompile with MAXNUMPTS > %d in trans_spline.h\n",
-	  MAXNUMPTS);
-}
-
+#define ADD_POINT(X, Y) \
+    { int x_ = (X), y_ = (Y); \
+      /* ignore identical points */ \
+      if (npoints == 0 || points[npoints-1].x != x_ || \
+		points[npoints-1].y != y_) { \
+	  points[npoints].x = x_; \
+	  points[npoints].y = y_; \
+	  npoints++; \
+      } }
 
 static		Boolean
 add_point(x, y)
     int		    x, y;
 {
-    if (npoints >= max_points) {
-	zXPoint	       *tmp_p;
-
-	if (max_points >= MAXNUMPTS) {
-	    max_points = MAXNUMPTS;
-	    return False;		/* stop; it is not closing */
-	}
-	max_points += allocstep;
-	if (max_points >= MAXNUMPTS)
-	    max_points = MAXNUMPTS;
-
-	if ((tmp_p = (zXPoint *) realloc(points,
-					max_points * sizeof(zXPoint))) == 0) {
-	    fprintf(stderr,
-		    "xfig: insufficient memory to reallocate point array\n");
-	    return False;
-	}
-	points = tmp_p;
-    }
-    /* ignore identical points */
-    if (npoints > 0 &&
-	points[npoints-1].x == x && points[npoints-1].y == y)
-		return True;
-    points[npoints].x = x;
-    points[npoints].y = y;
-    npoints++;
+    if (!reserve_points(1))
+	return False;
+    ADD_POINT(x, y);
     return True;
 }
 
@@ -163,21 +147,24 @@ add_point(x, y)
 
     by Carole BLANC and Christophe SCHLICK, Proceedings of SIGGRAPH'95
 
+ The segments are flattened adaptively: a piece of a segment is cut in
+ two until the middle of the curve lies within tolerance (in Fig units)
+ of the chord.  X-splines are rational curves, so there is no exact
+ Bezier form to hand to the drivers instead.
+
 ***********************************************************************/
 
 
-zXPoint *
-compute_open_spline(spline, precision)
+static F_pos *
+compute_open_spline(spline, tolerance)
      F_spline	   *spline;
-     float         precision;
+     double        tolerance;
 {
   int       k;
-  float     step;
   F_point   *p0, *p1, *p2, *p3;
   F_control *s0, *s1, *s2, *s3;
 
-  if (!init_point_array(300, 200))
-      return NULL;
+  init_point_array();
 
   p1 = spline->points;
   for (k=0; p1->next; k++) {
@@ -188,7 +175,7 @@ compute_open_spline(spline, precision)
   if (k==1) {
       if (!add_point(p0->x,p0->y) ||
 	  !add_point(p1->x,p1->y))
-		too_many_points();
+		return NULL;
       return points;
   }
 
@@ -203,7 +190,7 @@ compute_open_spline(spline, precision)
   }
 
   for (k = 0 ;  ; k++) {
-      SPLINE_SEGMENT_LOOP(k, p0, p1, p2, p3, s1->s, s2->s, precision);
+      SPLINE_SEGMENT_LOOP(k, p0, p1, p2, p3, s1->s, s2->s, tolerance);
       if (p3->next == NULL)
 	break;
       NEXT_CONTROL_POINTS(p0, s0, p1, s1, p2, s2, p3, s3);
@@ -212,56 +199,51 @@ compute_open_spline(spline, precision)
   COPY_CONTROL_POINT(p0, s0, p1, s1);
   COPY_CONTROL_POINT(p1, s1, p2, s2);
   COPY_CONTROL_POINT(p2, s2, p3, s3);
-  SPLINE_SEGMENT_LOOP(k, p0, p1, p2, p3, s1->s, s2->s, precision);
+  SPLINE_SEGMENT_LOOP(k, p0, p1, p2, p3, s1->s, s2->s, tolerance);
   
   if (!add_point(p3->x, p3->y))
-    too_many_points();
+    return NULL;
   
   return points;
 }
 
 
-zXPoint *
-compute_closed_spline(spline, precision)
+static F_pos *
+compute_closed_spline(spline, tolerance)
      F_spline	   *spline;
-     float         precision;
+     double        tolerance;
 {
   int k, i;
-  float     step;
   F_point   *p0, *p1, *p2, *p3, *first;
   F_control *s0, *s1, *s2, *s3, *s_first;
 
-  if (!init_point_array(300, 200))
-      return NULL;
+  init_point_array();
 
   INIT_CONTROL_POINTS(spline, p0, s0, p1, s1, p2, s2, p3, s3);
   COPY_CONTROL_POINT(first, s_first, p0, s0); 
 
   for (k = 0 ; p3 != NULL ; k++) {
-      SPLINE_SEGMENT_LOOP(k, p0, p1, p2, p3, s1->s, s2->s, precision);
+      SPLINE_SEGMENT_LOOP(k, p0, p1, p2, p3, s1->s, s2->s, tolerance);
       NEXT_CONTROL_POINTS(p0, s0, p1, s1, p2, s2, p3, s3);
   }
   /* when we are at the end, join to the beginning */
   COPY_CONTROL_POINT(p3, s3, first, s_first);
-  SPLINE_SEGMENT_LOOP(k, p0, p1, p2, p3, s1->s, s2->s, precision);
+  SPLINE_SEGMENT_LOOP(k, p0, p1, p2, p3, s1->s, s2->s, tolerance);
 
   for (i = 0; i < 2; i++) {
       k++;
       NEXT_CONTROL_POINTS(p0, s0, p1, s1, p2, s2, p3, s3);
-      SPLINE_SEGMENT_LOOP(k, p0, p1, p2, p3, s1->s, s2->s, precision);
+      SPLINE_SEGMENT_LOOP(k, p0, p1, p2, p3, s1->s, s2->s, tolerance);
   }
 
   if (!add_point(points[0].x,points[0].y))
-    too_many_points();
+    return NULL;
 
   return points;
 }
 
 
-
 #define Q(s)  (-(s))
-#define EQN_NUMERATOR(dim) \
-  (A_blend[0]*p0->dim+A_blend[1]*p1->dim+A_blend[2]*p2->dim+A_blend[3]*p3->dim)
 
 static INLINE double
 f_blend(numerator, denominator)
@@ -289,6 +271,17 @@ h_blend(u, q)
    return (u * (q + u * (2 * q + u2 * (-2*q - u*q))));
 }
 
+#ifdef SCALAR_SPLINE
+
+/*
+ * The segments are evaluated one point at a time and flattened recursively,
+ * as before the batched evaluator below.  Compile with -DSCALAR_SPLINE to
+ * use it; splinebench checks that both give the same points.
+ */
+
+#define EQN_NUMERATOR(dim) \
+  (A_blend[0]*p0->dim+A_blend[1]*p1->dim+A_blend[2]*p2->dim+A_blend[3]*p3->dim)
+
 static INLINE void
 negative_s1_influence(t, s1, A0, A2)
      double       t, s1, *A0 ,*A2;
@@ -333,202 +326,337 @@ positive_s2_influence(k, t, s2, A1, A3)
   *A3 = (t+k+1>Tk) ? f_blend(t+k+1-Tk, k+3-Tk) : 0.0;
 }
 
+/* the point of the segment at parameter t */
+
 static INLINE void
-point_adding(A_blend, p0, p1, p2, p3)
-     F_point     *p0, *p1, *p2, *p3;
-     double      *A_blend;
+point_computing(seg, t, x, y)
+     Segment     *seg;
+     double      t;
+     double      *x, *y;
 {
+  double A_blend[4];
   double weights_sum;
+  F_point *p0 = seg->p0, *p1 = seg->p1, *p2 = seg->p2, *p3 = seg->p3;
+
+  if (seg->s1 < 0)
+      negative_s1_influence(t, seg->s1, &A_blend[0], &A_blend[2]);
+  else
+      positive_s1_influence(seg->k, t, seg->s1, &A_blend[0], &A_blend[2]);
+  if (seg->s2 < 0)
+      negative_s2_influence(t, seg->s2, &A_blend[1], &A_blend[3]);
+  else
+      positive_s2_influence(seg->k, t, seg->s2, &A_blend[1], &A_blend[3]);
 
   weights_sum = A_blend[0] + A_blend[1] + A_blend[2] + A_blend[3];
-  if (!add_point(round(EQN_NUMERATOR(x) / (weights_sum)),
-		 round(EQN_NUMERATOR(y) / (weights_sum))))
-      too_many_points();
+
+  *x = EQN_NUMERATOR(x) / weights_sum;
+  *y = EQN_NUMERATOR(y) / weights_sum;
 }
 
-static INLINE void
-point_computing(A_blend, p0, p1, p2, p3, x, y)
-     F_point     *p0, *p1, *p2, *p3;
-     double      *A_blend;
-     int         *x, *y;
+/* add the points of the piece of the segment from t0 to t1, but the first */
+
+static Boolean
+segment_flattening(seg, t0, x0, y0, t1, x1, y1, depth, tolerance)
+     Segment     *seg;
+     double      t0, x0, y0, t1, x1, y1;
+     int         depth;
+     double      tolerance;
 {
-  double weights_sum;
+  double tm, xm, ym, dx, dy, len2, dist;
 
-  weights_sum = A_blend[0] + A_blend[1] + A_blend[2] + A_blend[3];
+  tm = (t0 + t1) / 2.0;
+  point_computing(seg, tm, &xm, &ym);
 
-  *x = round(EQN_NUMERATOR(x) / (weights_sum));
-  *y = round(EQN_NUMERATOR(y) / (weights_sum));
+  if (depth < MAX_SPLINE_DEPTH) {
+      if (depth < MIN_SPLINE_DEPTH) {
+	  dist = tolerance + 1.0;
+      } else {
+	  /* distance of the middle of the curve from the chord */
+	  dx = x1 - x0;
+	  dy = y1 - y0;
+	  len2 = dx*dx + dy*dy;
+	  if (len2 == 0.0)
+	      dist = sqrt((xm-x0)*(xm-x0) + (ym-y0)*(ym-y0));
+	  else
+	      dist = fabs((xm-x0)*dy - (ym-y0)*dx) / sqrt(len2);
+      }
+      if (dist > tolerance)
+	  return segment_flattening(seg, t0, x0, y0, tm, xm, ym, depth+1,
+				    tolerance) &&
+		 segment_flattening(seg, tm, xm, ym, t1, x1, y1, depth+1,
+				    tolerance);
+  }
+  return add_point(round(x1), round(y1));
 }
 
-static float
-step_computing(k, p0, p1, p2, p3, s1, s2, precision)
+static Boolean
+spline_segment_computing(k, p0, p1, p2, p3, s1, s2, tolerance)
      int     k;
      F_point *p0, *p1, *p2, *p3;
      double  s1, s2;
-     float   precision;
+     double  tolerance;
 {
-  double A_blend[4];
-  int    xstart, ystart, xend, yend, xmid, ymid, xlength, ylength;
-  int    start_to_end_dist, number_of_steps;
-  float  step, angle_cos, scal_prod, xv1, xv2, yv1, yv2, sides_length_prod;
-  
-  /* This function computes the step used to draw the segment (p1, p2)
-     (xv1, yv1) : coordinates of the vector from middle to origin
-     (xv2, yv2) : coordinates of the vector from middle to extremity */
-
-  /* compute coordinates of the origin */
-  if (s1>0) {
-      if (s2<0) {
-	  positive_s1_influence(k, 0.0, s1, &A_blend[0], &A_blend[2]);
-	  negative_s2_influence(0.0, s2, &A_blend[1], &A_blend[3]); 
+  Segment seg;
+  double  x0, y0, x1, y1;
+
+  seg.k = k;
+  seg.p0 = p0;
+  seg.p1 = p1;
+  seg.p2 = p2;
+  seg.p3 = p3;
+  seg.s1 = s1;
+  seg.s2 = s2;
+
+  point_computing(&seg, 0.0, &x0, &y0);
+  point_computing(&seg, 1.0, &x1, &y1);
+  return add_point(round(x0), round(y0)) &&
+	 segment_flattening(&seg, 0.0, x0, y0, 1.0, x1, y1, 0, tolerance);
+}
+
+#else /* SCALAR_SPLINE */
+
+/*
+ * Compute the points of the segment at the n parameters t[] into x[], y[].
+ * The branches on the shape factors are taken once per segment, so that the
+ * loops over the parameters are straight polynomial code that the compiler
+ * can keep in registers (and vectorize).  The arithmetic is the same as in
+ * point_computing(), so the points come out the same.
+ */
+
+#define BLEND_BATCH	64
+
+static void
+segment_computing(seg, t, x, y, n)
+     Segment     *seg;
+     double      *t, *x, *y;
+     int         n;
+{
+  double A0[BLEND_BATCH], A1[BLEND_BATCH], A2[BLEND_BATCH], A3[BLEND_BATCH];
+  double Tk0, Tk1, Tk2, Tk3, q1, q2, weights_sum;
+  double x0 = seg->p0->x, x1 = seg->p1->x, x2 = seg->p2->x, x3 = seg->p3->x;
+  double y0 = seg->p0->y, y1 = seg->p1->y, y2 = seg->p2->y, y3 = seg->p3->y;
+  int    k = seg->k;
+  int    i, m;
+
+  Tk0 = k+1+seg->s1;
+  Tk2 = k+1-seg->s1;
+  Tk1 = k+2+seg->s2;
+  Tk3 = k+2-seg->s2;
+  q1 = Q(seg->s1);
+  q2 = Q(seg->s2);
+
+  for ( ; n > 0; t += m, x += m, y += m, n -= m) {
+      m = n < BLEND_BATCH ? n : BLEND_BATCH;
+
+      /* influence of p0 and p2 */
+      if (seg->s1 < 0) {
+	  for (i = 0; i < m; i++) {
+	      A0[i] = h_blend(-t[i], q1);
+	      A2[i] = g_blend(t[i], q1);
+	  }
       } else {
-	  positive_s1_influence(k, 0.0, s1, &A_blend[0], &A_blend[2]);
-	  positive_s2_influence(k, 0.0, s2, &A_blend[1], &A_blend[3]); 
+	  for (i = 0; i < m; i++) {
+	      A0[i] = (t[i]+k+1<Tk0) ? f_blend(t[i]+k+1-Tk0, k-Tk0) : 0.0;
+	      A2[i] = f_blend(t[i]+k+1-Tk2, k+2-Tk2);
+	  }
       }
-      point_computing(A_blend, p0, p1, p2, p3, &xstart, &ystart);
-  } else {
-      xstart = p1->x;
-      ystart = p1->y;
-  }
-  
-  /* compute coordinates  of the extremity */
-  if (s2>0) {
-      if (s1<0) {
-	  negative_s1_influence(1.0, s1, &A_blend[0], &A_blend[2]);
-	  positive_s2_influence(k, 1.0, s2, &A_blend[1], &A_blend[3]);
+      /* influence of p1 and p3 */
+      if (seg->s2 < 0) {
+	  for (i = 0; i < m; i++) {
+	      A1[i] = g_blend(1-t[i], q2);
+	      A3[i] = h_blend(t[i]-1, q2);
+	  }
       } else {
-	  positive_s1_influence(k, 1.0, s1, &A_blend[0], &A_blend[2]);
-	  positive_s2_influence(k, 1.0, s2, &A_blend[1], &A_blend[3]); 
+	  for (i = 0; i < m; i++) {
+	      A1[i] = f_blend(t[i]+k+1-Tk1, k+1-Tk1);
+	      A3[i] = (t[i]+k+1>Tk3) ? f_blend(t[i]+k+1-Tk3, k+3-Tk3) : 0.0;
+	  }
       }
-      point_computing(A_blend, p0, p1, p2, p3, &xend, &yend);
-  } else {
-      xend = p2->x;
-      yend = p2->y;
-  }
-
-  /* compute coordinates  of the middle */
-  if (s2>0) {
-      if (s1<0) {
-	  negative_s1_influence(0.5, s1, &A_blend[0], &A_blend[2]);
-	  positive_s2_influence(k, 0.5, s2, &A_blend[1], &A_blend[3]);
-      } else {
-	  positive_s1_influence(k, 0.5, s1, &A_blend[0], &A_blend[2]);
-	  positive_s2_influence(k, 0.5, s2, &A_blend[1], &A_blend[3]); 
+      for (i = 0; i < m; i++) {
+	  weights_sum = A0[i] + A1[i] + A2[i] + A3[i];
+	  x[i] = (A0[i]*x0+A1[i]*x1+A2[i]*x2+A3[i]*x3) / weights_sum;
+	  y[i] = (A0[i]*y0+A1[i]*y1+A2[i]*y2+A3[i]*y3) / weights_sum;
       }
-  } else if (s1<0) {
-      negative_s1_influence(0.5, s1, &A_blend[0], &A_blend[2]);
-      negative_s2_influence(0.5, s2, &A_blend[1], &A_blend[3]);
-  } else {
-      positive_s1_influence(k, 0.5, s1, &A_blend[0], &A_blend[2]);
-      negative_s2_influence(0.5, s2, &A_blend[1], &A_blend[3]);
   }
-  point_computing(A_blend, p0, p1, p2, p3, &xmid, &ymid);
-
-  xv1 = xstart - xmid;
-  yv1 = ystart - ymid;
-  xv2 = xend - xmid;
-  yv2 = yend - ymid;
-
-  scal_prod = xv1*xv2 + yv1*yv2;
-  
-  sides_length_prod = sqrt((xv1*xv1 + yv1*yv1)*(xv2*xv2 + yv2*yv2));
+}
 
-  /* compute cosinus of origin-middle-extremity angle, which approximates the
-     curve of the spline segment */
+/*
+ * Flatten one segment.  The pieces are refined a level at a time: the
+ * middles of all pieces that may still be too coarse are computed in one
+ * batch, and a piece is halved if the curve at its middle is further than
+ * tolerance from the chord.  At most 2^MAX_SPLINE_DEPTH+1 points, so the
+ * room for them is made once per segment.
+ */
 
-/* IG: Wed Oct  1 13:16:46 BST 1997: Fix floating-point exception bug */
+#define MAX_SEG_POINTS	((1 << MAX_SPLINE_DEPTH) + 1)
 
-   if (sides_length_prod == 0.0)
-     angle_cos = 0.0;
-   else
-     angle_cos = scal_prod/sides_length_prod; 
+static double	seg_t[2][MAX_SEG_POINTS], seg_x[2][MAX_SEG_POINTS],
+		seg_y[2][MAX_SEG_POINTS];
+static char	seg_open[2][MAX_SEG_POINTS];	/* piece from here on not done */
+static double	mid_t[MAX_SEG_POINTS], mid_x[MAX_SEG_POINTS],
+		mid_y[MAX_SEG_POINTS];
 
-  xlength = xend - xstart;
-  ylength = yend - ystart;
+static Boolean
+spline_segment_computing(k, p0, p1, p2, p3, s1, s2, tolerance)
+     int     k;
+     F_point *p0, *p1, *p2, *p3;
+     double  s1, s2;
+     double  tolerance;
+{
+  Segment seg;
+  double  *t, *x, *y, *nt, *nx, *ny;
+  double  dx, dy, len2, dist;
+  char    *open, *nopen;
+  int     i, j, n, nn, nmid, depth, cur;
+
+  seg.k = k;
+  seg.p0 = p0;
+  seg.p1 = p1;
+  seg.p2 = p2;
+  seg.p3 = p3;
+  seg.s1 = s1;
+  seg.s2 = s2;
+
+  /* the pieces of the first MIN_SPLINE_DEPTH levels are always halved */
+  cur = 0;
+  n = (1 << MIN_SPLINE_DEPTH) + 1;
+  t = seg_t[cur];
+  for (i = 0; i < n; i++) {
+      t[i] = (double) i / (n - 1);
+      seg_open[cur][i] = True;
+  }
+  segment_computing(&seg, t, seg_x[cur], seg_y[cur], n);
+
+  for (depth = MIN_SPLINE_DEPTH; depth < MAX_SPLINE_DEPTH; depth++) {
+      t = seg_t[cur]; x = seg_x[cur]; y = seg_y[cur]; open = seg_open[cur];
+      for (i = nmid = 0; i < n-1; i++)
+	  if (open[i])
+	      mid_t[nmid++] = (t[i] + t[i+1]) / 2.0;
+      if (nmid == 0)
+	  break;
+      segment_computing(&seg, mid_t, mid_x, mid_y, nmid);
+
+      nt = seg_t[1-cur]; nx = seg_x[1-cur]; ny = seg_y[1-cur];
+      nopen = seg_open[1-cur];
+      for (i = j = nn = 0; i < n-1; i++) {
+	  nt[nn] = t[i]; nx[nn] = x[i]; ny[nn] = y[i];
+	  nopen[nn++] = False;
+	  if (!open[i])
+	      continue;
+	  /* distance of the middle of the curve from the chord */
+	  dx = x[i+1] - x[i];
+	  dy = y[i+1] - y[i];
+	  len2 = dx*dx + dy*dy;
+	  if (len2 == 0.0)
+	      dist = sqrt((mid_x[j]-x[i])*(mid_x[j]-x[i]) +
+			  (mid_y[j]-y[i])*(mid_y[j]-y[i]));
+	  else
+	      dist = fabs((mid_x[j]-x[i])*dy - (mid_y[j]-y[i])*dx) / sqrt(len2);
+	  if (dist > tolerance) {
+	      nopen[nn-1] = True;
+	      nt[nn] = mid_t[j]; nx[nn] = mid_x[j]; ny[nn] = mid_y[j];
+	      nopen[nn++] = True;
+	  }
+	  j++;
+      }
+      nt[nn] = t[n-1]; nx[nn] = x[n-1]; ny[nn] = y[n-1];
+      nopen[nn++] = False;
+      n = nn;
+      cur = 1 - cur;
+  }
 
-  start_to_end_dist = (int)sqrt((double)xlength*(double)xlength + (double)ylength*(double)ylength);
+  if (!reserve_points(n))
+      return False;
+  x = seg_x[cur];
+  y = seg_y[cur];
+  for (i = 0; i < n; i++)
+      ADD_POINT(round(x[i]), round(y[i]));
+  return True;
+}
 
-  /* more steps if segment's origin and extremity are remote */
-  number_of_steps = (int)sqrt((double)start_to_end_dist)/2;
+#endif /* SCALAR_SPLINE */
 
-  /* more steps if the curve is high */
-  number_of_steps += (int)((1.0 + angle_cos)*10.0);
+/*
+ * Leave out the points of the curve that lie under an arrowhead, but the tip,
+ * so that the arrowhead follows the direction of the curve where it is
+ * attached instead of the direction of the last tiny piece of the curve.
+ */
 
-  if (number_of_steps == 0 || number_of_steps > 999)
-    step = 1.0;
-  else
-    step = precision/number_of_steps;
-  
-  if ((step > MAX_SPLINE_STEP) || (step == 0))
-    step = MAX_SPLINE_STEP;
-  return step;
+static void
+arrow_trimming(s)
+     F_spline *s;
+{
+  int	i, n;
+  double dx, dy, len;
+
+  if (s->for_arrow && npoints > 2) {
+      len = s->for_arrow->ht / 2.0;
+      for (n = npoints - 2; n > 0; n--) {
+	  dx = points[n].x - points[npoints-1].x;
+	  dy = points[n].y - points[npoints-1].y;
+	  if (dx*dx + dy*dy >= len*len)
+	      break;
+      }
+      points[n+1] = points[npoints-1];
+      npoints = n + 2;
+  }
+  if (s->back_arrow && npoints > 2) {
+      len = s->back_arrow->ht / 2.0;
+      for (n = 1; n < npoints - 1; n++) {
+	  dx = points[n].x - points[0].x;
+	  dy = points[n].y - points[0].y;
+	  if (dx*dx + dy*dy >= len*len)
+	      break;
+      }
+      for (i = 1; n < npoints; i++, n++)
+	  points[i] = points[n];
+      npoints = i;
+  }
 }
 
-static void
-spline_segment_computing(step, k, p0, p1, p2, p3, s1, s2)
-     float   step;
-     F_point *p0, *p1, *p2, *p3;
-     int     k;
-     double  s1, s2;
+/*
+ * Flatten the X-spline s to within tolerance Fig units.  The points are
+ * valid until the next call; *npts is set to their number.
+ */
+
+F_pos *
+xspline_points(s, tolerance, npts)
+    F_spline	   *s;
+    double	   tolerance;
+    int		   *npts;
 {
-  double A_blend[4];
-  double t;
-  
-  if (s1<0) {  
-     if (s2<0) {
-	 for (t=0.0 ; t<1 ; t+=step) {
-	     negative_s1_influence(t, s1, &A_blend[0], &A_blend[2]);
-	     negative_s2_influence(t, s2, &A_blend[1], &A_blend[3]);
-
-	     point_adding(A_blend, p0, p1, p2, p3);
-	 }
-     } else {
-	 for (t = 0.0 ; t<1 ; t+=step) {
-	     negative_s1_influence(t, s1, &A_blend[0], &A_blend[2]);
-	     positive_s2_influence(k, t, s2, &A_blend[1], &A_blend[3]);
-
-	     point_adding(A_blend, p0, p1, p2, p3);
-	 }
-     }
-  } else if (s2<0) {
-      for (t = 0.0 ; t<1 ; t+=step) {
-	     positive_s1_influence(k, t, s1, &A_blend[0], &A_blend[2]);
-	     negative_s2_influence(t, s2, &A_blend[1], &A_blend[3]);
-
-	     point_adding(A_blend, p0, p1, p2, p3);
-	   }
-  } else {
-      for (t = 0.0 ; t<1 ; t+=step) {
-	     positive_s1_influence(k, t, s1, &A_blend[0], &A_blend[2]);
-	     positive_s2_influence(k, t, s2, &A_blend[1], &A_blend[3]);
+  F_pos	*pts;
 
-	     point_adding(A_blend, p0, p1, p2, p3);
-      } 
-  }
+  pts = open_spline(s) ? compute_open_spline(s, tolerance)
+                       : compute_closed_spline(s, tolerance);
+  if (pts == NULL)
+    return NULL;
+  arrow_trimming(s);
+  *npts = npoints;
+  return pts;
 }
 
 
+/*
+ * Make a polyline (or polygon) of the X-spline s, flattened to within
+ * tolerance Fig units.  The line shares the arrows and comments of s.
+ */
+
 F_line *
-create_line_with_spline(s)
+create_line_with_spline(s, tolerance)
     F_spline	   *s;
+    double	   tolerance;
 {
-  zXPoint  *points;
+  F_pos    *pts;
   F_line   *line;
-  int      i = 0;
-  int      start = 0;
+  int      i, n;
   F_point  *ptr, *pt;
-  F_comment *lcomm, *scomm;
   
-  points = open_spline(s) ? compute_open_spline(s, HIGH_PRECISION)
-                          : compute_closed_spline(s, HIGH_PRECISION);
-  if (points==NULL)  
+  if ((pts = xspline_points(s, tolerance, &n)) == NULL)
     return NULL;
 
-
-  if ((line = create_line()) == NULL) {
-    free_point_array(points);
+  if ((line = create_line()) == NULL)
     return NULL;
-  }
   line->style      = s->style;  
   line->thickness  = s->thickness;
   line->pen_color  = s->pen_color;
@@ -541,57 +669,17 @@ create_line_with_spline(s)
   line->cap_style  = s->cap_style;
   line->for_arrow  = s->for_arrow;
   line->back_arrow = s->back_arrow;
-  /* copy the comments */
-  if (s->comments) {
-    scomm = s->comments;
-    line->comments = lcomm = (F_comment *) malloc(COMMENT_SIZE);
-    while (scomm) {
-	lcomm->comment = malloc(strlen(scomm->comment)+1);
-	strcpy(lcomm->comment, scomm->comment);
-	if (scomm->next)
-	    lcomm->next = (F_comment *) malloc(COMMENT_SIZE);
-	else
-	    lcomm->next = NULL;
-	scomm = scomm->next;
-	lcomm = lcomm->next;
-    }
-  }
-  
-  if (s->for_arrow) {
-    s->for_arrow = NULL;
-    if (npoints > ARROW_START) {
-	points[npoints - ARROW_START] = points[npoints - 1];
-	npoints -= (ARROW_START-1);          /* avoid some points to have good 
-					    orientation for arrow */
-    }
-  }
-  if (s->back_arrow) {
-    s->back_arrow = NULL;
-    if (npoints > ARROW_START) {
-	points[ARROW_START - 1] = points[0];   /* avoid some points to have good 
-					      orientation for arrow */
-	npoints -= (ARROW_START - 1);
-	start = ARROW_START - 1;
-    } else {
-	start = 0;
-    }
-  }
+  line->comments   = s->comments;
   
   line->type = open_spline(s) ? T_POLYLINE : T_POLYGON;
   line->radius = 0;
-  line->next = NULL;
-  line->pic = NULL;  
   ptr = NULL;
-  for (i = start; i<npoints+start; i++)
+  for (i = 0; i < n; i++)
     {
       if ((pt = create_point()) == NULL)
-	{
-	  free(points);
-	  free_line(&line);
-	  return NULL;
-	}
-      pt->x = points[i].x;
-      pt->y = points[i].y;
+	return NULL;
+      pt->x = pts[i].x;
+      pt->y = pts[i].y;
       pt->next = NULL;
 
       if (ptr == NULL)
@@ -602,9 +690,9 @@ create_line_with_spline(s)
 	  ptr = ptr->next;
 	}
     }
+  if (!pack_points(line))
+    return NULL;
 
-  free_point_array(points);
-  npoints = 0;
   return line;
 }
 
@@ -647,7 +735,7 @@ create_cpoint()
 {
     F_control	   *cp;
 
-    if ((cp = (F_control *) malloc(CONTROL_SIZE)) == NULL)
+    if ((Control_malloc(cp)) == NULL)
 	fprintf(stderr,Err_mem);
     return cp;
 }
@@ -658,13 +746,17 @@ create_line()
 {
     F_line	   *l;
 
-    if ((l = (F_line *) malloc(LINOBJ_SIZE)) == NULL)
-	fprintf(stderr,Err_mem);
+    if ((Line_malloc(l)) == NULL) {
+	put_msg(Err_mem);
+	return NULL;
+    }
     l->pic = NULL;
     l->next = NULL;
     l->for_arrow = NULL;
     l->back_arrow = NULL;
     l->points = NULL;
+    l->pts = NULL;
+    l->npts = 0;
     l->radius = DEFAULT;
     l->comments = NULL;
     return l;
@@ -675,20 +767,8 @@ create_point()
 {
     F_point	   *p;
 
-    if ((p = (F_point *) malloc(POINT_SIZE)) == NULL)
+    if ((Point_malloc(p)) == NULL)
 	put_msg(Err_mem);
     return p;
 }
 
-
-
-static int
-num_points(points)
-    F_point	   *points;
-{
-    int		    n;
-    F_point	   *p;
-
-    for (p = points, n = 0; p != NULL; p = p->next, n++);
-    return n;
-}
@@ -16,11 +16,14 @@
 #ifndef TRANS_SPLINE_H
 #define TRANS_SPLINE_H
 
-#define         MAXNUMPTS 25000
-#define         HIGH_PRECISION 0.5
-#define         ARROW_START    4
+/* tolerance (in Fig units) for the bounding box of X-splines */
+#define         BOUND_TOLERANCE 1.0
 
-F_line          *create_line_with_spline();
+/* default resolution (dpi) of the output for flattening X-splines */
+#define         DEF_CURVE_RES   600.0
+
+F_line          *create_line_with_spline();	/* (spline, tolerance) */
+F_pos           *xspline_points();		/* (spline, tolerance, &npts) */
     
 int             make_control_factors();
  